@@ -250,6 +250,35 @@ do
             echo -e "::group::Running CA Recovery Unit Tests"
             ./build_pc_linux/demos/projects/PC/linux/test_ca_recovery
 
+            echo -e "::group::Running TLS Transport Tests"
+            ./build_pc_linux/demos/projects/PC/linux/test_tls_async_connect
+            ./build_pc_linux/demos/projects/PC/linux/test_tls_read_ahead
+            ./build_pc_linux/demos/projects/PC/linux/test_tls_runtime_stress
+            ./build_pc_linux/demos/projects/PC/linux/test_tls_buffer_sizing
+            ./build_pc_linux/demos/projects/PC/linux/test_tls_connect_stats
+            ./build_pc_linux/demos/projects/PC/linux/test_tls_der_credentials
+            ./build_pc_linux/demos/projects/PC/linux/test_tls_handshake_rtt
+            ./build_pc_linux/demos/projects/PC/linux/test_tls_cipher_profiles
+            ./build_pc_linux/demos/projects/PC/linux/test_tls_ecp_restartable
+            ./build_pc_linux/demos/projects/PC/linux/test_tls_arena_soak
+            ./build_pc_linux/demos/projects/PC/linux/test_tls_static_contexts
+            ./build_pc_linux/demos/projects/PC/linux/test_tls_recv_borrow
+            ./build_pc_linux/demos/projects/PC/linux/test_tls_verify_cache
+
+            echo -e "::group::Running ADU Download Tests"
+            ./build_pc_linux/demos/projects/PC/linux/test_adu_download
+
+            echo -e "::group::Running Sockets Wrapper Tests"
+            ./build_pc_linux/demos/projects/PC/linux/test_sockets_dns_cache
+            ./build_pc_linux/demos/projects/PC/linux/test_sockets_poll
+            ./build_pc_linux/demos/projects/PC/linux/test_sockets_linger
+            ./build_pc_linux/demos/projects/PC/linux/test_sockets_traffic_class
+            ./build_pc_linux/demos/projects/PC/linux/test_sockets_posix
+            ./build_pc_linux/demos/projects/PC/linux/test_sockets_lwip_dns
+            ./build_pc_linux/demos/projects/PC/linux/test_sockets_freertos_tcpip
+            ./build_pc_linux/demos/projects/PC/linux/test_sockets_lwip
+            ./build_pc_linux/demos/projects/PC/linux/test_sockets_stm32
+
             ;;
         * )
             echo "build for $arg not found";;
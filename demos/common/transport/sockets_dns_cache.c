@@ -0,0 +1,570 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sockets_dns_cache.c
+ * @brief Host name cache with stale answers and background resolution, used by
+ * the sockets wrappers.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the DNS cache. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "SocketsDnsCache"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_ERROR
+#endif
+
+/* Prototype for the function used to print to console on Windows simulator
+ * of FreeRTOS.
+ * The function prints to the console before the network is connected;
+ * then a UDP port after the network has connected. */
+extern void vLoggingPrintf( const char * pcFormatString,
+                            ... );
+
+/* Map the SdkLog macro to the logging function to enable logging
+ * on Windows simulator. */
+#ifndef SdkLog
+    #define SdkLog( message )    vLoggingPrintf message
+#endif
+
+#include "logging_stack.h"
+
+/************ End of logging configuration ****************/
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+/* Socket wrapper include, for the host name length. */
+#include "sockets_wrapper.h"
+
+#include "sockets_dns_cache.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Seconds to ticks, for the second counts of the configuration.
+ */
+#define socketsDNS_CACHE_S_TO_TICKS( ulSeconds )    ( ( TickType_t ) ( ulSeconds ) * ( TickType_t ) configTICK_RATE_HZ )
+
+/**
+ * @brief The cached address of one host name.
+ */
+typedef struct SocketsDnsCacheEntry
+{
+    char cHostName[ SOCKETS_MAX_HOST_NAME_LENGTH + 1 ]; /**< Host name, empty if the entry is free. */
+    uint32_t ulAddress;                                 /**< Cached address, 0 until the name resolved. */
+    TickType_t xStoredTime;                             /**< Tick count when the address was stored. */
+    TickType_t xTtl;                                    /**< Ticks after #SocketsDnsCacheEntry_t.xStoredTime the address is fresh. */
+    TickType_t xRefreshAge;                             /**< Ticks after #SocketsDnsCacheEntry_t.xStoredTime the name is resolved again, portMAX_DELAY for never. */
+    TickType_t xLastUsed;                               /**< Tick count of the last lookup, to evict the least recently used name. */
+    BaseType_t xRefreshing;                             /**< Set while the background task resolves the name. */
+    uint32_t ulFailures;                                /**< Background resolutions that failed since the name last resolved. */
+} SocketsDnsCacheEntry_t;
+
+static SocketsDnsCacheEntry_t xDnsCache[ socketsDNS_CACHE_ENTRIES ];
+static SocketsDnsCacheStats_t xDnsCacheStats;
+
+static SocketsDnsResolver_t xDnsResolver = NULL;
+static TaskHandle_t xDnsCacheTask = NULL;
+
+static SemaphoreHandle_t xDnsCacheMutex = NULL;
+static StaticSemaphore_t xDnsCacheMutexStorage;
+
+/*-----------------------------------------------------------*/
+
+static void prvDnsCacheLock( void )
+{
+    if( xDnsCacheMutex == NULL )
+    {
+        vTaskSuspendAll();
+        {
+            if( xDnsCacheMutex == NULL )
+            {
+                xDnsCacheMutex = xSemaphoreCreateMutexStatic( &xDnsCacheMutexStorage );
+            }
+        }
+        ( void ) xTaskResumeAll();
+    }
+
+    ( void ) xSemaphoreTake( xDnsCacheMutex, portMAX_DELAY );
+}
+/*-----------------------------------------------------------*/
+
+static void prvDnsCacheUnlock( void )
+{
+    ( void ) xSemaphoreGive( xDnsCacheMutex );
+}
+/*-----------------------------------------------------------*/
+
+static void prvWakeRefreshTask( void )
+{
+    if( xDnsCacheTask != NULL )
+    {
+        ( void ) xTaskNotifyGive( xDnsCacheTask );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static SocketsDnsCacheEntry_t * prvFindEntry( const char * pcHostName )
+{
+    SocketsDnsCacheEntry_t * pxEntry = NULL;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < socketsDNS_CACHE_ENTRIES; ulIndex++ )
+    {
+        if( ( xDnsCache[ ulIndex ].cHostName[ 0 ] != '\0' ) &&
+            ( strncmp( xDnsCache[ ulIndex ].cHostName, pcHostName,
+                       SOCKETS_MAX_HOST_NAME_LENGTH ) == 0 ) )
+        {
+            pxEntry = &xDnsCache[ ulIndex ];
+            break;
+        }
+    }
+
+    return pxEntry;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Find the entry of a host name, or else take a free entry, or else the least
+ * recently used one, and set it up for the name without an address.
+ */
+static SocketsDnsCacheEntry_t * prvGetEntryForStore( const char * pcHostName )
+{
+    SocketsDnsCacheEntry_t * pxEntry = prvFindEntry( pcHostName );
+    TickType_t xNow = xTaskGetTickCount();
+    uint32_t ulIndex;
+
+    if( pxEntry == NULL )
+    {
+        for( ulIndex = 0; ( pxEntry == NULL ) && ( ulIndex < socketsDNS_CACHE_ENTRIES ); ulIndex++ )
+        {
+            if( xDnsCache[ ulIndex ].cHostName[ 0 ] == '\0' )
+            {
+                pxEntry = &xDnsCache[ ulIndex ];
+            }
+        }
+
+        if( pxEntry == NULL )
+        {
+            pxEntry = &xDnsCache[ 0 ];
+
+            for( ulIndex = 1; ulIndex < socketsDNS_CACHE_ENTRIES; ulIndex++ )
+            {
+                if( ( xNow - xDnsCache[ ulIndex ].xLastUsed ) > ( xNow - pxEntry->xLastUsed ) )
+                {
+                    pxEntry = &xDnsCache[ ulIndex ];
+                }
+            }
+
+            LogInfo( ( "Evicting %s for %s.", pxEntry->cHostName, pcHostName ) );
+            xDnsCacheStats.ulEvictions++;
+        }
+
+        ( void ) memset( pxEntry, 0, sizeof( SocketsDnsCacheEntry_t ) );
+        ( void ) strcpy( pxEntry->cHostName, pcHostName );
+        pxEntry->xStoredTime = xNow;
+        pxEntry->xLastUsed = xNow;
+    }
+
+    return pxEntry;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetAddress( SocketsDnsCacheEntry_t * pxEntry,
+                           uint32_t ulAddress,
+                           uint32_t ulTtlSeconds )
+{
+    if( ulTtlSeconds == 0U )
+    {
+        ulTtlSeconds = socketsDNS_CACHE_DEFAULT_TTL_S;
+    }
+    else if( ulTtlSeconds < socketsDNS_CACHE_MIN_TTL_S )
+    {
+        ulTtlSeconds = socketsDNS_CACHE_MIN_TTL_S;
+    }
+    else if( ulTtlSeconds > socketsDNS_CACHE_MAX_TTL_S )
+    {
+        ulTtlSeconds = socketsDNS_CACHE_MAX_TTL_S;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    pxEntry->ulAddress = ulAddress;
+    pxEntry->xStoredTime = xTaskGetTickCount();
+    pxEntry->xTtl = socketsDNS_CACHE_S_TO_TICKS( ulTtlSeconds );
+    pxEntry->xRefreshAge = ( socketsDNS_CACHE_PREFETCH_PERCENT > 0U ) ?
+                           ( pxEntry->xTtl / 100U ) * socketsDNS_CACHE_PREFETCH_PERCENT :
+                           portMAX_DELAY;
+    pxEntry->xRefreshing = pdFALSE;
+    pxEntry->ulFailures = 0;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Whether an entry has no address Sockets_DnsCache_Lookup would return: the
+ * name never resolved, or its address is past the stale window.
+ */
+static BaseType_t prvIsUnusable( const SocketsDnsCacheEntry_t * pxEntry )
+{
+    TickType_t xAge = xTaskGetTickCount() - pxEntry->xStoredTime;
+
+    return ( ( pxEntry->ulAddress == 0U ) ||
+             ( ( xAge >= pxEntry->xTtl ) &&
+               ( ( xAge - pxEntry->xTtl ) >= socketsDNS_CACHE_S_TO_TICKS( socketsDNS_CACHE_MAX_STALE_S ) ) ) ) ?
+           pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Claim the next name due to be resolved again, or else get the time until
+ * one is due.
+ */
+static BaseType_t prvClaimRefresh( char * pcHostName,
+                                   TickType_t * pxWait )
+{
+    SocketsDnsCacheEntry_t * pxEntry;
+    TickType_t xNow;
+    TickType_t xAge;
+    TickType_t xTtl;
+    BaseType_t xClaimed = pdFALSE;
+    uint32_t ulIndex;
+
+    *pxWait = portMAX_DELAY;
+
+    prvDnsCacheLock();
+
+    xNow = xTaskGetTickCount();
+
+    for( ulIndex = 0; ( xClaimed == pdFALSE ) && ( ulIndex < socketsDNS_CACHE_ENTRIES ); ulIndex++ )
+    {
+        pxEntry = &xDnsCache[ ulIndex ];
+        xAge = xNow - pxEntry->xStoredTime;
+
+        /* A name that never resolved has no TTL yet. */
+        xTtl = ( pxEntry->xTtl != 0U ) ? pxEntry->xTtl :
+               socketsDNS_CACHE_S_TO_TICKS( socketsDNS_CACHE_DEFAULT_TTL_S );
+
+        if( ( pxEntry->cHostName[ 0 ] == '\0' ) ||
+            ( pxEntry->xRefreshing == pdTRUE ) ||
+            ( pxEntry->xRefreshAge == portMAX_DELAY ) )
+        {
+            continue;
+        }
+        else if( ( socketsDNS_CACHE_IDLE_TTLS > 0U ) &&
+                 ( ( xNow - pxEntry->xLastUsed ) >= ( xTtl * socketsDNS_CACHE_IDLE_TTLS ) ) )
+        {
+            /* Nobody asked for the name for a while, stop resolving it. */
+            LogInfo( ( "Dropping idle DNS cache entry for %s.", pxEntry->cHostName ) );
+            ( void ) memset( pxEntry, 0, sizeof( SocketsDnsCacheEntry_t ) );
+            xDnsCacheStats.ulIdleDrops++;
+        }
+        else if( xAge >= pxEntry->xRefreshAge )
+        {
+            ( void ) strcpy( pcHostName, pxEntry->cHostName );
+            pxEntry->xRefreshing = pdTRUE;
+            xClaimed = pdTRUE;
+        }
+        else if( ( pxEntry->xRefreshAge - xAge ) < *pxWait )
+        {
+            *pxWait = pxEntry->xRefreshAge - xAge;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+
+    prvDnsCacheUnlock();
+
+    return xClaimed;
+}
+/*-----------------------------------------------------------*/
+
+static void prvRefreshDone( const char * pcHostName,
+                            uint32_t ulAddress,
+                            uint32_t ulTtlSeconds )
+{
+    SocketsDnsCacheEntry_t * pxEntry;
+
+    prvDnsCacheLock();
+
+    if( ulAddress != 0U )
+    {
+        /* The entry may have been evicted or cleared in the meantime. */
+        prvSetAddress( prvGetEntryForStore( pcHostName ), ulAddress, ulTtlSeconds );
+        xDnsCacheStats.ulRefreshes++;
+    }
+    else
+    {
+        xDnsCacheStats.ulRefreshFailures++;
+
+        if( ( pxEntry = prvFindEntry( pcHostName ) ) == NULL )
+        {
+            /* Evicted or cleared in the meantime. */
+        }
+        else if( ( socketsDNS_CACHE_MAX_RETRIES > 0U ) &&
+                 ( ++pxEntry->ulFailures >= socketsDNS_CACHE_MAX_RETRIES ) &&
+                 ( prvIsUnusable( pxEntry ) == pdTRUE ) )
+        {
+            /* Nothing to return and no sign it will resolve, stop trying. */
+            LogWarn( ( "Failed to resolve %s %u times, dropping it.",
+                       pcHostName, ( unsigned ) pxEntry->ulFailures ) );
+            ( void ) memset( pxEntry, 0, sizeof( SocketsDnsCacheEntry_t ) );
+            xDnsCacheStats.ulFailureDrops++;
+        }
+        else
+        {
+            LogWarn( ( "Failed to resolve %s again, retrying in %u seconds.",
+                       pcHostName, ( unsigned ) socketsDNS_CACHE_RETRY_S ) );
+            pxEntry->xRefreshing = pdFALSE;
+            pxEntry->xRefreshAge = ( xTaskGetTickCount() - pxEntry->xStoredTime ) +
+                                   socketsDNS_CACHE_S_TO_TICKS( socketsDNS_CACHE_RETRY_S );
+        }
+    }
+
+    prvDnsCacheUnlock();
+}
+/*-----------------------------------------------------------*/
+
+static void prvRefreshTask( void * pvParameters )
+{
+    char cHostName[ SOCKETS_MAX_HOST_NAME_LENGTH + 1 ];
+    TickType_t xWait;
+    uint32_t ulAddress;
+    uint32_t ulTtlSeconds;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        while( prvClaimRefresh( cHostName, &xWait ) == pdTRUE )
+        {
+            ulTtlSeconds = 0;
+            ulAddress = xDnsResolver( cHostName, &ulTtlSeconds );
+            prvRefreshDone( cHostName, ulAddress, ulTtlSeconds );
+        }
+
+        ( void ) ulTaskNotifyTake( pdTRUE, xWait );
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_DnsCache_Init( SocketsDnsResolver_t xResolver )
+{
+    BaseType_t xResult = pdPASS;
+
+    configASSERT( xResolver != NULL );
+
+    prvDnsCacheLock();
+
+    if( xDnsResolver == NULL )
+    {
+        xDnsResolver = xResolver;
+
+        if( xTaskCreate( prvRefreshTask, "DnsCache", socketsDNS_CACHE_TASK_STACK_SIZE,
+                         NULL, socketsDNS_CACHE_TASK_PRIORITY, &xDnsCacheTask ) != pdPASS )
+        {
+            LogError( ( "Failed to create the DNS cache task." ) );
+            xDnsResolver = NULL;
+            xDnsCacheTask = NULL;
+            xResult = pdFAIL;
+        }
+    }
+
+    prvDnsCacheUnlock();
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t Sockets_DnsCache_Lookup( const char * pcHostName )
+{
+    SocketsDnsCacheEntry_t * pxEntry;
+    uint32_t ulAddress = 0;
+    BaseType_t xWake = pdFALSE;
+    TickType_t xNow;
+    TickType_t xAge;
+
+    configASSERT( pcHostName != NULL );
+
+    prvDnsCacheLock();
+
+    pxEntry = prvFindEntry( pcHostName );
+    xNow = xTaskGetTickCount();
+
+    if( ( pxEntry == NULL ) || ( pxEntry->ulAddress == 0U ) )
+    {
+        xDnsCacheStats.ulMisses++;
+    }
+    else
+    {
+        xAge = xNow - pxEntry->xStoredTime;
+        pxEntry->xLastUsed = xNow;
+
+        if( xAge < pxEntry->xTtl )
+        {
+            ulAddress = pxEntry->ulAddress;
+            xDnsCacheStats.ulFreshHits++;
+        }
+        else if( ( xAge - pxEntry->xTtl ) < socketsDNS_CACHE_S_TO_TICKS( socketsDNS_CACHE_MAX_STALE_S ) )
+        {
+            LogInfo( ( "Returning stale address of %s while resolving it again.", pcHostName ) );
+            ulAddress = pxEntry->ulAddress;
+            xDnsCacheStats.ulStaleHits++;
+
+            /* Prefetched names are already due, or wait for the retry delay
+             * of a failed resolution. */
+            if( ( pxEntry->xRefreshing == pdFALSE ) &&
+                ( pxEntry->xRefreshAge == portMAX_DELAY ) )
+            {
+                pxEntry->xRefreshAge = xAge;
+                xWake = pdTRUE;
+            }
+        }
+        else
+        {
+            xDnsCacheStats.ulMisses++;
+        }
+    }
+
+    prvDnsCacheUnlock();
+
+    if( xWake == pdTRUE )
+    {
+        prvWakeRefreshTask();
+    }
+
+    return ulAddress;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t Sockets_DnsCache_Resolve( const char * pcHostName )
+{
+    uint32_t ulAddress = Sockets_DnsCache_Lookup( pcHostName );
+    uint32_t ulTtlSeconds = 0;
+
+    if( ulAddress != 0U )
+    {
+        /* Answered from the cache. */
+    }
+    else if( xDnsResolver == NULL )
+    {
+        LogError( ( "Cannot resolve %s: Sockets_Init was not called.", pcHostName ) );
+    }
+    else
+    {
+        ulAddress = xDnsResolver( pcHostName, &ulTtlSeconds );
+
+        if( ulAddress != 0U )
+        {
+            Sockets_DnsCache_Store( pcHostName, ulAddress, ulTtlSeconds );
+        }
+    }
+
+    return ulAddress;
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_DnsCache_Store( const char * pcHostName,
+                             uint32_t ulAddress,
+                             uint32_t ulTtlSeconds )
+{
+    configASSERT( pcHostName != NULL );
+
+    if( ( ulAddress != 0U ) && ( strlen( pcHostName ) <= SOCKETS_MAX_HOST_NAME_LENGTH ) )
+    {
+        prvDnsCacheLock();
+        prvSetAddress( prvGetEntryForStore( pcHostName ), ulAddress, ulTtlSeconds );
+        prvDnsCacheUnlock();
+
+        /* The name is due to be resolved again at a new time. */
+        prvWakeRefreshTask();
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_DnsCache_Prefetch( const char * pcHostName )
+{
+    SocketsDnsCacheEntry_t * pxEntry;
+    BaseType_t xResult = pdPASS;
+
+    configASSERT( pcHostName != NULL );
+
+    if( strlen( pcHostName ) > SOCKETS_MAX_HOST_NAME_LENGTH )
+    {
+        xResult = pdFAIL;
+    }
+    else
+    {
+        prvDnsCacheLock();
+
+        if( prvFindEntry( pcHostName ) == NULL )
+        {
+            /* Due at once, with no address until it resolved. */
+            pxEntry = prvGetEntryForStore( pcHostName );
+            pxEntry->xRefreshAge = 0;
+        }
+
+        prvDnsCacheUnlock();
+
+        prvWakeRefreshTask();
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_DnsCache_Refresh( const char * pcHostName )
+{
+    SocketsDnsCacheEntry_t * pxEntry;
+    BaseType_t xWake = pdFALSE;
+
+    configASSERT( pcHostName != NULL );
+
+    prvDnsCacheLock();
+
+    if( ( ( pxEntry = prvFindEntry( pcHostName ) ) != NULL ) &&
+        ( pxEntry->xRefreshing == pdFALSE ) )
+    {
+        pxEntry->xRefreshAge = xTaskGetTickCount() - pxEntry->xStoredTime;
+        xWake = pdTRUE;
+    }
+
+    prvDnsCacheUnlock();
+
+    if( xWake == pdTRUE )
+    {
+        prvWakeRefreshTask();
+    }
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_DnsCache_Clear( void )
+{
+    prvDnsCacheLock();
+    ( void ) memset( xDnsCache, 0, sizeof( xDnsCache ) );
+    prvDnsCacheUnlock();
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_DnsCache_GetStats( SocketsDnsCacheStats_t * pxStats )
+{
+    configASSERT( pxStats != NULL );
+
+    prvDnsCacheLock();
+    *pxStats = xDnsCacheStats;
+    prvDnsCacheUnlock();
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,196 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sockets_dns_cache.h
+ * @brief Host name cache used by the sockets wrappers.
+ *
+ * Addresses are kept per host name for the TTL the resolver reported. Once the
+ * TTL elapsed, the address is still returned for up to
+ * socketsDNS_CACHE_MAX_STALE_S while a background task resolves the name
+ * again, and names are resolved again before their TTL elapses, so that a
+ * reconnect to a host the device already connected to does not wait for DNS.
+ */
+
+#ifndef SOCKETS_DNS_CACHE_H
+#define SOCKETS_DNS_CACHE_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/**
+ * @brief Number of host names kept in the cache.
+ */
+#ifndef socketsDNS_CACHE_ENTRIES
+    #define socketsDNS_CACHE_ENTRIES    ( 4 )
+#endif
+
+/**
+ * @brief TTL given to an address when the resolver does not report the TTL of
+ * the record.
+ */
+#ifndef socketsDNS_CACHE_DEFAULT_TTL_S
+    #define socketsDNS_CACHE_DEFAULT_TTL_S    ( 120U )
+#endif
+
+/**
+ * @brief Bounds of the TTL of a cached address.
+ */
+#ifndef socketsDNS_CACHE_MIN_TTL_S
+    #define socketsDNS_CACHE_MIN_TTL_S    ( 10U )
+#endif
+#ifndef socketsDNS_CACHE_MAX_TTL_S
+    #define socketsDNS_CACHE_MAX_TTL_S    ( 3600U )
+#endif
+
+/**
+ * @brief Time after the TTL elapsed during which the address is still returned
+ * while the name is resolved again.
+ */
+#ifndef socketsDNS_CACHE_MAX_STALE_S
+    #define socketsDNS_CACHE_MAX_STALE_S    ( 3600U )
+#endif
+
+/**
+ * @brief Share of the TTL, in percent, after which the name is resolved again.
+ * Set to 0 to resolve names again only once their TTL elapsed and they are
+ * looked up.
+ */
+#ifndef socketsDNS_CACHE_PREFETCH_PERCENT
+    #define socketsDNS_CACHE_PREFETCH_PERCENT    ( 80U )
+#endif
+
+/**
+ * @brief Number of TTLs after which a name that was not looked up is dropped
+ * instead of being resolved again. Names that never resolved count
+ * socketsDNS_CACHE_DEFAULT_TTL_S as their TTL. Set to 0 to keep resolving names
+ * until they are evicted to make room for another.
+ */
+#ifndef socketsDNS_CACHE_IDLE_TTLS
+    #define socketsDNS_CACHE_IDLE_TTLS    ( 4U )
+#endif
+
+/**
+ * @brief Delay before a failed background resolution is attempted again.
+ */
+#ifndef socketsDNS_CACHE_RETRY_S
+    #define socketsDNS_CACHE_RETRY_S    ( 30U )
+#endif
+
+/**
+ * @brief Number of background resolutions in a row that may fail before a name
+ * with no address left to return is dropped. Set to 0 to keep retrying.
+ */
+#ifndef socketsDNS_CACHE_MAX_RETRIES
+    #define socketsDNS_CACHE_MAX_RETRIES    ( 5U )
+#endif
+
+/**
+ * @brief Stack size and priority of the task that resolves names in the
+ * background.
+ */
+#ifndef socketsDNS_CACHE_TASK_STACK_SIZE
+    #define socketsDNS_CACHE_TASK_STACK_SIZE    ( configMINIMAL_STACK_SIZE * 4 )
+#endif
+#ifndef socketsDNS_CACHE_TASK_PRIORITY
+    #define socketsDNS_CACHE_TASK_PRIORITY    ( tskIDLE_PRIORITY + 1 )
+#endif
+
+/**
+ * @brief Resolve a host name, blocking until the lookup completed.
+ *
+ * @param[in] pcHostName Null-terminated host name.
+ * @param[out] pulTtlSeconds TTL of the address, or 0 if it is not known.
+ * @return IPv4 address in network byte order, or 0 if the lookup failed.
+ */
+typedef uint32_t ( * SocketsDnsResolver_t )( const char * pcHostName,
+                                             uint32_t * pulTtlSeconds );
+
+/**
+ * @brief DNS cache counters.
+ */
+typedef struct SocketsDnsCacheStats
+{
+    uint32_t ulFreshHits;       /**< Lookups answered within the TTL. */
+    uint32_t ulStaleHits;       /**< Lookups answered after the TTL elapsed, while the name was resolved again. */
+    uint32_t ulMisses;          /**< Lookups for which no address could be returned. */
+    uint32_t ulRefreshes;       /**< Names resolved again in the background. */
+    uint32_t ulRefreshFailures; /**< Background resolutions that failed. */
+    uint32_t ulEvictions;       /**< Names dropped to make room for another. */
+    uint32_t ulIdleDrops;       /**< Names dropped after not being looked up for socketsDNS_CACHE_IDLE_TTLS TTLs. */
+    uint32_t ulFailureDrops;    /**< Names dropped after socketsDNS_CACHE_MAX_RETRIES failed resolutions. */
+} SocketsDnsCacheStats_t;
+
+/**
+ * @brief Set the resolver of the cache and start its background task.
+ *
+ * Called once, by Sockets_Init of the sockets wrapper; later calls have no
+ * effect. Until then, Sockets_DnsCache_Resolve returns 0.
+ *
+ * @param[in] xResolver Resolver used in the background and by Sockets_DnsCache_Resolve.
+ * @return pdPASS on success, pdFAIL if the task could not be created.
+ */
+BaseType_t Sockets_DnsCache_Init( SocketsDnsResolver_t xResolver );
+
+/**
+ * @brief Get the cached address of a host name without blocking.
+ *
+ * A stale address is returned, and the name is resolved again in the
+ * background.
+ *
+ * @param[in] pcHostName Null-terminated host name.
+ * @return IPv4 address in network byte order, or 0 if none can be returned.
+ */
+uint32_t Sockets_DnsCache_Lookup( const char * pcHostName );
+
+/**
+ * @brief Get the address of a host name, from the cache or else from the
+ * resolver, and cache it.
+ *
+ * @param[in] pcHostName Null-terminated host name.
+ * @return IPv4 address in network byte order, or 0 if the lookup failed.
+ */
+uint32_t Sockets_DnsCache_Resolve( const char * pcHostName );
+
+/**
+ * @brief Cache the address a host name resolved to.
+ *
+ * @param[in] pcHostName Null-terminated host name.
+ * @param[in] ulAddress IPv4 address in network byte order.
+ * @param[in] ulTtlSeconds TTL of the address, or 0 if it is not known.
+ */
+void Sockets_DnsCache_Store( const char * pcHostName,
+                             uint32_t ulAddress,
+                             uint32_t ulTtlSeconds );
+
+/**
+ * @brief Resolve a host name in the background, to have it cached before it
+ * is connected to.
+ *
+ * @param[in] pcHostName Null-terminated host name.
+ * @return pdPASS if the name is cached or will be; pdFAIL if it is too long.
+ */
+BaseType_t Sockets_DnsCache_Prefetch( const char * pcHostName );
+
+/**
+ * @brief Resolve a cached host name again in the background, for example after
+ * a connect to its address failed. The cached address is kept until then.
+ *
+ * @param[in] pcHostName Null-terminated host name.
+ */
+void Sockets_DnsCache_Refresh( const char * pcHostName );
+
+/**
+ * @brief Drop all cached addresses. Counters are kept.
+ */
+void Sockets_DnsCache_Clear( void );
+
+/**
+ * @brief Get a copy of the DNS cache counters.
+ *
+ * @param[out] pxStats Where the counters are copied.
+ */
+void Sockets_DnsCache_GetStats( SocketsDnsCacheStats_t * pxStats );
+
+#endif /* SOCKETS_DNS_CACHE_H */
@@ -0,0 +1,260 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sockets_linger.c
+ * @brief Task that releases shut down sockets once their peer closed, used by
+ * the sockets wrappers.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the linger task. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "SocketsLinger"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_ERROR
+#endif
+
+/* Prototype for the function used to print to console on Windows simulator
+ * of FreeRTOS.
+ * The function prints to the console before the network is connected;
+ * then a UDP port after the network has connected. */
+extern void vLoggingPrintf( const char * pcFormatString,
+                            ... );
+
+/* Map the SdkLog macro to the logging function to enable logging
+ * on Windows simulator. */
+#ifndef SdkLog
+    #define SdkLog( message )    vLoggingPrintf message
+#endif
+
+#include "logging_stack.h"
+
+/************ End of logging configuration ****************/
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "sockets_linger.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A socket waiting for its peer to close.
+ */
+typedef struct SocketsLingerEntry
+{
+    SocketHandle xSocket; /**< Lingering socket. */
+    TickType_t xStart;    /**< Tick count when the socket was handed over. */
+    BaseType_t xInUse;    /**< Set while the entry holds a socket. */
+} SocketsLingerEntry_t;
+
+static SocketsLingerEntry_t xLingerEntries[ socketsLINGER_MAX_SOCKETS ];
+static SocketsLingerStats_t xLingerStats;
+
+static SocketsLingerPoll_t xLingerPoll = NULL;
+static SocketsLingerRelease_t xLingerRelease = NULL;
+static TaskHandle_t xLingerTask = NULL;
+
+static SemaphoreHandle_t xLingerMutex = NULL;
+static StaticSemaphore_t xLingerMutexStorage;
+
+/*-----------------------------------------------------------*/
+
+static void prvLingerLock( void )
+{
+    if( xLingerMutex == NULL )
+    {
+        vTaskSuspendAll();
+        {
+            if( xLingerMutex == NULL )
+            {
+                xLingerMutex = xSemaphoreCreateMutexStatic( &xLingerMutexStorage );
+            }
+        }
+        ( void ) xTaskResumeAll();
+    }
+
+    ( void ) xSemaphoreTake( xLingerMutex, portMAX_DELAY );
+}
+/*-----------------------------------------------------------*/
+
+static void prvLingerUnlock( void )
+{
+    ( void ) xSemaphoreGive( xLingerMutex );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Release the socket of an entry and count how long it lingered.
+ */
+static void prvReleaseEntry( SocketsLingerEntry_t * pxEntry,
+                             BaseType_t xTimedOut )
+{
+    /* The entry can be reused once released, so log the handle copied here. */
+    SocketHandle xSocket = pxEntry->xSocket;
+    uint32_t ulLingerMs = ( uint32_t ) ( ( xTaskGetTickCount() - pxEntry->xStart ) * portTICK_PERIOD_MS );
+
+    xLingerRelease( xSocket );
+
+    prvLingerLock();
+
+    pxEntry->xInUse = pdFALSE;
+    xLingerStats.ulLingering--;
+    xLingerStats.ulTotalLingerMs += ulLingerMs;
+
+    if( ulLingerMs > xLingerStats.ulMaxLingerMs )
+    {
+        xLingerStats.ulMaxLingerMs = ulLingerMs;
+    }
+
+    if( xTimedOut == pdTRUE )
+    {
+        xLingerStats.ulTimedOut++;
+    }
+    else
+    {
+        xLingerStats.ulClosed++;
+    }
+
+    prvLingerUnlock();
+
+    LogInfo( ( "Socket %p released after %u ms%s.", xSocket,
+               ( unsigned ) ulLingerMs, ( xTimedOut == pdTRUE ) ? ", timed out" : "" ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvLingerTask( void * pvParameters )
+{
+    TickType_t xWait = portMAX_DELAY;
+    uint32_t ulIndex;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        ( void ) ulTaskNotifyTake( pdTRUE, xWait );
+
+        /* Only this task frees entries, so a socket in use can be checked
+         * without the lock. */
+        for( ulIndex = 0; ulIndex < socketsLINGER_MAX_SOCKETS; ulIndex++ )
+        {
+            if( xLingerEntries[ ulIndex ].xInUse == pdFALSE )
+            {
+                /* Empty else marker. */
+            }
+            else if( xLingerPoll( xLingerEntries[ ulIndex ].xSocket ) == pdTRUE )
+            {
+                prvReleaseEntry( &xLingerEntries[ ulIndex ], pdFALSE );
+            }
+            else if( ( xTaskGetTickCount() - xLingerEntries[ ulIndex ].xStart ) >=
+                     pdMS_TO_TICKS( socketsLINGER_TIMEOUT_MS ) )
+            {
+                prvReleaseEntry( &xLingerEntries[ ulIndex ], pdTRUE );
+            }
+        }
+
+        prvLingerLock();
+        xWait = ( xLingerStats.ulLingering == 0U ) ? portMAX_DELAY : pdMS_TO_TICKS( socketsLINGER_POLL_MS );
+        prvLingerUnlock();
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Linger_Init( SocketsLingerPoll_t xPoll,
+                                SocketsLingerRelease_t xRelease )
+{
+    BaseType_t xResult = pdPASS;
+
+    configASSERT( ( xPoll != NULL ) && ( xRelease != NULL ) );
+
+    prvLingerLock();
+
+    if( xLingerTask == NULL )
+    {
+        xLingerPoll = xPoll;
+        xLingerRelease = xRelease;
+
+        if( xTaskCreate( prvLingerTask, "SocketsLinger", socketsLINGER_TASK_STACK_SIZE,
+                         NULL, socketsLINGER_TASK_PRIORITY, &xLingerTask ) != pdPASS )
+        {
+            LogError( ( "Failed to create the linger task." ) );
+            xLingerTask = NULL;
+            xResult = pdFAIL;
+        }
+    }
+
+    prvLingerUnlock();
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Linger_Add( SocketHandle xSocket )
+{
+    BaseType_t xResult = pdFAIL;
+    uint32_t ulIndex;
+
+    prvLingerLock();
+
+    if( xLingerTask != NULL )
+    {
+        for( ulIndex = 0; ulIndex < socketsLINGER_MAX_SOCKETS; ulIndex++ )
+        {
+            if( xLingerEntries[ ulIndex ].xInUse == pdFALSE )
+            {
+                xLingerEntries[ ulIndex ].xSocket = xSocket;
+                xLingerEntries[ ulIndex ].xStart = xTaskGetTickCount();
+                xLingerEntries[ ulIndex ].xInUse = pdTRUE;
+                xResult = pdPASS;
+                break;
+            }
+        }
+    }
+
+    if( xResult == pdPASS )
+    {
+        xLingerStats.ulLingering++;
+
+        if( xLingerStats.ulLingering > xLingerStats.ulMaxLingering )
+        {
+            xLingerStats.ulMaxLingering = xLingerStats.ulLingering;
+        }
+    }
+    else
+    {
+        xLingerStats.ulOverflows++;
+    }
+
+    prvLingerUnlock();
+
+    if( xResult == pdPASS )
+    {
+        ( void ) xTaskNotifyGive( xLingerTask );
+    }
+    else
+    {
+        LogWarn( ( "No linger entry left, socket %p released at once.", xSocket ) );
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_Linger_GetStats( SocketsLingerStats_t * pxStats )
+{
+    configASSERT( pxStats != NULL );
+
+    prvLingerLock();
+    ( void ) memcpy( pxStats, &xLingerStats, sizeof( SocketsLingerStats_t ) );
+    prvLingerUnlock();
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,115 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sockets_linger.h
+ * @brief Background close of sockets, used by the sockets wrappers.
+ *
+ * A socket closed with Sockets_CloseAsync has its connection shut down and is
+ * handed to a low priority task, which waits for the peer to close its side
+ * before it releases the socket. The task that closed the socket can connect
+ * again at once instead of waiting for the peer.
+ */
+
+#ifndef SOCKETS_LINGER_H
+#define SOCKETS_LINGER_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include "sockets_wrapper.h"
+
+/**
+ * @brief Number of sockets that can wait for their peer to close at the same
+ * time. A socket closed while all are taken is released at once.
+ */
+#ifndef socketsLINGER_MAX_SOCKETS
+    #define socketsLINGER_MAX_SOCKETS    ( 4 )
+#endif
+
+/**
+ * @brief Time a socket waits for its peer to close before it is released
+ * anyway.
+ */
+#ifndef socketsLINGER_TIMEOUT_MS
+    #define socketsLINGER_TIMEOUT_MS    ( 15000U )
+#endif
+
+/**
+ * @brief Interval at which lingering sockets are checked.
+ */
+#ifndef socketsLINGER_POLL_MS
+    #define socketsLINGER_POLL_MS    ( 100U )
+#endif
+
+/**
+ * @brief Stack size and priority of the task that releases lingering sockets.
+ */
+#ifndef socketsLINGER_TASK_STACK_SIZE
+    #define socketsLINGER_TASK_STACK_SIZE    ( configMINIMAL_STACK_SIZE * 2 )
+#endif
+#ifndef socketsLINGER_TASK_PRIORITY
+    #define socketsLINGER_TASK_PRIORITY    ( tskIDLE_PRIORITY + 1 )
+#endif
+
+/**
+ * @brief Check whether the peer of a shut down socket closed its side,
+ * without blocking. Data still arriving should be discarded.
+ *
+ * @param[in] xSocket Lingering socket.
+ * @return pdTRUE once the socket can be released, pdFALSE otherwise.
+ */
+typedef BaseType_t ( * SocketsLingerPoll_t )( SocketHandle xSocket );
+
+/**
+ * @brief Release a socket.
+ *
+ * @param[in] xSocket Socket to release.
+ */
+typedef void ( * SocketsLingerRelease_t )( SocketHandle xSocket );
+
+/**
+ * @brief Background close counters.
+ */
+typedef struct SocketsLingerStats
+{
+    uint32_t ulClosed;        /**< Sockets that lingered and were released once their peer closed. */
+    uint32_t ulTimedOut;      /**< Sockets released after socketsLINGER_TIMEOUT_MS. */
+    uint32_t ulOverflows;     /**< Sockets released at once as all linger entries were taken. */
+    uint32_t ulLingering;     /**< Sockets lingering now. */
+    uint32_t ulMaxLingering;  /**< Most sockets lingering at the same time. */
+    uint32_t ulTotalLingerMs; /**< Time the released sockets lingered, added up. */
+    uint32_t ulMaxLingerMs;   /**< Longest time a socket lingered. */
+} SocketsLingerStats_t;
+
+/**
+ * @brief Set how lingering sockets are checked and released, and start the
+ * task that does it.
+ *
+ * Only the first call has an effect.
+ *
+ * @param[in] xPoll Check whether a socket can be released.
+ * @param[in] xRelease Release a socket.
+ * @return pdPASS on success, pdFAIL if the task could not be created.
+ */
+BaseType_t Sockets_Linger_Init( SocketsLingerPoll_t xPoll,
+                                SocketsLingerRelease_t xRelease );
+
+/**
+ * @brief Hand a shut down socket to the background task.
+ *
+ * @param[in] xSocket Socket whose connection was shut down.
+ * @return pdPASS if the socket lingers; pdFAIL if all entries are taken or
+ * the task is not running, in which case the caller releases the socket.
+ */
+BaseType_t Sockets_Linger_Add( SocketHandle xSocket );
+
+/**
+ * @brief Get a copy of the background close counters.
+ *
+ * @param[out] pxStats Where the counters are copied.
+ */
+void Sockets_Linger_GetStats( SocketsLingerStats_t * pxStats );
+
+#endif /* SOCKETS_LINGER_H */
@@ -41,10 +41,63 @@ typedef void * SocketHandle;
  */
 #define SOCKETS_SO_RCVTIMEO         ( 0 )          /**< Set the receive timeout. */
 #define SOCKETS_SO_SNDTIMEO         ( 1 )          /**< Set the send timeout. */
+#define SOCKETS_SO_NONBLOCK         ( 2 )          /**< Set or clear non-blocking mode (BaseType_t, pdTRUE/pdFALSE). */
+#define SOCKETS_SO_NODELAY          ( 3 )          /**< Send small segments at once instead of coalescing them (BaseType_t, pdTRUE/pdFALSE). */
+#define SOCKETS_SO_KEEPALIVE        ( 4 )          /**< Probe an idle connection to detect a dead peer (BaseType_t, pdTRUE/pdFALSE). */
+#define SOCKETS_SO_SNDBUF           ( 5 )          /**< Size of the send buffer in bytes (uint32_t). Set before connecting. */
+#define SOCKETS_SO_RCVBUF           ( 6 )          /**< Size of the receive buffer in bytes (uint32_t). Set before connecting. */
+#define SOCKETS_SO_WINDOW           ( 7 )          /**< Buffer and TCP window sizes (SocketsWindow_t). Set before connecting. */
+
+/**
+ * @brief Buffer and window sizes set with #SOCKETS_SO_WINDOW. A buffer size
+ * of 0 keeps the default of the port; a window of 0 spans the whole buffer.
+ * Ports that cannot set the window size apply the buffer sizes only.
+ */
+typedef struct SocketsWindow
+{
+    uint32_t ulSendBufferBytes;    /**< Send buffer. */
+    uint32_t ulSendWindowBytes;    /**< Data sent before waiting for an acknowledgement, at most ulSendBufferBytes. */
+    uint32_t ulReceiveBufferBytes; /**< Receive buffer. */
+    uint32_t ulReceiveWindowBytes; /**< Receive window advertised to the peer, at most ulReceiveBufferBytes. */
+} SocketsWindow_t;
+
+/**
+ * @brief Events of a socket waited for with Sockets_Poll.
+ */
+#define SOCKETS_POLL_READ           ( 1U << 0 )    /**< Data can be received, or the peer closed the connection. */
+#define SOCKETS_POLL_WRITE          ( 1U << 1 )    /**< Data can be sent, or a connect in progress completed. */
+#define SOCKETS_POLL_ERROR          ( 1U << 2 )    /**< The connection failed; always reported. */
+
+/**
+ * @brief Timeout of Sockets_Poll that waits until an event.
+ */
+#define SOCKETS_POLL_WAIT_FOREVER   ( 0xFFFFFFFFU )
+
+/**
+ * @brief A socket waited on with Sockets_Poll.
+ */
+typedef struct SocketsPollFd
+{
+    SocketHandle xSocket; /**< Socket to wait on. */
+    uint32_t ulEvents;    /**< Events to wait for, a mask of SOCKETS_POLL_* values. */
+    uint32_t ulRevents;   /**< Events that occurred, set by Sockets_Poll. */
+} SocketsPollFd_t;
+
+/**
+ * @brief Time spent in each phase of the last connect of a socket.
+ */
+typedef struct SocketsConnectTimes
+{
+    uint32_t ulDnsMs;        /**< Name resolution. */
+    uint32_t ulTcpConnectMs; /**< TCP handshake, from the end of name resolution. */
+} SocketsConnectTimes_t;
 
 /**
  * @brief Initialize the sockets
  *
+ * Call once before connecting any socket; it starts the host name cache of the
+ * ports that have one.
+ *
  * @return A #BaseType_t with the result of the operation.
  *        - On success returns SOCKETS_ERROR_NONE
  */
@@ -88,6 +141,39 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
                             const char * pcHostName,
                             uint16_t usPort );
 
+/**
+ * @brief Start connecting the socket to hostname and port without blocking.
+ *
+ * Name resolution and the TCP handshake continue in the background; call
+ * Sockets_ConnectPoll() until it stops returning SOCKETS_EWOULDBLOCK. Closing
+ * the socket abandons a connect in progress. The socket should be in
+ * non-blocking mode (#SOCKETS_SO_NONBLOCK); otherwise the TCP handshake may
+ * wait for the receive timeout. Ports that cannot connect in the background
+ * connect before returning.
+ *
+ * @param[in] xSocket The #SocketHandle used for this call.
+ * @param[in] pcHostName `NULL` terminated hostname, only used during this call.
+ * @param[in] usPort Connecting port.
+ * @return A #BaseType_t with the result of the operation.
+ *        - SOCKETS_ERROR_NONE if the socket is already connected.
+ *        - SOCKETS_EWOULDBLOCK if the connect is in progress.
+ *        - On failure returns negative error code.
+ */
+BaseType_t Sockets_ConnectStart( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort );
+
+/**
+ * @brief Check on a connect started with Sockets_ConnectStart().
+ *
+ * @param[in] xSocket The #SocketHandle used for this call.
+ * @return A #BaseType_t with the result of the operation.
+ *        - SOCKETS_ERROR_NONE once the socket is connected.
+ *        - SOCKETS_EWOULDBLOCK while the connect is in progress.
+ *        - On failure returns negative error code.
+ */
+BaseType_t Sockets_ConnectPoll( SocketHandle xSocket );
+
 /**
  * @brief Disconnect socket handle.
  *
@@ -95,6 +181,20 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
  */
 void Sockets_Disconnect( SocketHandle xSocket );
 
+/**
+ * @brief Disconnect and close socket handle without waiting for the peer.
+ *
+ * Replaces Sockets_Disconnect() followed by Sockets_Close(). The connection is
+ * shut down and, on ports whose graceful disconnect blocks, the socket is
+ * released in the background once the peer closed its side or after a
+ * timeout. The handle must not be used after this call.
+ *
+ * @param[in] xSocket The #SocketHandle used for this call.
+ * @return A #BaseType_t with the result of the operation.
+ *        - On success returns SOCKETS_ERROR_NONE
+ */
+BaseType_t Sockets_CloseAsync( SocketHandle xSocket );
+
 /**
  * @brief Receive data from socket handle.
  *
@@ -103,6 +203,8 @@ void Sockets_Disconnect( SocketHandle xSocket );
  * @param[in] xReceiveBufferLength Length of the buffer.
  * @return A #BaseType_t with the result of the operation.
  *        - On success returns number of bytes copied.
+ *        - Returns 0 if no data arrived within the receive timeout, or at
+ *          once in non-blocking mode.
  *        - On failure return neagtive error code.
  */
 BaseType_t Sockets_Recv( SocketHandle xSocket,
@@ -117,6 +219,8 @@ BaseType_t Sockets_Recv( SocketHandle xSocket,
  * @param[in] xDataLength Length of the data to be sent.
  * @return A #BaseType_t with the result of the operation.
  *        - On success returns number of bytes sent.
+ *        - In non-blocking mode, returns 0 or SOCKETS_EWOULDBLOCK if no
+ *          data could be queued.
  */
 BaseType_t Sockets_Send( SocketHandle xSocket,
                          const uint8_t * pucData,
@@ -131,10 +235,60 @@ BaseType_t Sockets_Send( SocketHandle xSocket,
  * @param[in] xOptionLength Lenght of option value.
  * @return A #BaseType_t with the result of the operation.
  *        - On success returns SOCKETS_ERROR_NONE
+ *        - SOCKETS_ENOPROTOOPT if the port does not support the option or
+ *          value.
  */
 BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
                                int32_t lOptionName,
                                const void * pvOptionValue,
                                size_t xOptionLength );
 
+/**
+ * @brief Wait until one of several sockets can be read or written, or failed.
+ *
+ * Lets one task serve several connections: it waits here, then receives or
+ * sends on the sockets that are ready, in non-blocking mode
+ * (#SOCKETS_SO_NONBLOCK) or with short timeouts. A socket should be polled by
+ * one task at a time.
+ *
+ * @param[in,out] pxSockets Sockets with the events to wait for; the events
+ * that occurred are set in #SocketsPollFd_t.ulRevents.
+ * @param[in] xSocketCount Number of entries in pxSockets.
+ * @param[in] ulTimeoutMs Time to wait for an event, 0 to check without
+ * waiting, or #SOCKETS_POLL_WAIT_FOREVER.
+ * @return A #BaseType_t with the result of the operation.
+ *        - On success returns the number of sockets with events, 0 if the
+ *          timeout elapsed first.
+ *        - On failure returns negative error code.
+ */
+BaseType_t Sockets_Poll( SocketsPollFd_t * pxSockets,
+                         size_t xSocketCount,
+                         uint32_t ulTimeoutMs );
+
+/**
+ * @brief Get the time spent in each phase of the last connect of a socket.
+ *
+ * Valid once Sockets_Connect() or Sockets_ConnectPoll() reported the socket
+ * connected, until it is closed. Times are only kept for a few sockets at a
+ * time; the oldest are dropped first.
+ *
+ * @param[in] xSocket The #SocketHandle used for this call.
+ * @param[out] pxTimes Where the times are copied.
+ * @return A #BaseType_t with the result of the operation.
+ *        - On success returns SOCKETS_ERROR_NONE
+ *        - SOCKETS_ENOTCONN if no connect of the socket was timed.
+ */
+BaseType_t Sockets_GetConnectTimes( SocketHandle xSocket,
+                                    SocketsConnectTimes_t * pxTimes );
+
+/**
+ * @brief Resolve a host name in the background, so that connecting to it later
+ * does not wait for DNS. The name is then kept resolved while it is used.
+ *
+ * Ports without a host name cache ignore the call.
+ *
+ * @param[in] pcHostName `NULL` terminated hostname.
+ */
+void Sockets_Prefetch( const char * pcHostName );
+
 #endif /* SOCKETS_WRAPPER_H */
@@ -7,17 +7,21 @@
  */
 
 #include "sockets_wrapper.h"
+#include "sockets_dns_cache.h"
+#include "sockets_linger.h"
 
 /* Standard includes. */
 #include <string.h>
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
+#include "task.h"
 
 /* FreeRTOS+TCP includes. */
 #include "FreeRTOS_IP.h"
 #include "FreeRTOS_Sockets.h"
 #include "FreeRTOS_DNS.h"
+#include "FreeRTOS_TCP_IP.h"
 /*-----------------------------------------------------------*/
 
 /* Maximum number of times to call FreeRTOS_recv when initiating a graceful shutdown. */
@@ -28,11 +32,355 @@
 /* A negative error code indicating a network failure. */
 #define FREERTOS_SOCKETS_WRAPPER_NETWORK_ERROR    ( -1 )
 
+/* Maximum number of sockets that can be in Sockets_ConnectStart at the same time. */
+#ifndef FREERTOS_SOCKETS_WRAPPER_MAX_PENDING_CONNECTS
+    #define FREERTOS_SOCKETS_WRAPPER_MAX_PENDING_CONNECTS    ( 4 )
+#endif
+
+/* Time given to a non-blocking DNS lookup to complete. */
+#ifndef FREERTOS_SOCKETS_WRAPPER_DNS_TIMEOUT_MS
+    #define FREERTOS_SOCKETS_WRAPPER_DNS_TIMEOUT_MS    ( 20000U )
+#endif
+
+/* Number of sockets whose connect times are kept by Sockets_GetConnectTimes. */
+#ifndef FREERTOS_SOCKETS_WRAPPER_TIMED_CONNECTS
+    #define FREERTOS_SOCKETS_WRAPPER_TIMED_CONNECTS    ( 4 )
+#endif
+
+/**
+ * @brief State of a connect started with Sockets_ConnectStart.
+ */
+typedef struct PendingConnect
+{
+    Socket_t xSocket;                 /**< Socket being connected, or NULL if the entry is free. */
+    uint16_t usPort;                  /**< Remote port. */
+    volatile uint32_t ulIPAddress;    /**< Resolved address, 0 if the lookup failed. */
+    volatile BaseType_t xDnsComplete; /**< Set once the lookup finished. */
+    BaseType_t xConnectStarted;       /**< Set once FreeRTOS_connect was called. */
+    char cHostName[ SOCKETS_MAX_HOST_NAME_LENGTH + 1 ]; /**< Name looked up in the background, to cache its address; empty otherwise. */
+} PendingConnect_t;
+
+/**
+ * @brief Time spent in each phase of the last connect of a socket.
+ */
+typedef struct ConnectTimes
+{
+    Socket_t xSocket;             /**< Socket timed, or NULL if the entry is free. */
+    TickType_t xPhaseStart;       /**< Start of the phase in progress. */
+    BaseType_t xComplete;         /**< Set once the socket connected. */
+    SocketsConnectTimes_t xTimes; /**< Phase durations. */
+} ConnectTimes_t;
+
+/*-----------------------------------------------------------*/
+
+static PendingConnect_t xPendingConnects[ FREERTOS_SOCKETS_WRAPPER_MAX_PENDING_CONNECTS ];
+
+static ConnectTimes_t xConnectTimes[ FREERTOS_SOCKETS_WRAPPER_TIMED_CONNECTS ];
+
+/* Entry reused next when no entry is free. */
+static size_t xNextConnectTimes = 0;
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Find the pending connect of a socket, or a free entry if xSocket is NULL.
+ */
+static PendingConnect_t * prvPendingConnectGet( Socket_t xSocket )
+{
+    PendingConnect_t * pxPending = NULL;
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < FREERTOS_SOCKETS_WRAPPER_MAX_PENDING_CONNECTS; xIndex++ )
+    {
+        if( xPendingConnects[ xIndex ].xSocket == xSocket )
+        {
+            pxPending = &xPendingConnects[ xIndex ];
+            break;
+        }
+    }
+
+    return pxPending;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Reserve a pending connect entry for a socket.
+ */
+static PendingConnect_t * prvPendingConnectAlloc( Socket_t xSocket )
+{
+    PendingConnect_t * pxPending;
+
+    taskENTER_CRITICAL();
+    {
+        pxPending = prvPendingConnectGet( NULL );
+
+        if( pxPending != NULL )
+        {
+            ( void ) memset( pxPending, 0, sizeof( PendingConnect_t ) );
+            pxPending->xSocket = xSocket;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return pxPending;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Release a pending connect entry, cancelling its lookup if still running.
+ */
+static void prvPendingConnectFree( PendingConnect_t * pxPending )
+{
+    #if ( ipconfigDNS_USE_CALLBACKS == 1 )
+        if( pxPending->xDnsComplete == pdFALSE )
+        {
+            FreeRTOS_gethostbyname_cancel( pxPending );
+        }
+    #endif
+
+    taskENTER_CRITICAL();
+    {
+        pxPending->xSocket = NULL;
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Find the connect times of a socket, or a free entry if xSocket is NULL.
+ */
+static ConnectTimes_t * prvConnectTimesGet( Socket_t xSocket )
+{
+    ConnectTimes_t * pxTimes = NULL;
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < FREERTOS_SOCKETS_WRAPPER_TIMED_CONNECTS; xIndex++ )
+    {
+        if( xConnectTimes[ xIndex ].xSocket == xSocket )
+        {
+            pxTimes = &xConnectTimes[ xIndex ];
+            break;
+        }
+    }
+
+    return pxTimes;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Start timing a connect, reusing the oldest entry if none is free.
+ */
+static void prvConnectTimesStart( Socket_t xSocket )
+{
+    ConnectTimes_t * pxTimes;
+
+    taskENTER_CRITICAL();
+    {
+        if( ( ( pxTimes = prvConnectTimesGet( xSocket ) ) == NULL ) &&
+            ( ( pxTimes = prvConnectTimesGet( NULL ) ) == NULL ) )
+        {
+            pxTimes = &xConnectTimes[ xNextConnectTimes ];
+            xNextConnectTimes = ( xNextConnectTimes + 1 ) % FREERTOS_SOCKETS_WRAPPER_TIMED_CONNECTS;
+        }
+
+        ( void ) memset( pxTimes, 0, sizeof( ConnectTimes_t ) );
+        pxTimes->xSocket = xSocket;
+        pxTimes->xPhaseStart = xTaskGetTickCount();
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Record the end of name resolution, or of the TCP handshake.
+ */
+static void prvConnectTimesPhaseDone( Socket_t xSocket,
+                                      BaseType_t xConnected )
+{
+    ConnectTimes_t * pxTimes;
+    TickType_t xNow = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+    {
+        if( ( ( pxTimes = prvConnectTimesGet( xSocket ) ) != NULL ) &&
+            ( pxTimes->xComplete == pdFALSE ) )
+        {
+            if( xConnected == pdFALSE )
+            {
+                pxTimes->xTimes.ulDnsMs = ( uint32_t ) ( ( xNow - pxTimes->xPhaseStart ) * portTICK_PERIOD_MS );
+            }
+            else
+            {
+                pxTimes->xTimes.ulTcpConnectMs = ( uint32_t ) ( ( xNow - pxTimes->xPhaseStart ) * portTICK_PERIOD_MS );
+                pxTimes->xComplete = pdTRUE;
+            }
+
+            pxTimes->xPhaseStart = xNow;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+#if ( ipconfigDNS_USE_CALLBACKS == 1 )
+
+/*
+ * Called from the IP task when a lookup started by Sockets_ConnectStart
+ * completes or times out. The address is cached by Sockets_ConnectPoll, as the
+ * IP task must not wait for the cache mutex.
+ */
+    static void prvDnsCallback( const char * pcName,
+                                void * pvSearchID,
+                                uint32_t ulIPAddress )
+    {
+        PendingConnect_t * pxPending = ( PendingConnect_t * ) pvSearchID;
+
+        ( void ) pcName;
+
+        pxPending->ulIPAddress = ulIPAddress;
+        pxPending->xDnsComplete = pdTRUE;
+    }
+
+#endif /* ipconfigDNS_USE_CALLBACKS == 1 */
+/*-----------------------------------------------------------*/
+
+/*
+ * Resolver of the DNS cache. FreeRTOS+TCP does not report the TTL of the
+ * record, so the cache uses its default TTL; the FreeRTOS+TCP cache honours
+ * the TTL of the record, so resolving a name again before it elapsed sends no
+ * query.
+ */
+static uint32_t prvResolve( const char * pcHostName,
+                            uint32_t * pulTtlSeconds )
+{
+    *pulTtlSeconds = 0;
+
+    return FreeRTOS_gethostbyname( pcHostName );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Send the SYN to the resolved address.
+ */
+static BaseType_t prvStartTcpConnect( PendingConnect_t * pxPending )
+{
+    struct freertos_sockaddr xServerAddress = { 0 };
+    BaseType_t xResult;
+
+    xServerAddress.sin_family = FREERTOS_AF_INET;
+    xServerAddress.sin_port = FreeRTOS_htons( pxPending->usPort );
+    xServerAddress.sin_addr = pxPending->ulIPAddress;
+    xServerAddress.sin_len = ( uint8_t ) sizeof( xServerAddress );
+
+    pxPending->xConnectStarted = pdTRUE;
+    prvConnectTimesPhaseDone( pxPending->xSocket, pdFALSE );
+
+    /* In non-blocking mode FreeRTOS_connect only sends the SYN. */
+    xResult = FreeRTOS_connect( pxPending->xSocket, &xServerAddress, sizeof( xServerAddress ) );
+
+    if( ( xResult == 0 ) || ( xResult == -pdFREERTOS_ERRNO_EWOULDBLOCK ) )
+    {
+        xResult = SOCKETS_EWOULDBLOCK;
+    }
+    else
+    {
+        xResult = SOCKETS_SOCKET_ERROR;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Check a socket closed with Sockets_CloseAsync. It stays connected in
+ * FIN_WAIT_1 and FIN_WAIT_2, until the FIN of the peer arrives.
+ */
+static BaseType_t prvLingerPoll( SocketHandle xSocket )
+{
+    uint8_t pucDummyBuffer[ 16 ];
+
+    while( FreeRTOS_recv( ( Socket_t ) xSocket, pucDummyBuffer, sizeof( pucDummyBuffer ),
+                          FREERTOS_MSG_DONTWAIT ) > 0 )
+    {
+        /* Discard data the peer sent before it closed. */
+    }
+
+    return ( FreeRTOS_issocketconnected( ( Socket_t ) xSocket ) == pdTRUE ) ? pdFALSE : pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvLingerRelease( SocketHandle xSocket )
+{
+    ( void ) FreeRTOS_closesocket( ( Socket_t ) xSocket );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Drop the pending connect and connect times of a socket being closed.
+ */
+static void prvSocketEntriesFree( Socket_t xSocket )
+{
+    PendingConnect_t * pxPending = prvPendingConnectGet( xSocket );
+    ConnectTimes_t * pxTimes;
+
+    if( pxPending != NULL )
+    {
+        prvPendingConnectFree( pxPending );
+    }
+
+    taskENTER_CRITICAL();
+    {
+        if( ( pxTimes = prvConnectTimesGet( xSocket ) ) != NULL )
+        {
+            pxTimes->xSocket = NULL;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+#if ( ipconfigUSE_TCP_WIN == 1 )
+
+/*
+ * Set the buffer sizes and sliding windows of a socket that is not connected
+ * yet. FreeRTOS+TCP counts windows in segments.
+ */
+    static BaseType_t prvSetWindow( Socket_t xTcpSocket,
+                                    const SocketsWindow_t * pxWindow )
+    {
+        WinProperties_t xProperties;
+
+        xProperties.lTxBufSize = ( int32_t ) ( ( pxWindow->ulSendBufferBytes != 0U ) ?
+                                               pxWindow->ulSendBufferBytes : ipconfigTCP_TX_BUFFER_LENGTH );
+        xProperties.lRxBufSize = ( int32_t ) ( ( pxWindow->ulReceiveBufferBytes != 0U ) ?
+                                               pxWindow->ulReceiveBufferBytes : ipconfigTCP_RX_BUFFER_LENGTH );
+        xProperties.lTxWinSize = ( int32_t ) ( ( pxWindow->ulSendWindowBytes != 0U ) ?
+                                               pxWindow->ulSendWindowBytes : ( uint32_t ) xProperties.lTxBufSize );
+        xProperties.lRxWinSize = ( int32_t ) ( ( pxWindow->ulReceiveWindowBytes != 0U ) ?
+                                               pxWindow->ulReceiveWindowBytes : ( uint32_t ) xProperties.lRxBufSize );
+
+        xProperties.lTxWinSize = ( xProperties.lTxWinSize + ipconfigTCP_MSS - 1 ) / ipconfigTCP_MSS;
+        xProperties.lRxWinSize = ( xProperties.lRxWinSize + ipconfigTCP_MSS - 1 ) / ipconfigTCP_MSS;
+
+        return ( FreeRTOS_setsockopt( xTcpSocket, 0, FREERTOS_SO_WIN_PROPERTIES,
+                                      &xProperties, sizeof( xProperties ) ) != 0 ) ?
+               SOCKETS_EINVAL : SOCKETS_ERROR_NONE;
+    }
+
+#endif /* ipconfigUSE_TCP_WIN == 1 */
 /*-----------------------------------------------------------*/
 
 BaseType_t Sockets_Init()
 {
-    return SOCKETS_ERROR_NONE;
+    BaseType_t xRetVal = SOCKETS_ERROR_NONE;
+
+    if( ( Sockets_DnsCache_Init( prvResolve ) != pdPASS ) ||
+        ( Sockets_Linger_Init( prvLingerPoll, prvLingerRelease ) != pdPASS ) )
+    {
+        xRetVal = SOCKETS_ENOMEM;
+    }
+
+    return xRetVal;
 }
 /*-----------------------------------------------------------*/
 
@@ -62,6 +410,8 @@ SocketHandle Sockets_Open()
 
 BaseType_t Sockets_Close( SocketHandle xSocket )
 {
+    prvSocketEntriesFree( ( Socket_t ) xSocket );
+
     return ( BaseType_t ) FreeRTOS_closesocket( ( Socket_t ) xSocket );
 }
 /*-----------------------------------------------------------*/
@@ -75,13 +425,17 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
     struct freertos_sockaddr xServerAddress = { 0 };
     uint32_t ulIPAddres;
 
-    /* Check for errors from DNS lookup. */
-    if( ( ulIPAddres = ( uint32_t ) FreeRTOS_gethostbyname( pcHostName ) ) == 0 )
+    prvConnectTimesStart( xTcpSocket );
+
+    /* Check for errors from DNS lookup. A cached address returns at once. */
+    if( ( ulIPAddres = Sockets_DnsCache_Resolve( pcHostName ) ) == 0 )
     {
         lRetVal = SOCKETS_SOCKET_ERROR;
     }
     else
     {
+        prvConnectTimesPhaseDone( xTcpSocket, pdFALSE );
+
         /* Connection parameters. */
         xServerAddress.sin_family = FREERTOS_AF_INET;
         xServerAddress.sin_port = FreeRTOS_htons( usPort );
@@ -91,6 +445,14 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
         if( FreeRTOS_connect( xTcpSocket, &xServerAddress, sizeof( xServerAddress ) ) != 0 )
         {
             lRetVal = SOCKETS_SOCKET_ERROR;
+
+            /* The host may have moved; the cached address is kept until the
+             * name resolved again. */
+            Sockets_DnsCache_Refresh( pcHostName );
+        }
+        else
+        {
+            prvConnectTimesPhaseDone( xTcpSocket, pdTRUE );
         }
     }
 
@@ -98,6 +460,130 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_ConnectStart( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort )
+{
+    PendingConnect_t * pxPending;
+    BaseType_t xRetVal;
+
+    #if ( ipconfigDNS_USE_CALLBACKS == 1 )
+        uint32_t ulIPAddress;
+    #endif
+
+    if( ( pxPending = prvPendingConnectAlloc( ( Socket_t ) xSocket ) ) == NULL )
+    {
+        xRetVal = SOCKETS_ENOMEM;
+    }
+    else
+    {
+        pxPending->usPort = usPort;
+        prvConnectTimesStart( ( Socket_t ) xSocket );
+
+        pxPending->ulIPAddress = Sockets_DnsCache_Lookup( pcHostName );
+
+        if( pxPending->ulIPAddress == 0U )
+        {
+            #if ( ipconfigDNS_USE_CALLBACKS == 1 )
+                /* Returns the address at once if FreeRTOS+TCP has it cached;
+                 * otherwise prvDnsCallback is called when the lookup completes,
+                 * possibly before this call returns 0, so 0 must not overwrite
+                 * the address it stored. The name is kept so that
+                 * Sockets_ConnectPoll can cache the answer. */
+                if( strlen( pcHostName ) <= ( size_t ) SOCKETS_MAX_HOST_NAME_LENGTH )
+                {
+                    ( void ) strcpy( pxPending->cHostName, pcHostName );
+                }
+
+                ulIPAddress = FreeRTOS_gethostbyname_a( pcHostName, prvDnsCallback, pxPending,
+                                                        pdMS_TO_TICKS( FREERTOS_SOCKETS_WRAPPER_DNS_TIMEOUT_MS ) );
+
+                if( ulIPAddress != 0U )
+                {
+                    pxPending->ulIPAddress = ulIPAddress;
+                }
+            #else
+                /* Without DNS callbacks the lookup blocks. */
+                pxPending->ulIPAddress = Sockets_DnsCache_Resolve( pcHostName );
+                pxPending->xDnsComplete = pdTRUE;
+            #endif
+        }
+
+        if( pxPending->ulIPAddress != 0U )
+        {
+            pxPending->xDnsComplete = pdTRUE;
+        }
+
+        xRetVal = Sockets_ConnectPoll( xSocket );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectPoll( SocketHandle xSocket )
+{
+    Socket_t xTcpSocket = ( Socket_t ) xSocket;
+    PendingConnect_t * pxPending = prvPendingConnectGet( xTcpSocket );
+    BaseType_t xRetVal;
+    BaseType_t xTcpState;
+
+    if( pxPending == NULL )
+    {
+        xRetVal = ( FreeRTOS_issocketconnected( xTcpSocket ) == pdTRUE ) ?
+                  SOCKETS_ERROR_NONE : SOCKETS_ENOTCONN;
+    }
+    else if( pxPending->xDnsComplete == pdFALSE )
+    {
+        xRetVal = SOCKETS_EWOULDBLOCK;
+    }
+    else if( pxPending->ulIPAddress == 0U )
+    {
+        xRetVal = SOCKETS_SOCKET_ERROR;
+    }
+    else if( pxPending->xConnectStarted == pdFALSE )
+    {
+        /* Cache the address of a background lookup, in this task rather than
+         * in the IP task that reported it. */
+        if( pxPending->cHostName[ 0 ] != '\0' )
+        {
+            Sockets_DnsCache_Store( pxPending->cHostName, pxPending->ulIPAddress, 0 );
+            pxPending->cHostName[ 0 ] = '\0';
+        }
+
+        xRetVal = prvStartTcpConnect( pxPending );
+    }
+    else if( FreeRTOS_issocketconnected( xTcpSocket ) == pdTRUE )
+    {
+        prvConnectTimesPhaseDone( xTcpSocket, pdTRUE );
+        xRetVal = SOCKETS_ERROR_NONE;
+    }
+    else
+    {
+        xTcpState = FreeRTOS_connstatus( xTcpSocket );
+
+        if( ( xTcpState == ( BaseType_t ) eCONNECT_SYN ) ||
+            ( xTcpState == ( BaseType_t ) eSYN_FIRST ) ||
+            ( xTcpState == ( BaseType_t ) eSYN_RECEIVED ) )
+        {
+            xRetVal = SOCKETS_EWOULDBLOCK;
+        }
+        else
+        {
+            /* Refused, or the SYN was not answered. */
+            xRetVal = SOCKETS_SOCKET_ERROR;
+        }
+    }
+
+    if( ( pxPending != NULL ) && ( xRetVal != SOCKETS_EWOULDBLOCK ) )
+    {
+        prvPendingConnectFree( pxPending );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
 void Sockets_Disconnect( SocketHandle xSocket )
 {
     BaseType_t xWaitForShutdownLoopCount = 0;
@@ -124,6 +610,26 @@ void Sockets_Disconnect( SocketHandle xSocket )
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_CloseAsync( SocketHandle xSocket )
+{
+    Socket_t xTcpSocket = ( Socket_t ) xSocket;
+
+    prvSocketEntriesFree( xTcpSocket );
+
+    /* Send the FIN, and leave waiting for the FIN of the peer to the linger
+     * task. A socket that is not connected, or that finds no linger entry, is
+     * released at once. */
+    if( ( FreeRTOS_shutdown( xTcpSocket, FREERTOS_SHUT_RDWR ) != 0 ) ||
+        ( Sockets_Linger_Init( prvLingerPoll, prvLingerRelease ) != pdPASS ) ||
+        ( Sockets_Linger_Add( xSocket ) != pdPASS ) )
+    {
+        ( void ) FreeRTOS_closesocket( xTcpSocket );
+    }
+
+    return SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
 BaseType_t Sockets_Recv( SocketHandle xSocket,
                          uint8_t * pucReceiveBuffer,
                          size_t xReceiveBufferLength )
@@ -137,8 +643,16 @@ BaseType_t Sockets_Send( SocketHandle xSocket,
                          const uint8_t * pucData,
                          size_t xDataLength )
 {
-    return ( BaseType_t ) FreeRTOS_send( ( Socket_t ) xSocket,
-                                         pucData, xDataLength, 0 );
+    BaseType_t xRetVal = FreeRTOS_send( ( Socket_t ) xSocket,
+                                        pucData, xDataLength, 0 );
+
+    /* No space in the send buffer before the timeout. */
+    if( xRetVal == -pdFREERTOS_ERRNO_ENOSPC )
+    {
+        xRetVal = SOCKETS_EWOULDBLOCK;
+    }
+
+    return xRetVal;
 }
 /*-----------------------------------------------------------*/
 
@@ -149,6 +663,7 @@ BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
 {
     Socket_t xTcpSocket = ( Socket_t ) xSocket;
     BaseType_t xRetVal;
+    BaseType_t xFullSize;
     int ulRet = 0;
     TickType_t xTimeout;
 
@@ -181,6 +696,72 @@ BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
 
             break;
 
+        case SOCKETS_SO_NONBLOCK:
+            /* A zero timeout makes FreeRTOS+TCP calls return at once. Clearing
+             * the option restores the default of waiting forever. */
+            xTimeout = ( *( ( const BaseType_t * ) pvOptionValue ) != pdFALSE ) ? 0U : portMAX_DELAY;
+
+            if( ( FreeRTOS_setsockopt( xTcpSocket, 0, FREERTOS_SO_RCVTIMEO,
+                                       &xTimeout, sizeof( xTimeout ) ) != 0 ) ||
+                ( FreeRTOS_setsockopt( xTcpSocket, 0, FREERTOS_SO_SNDTIMEO,
+                                       &xTimeout, sizeof( xTimeout ) ) != 0 ) )
+            {
+                xRetVal = SOCKETS_EINVAL;
+            }
+            else
+            {
+                xRetVal = SOCKETS_ERROR_NONE;
+            }
+
+            break;
+
+        case SOCKETS_SO_NODELAY:
+
+            /* FreeRTOS+TCP has no Nagle algorithm: it sends at once unless
+             * told to wait for full size segments. */
+            if( *( ( const BaseType_t * ) pvOptionValue ) == pdFALSE )
+            {
+                xRetVal = SOCKETS_ENOPROTOOPT;
+            }
+            else
+            {
+                xFullSize = pdFALSE;
+                xRetVal = ( FreeRTOS_setsockopt( xTcpSocket, 0, FREERTOS_SO_SET_FULL_SIZE,
+                                                 &xFullSize, sizeof( xFullSize ) ) != 0 ) ?
+                          SOCKETS_EINVAL : SOCKETS_ERROR_NONE;
+            }
+
+            break;
+
+        case SOCKETS_SO_KEEPALIVE:
+
+            /* Keep-alive is set for all sockets by ipconfigTCP_KEEP_ALIVE. */
+            #if ( ipconfigTCP_KEEP_ALIVE == 1 )
+                xRetVal = ( *( ( const BaseType_t * ) pvOptionValue ) != pdFALSE ) ?
+                          SOCKETS_ERROR_NONE : SOCKETS_ENOPROTOOPT;
+            #else
+                xRetVal = ( *( ( const BaseType_t * ) pvOptionValue ) != pdFALSE ) ?
+                          SOCKETS_ENOPROTOOPT : SOCKETS_ERROR_NONE;
+            #endif
+            break;
+
+        case SOCKETS_SO_SNDBUF:
+        case SOCKETS_SO_RCVBUF:
+            /* The buffers are created on connect, so this fails afterwards. */
+            ulRet = FreeRTOS_setsockopt( xTcpSocket, 0,
+                                         ( lOptionName == SOCKETS_SO_SNDBUF ) ? FREERTOS_SO_SNDBUF : FREERTOS_SO_RCVBUF,
+                                         pvOptionValue, sizeof( uint32_t ) );
+            xRetVal = ( ulRet != 0 ) ? SOCKETS_EINVAL : SOCKETS_ERROR_NONE;
+            break;
+
+        case SOCKETS_SO_WINDOW:
+            #if ( ipconfigUSE_TCP_WIN == 1 )
+                xRetVal = prvSetWindow( xTcpSocket, ( const SocketsWindow_t * ) pvOptionValue );
+            #else
+                xRetVal = SOCKETS_ENOPROTOOPT;
+            #endif
+            break;
+
         default:
             xRetVal = SOCKETS_ENOPROTOOPT;
             break;
@@ -189,3 +770,101 @@ BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
     return xRetVal;
 }
 /*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Poll( SocketsPollFd_t * pxSockets,
+                         size_t xSocketCount,
+                         uint32_t ulTimeoutMs )
+{
+    BaseType_t xRetVal = 0;
+
+    #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+        SocketSet_t xSocketSet;
+        EventBits_t xBits;
+        size_t xIndex;
+
+        if( ( pxSockets == NULL ) && ( xSocketCount > 0U ) )
+        {
+            xRetVal = SOCKETS_EINVAL;
+        }
+        else if( ( xSocketSet = FreeRTOS_CreateSocketSet() ) == NULL )
+        {
+            xRetVal = SOCKETS_ENOMEM;
+        }
+        else
+        {
+            for( xIndex = 0; xIndex < xSocketCount; xIndex++ )
+            {
+                xBits = eSELECT_EXCEPT;
+                xBits |= ( ( pxSockets[ xIndex ].ulEvents & SOCKETS_POLL_READ ) != 0U ) ? eSELECT_READ : 0;
+                xBits |= ( ( pxSockets[ xIndex ].ulEvents & SOCKETS_POLL_WRITE ) != 0U ) ? eSELECT_WRITE : 0;
+
+                pxSockets[ xIndex ].ulRevents = 0;
+                FreeRTOS_FD_SET( ( Socket_t ) pxSockets[ xIndex ].xSocket, xSocketSet, xBits );
+            }
+
+            if( FreeRTOS_select( xSocketSet, ( ulTimeoutMs == SOCKETS_POLL_WAIT_FOREVER ) ?
+                                 portMAX_DELAY : pdMS_TO_TICKS( ulTimeoutMs ) ) != 0 )
+            {
+                for( xIndex = 0; xIndex < xSocketCount; xIndex++ )
+                {
+                    xBits = ( EventBits_t ) FreeRTOS_FD_ISSET( ( Socket_t ) pxSockets[ xIndex ].xSocket, xSocketSet );
+
+                    pxSockets[ xIndex ].ulRevents = ( ( ( xBits & eSELECT_READ ) != 0U ) ? SOCKETS_POLL_READ : 0U ) |
+                                                    ( ( ( xBits & eSELECT_WRITE ) != 0U ) ? SOCKETS_POLL_WRITE : 0U ) |
+                                                    ( ( ( xBits & eSELECT_EXCEPT ) != 0U ) ? SOCKETS_POLL_ERROR : 0U );
+
+                    if( pxSockets[ xIndex ].ulRevents != 0U )
+                    {
+                        xRetVal++;
+                    }
+                }
+            }
+
+            /* A socket belongs to one set at a time; release them. */
+            for( xIndex = 0; xIndex < xSocketCount; xIndex++ )
+            {
+                FreeRTOS_FD_CLR( ( Socket_t ) pxSockets[ xIndex ].xSocket, xSocketSet, eSELECT_ALL );
+            }
+
+            FreeRTOS_DeleteSocketSet( xSocketSet );
+        }
+    #else /* if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 ) */
+        ( void ) pxSockets;
+        ( void ) xSocketCount;
+        ( void ) ulTimeoutMs;
+
+        /* FreeRTOS_select is only built with ipconfigSUPPORT_SELECT_FUNCTION. */
+        xRetVal = SOCKETS_ENOPROTOOPT;
+    #endif /* if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 ) */
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_GetConnectTimes( SocketHandle xSocket,
+                                    SocketsConnectTimes_t * pxTimes )
+{
+    ConnectTimes_t * pxConnectTimes;
+    BaseType_t xRetVal = SOCKETS_ENOTCONN;
+
+    taskENTER_CRITICAL();
+    {
+        pxConnectTimes = prvConnectTimesGet( ( Socket_t ) xSocket );
+
+        if( ( pxConnectTimes != NULL ) && ( pxConnectTimes->xComplete == pdTRUE ) )
+        {
+            *pxTimes = pxConnectTimes->xTimes;
+            xRetVal = SOCKETS_ERROR_NONE;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_Prefetch( const char * pcHostName )
+{
+    ( void ) Sockets_DnsCache_Prefetch( pcHostName );
+}
+/*-----------------------------------------------------------*/
@@ -7,6 +7,7 @@
  */
 
 #include "sockets_wrapper.h"
+#include "sockets_dns_cache.h"
 
 /* Standard includes. */
 #include <stdbool.h>
@@ -31,6 +32,27 @@
     #define lwipdnsresolverMAX_WAIT_SECONDS    ( 20 )
 #endif
 
+/*
+ * Number of different host names that can be resolved at the same time.
+ */
+#ifndef lwipdnsresolverMAX_PENDING
+    #define lwipdnsresolverMAX_PENDING    ( 4 )
+#endif
+
+/*
+ * Number of tasks that can wait for the same host name at the same time.
+ */
+#ifndef lwipdnsresolverMAX_WAITERS
+    #define lwipdnsresolverMAX_WAITERS    ( 4 )
+#endif
+
+/*
+ * Number of sockets whose connect times are kept by Sockets_GetConnectTimes.
+ */
+#ifndef lwipsocketsTIMED_CONNECTS
+    #define lwipsocketsTIMED_CONNECTS    ( 4 )
+#endif
+
 /*
  * convert from system ticks to seconds.
  */
@@ -43,15 +65,199 @@
 /*-----------------------------------------------------------*/
 
 /*
- * Task handle to use for DNS resolution.
+ * Time spent in each phase of the last connect of a socket.
+ */
+typedef struct ConnectTimes
+{
+    BaseType_t xInUse;            /**< Set while the entry holds the times of xSocket. */
+    uint32_t ulSocketNumber;      /**< Socket timed. */
+    TickType_t xPhaseStart;       /**< Start of the phase in progress. */
+    BaseType_t xComplete;         /**< Set once the socket connected. */
+    SocketsConnectTimes_t xTimes; /**< Phase durations. */
+} ConnectTimes_t;
+
+/*
+ * A host name lookup handed to lwIP. The entry is the argument of the lwIP
+ * callback, so it stays in use until lwIP called back, even once all the
+ * tasks waiting for it timed out.
+ */
+typedef struct DnsRequest
+{
+    BaseType_t xInUse;                                   /**< Set until lwIP called back and no task waits. */
+    volatile BaseType_t xComplete;                       /**< Set once lwIP called back. */
+    uint32_t ulAddress;                                  /**< Resolved address, 0 if the lookup failed. */
+    TaskHandle_t xWaiters[ lwipdnsresolverMAX_WAITERS ]; /**< Tasks waiting for the address, NULL for free slots. */
+    char cHostName[ SOCKETS_MAX_HOST_NAME_LENGTH + 1 ];  /**< Host name looked up. */
+} DnsRequest_t;
+/*-----------------------------------------------------------*/
+
+/*
+ * Lookups in progress, shared by the tasks resolving the same name.
+ */
+static DnsRequest_t xDnsRequests[ lwipdnsresolverMAX_PENDING ];
+
+static ConnectTimes_t xConnectTimes[ lwipsocketsTIMED_CONNECTS ];
+
+/*
+ * Entry reused next when no entry is free.
+ */
+static size_t xNextConnectTimes = 0;
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Record the outcome of a lookup and wake the tasks waiting for it, except
+ * xCaller, the task completing the lookup itself if any. The entry is freed
+ * if no task waits for it anymore.
+ */
+static void prvDnsRequestComplete( DnsRequest_t * pxRequest,
+                                   uint32_t ulAddress,
+                                   TaskHandle_t xCaller )
+{
+    TaskHandle_t xWaiters[ lwipdnsresolverMAX_WAITERS ];
+    BaseType_t xWaiting = pdFALSE;
+    size_t xIndex;
+
+    /* A waiter that timed out must not leave and be deleted before it is
+     * notified. */
+    vTaskSuspendAll();
+
+    taskENTER_CRITICAL();
+    {
+        pxRequest->ulAddress = ulAddress;
+        pxRequest->xComplete = pdTRUE;
+
+        for( xIndex = 0; xIndex < lwipdnsresolverMAX_WAITERS; xIndex++ )
+        {
+            xWaiters[ xIndex ] = pxRequest->xWaiters[ xIndex ];
+            xWaiting = ( xWaiters[ xIndex ] != NULL ) ? pdTRUE : xWaiting;
+        }
+
+        if( xWaiting == pdFALSE )
+        {
+            pxRequest->xInUse = pdFALSE;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    for( xIndex = 0; xIndex < lwipdnsresolverMAX_WAITERS; xIndex++ )
+    {
+        if( ( xWaiters[ xIndex ] != NULL ) && ( xWaiters[ xIndex ] != xCaller ) )
+        {
+            ( void ) xTaskNotifyGive( xWaiters[ xIndex ] );
+        }
+    }
+
+    ( void ) xTaskResumeAll();
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Wait for a lookup of a host name: join the lookup in progress for the same
+ * name, or else start one in a free entry. *pxStart is set if the caller has
+ * to hand the lookup to lwIP. Returns NULL if no entry or waiter slot is free.
+ */
+static DnsRequest_t * prvDnsRequestJoin( const char * pcHostName,
+                                         BaseType_t * pxStart )
+{
+    DnsRequest_t * pxRequest = NULL;
+    DnsRequest_t * pxFree = NULL;
+    size_t xIndex;
+
+    *pxStart = pdFALSE;
+
+    taskENTER_CRITICAL();
+    {
+        for( xIndex = 0; xIndex < lwipdnsresolverMAX_PENDING; xIndex++ )
+        {
+            if( xDnsRequests[ xIndex ].xInUse == pdFALSE )
+            {
+                pxFree = ( pxFree == NULL ) ? &xDnsRequests[ xIndex ] : pxFree;
+            }
+            else if( ( xDnsRequests[ xIndex ].xComplete == pdFALSE ) &&
+                     ( strcmp( xDnsRequests[ xIndex ].cHostName, pcHostName ) == 0 ) )
+            {
+                pxRequest = &xDnsRequests[ xIndex ];
+                break;
+            }
+        }
+
+        if( ( pxRequest == NULL ) && ( pxFree != NULL ) )
+        {
+            ( void ) memset( pxFree, 0, sizeof( DnsRequest_t ) );
+            ( void ) strcpy( pxFree->cHostName, pcHostName );
+            pxFree->xInUse = pdTRUE;
+            pxRequest = pxFree;
+            *pxStart = pdTRUE;
+        }
+
+        if( pxRequest != NULL )
+        {
+            for( xIndex = 0; xIndex < lwipdnsresolverMAX_WAITERS; xIndex++ )
+            {
+                if( pxRequest->xWaiters[ xIndex ] == NULL )
+                {
+                    pxRequest->xWaiters[ xIndex ] = xTaskGetCurrentTaskHandle();
+                    break;
+                }
+            }
+
+            /* A new entry always has a free slot. */
+            if( xIndex == lwipdnsresolverMAX_WAITERS )
+            {
+                pxRequest = NULL;
+            }
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return pxRequest;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Stop waiting for a lookup, and get its address if it completed. The entry
+ * is freed once it completed and no task waits for it.
  */
-static TaskHandle_t xDNSResolutionTaskHandle = NULL;
+static uint32_t prvDnsRequestLeave( DnsRequest_t * pxRequest )
+{
+    TaskHandle_t xTask = xTaskGetCurrentTaskHandle();
+    BaseType_t xWaiting = pdFALSE;
+    uint32_t ulAddress = 0;
+    size_t xIndex;
+
+    taskENTER_CRITICAL();
+    {
+        for( xIndex = 0; xIndex < lwipdnsresolverMAX_WAITERS; xIndex++ )
+        {
+            if( pxRequest->xWaiters[ xIndex ] == xTask )
+            {
+                pxRequest->xWaiters[ xIndex ] = NULL;
+            }
+
+            xWaiting = ( pxRequest->xWaiters[ xIndex ] != NULL ) ? pdTRUE : xWaiting;
+        }
+
+        if( pxRequest->xComplete == pdTRUE )
+        {
+            ulAddress = pxRequest->ulAddress;
 
+            if( xWaiting == pdFALSE )
+            {
+                pxRequest->xInUse = pdFALSE;
+            }
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return ulAddress;
+}
 /*-----------------------------------------------------------*/
 
 /*
  * Lwip DNS Found callback, compatible with type "dns_found_callback"
- * declared in lwip/dns.h.
+ * declared in lwip/dns.h. Called from the lwIP thread with the entry of the
+ * lookup, which stays valid until then.
  *
  * NOTE: this resolves only ipv4 addresses; calls to dns_gethostbyname_addrtype()
  * must specify dns_addrtype == LWIP_DNS_ADDRTYPE_IPV4.
@@ -60,21 +266,112 @@ static void lwip_dns_found_callback( const char * ucName,
                                      const ip_addr_t * xIPAddr,
                                      void * pvCallbackArg )
 {
-    if( xDNSResolutionTaskHandle != NULL )
+    ( void ) ucName;
+
+    /* NOTE: IPv4 addresses only */
+    prvDnsRequestComplete( ( DnsRequest_t * ) pvCallbackArg,
+                           ( xIPAddr != NULL ) ? *( ( const uint32_t * ) xIPAddr ) : 0U,
+                           NULL );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Find the connect times of a socket, or a free entry if xFree is pdTRUE.
+ * Called in a critical section.
+ */
+static ConnectTimes_t * prvConnectTimesGet( uint32_t ulSocketNumber,
+                                            BaseType_t xFree )
+{
+    ConnectTimes_t * pxTimes = NULL;
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < lwipsocketsTIMED_CONNECTS; xIndex++ )
     {
-        uint32_t * ulAddr = ( uint32_t * ) pvCallbackArg;
+        if( ( xFree == pdTRUE ) ?
+            ( xConnectTimes[ xIndex ].xInUse == pdFALSE ) :
+            ( ( xConnectTimes[ xIndex ].xInUse == pdTRUE ) &&
+              ( xConnectTimes[ xIndex ].ulSocketNumber == ulSocketNumber ) ) )
+        {
+            pxTimes = &xConnectTimes[ xIndex ];
+            break;
+        }
+    }
+
+    return pxTimes;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Start timing a connect, reusing the oldest entry if none is free.
+ */
+static void prvConnectTimesStart( uint32_t ulSocketNumber )
+{
+    ConnectTimes_t * pxTimes;
 
-        if( xIPAddr != NULL )
+    taskENTER_CRITICAL();
+    {
+        if( ( ( pxTimes = prvConnectTimesGet( ulSocketNumber, pdFALSE ) ) == NULL ) &&
+            ( ( pxTimes = prvConnectTimesGet( 0, pdTRUE ) ) == NULL ) )
         {
-            *ulAddr = *( ( uint32_t * ) xIPAddr ); /* NOTE: IPv4 addresses only */
+            pxTimes = &xConnectTimes[ xNextConnectTimes ];
+            xNextConnectTimes = ( xNextConnectTimes + 1 ) % lwipsocketsTIMED_CONNECTS;
         }
-        else
+
+        ( void ) memset( pxTimes, 0, sizeof( ConnectTimes_t ) );
+        pxTimes->xInUse = pdTRUE;
+        pxTimes->ulSocketNumber = ulSocketNumber;
+        pxTimes->xPhaseStart = xTaskGetTickCount();
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Record the end of name resolution, or of the TCP handshake.
+ */
+static void prvConnectTimesPhaseDone( uint32_t ulSocketNumber,
+                                      BaseType_t xConnected )
+{
+    ConnectTimes_t * pxTimes;
+    TickType_t xNow = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+    {
+        if( ( ( pxTimes = prvConnectTimesGet( ulSocketNumber, pdFALSE ) ) != NULL ) &&
+            ( pxTimes->xComplete == pdFALSE ) )
         {
-            *ulAddr = 0;
+            if( xConnected == pdFALSE )
+            {
+                pxTimes->xTimes.ulDnsMs = ( uint32_t ) ( ( xNow - pxTimes->xPhaseStart ) * portTICK_PERIOD_MS );
+            }
+            else
+            {
+                pxTimes->xTimes.ulTcpConnectMs = ( uint32_t ) ( ( xNow - pxTimes->xPhaseStart ) * portTICK_PERIOD_MS );
+                pxTimes->xComplete = pdTRUE;
+            }
+
+            pxTimes->xPhaseStart = xNow;
         }
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
 
-        xTaskNotifyGive( xDNSResolutionTaskHandle );
+/*
+ * Forget the connect times of a socket that is being closed.
+ */
+static void prvConnectTimesFree( uint32_t ulSocketNumber )
+{
+    ConnectTimes_t * pxTimes;
+
+    taskENTER_CRITICAL();
+    {
+        if( ( pxTimes = prvConnectTimesGet( ulSocketNumber, pdFALSE ) ) != NULL )
+        {
+            pxTimes->xInUse = pdFALSE;
+        }
     }
+    taskEXIT_CRITICAL();
 }
 /*-----------------------------------------------------------*/
 
@@ -83,60 +380,91 @@ uint32_t prvGetHostByName( const char * pcHostName )
     uint32_t ulAddr = 0;
     err_t xLwipError = ERR_OK;
     ip_addr_t xLwipIpv4Address;
-    uint32_t ulDNSNotificationValue = 0;
+    DnsRequest_t * pxRequest = NULL;
+    BaseType_t xStart = pdFALSE;
+    TickType_t xWaitStart = xTaskGetTickCount();
+    TickType_t xWaitTicks = ( lwipdnsresolverMAX_WAIT_SECONDS * 1000 ) / portTICK_PERIOD_MS;
+    TickType_t xElapsed;
 
-    xDNSResolutionTaskHandle = xTaskGetCurrentTaskHandle();
-
-    if( strlen( pcHostName ) <= ( size_t ) SOCKETS_MAX_HOST_NAME_LENGTH )
+    if( strlen( pcHostName ) > ( size_t ) SOCKETS_MAX_HOST_NAME_LENGTH )
     {
-        xLwipError = dns_gethostbyname_addrtype( pcHostName, &xLwipIpv4Address,
-                                                 lwip_dns_found_callback, ( void * ) &ulAddr,
-                                                 LWIP_DNS_ADDRTYPE_IPV4 );
-
-        switch( xLwipError )
+        configPRINTF( ( "Host name (%s) too long!", pcHostName ) );
+    }
+    else if( ( pxRequest = prvDnsRequestJoin( pcHostName, &xStart ) ) == NULL )
+    {
+        configPRINTF( ( "Too many lookups in progress to resolve (%s)!", pcHostName ) );
+    }
+    else
+    {
+        /* Tasks resolving a name already looked up only wait for its
+         * outcome. */
+        if( xStart == pdTRUE )
         {
-            case ERR_OK:
-                ulAddr = *( ( uint32_t * ) &xLwipIpv4Address ); /* NOTE: IPv4 addresses only */
-                break;
-
-            case ERR_INPROGRESS:
-
-                /*
-                 * The DNS resolver is working the request.  Wait for it to complete
-                 * or time out; print a timeout error message if configured for debug
-                 * printing.
-                 */
-                ulDNSNotificationValue = ulTaskNotifyTake( pdTRUE, ( lwipdnsresolverMAX_WAIT_SECONDS * 1000 ) / portTICK_PERIOD_MS );
-                xDNSResolutionTaskHandle = NULL;
+            xLwipError = dns_gethostbyname_addrtype( pxRequest->cHostName, &xLwipIpv4Address,
+                                                     lwip_dns_found_callback, ( void * ) pxRequest,
+                                                     LWIP_DNS_ADDRTYPE_IPV4 );
+
+            switch( xLwipError )
+            {
+                case ERR_OK:
+                    /* Cached by lwIP; there is no callback. This task does
+                     * not wait, so it is not notified. */
+                    prvDnsRequestComplete( pxRequest, *( ( uint32_t * ) &xLwipIpv4Address ), /* NOTE: IPv4 addresses only */
+                                           xTaskGetCurrentTaskHandle() );
+                    break;
+
+                case ERR_INPROGRESS:
+                    /* The DNS resolver is working the request. */
+                    break;
+
+                default:
+                    configPRINTF( ( "Unexpected error (%lu) from dns_gethostbyname_addrtype() while resolving (%s)!",
+                                    ( uint32_t ) xLwipError, pcHostName ) );
+                    prvDnsRequestComplete( pxRequest, 0, xTaskGetCurrentTaskHandle() );
+                    break;
+            }
+        }
 
-                if( ( ulDNSNotificationValue != 1 ) || ( ulAddr == 0 ) )
-                {
-                    /* DNS resolution timed out */
-                    configPRINTF( ( "Unable to resolve (%s) within (%lu) seconds",
-                                    pcHostName, lwipdnsresolverMAX_WAIT_SECONDS ) );
-                }
+        /* Wait for the lookup to complete or time out. The entry stays in use
+         * while this task waits for it. A notification may be left from an
+         * earlier lookup, so the entry is checked after each one. */
+        while( ( pxRequest->xComplete == pdFALSE ) &&
+               ( ( xElapsed = xTaskGetTickCount() - xWaitStart ) < xWaitTicks ) )
+        {
+            ( void ) ulTaskNotifyTake( pdTRUE, xWaitTicks - xElapsed );
+        }
 
-                break;
+        ulAddr = prvDnsRequestLeave( pxRequest );
 
-            default:
-                configPRINTF( ( "Unexpected error (%lu) from dns_gethostbyname_addrtype() while resolving (%s)!",
-                                ( uint32_t ) xLwipError, pcHostName ) );
-                break;
+        if( ulAddr == 0U )
+        {
+            configPRINTF( ( "Unable to resolve (%s) within (%lu) seconds",
+                            pcHostName, lwipdnsresolverMAX_WAIT_SECONDS ) );
         }
     }
-    else
-    {
-        ulAddr = 0;
-        configPRINTF( ( "Host name (%s) too long!", pcHostName ) );
-    }
 
     return ulAddr;
 }
 /*-----------------------------------------------------------*/
 
+/*
+ * Resolver of the DNS cache. lwIP does not report the TTL of the record, so
+ * the cache uses its default TTL; the lwIP cache honours the TTL of the
+ * record, so resolving a name again before it elapsed sends no query.
+ */
+static uint32_t prvResolve( const char * pcHostName,
+                            uint32_t * pulTtlSeconds )
+{
+    /* Lookups of the cache task and of connecting tasks run side by side. */
+    *pulTtlSeconds = 0;
+
+    return prvGetHostByName( pcHostName );
+}
+/*-----------------------------------------------------------*/
+
 BaseType_t Sockets_Init()
 {
-    return SOCKETS_ERROR_NONE;
+    return ( Sockets_DnsCache_Init( prvResolve ) == pdPASS ) ? SOCKETS_ERROR_NONE : SOCKETS_ENOMEM;
 }
 /*-----------------------------------------------------------*/
 
@@ -166,6 +494,8 @@ SocketHandle Sockets_Open()
 
 BaseType_t Sockets_Close( SocketHandle xSocket )
 {
+    prvConnectTimesFree( ( uint32_t ) xSocket );
+
     return ( BaseType_t ) lwip_close( ( uint32_t ) xSocket );
 }
 /*-----------------------------------------------------------*/
@@ -179,12 +509,17 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
     uint32_t ulIPAddres = 0;
     struct sockaddr_in xSockAddr = { 0 };
 
-    if( ( ulIPAddres = prvGetHostByName( pcHostName ) ) == 0 )
+    prvConnectTimesStart( ulSocketNumber );
+
+    /* A cached address returns at once. */
+    if( ( ulIPAddres = Sockets_DnsCache_Resolve( pcHostName ) ) == 0 )
     {
         lRetVal = SOCKETS_SOCKET_ERROR;
     }
     else
     {
+        prvConnectTimesPhaseDone( ulSocketNumber, pdFALSE );
+
         xSockAddr.sin_family = AF_INET;
         xSockAddr.sin_addr.s_addr = ulIPAddres;
         xSockAddr.sin_port = lwip_htons( usPort );
@@ -192,6 +527,14 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
         if( lwip_connect( ulSocketNumber, ( struct sockaddr * ) &xSockAddr, sizeof( xSockAddr ) ) < 0 )
         {
             lRetVal = SOCKETS_SOCKET_ERROR;
+
+            /* The host may have moved; the cached address is kept until the
+             * name resolved again. */
+            Sockets_DnsCache_Refresh( pcHostName );
+        }
+        else
+        {
+            prvConnectTimesPhaseDone( ulSocketNumber, pdTRUE );
         }
     }
 
@@ -199,12 +542,100 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_ConnectStart( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort )
+{
+    uint32_t ulSocketNumber = ( uint32_t ) xSocket;
+    BaseType_t xRetVal = SOCKETS_ERROR_NONE;
+    uint32_t ulIPAddres = 0;
+    struct sockaddr_in xSockAddr = { 0 };
+
+    prvConnectTimesStart( ulSocketNumber );
+
+    /* Unless the address is cached, the lookup blocks; only the TCP handshake
+     * runs in the background. */
+    if( ( ulIPAddres = Sockets_DnsCache_Resolve( pcHostName ) ) == 0 )
+    {
+        xRetVal = SOCKETS_SOCKET_ERROR;
+    }
+    else
+    {
+        prvConnectTimesPhaseDone( ulSocketNumber, pdFALSE );
+
+        xSockAddr.sin_family = AF_INET;
+        xSockAddr.sin_addr.s_addr = ulIPAddres;
+        xSockAddr.sin_port = lwip_htons( usPort );
+
+        if( lwip_connect( ulSocketNumber, ( struct sockaddr * ) &xSockAddr, sizeof( xSockAddr ) ) < 0 )
+        {
+            xRetVal = ( errno == EINPROGRESS ) ? SOCKETS_EWOULDBLOCK : SOCKETS_SOCKET_ERROR;
+        }
+        else
+        {
+            prvConnectTimesPhaseDone( ulSocketNumber, pdTRUE );
+        }
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectPoll( SocketHandle xSocket )
+{
+    uint32_t ulSocketNumber = ( uint32_t ) xSocket;
+    BaseType_t xRetVal;
+    fd_set xWriteSet;
+    struct timeval xNoWait = { 0 };
+    int lSocketError = 0;
+    socklen_t xOptionLength = sizeof( lSocketError );
+    int lReady;
+
+    FD_ZERO( &xWriteSet );
+    FD_SET( ulSocketNumber, &xWriteSet );
+
+    /* The socket becomes writable once the connect completed or failed. */
+    lReady = lwip_select( ulSocketNumber + 1, NULL, &xWriteSet, NULL, &xNoWait );
+
+    if( lReady < 0 )
+    {
+        xRetVal = SOCKETS_SOCKET_ERROR;
+    }
+    else if( lReady == 0 )
+    {
+        xRetVal = SOCKETS_EWOULDBLOCK;
+    }
+    else if( ( lwip_getsockopt( ulSocketNumber, SOL_SOCKET, SO_ERROR,
+                                &lSocketError, &xOptionLength ) != 0 ) ||
+             ( lSocketError != 0 ) )
+    {
+        xRetVal = SOCKETS_SOCKET_ERROR;
+    }
+    else
+    {
+        prvConnectTimesPhaseDone( ulSocketNumber, pdTRUE );
+        xRetVal = SOCKETS_ERROR_NONE;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
 void Sockets_Disconnect( SocketHandle xSocket )
 {
+    prvConnectTimesFree( ( uint32_t ) xSocket );
     lwip_close( ( uint32_t ) xSocket );
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_CloseAsync( SocketHandle xSocket )
+{
+    /* lwip_close returns at once; the stack sends the FIN and waits for the
+     * peer in the background. */
+    return Sockets_Close( xSocket );
+}
+/*-----------------------------------------------------------*/
+
 BaseType_t Sockets_Recv( SocketHandle xSocket,
                          uint8_t * pucReceiveBuffer,
                          size_t xReceiveBufferLength )
@@ -250,10 +681,17 @@ BaseType_t Sockets_Send( SocketHandle xSocket,
                          const uint8_t * pucData,
                          size_t xDataLength )
 {
-    return ( BaseType_t ) lwip_send( ( uint32_t ) xSocket,
-                                     pucData,
-                                     xDataLength,
-                                     0 );
+    int lRetVal = lwip_send( ( uint32_t ) xSocket,
+                             pucData,
+                             xDataLength,
+                             0 );
+
+    if( ( lRetVal == -1 ) && ( ( errno == EWOULDBLOCK ) || ( errno == EAGAIN ) ) )
+    {
+        lRetVal = SOCKETS_EWOULDBLOCK;
+    }
+
+    return ( BaseType_t ) lRetVal;
 }
 /*-----------------------------------------------------------*/
 
@@ -265,6 +703,7 @@ BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
     uint32_t ulSocketNumber = ( uint32_t ) xSocket;
     BaseType_t xRetVal;
     int ulRet = 0;
+    int lValue;
 
     switch( lOptionName )
     {
@@ -297,6 +736,61 @@ BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
            }
            break;
 
+        case SOCKETS_SO_NONBLOCK:
+            ulRet = lwip_fcntl( ulSocketNumber, F_SETFL,
+                                ( *( ( const BaseType_t * ) pvOptionValue ) != pdFALSE ) ? O_NONBLOCK : 0 );
+
+            xRetVal = ( ulRet < 0 ) ? SOCKETS_EINVAL : SOCKETS_ERROR_NONE;
+            break;
+
+        case SOCKETS_SO_NODELAY:
+        case SOCKETS_SO_KEEPALIVE:
+            lValue = ( *( ( const BaseType_t * ) pvOptionValue ) != pdFALSE ) ? 1 : 0;
+
+            if( lOptionName == SOCKETS_SO_NODELAY )
+            {
+                ulRet = lwip_setsockopt( ulSocketNumber, IPPROTO_TCP, TCP_NODELAY,
+                                         &lValue, sizeof( lValue ) );
+            }
+            else
+            {
+                ulRet = lwip_setsockopt( ulSocketNumber, SOL_SOCKET, SO_KEEPALIVE,
+                                         &lValue, sizeof( lValue ) );
+            }
+
+            xRetVal = ( ulRet != 0 ) ? SOCKETS_EINVAL : SOCKETS_ERROR_NONE;
+            break;
+
+        case SOCKETS_SO_RCVBUF:
+        case SOCKETS_SO_WINDOW:
+
+            /* lwIP has no send buffer option, and its window is TCP_WND for
+             * all sockets; only the receive buffer can be set. */
+            #if ( LWIP_SO_RCVBUF == 1 )
+                if( lOptionName == SOCKETS_SO_RCVBUF )
+                {
+                    lValue = ( int ) *( ( const uint32_t * ) pvOptionValue );
+                }
+                else
+                {
+                    lValue = ( int ) ( ( const SocketsWindow_t * ) pvOptionValue )->ulReceiveBufferBytes;
+                }
+
+                if( lValue == 0 )
+                {
+                    xRetVal = SOCKETS_ERROR_NONE;
+                }
+                else
+                {
+                    ulRet = lwip_setsockopt( ulSocketNumber, SOL_SOCKET, SO_RCVBUF,
+                                             &lValue, sizeof( lValue ) );
+                    xRetVal = ( ulRet != 0 ) ? SOCKETS_EINVAL : SOCKETS_ERROR_NONE;
+                }
+            #else
+                xRetVal = SOCKETS_ENOPROTOOPT;
+            #endif /* LWIP_SO_RCVBUF == 1 */
+            break;
+
         default:
             xRetVal = SOCKETS_ENOPROTOOPT;
             break;
@@ -305,3 +799,112 @@ BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
     return xRetVal;
 }
 /*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Poll( SocketsPollFd_t * pxSockets,
+                         size_t xSocketCount,
+                         uint32_t ulTimeoutMs )
+{
+    BaseType_t xRetVal = 0;
+    fd_set xReadSet;
+    fd_set xWriteSet;
+    fd_set xErrorSet;
+    struct timeval xTimeout;
+    int lMaxSocketNumber = -1;
+    int lSocketNumber;
+    int lReady;
+    size_t xIndex;
+
+    if( ( pxSockets == NULL ) && ( xSocketCount > 0U ) )
+    {
+        return SOCKETS_EINVAL;
+    }
+
+    FD_ZERO( &xReadSet );
+    FD_ZERO( &xWriteSet );
+    FD_ZERO( &xErrorSet );
+
+    for( xIndex = 0; xIndex < xSocketCount; xIndex++ )
+    {
+        lSocketNumber = ( int ) ( uint32_t ) pxSockets[ xIndex ].xSocket;
+        pxSockets[ xIndex ].ulRevents = 0;
+
+        if( ( pxSockets[ xIndex ].ulEvents & SOCKETS_POLL_READ ) != 0U )
+        {
+            FD_SET( lSocketNumber, &xReadSet );
+        }
+
+        if( ( pxSockets[ xIndex ].ulEvents & SOCKETS_POLL_WRITE ) != 0U )
+        {
+            FD_SET( lSocketNumber, &xWriteSet );
+        }
+
+        FD_SET( lSocketNumber, &xErrorSet );
+
+        if( lSocketNumber > lMaxSocketNumber )
+        {
+            lMaxSocketNumber = lSocketNumber;
+        }
+    }
+
+    xTimeout.tv_sec = ( long ) ( ulTimeoutMs / 1000U );
+    xTimeout.tv_usec = ( long ) ( ( ulTimeoutMs % 1000U ) * 1000U );
+
+    lReady = lwip_select( lMaxSocketNumber + 1, &xReadSet, &xWriteSet, &xErrorSet,
+                          ( ulTimeoutMs == SOCKETS_POLL_WAIT_FOREVER ) ? NULL : &xTimeout );
+
+    if( lReady < 0 )
+    {
+        xRetVal = SOCKETS_SOCKET_ERROR;
+    }
+    else if( lReady > 0 )
+    {
+        for( xIndex = 0; xIndex < xSocketCount; xIndex++ )
+        {
+            lSocketNumber = ( int ) ( uint32_t ) pxSockets[ xIndex ].xSocket;
+
+            pxSockets[ xIndex ].ulRevents = ( FD_ISSET( lSocketNumber, &xReadSet ) ? SOCKETS_POLL_READ : 0U ) |
+                                            ( FD_ISSET( lSocketNumber, &xWriteSet ) ? SOCKETS_POLL_WRITE : 0U ) |
+                                            ( FD_ISSET( lSocketNumber, &xErrorSet ) ? SOCKETS_POLL_ERROR : 0U );
+
+            if( pxSockets[ xIndex ].ulRevents != 0U )
+            {
+                xRetVal++;
+            }
+        }
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_GetConnectTimes( SocketHandle xSocket,
+                                    SocketsConnectTimes_t * pxTimes )
+{
+    ConnectTimes_t * pxConnectTimes;
+    BaseType_t xRetVal = SOCKETS_ENOTCONN;
+
+    taskENTER_CRITICAL();
+    {
+        pxConnectTimes = prvConnectTimesGet( ( uint32_t ) xSocket, pdFALSE );
+
+        if( ( pxConnectTimes != NULL ) && ( pxConnectTimes->xComplete == pdTRUE ) )
+        {
+            *pxTimes = pxConnectTimes->xTimes;
+            xRetVal = SOCKETS_ERROR_NONE;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_Prefetch( const char * pcHostName )
+{
+    ( void ) Sockets_DnsCache_Prefetch( pcHostName );
+}
+/*-----------------------------------------------------------*/
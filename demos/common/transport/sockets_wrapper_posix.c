@@ -0,0 +1,725 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sockets_wrapper_posix.c
+ * @brief Sockets wrapper on the BSD sockets of the host, for the FreeRTOS
+ * POSIX port.
+ *
+ * Host sockets are kept in non-blocking mode. A call that has to wait blocks
+ * in poll() until the socket is ready or the timeout elapsed, in slices of at
+ * most POSIX_SOCKETS_WRAPPER_POLL_SLICE_MS, so that the host thread returns
+ * to the FreeRTOS POSIX port regularly.
+ *
+ * Name resolution is the exception: unless the address is in the DNS cache,
+ * getaddrinfo() blocks the host thread, and so every task, until the lookup
+ * completed. This includes Sockets_ConnectStart, which only runs the TCP
+ * handshake in the background.
+ */
+
+#include "sockets_wrapper.h"
+#include "sockets_dns_cache.h"
+
+/* Standard includes. */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Host sockets includes. */
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+/*-----------------------------------------------------------*/
+
+/* Longest a task waiting on a socket blocks in a single poll(). */
+#ifndef POSIX_SOCKETS_WRAPPER_POLL_SLICE_MS
+    #define POSIX_SOCKETS_WRAPPER_POLL_SLICE_MS    ( 10 )
+#endif
+
+/**
+ * @brief Host socket and the state the wrapper keeps for it.
+ */
+typedef struct PosixSocket
+{
+    int lFd;                       /**< Host socket, always non-blocking. */
+    TickType_t xReceiveTimeout;    /**< Set with #SOCKETS_SO_RCVTIMEO. */
+    TickType_t xSendTimeout;       /**< Set with #SOCKETS_SO_SNDTIMEO. */
+    BaseType_t xNonBlocking;       /**< Set with #SOCKETS_SO_NONBLOCK. */
+    BaseType_t xConnectPending;    /**< Set while a connect started with Sockets_ConnectStart is in progress. */
+    TickType_t xPhaseStart;        /**< Start of the connect phase in progress. */
+    BaseType_t xConnectTimesValid; /**< Set once the socket connected. */
+    SocketsConnectTimes_t xTimes;  /**< Phase durations of the last connect. */
+} PosixSocket_t;
+/*-----------------------------------------------------------*/
+
+/*
+ * Map errno after a failed host call to a sockets wrapper error code.
+ */
+static BaseType_t prvErrnoToError( int lError )
+{
+    BaseType_t xRetVal;
+
+    switch( lError )
+    {
+        case EAGAIN:
+        #if ( EWOULDBLOCK != EAGAIN )
+            case EWOULDBLOCK:
+        #endif
+        case EINPROGRESS:
+            xRetVal = SOCKETS_EWOULDBLOCK;
+            break;
+
+        case ENOMEM:
+        case ENOBUFS:
+            xRetVal = SOCKETS_ENOMEM;
+            break;
+
+        case EINVAL:
+            xRetVal = SOCKETS_EINVAL;
+            break;
+
+        case ENOPROTOOPT:
+            xRetVal = SOCKETS_ENOPROTOOPT;
+            break;
+
+        case ENOTCONN:
+            xRetVal = SOCKETS_ENOTCONN;
+            break;
+
+        case EISCONN:
+            xRetVal = SOCKETS_EISCONN;
+            break;
+
+        case EBADF:
+        case EPIPE:
+        case ECONNRESET:
+            xRetVal = SOCKETS_ECLOSED;
+            break;
+
+        default:
+            xRetVal = SOCKETS_SOCKET_ERROR;
+            break;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * poll() host sockets until one is ready, or xTimeout ticks after xStart.
+ * Returns the result of the last poll(), 0 once the timeout elapsed.
+ */
+static int prvPoll( struct pollfd * pxPollFds,
+                    nfds_t xCount,
+                    TickType_t xStart,
+                    TickType_t xTimeout )
+{
+    TickType_t xElapsed;
+    TickType_t xRemaining;
+    int lSliceMs;
+    int lReady;
+
+    for( ; ; )
+    {
+        xElapsed = xTaskGetTickCount() - xStart;
+        xRemaining = ( xElapsed < xTimeout ) ? ( xTimeout - xElapsed ) : 0U;
+        lSliceMs = ( xRemaining >= pdMS_TO_TICKS( POSIX_SOCKETS_WRAPPER_POLL_SLICE_MS ) ) ?
+                   POSIX_SOCKETS_WRAPPER_POLL_SLICE_MS : ( int ) ( xRemaining * portTICK_PERIOD_MS );
+
+        lReady = poll( pxPollFds, xCount, lSliceMs );
+
+        if( ( lReady < 0 ) && ( errno == EINTR ) )
+        {
+            /* Interrupted by a signal of the port, e.g. the tick. */
+            lReady = 0;
+        }
+
+        if( ( lReady != 0 ) || ( xRemaining == 0U ) )
+        {
+            break;
+        }
+    }
+
+    return lReady;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Wait until a socket has one of sEvents, or xTimeout ticks after xStart.
+ * Returns the events of the socket, 0 once the timeout elapsed.
+ */
+static short prvWait( const PosixSocket_t * pxSocket,
+                      short sEvents,
+                      TickType_t xStart,
+                      TickType_t xTimeout )
+{
+    struct pollfd xPollFd;
+
+    xPollFd.fd = pxSocket->lFd;
+    xPollFd.events = sEvents;
+    xPollFd.revents = 0;
+
+    return ( prvPoll( &xPollFd, 1, xStart, xTimeout ) > 0 ) ? xPollFd.revents : 0;
+}
+/*-----------------------------------------------------------*/
+
+static void prvConnectTimesStart( PosixSocket_t * pxSocket )
+{
+    ( void ) memset( &pxSocket->xTimes, 0, sizeof( pxSocket->xTimes ) );
+    pxSocket->xConnectTimesValid = pdFALSE;
+    pxSocket->xPhaseStart = xTaskGetTickCount();
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Record the end of name resolution, or of the TCP handshake.
+ */
+static void prvConnectTimesPhaseDone( PosixSocket_t * pxSocket,
+                                      BaseType_t xConnected )
+{
+    TickType_t xNow = xTaskGetTickCount();
+    uint32_t ulPhaseMs = ( uint32_t ) ( ( xNow - pxSocket->xPhaseStart ) * portTICK_PERIOD_MS );
+
+    if( xConnected == pdFALSE )
+    {
+        pxSocket->xTimes.ulDnsMs = ulPhaseMs;
+    }
+    else
+    {
+        pxSocket->xTimes.ulTcpConnectMs = ulPhaseMs;
+        pxSocket->xConnectTimesValid = pdTRUE;
+    }
+
+    pxSocket->xPhaseStart = xNow;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Resolver of the DNS cache. getaddrinfo blocks the host thread, not only the
+ * calling task, and does not report the TTL of the record, so the cache uses
+ * its default TTL.
+ */
+static uint32_t prvResolve( const char * pcHostName,
+                            uint32_t * pulTtlSeconds )
+{
+    struct addrinfo xHints;
+    struct addrinfo * pxResult = NULL;
+    uint32_t ulAddress = 0;
+
+    *pulTtlSeconds = 0;
+
+    ( void ) memset( &xHints, 0, sizeof( xHints ) );
+    xHints.ai_family = AF_INET;
+    xHints.ai_socktype = SOCK_STREAM;
+
+    if( ( getaddrinfo( pcHostName, NULL, &xHints, &pxResult ) == 0 ) && ( pxResult != NULL ) )
+    {
+        ulAddress = ( ( const struct sockaddr_in * ) pxResult->ai_addr )->sin_addr.s_addr;
+    }
+
+    if( pxResult != NULL )
+    {
+        freeaddrinfo( pxResult );
+    }
+
+    return ulAddress;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Send the SYN to the resolved address.
+ */
+static BaseType_t prvStartTcpConnect( PosixSocket_t * pxSocket,
+                                      uint32_t ulIPAddress,
+                                      uint16_t usPort )
+{
+    struct sockaddr_in xServerAddress;
+    BaseType_t xRetVal = SOCKETS_ERROR_NONE;
+
+    ( void ) memset( &xServerAddress, 0, sizeof( xServerAddress ) );
+    xServerAddress.sin_family = AF_INET;
+    xServerAddress.sin_addr.s_addr = ulIPAddress;
+    xServerAddress.sin_port = htons( usPort );
+
+    prvConnectTimesPhaseDone( pxSocket, pdFALSE );
+
+    if( connect( pxSocket->lFd, ( const struct sockaddr * ) &xServerAddress, sizeof( xServerAddress ) ) == 0 )
+    {
+        prvConnectTimesPhaseDone( pxSocket, pdTRUE );
+    }
+    else
+    {
+        xRetVal = ( errno == EINPROGRESS ) ? SOCKETS_EWOULDBLOCK : SOCKETS_SOCKET_ERROR;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Get the outcome of a connect once the socket became writable.
+ */
+static BaseType_t prvConnectResult( PosixSocket_t * pxSocket )
+{
+    int lSocketError = 0;
+    socklen_t xOptionLength = sizeof( lSocketError );
+    BaseType_t xRetVal = SOCKETS_SOCKET_ERROR;
+
+    if( ( getsockopt( pxSocket->lFd, SOL_SOCKET, SO_ERROR, &lSocketError, &xOptionLength ) == 0 ) &&
+        ( lSocketError == 0 ) )
+    {
+        prvConnectTimesPhaseDone( pxSocket, pdTRUE );
+        xRetVal = SOCKETS_ERROR_NONE;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvSetIntOption( const PosixSocket_t * pxSocket,
+                                   int lLevel,
+                                   int lOptionName,
+                                   int lValue )
+{
+    return ( setsockopt( pxSocket->lFd, lLevel, lOptionName, &lValue, sizeof( lValue ) ) != 0 ) ?
+           prvErrnoToError( errno ) : SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Init()
+{
+    return ( Sockets_DnsCache_Init( prvResolve ) == pdPASS ) ? SOCKETS_ERROR_NONE : SOCKETS_ENOMEM;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_DeInit()
+{
+    return SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
+SocketHandle Sockets_Open()
+{
+    PosixSocket_t * pxSocket = ( PosixSocket_t * ) pvPortMalloc( sizeof( PosixSocket_t ) );
+    SocketHandle xSocket = ( SocketHandle ) SOCKETS_INVALID_SOCKET;
+    int lFlags;
+
+    if( pxSocket != NULL )
+    {
+        ( void ) memset( pxSocket, 0, sizeof( PosixSocket_t ) );
+        pxSocket->xReceiveTimeout = portMAX_DELAY;
+        pxSocket->xSendTimeout = portMAX_DELAY;
+        pxSocket->lFd = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+
+        if( ( pxSocket->lFd < 0 ) ||
+            ( ( lFlags = fcntl( pxSocket->lFd, F_GETFL, 0 ) ) < 0 ) ||
+            ( fcntl( pxSocket->lFd, F_SETFL, lFlags | O_NONBLOCK ) < 0 ) )
+        {
+            if( pxSocket->lFd >= 0 )
+            {
+                ( void ) close( pxSocket->lFd );
+            }
+
+            vPortFree( pxSocket );
+        }
+        else
+        {
+            xSocket = ( SocketHandle ) pxSocket;
+        }
+    }
+
+    return xSocket;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Close( SocketHandle xSocket )
+{
+    PosixSocket_t * pxSocket = ( PosixSocket_t * ) xSocket;
+    BaseType_t xRetVal = SOCKETS_ERROR_NONE;
+
+    if( close( pxSocket->lFd ) != 0 )
+    {
+        xRetVal = prvErrnoToError( errno );
+    }
+
+    vPortFree( pxSocket );
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Connect( SocketHandle xSocket,
+                            const char * pcHostName,
+                            uint16_t usPort )
+{
+    PosixSocket_t * pxSocket = ( PosixSocket_t * ) xSocket;
+    BaseType_t xRetVal;
+    uint32_t ulIPAddress;
+
+    prvConnectTimesStart( pxSocket );
+
+    /* A cached address returns at once. */
+    if( ( ulIPAddress = Sockets_DnsCache_Resolve( pcHostName ) ) == 0 )
+    {
+        xRetVal = SOCKETS_SOCKET_ERROR;
+    }
+    else
+    {
+        xRetVal = prvStartTcpConnect( pxSocket, ulIPAddress, usPort );
+
+        /* Like FreeRTOS_connect, wait for the handshake up to the receive
+         * timeout. */
+        if( xRetVal == SOCKETS_EWOULDBLOCK )
+        {
+            xRetVal = ( prvWait( pxSocket, POLLOUT, xTaskGetTickCount(), pxSocket->xReceiveTimeout ) == 0 ) ?
+                      SOCKETS_SOCKET_ERROR : prvConnectResult( pxSocket );
+        }
+
+        if( xRetVal != SOCKETS_ERROR_NONE )
+        {
+            /* The host may have moved; the cached address is kept until the
+             * name resolved again. */
+            Sockets_DnsCache_Refresh( pcHostName );
+        }
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectStart( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort )
+{
+    PosixSocket_t * pxSocket = ( PosixSocket_t * ) xSocket;
+    BaseType_t xRetVal;
+    uint32_t ulIPAddress;
+
+    prvConnectTimesStart( pxSocket );
+
+    /* Unless the address is cached, the lookup blocks the host thread; only
+     * the TCP handshake runs in the background. */
+    if( ( ulIPAddress = Sockets_DnsCache_Resolve( pcHostName ) ) == 0 )
+    {
+        xRetVal = SOCKETS_SOCKET_ERROR;
+    }
+    else
+    {
+        xRetVal = prvStartTcpConnect( pxSocket, ulIPAddress, usPort );
+        pxSocket->xConnectPending = ( xRetVal == SOCKETS_EWOULDBLOCK ) ? pdTRUE : pdFALSE;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectPoll( SocketHandle xSocket )
+{
+    PosixSocket_t * pxSocket = ( PosixSocket_t * ) xSocket;
+    struct sockaddr_in xPeerAddress;
+    socklen_t xAddressLength = sizeof( xPeerAddress );
+    BaseType_t xRetVal;
+
+    if( pxSocket->xConnectPending == pdFALSE )
+    {
+        xRetVal = ( getpeername( pxSocket->lFd, ( struct sockaddr * ) &xPeerAddress, &xAddressLength ) == 0 ) ?
+                  SOCKETS_ERROR_NONE : SOCKETS_ENOTCONN;
+    }
+    else if( prvWait( pxSocket, POLLOUT, xTaskGetTickCount(), 0 ) == 0 )
+    {
+        xRetVal = SOCKETS_EWOULDBLOCK;
+    }
+    else
+    {
+        pxSocket->xConnectPending = pdFALSE;
+        xRetVal = prvConnectResult( pxSocket );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_Disconnect( SocketHandle xSocket )
+{
+    PosixSocket_t * pxSocket = ( PosixSocket_t * ) xSocket;
+
+    /* The host stack sends the FIN and completes the shutdown. */
+    ( void ) shutdown( pxSocket->lFd, SHUT_RDWR );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_CloseAsync( SocketHandle xSocket )
+{
+    /* close returns at once; the host stack sends the FIN and waits for the
+     * peer in the background. */
+    return Sockets_Close( xSocket );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Recv( SocketHandle xSocket,
+                         uint8_t * pucReceiveBuffer,
+                         size_t xReceiveBufferLength )
+{
+    PosixSocket_t * pxSocket = ( PosixSocket_t * ) xSocket;
+    TickType_t xTimeout = ( pxSocket->xNonBlocking == pdTRUE ) ? 0U : pxSocket->xReceiveTimeout;
+    TickType_t xStart = xTaskGetTickCount();
+    ssize_t xReceived;
+    BaseType_t xRetVal;
+
+    for( ; ; )
+    {
+        xReceived = recv( pxSocket->lFd, pucReceiveBuffer, xReceiveBufferLength, 0 );
+
+        if( xReceived > 0 )
+        {
+            xRetVal = ( BaseType_t ) xReceived;
+            break;
+        }
+        else if( xReceived == 0 )
+        {
+            /* The peer closed the connection. */
+            xRetVal = ( xReceiveBufferLength == 0U ) ? 0 : SOCKETS_ECLOSED;
+            break;
+        }
+        else if( errno == EINTR )
+        {
+            /* Interrupted before any data arrived; try again. */
+        }
+        else if( ( xRetVal = prvErrnoToError( errno ) ) != SOCKETS_EWOULDBLOCK )
+        {
+            break;
+        }
+        else if( prvWait( pxSocket, POLLIN, xStart, xTimeout ) == 0 )
+        {
+            /* No data within the timeout. */
+            xRetVal = 0;
+            break;
+        }
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Send( SocketHandle xSocket,
+                         const uint8_t * pucData,
+                         size_t xDataLength )
+{
+    PosixSocket_t * pxSocket = ( PosixSocket_t * ) xSocket;
+    TickType_t xTimeout = ( pxSocket->xNonBlocking == pdTRUE ) ? 0U : pxSocket->xSendTimeout;
+    TickType_t xStart = xTaskGetTickCount();
+    size_t xSent = 0;
+    ssize_t xQueued;
+    BaseType_t xRetVal = SOCKETS_ERROR_NONE;
+
+    /* Like FreeRTOS_send, queue all the data unless the timeout elapses. */
+    while( xSent < xDataLength )
+    {
+        /* A peer that closed must not raise SIGPIPE. */
+        xQueued = send( pxSocket->lFd, pucData + xSent, xDataLength - xSent, MSG_NOSIGNAL );
+
+        if( xQueued >= 0 )
+        {
+            xSent += ( size_t ) xQueued;
+        }
+        else if( errno == EINTR )
+        {
+            /* Interrupted before any data was queued; try again. */
+        }
+        else if( ( xRetVal = prvErrnoToError( errno ) ) != SOCKETS_EWOULDBLOCK )
+        {
+            break;
+        }
+        else if( prvWait( pxSocket, POLLOUT, xStart, xTimeout ) == 0 )
+        {
+            /* No space in the send buffer before the timeout. */
+            break;
+        }
+    }
+
+    return ( xSent > 0U ) ? ( BaseType_t ) xSent : xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
+                               int32_t lOptionName,
+                               const void * pvOptionValue,
+                               size_t xOptionLength )
+{
+    PosixSocket_t * pxSocket = ( PosixSocket_t * ) xSocket;
+    const SocketsWindow_t * pxWindow;
+    BaseType_t xRetVal = SOCKETS_ERROR_NONE;
+    TickType_t xTimeout;
+
+    ( void ) xOptionLength;
+
+    switch( lOptionName )
+    {
+        case SOCKETS_SO_RCVTIMEO:
+        case SOCKETS_SO_SNDTIMEO:
+            /* Comply with Berkeley standard - a 0 timeout is wait forever. */
+            xTimeout = *( ( const TickType_t * ) pvOptionValue );
+
+            if( xTimeout == 0U )
+            {
+                xTimeout = portMAX_DELAY;
+            }
+
+            if( lOptionName == SOCKETS_SO_RCVTIMEO )
+            {
+                pxSocket->xReceiveTimeout = xTimeout;
+            }
+            else
+            {
+                pxSocket->xSendTimeout = xTimeout;
+            }
+
+            break;
+
+        case SOCKETS_SO_NONBLOCK:
+            /* The host socket is always non-blocking; only the waits change. */
+            pxSocket->xNonBlocking = ( *( ( const BaseType_t * ) pvOptionValue ) != pdFALSE ) ? pdTRUE : pdFALSE;
+            break;
+
+        case SOCKETS_SO_NODELAY:
+            xRetVal = prvSetIntOption( pxSocket, IPPROTO_TCP, TCP_NODELAY,
+                                       ( *( ( const BaseType_t * ) pvOptionValue ) != pdFALSE ) ? 1 : 0 );
+            break;
+
+        case SOCKETS_SO_KEEPALIVE:
+            xRetVal = prvSetIntOption( pxSocket, SOL_SOCKET, SO_KEEPALIVE,
+                                       ( *( ( const BaseType_t * ) pvOptionValue ) != pdFALSE ) ? 1 : 0 );
+            break;
+
+        case SOCKETS_SO_SNDBUF:
+        case SOCKETS_SO_RCVBUF:
+            xRetVal = prvSetIntOption( pxSocket, SOL_SOCKET,
+                                       ( lOptionName == SOCKETS_SO_SNDBUF ) ? SO_SNDBUF : SO_RCVBUF,
+                                       ( int ) *( ( const uint32_t * ) pvOptionValue ) );
+            break;
+
+        case SOCKETS_SO_WINDOW:
+            pxWindow = ( const SocketsWindow_t * ) pvOptionValue;
+
+            /* The host stack sizes the windows from the buffers; only the
+             * receive window can be capped below its buffer. */
+            if( pxWindow->ulSendBufferBytes != 0U )
+            {
+                xRetVal = prvSetIntOption( pxSocket, SOL_SOCKET, SO_SNDBUF, ( int ) pxWindow->ulSendBufferBytes );
+            }
+
+            if( ( xRetVal == SOCKETS_ERROR_NONE ) && ( pxWindow->ulReceiveBufferBytes != 0U ) )
+            {
+                xRetVal = prvSetIntOption( pxSocket, SOL_SOCKET, SO_RCVBUF, ( int ) pxWindow->ulReceiveBufferBytes );
+            }
+
+            #ifdef TCP_WINDOW_CLAMP
+                if( ( xRetVal == SOCKETS_ERROR_NONE ) && ( pxWindow->ulReceiveWindowBytes != 0U ) )
+                {
+                    xRetVal = prvSetIntOption( pxSocket, IPPROTO_TCP, TCP_WINDOW_CLAMP, ( int ) pxWindow->ulReceiveWindowBytes );
+                }
+            #endif
+            break;
+
+        default:
+            xRetVal = SOCKETS_ENOPROTOOPT;
+            break;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Poll( SocketsPollFd_t * pxSockets,
+                         size_t xSocketCount,
+                         uint32_t ulTimeoutMs )
+{
+    TickType_t xTimeout = ( ulTimeoutMs == SOCKETS_POLL_WAIT_FOREVER ) ? portMAX_DELAY : pdMS_TO_TICKS( ulTimeoutMs );
+    TickType_t xStart = xTaskGetTickCount();
+    struct pollfd * pxPollFds = NULL;
+    BaseType_t xRetVal = 0;
+    int lReady;
+    size_t xIndex;
+
+    if( ( pxSockets == NULL ) && ( xSocketCount > 0U ) )
+    {
+        xRetVal = SOCKETS_EINVAL;
+    }
+    else if( ( xSocketCount > 0U ) &&
+             ( ( pxPollFds = ( struct pollfd * ) pvPortMalloc( xSocketCount * sizeof( struct pollfd ) ) ) == NULL ) )
+    {
+        xRetVal = SOCKETS_ENOMEM;
+    }
+    else
+    {
+        for( xIndex = 0; xIndex < xSocketCount; xIndex++ )
+        {
+            pxPollFds[ xIndex ].fd = ( ( const PosixSocket_t * ) pxSockets[ xIndex ].xSocket )->lFd;
+            pxPollFds[ xIndex ].events = ( ( ( pxSockets[ xIndex ].ulEvents & SOCKETS_POLL_READ ) != 0U ) ? POLLIN : 0 ) |
+                                         ( ( ( pxSockets[ xIndex ].ulEvents & SOCKETS_POLL_WRITE ) != 0U ) ? POLLOUT : 0 );
+            pxSockets[ xIndex ].ulRevents = 0;
+        }
+
+        lReady = prvPoll( pxPollFds, ( nfds_t ) xSocketCount, xStart, xTimeout );
+
+        if( lReady < 0 )
+        {
+            xRetVal = SOCKETS_SOCKET_ERROR;
+        }
+
+        for( xIndex = 0; ( lReady > 0 ) && ( xIndex < xSocketCount ); xIndex++ )
+        {
+            pxSockets[ xIndex ].ulRevents = ( ( ( pxPollFds[ xIndex ].revents & POLLIN ) != 0 ) ? SOCKETS_POLL_READ : 0U ) |
+                                            ( ( ( pxPollFds[ xIndex ].revents & POLLOUT ) != 0 ) ? SOCKETS_POLL_WRITE : 0U ) |
+                                            ( ( ( pxPollFds[ xIndex ].revents & ( POLLERR | POLLNVAL ) ) != 0 ) ? SOCKETS_POLL_ERROR : 0U );
+
+            /* A closed peer makes the socket readable, as with select, or
+             * fails it if it is not read. */
+            if( ( pxPollFds[ xIndex ].revents & POLLHUP ) != 0 )
+            {
+                pxSockets[ xIndex ].ulRevents |= ( ( pxSockets[ xIndex ].ulEvents & SOCKETS_POLL_READ ) != 0U ) ?
+                                                 SOCKETS_POLL_READ : SOCKETS_POLL_ERROR;
+            }
+
+            if( pxSockets[ xIndex ].ulRevents != 0U )
+            {
+                xRetVal++;
+            }
+        }
+
+        vPortFree( pxPollFds );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_GetConnectTimes( SocketHandle xSocket,
+                                    SocketsConnectTimes_t * pxTimes )
+{
+    const PosixSocket_t * pxSocket = ( const PosixSocket_t * ) xSocket;
+    BaseType_t xRetVal = SOCKETS_ENOTCONN;
+
+    if( pxSocket->xConnectTimesValid == pdTRUE )
+    {
+        *pxTimes = pxSocket->xTimes;
+        xRetVal = SOCKETS_ERROR_NONE;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_Prefetch( const char * pcHostName )
+{
+    ( void ) Sockets_DnsCache_Prefetch( pcHostName );
+}
+/*-----------------------------------------------------------*/
@@ -9,6 +9,8 @@
 #ifndef TRANSPORT_ABSTRACTION_H
 #define TRANSPORT_ABSTRACTION_H
 
+#include "sockets_wrapper.h"
+
 typedef struct NetworkContext   NetworkContext_t;
 
 /* SSL Context Handle */
@@ -17,4 +19,44 @@ typedef void                    * SSLContextHandle;
 /* Socket Context Handle */
 typedef void                    * SocketContextHandle;
 
+/**
+ * @brief Receive buffer of a bulk connection, in bytes.
+ */
+#ifndef transportBULK_RECEIVE_BUFFER_BYTES
+    #define transportBULK_RECEIVE_BUFFER_BYTES    ( 16384U )
+#endif
+
+/**
+ * @brief Receive window of a bulk connection, in bytes, 0 to span the whole
+ * receive buffer.
+ */
+#ifndef transportBULK_RECEIVE_WINDOW_BYTES
+    #define transportBULK_RECEIVE_WINDOW_BYTES    ( 0U )
+#endif
+
+/**
+ * @brief Kind of traffic a connection carries, which selects the socket
+ * options the transport sets before connecting.
+ */
+typedef enum TransportTrafficClass
+{
+    eTransportTrafficClassDefault = 0, /**< The defaults of the sockets wrapper. */
+    eTransportTrafficClassControl,     /**< Small messages waited on, such as commands and their responses: no delay, keep-alive. */
+    eTransportTrafficClassTelemetry,   /**< Steady small messages nobody waits on: coalesced segments, keep-alive. */
+    eTransportTrafficClassBulk         /**< Large downloads: a larger receive buffer and window. */
+} TransportTrafficClass_t;
+
+/**
+ * @brief Set the socket options of a traffic class on a socket that is not
+ * connected yet.
+ *
+ * Options the sockets wrapper does not support are skipped.
+ *
+ * @param[in] xSocket Socket to set the options on.
+ * @param[in] xTrafficClass Traffic class of the connection.
+ * @return SOCKETS_ERROR_NONE, or the error of the first option that failed.
+ */
+BaseType_t Transport_SetTrafficClass( SocketHandle xSocket,
+                                      TransportTrafficClass_t xTrafficClass );
+
 #endif /* TRANSPORT_ABSTRACTION_H */
@@ -42,6 +42,50 @@ struct NetworkContext
     void * pParams;
 };
 
+BaseType_t Transport_SetTrafficClass( SocketHandle xSocket,
+                                      TransportTrafficClass_t xTrafficClass )
+{
+    BaseType_t xEnable = pdTRUE;
+    SocketsWindow_t xWindow = { 0 };
+    BaseType_t xRetVal = SOCKETS_ERROR_NONE;
+
+    switch( xTrafficClass )
+    {
+        case eTransportTrafficClassControl:
+            xRetVal = Sockets_SetSockOpt( xSocket, SOCKETS_SO_NODELAY, &xEnable, sizeof( xEnable ) );
+
+            if( ( xRetVal == SOCKETS_ERROR_NONE ) || ( xRetVal == SOCKETS_ENOPROTOOPT ) )
+            {
+                xRetVal = Sockets_SetSockOpt( xSocket, SOCKETS_SO_KEEPALIVE, &xEnable, sizeof( xEnable ) );
+            }
+
+            break;
+
+        case eTransportTrafficClassTelemetry:
+            xRetVal = Sockets_SetSockOpt( xSocket, SOCKETS_SO_KEEPALIVE, &xEnable, sizeof( xEnable ) );
+            break;
+
+        case eTransportTrafficClassBulk:
+            xWindow.ulReceiveBufferBytes = transportBULK_RECEIVE_BUFFER_BYTES;
+            xWindow.ulReceiveWindowBytes = transportBULK_RECEIVE_WINDOW_BYTES;
+            xRetVal = Sockets_SetSockOpt( xSocket, SOCKETS_SO_WINDOW, &xWindow, sizeof( xWindow ) );
+            break;
+
+        default:
+            break;
+    }
+
+    /* An option the port does not have leaves its default in place. */
+    if( xRetVal == SOCKETS_ENOPROTOOPT )
+    {
+        LogInfo( ( "Traffic class %d only partly supported by the sockets wrapper.",
+                   ( int ) xTrafficClass ) );
+        xRetVal = SOCKETS_ERROR_NONE;
+    }
+
+    return xRetVal;
+}
+
 SocketTransportStatus_t Azure_Socket_Connect( NetworkContext_t * pxNetworkContext,
                                               const char * pHostName,
                                               uint16_t usPort,
@@ -75,6 +119,13 @@ SocketTransportStatus_t Azure_Socket_Connect( NetworkContext_t * pxNetworkContex
         LogError( ( "Failed to set send timeout on socket %d.", xSocketStatus ) );
         xSocketStatus = eSocketTransportInternalError;
     }
+    else if( ( xSocketStatus = Transport_SetTrafficClass( pxSocketParams->xTCPSocket,
+                                                          pxSocketParams->xTrafficClass ) ) != 0 )
+    {
+        LogError( ( "Failed to set traffic class %d on socket %d.",
+                    ( int ) pxSocketParams->xTrafficClass, xSocketStatus ) );
+        xSocketStatus = eSocketTransportInternalError;
+    }
     else if( ( xSocketStatus = Sockets_Connect( pxSocketParams->xTCPSocket,
                                                 pHostName,
                                                 usPort ) ) != 0 )
@@ -89,12 +140,28 @@ SocketTransportStatus_t Azure_Socket_Connect( NetworkContext_t * pxNetworkContex
         xSocketStatus = eSocketTransportSuccess;
     }
 
+    /* Do not leak the socket when it was opened but could not be connected. */
+    if( ( xSocketStatus != eSocketTransportSuccess ) &&
+        ( pxSocketParams->xTCPSocket != SOCKETS_INVALID_SOCKET ) )
+    {
+        ( void ) Sockets_Close( pxSocketParams->xTCPSocket );
+        pxSocketParams->xTCPSocket = SOCKETS_INVALID_SOCKET;
+    }
+
     return xSocketStatus;
 }
 
 void Azure_Socket_Close( NetworkContext_t * pNetworkContext )
 {
-    ( void ) pNetworkContext;
+    SocketTransportParams_t * pxSocketParams = ( SocketTransportParams_t * ) pNetworkContext->pParams;
+
+    if( pxSocketParams->xTCPSocket != SOCKETS_INVALID_SOCKET )
+    {
+        /* Shut the connection down so the server sees it closed; the socket
+         * is released once the server closed too, without waiting here. */
+        ( void ) Sockets_CloseAsync( pxSocketParams->xTCPSocket );
+        pxSocketParams->xTCPSocket = SOCKETS_INVALID_SOCKET;
+    }
 }
 
 int32_t Azure_Socket_Send( NetworkContext_t * pxNetworkContext,
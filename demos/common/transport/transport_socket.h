@@ -22,6 +22,7 @@ typedef struct SocketTransportParams
 {
     SocketHandle xTCPSocket;
     SocketContextHandle xSocketContext;
+    TransportTrafficClass_t xTrafficClass; /**< Set before connecting; 0 for the defaults. */
 } SocketTransportParams_t;
 
 /**
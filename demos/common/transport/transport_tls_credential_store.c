@@ -0,0 +1,508 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file transport_tls_credential_store.c
+ * @brief Parse-once, reference-counted store for TLS credentials.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the credential store. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "TlsCredentialStore"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_ERROR
+#endif
+
+/* Prototype for the function used to print to console on Windows simulator
+ * of FreeRTOS.
+ * The function prints to the console before the network is connected;
+ * then a UDP port after the network has connected. */
+extern void vLoggingPrintf( const char * pcFormatString,
+                            ... );
+
+/* Map the SdkLog macro to the logging function to enable logging
+ * on Windows simulator. */
+#ifndef SdkLog
+    #define SdkLog( message )    vLoggingPrintf message
+#endif
+
+#include "logging_stack.h"
+
+/************ End of logging configuration ****************/
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "transport_tls_credential_store.h"
+
+#include "mbedtls/asn1.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Identifies a credential blob without keeping a copy of it.
+ */
+typedef struct TlsCredentialBlob
+{
+    const uint8_t * pucData;       /**< Address of the blob. */
+    size_t xSize;                  /**< Size of the blob. */
+    uint32_t ulHash;               /**< FNV-1a hash of the blob content. */
+    TlsCredentialFormat_t xFormat; /**< Encoding of the blob. */
+} TlsCredentialBlob_t;
+
+/**
+ * @brief A parsed credential set.
+ */
+struct TlsCredentialStoreEntry
+{
+    TlsCredentialBlob_t xRootCaBlob;     /**< Root CA blob the entry was parsed from. */
+    TlsCredentialBlob_t xClientCertBlob; /**< Client certificate blob the entry was parsed from. */
+    TlsCredentialBlob_t xPrivateKeyBlob; /**< Private key blob the entry was parsed from. */
+    mbedtls_x509_crt xRootCa;            /**< Parsed root CA chain. */
+    mbedtls_x509_crt xClientCert;        /**< Parsed client certificate. */
+    mbedtls_pk_context xPrivateKey;      /**< Parsed client private key. */
+    BaseType_t xHasClientCredentials;    /**< pdTRUE if a client certificate and key were parsed. */
+    BaseType_t xInUse;                   /**< pdTRUE if the entry holds parsed credentials. */
+    BaseType_t xStale;                   /**< pdTRUE if the entry was purged while referenced. */
+    BaseType_t xTemporary;               /**< pdTRUE if the entry was allocated because the store was full. */
+    uint32_t ulRefCount;                 /**< Connections using the entry. */
+    TickType_t xParseTicks;              /**< Time spent parsing the entry. */
+    size_t xHeapBytes;                   /**< Approximate heap held by the parsed objects. */
+};
+
+static struct TlsCredentialStoreEntry xCredentialStore[ transporttlsCREDENTIAL_STORE_ENTRIES ];
+static TlsCredentialStoreStats_t xCredentialStoreStats;
+
+static SemaphoreHandle_t xCredentialStoreMutex = NULL;
+static StaticSemaphore_t xCredentialStoreMutexStorage;
+
+/*-----------------------------------------------------------*/
+
+static void prvCredentialStoreLock( void )
+{
+    if( xCredentialStoreMutex == NULL )
+    {
+        vTaskSuspendAll();
+        {
+            if( xCredentialStoreMutex == NULL )
+            {
+                xCredentialStoreMutex = xSemaphoreCreateMutexStatic( &xCredentialStoreMutexStorage );
+            }
+        }
+        ( void ) xTaskResumeAll();
+    }
+
+    ( void ) xSemaphoreTake( xCredentialStoreMutex, portMAX_DELAY );
+}
+/*-----------------------------------------------------------*/
+
+static void prvCredentialStoreUnlock( void )
+{
+    ( void ) xSemaphoreGive( xCredentialStoreMutex );
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetBlob( TlsCredentialBlob_t * pxBlob,
+                        const uint8_t * pucData,
+                        size_t xSize,
+                        TlsCredentialFormat_t xFormat )
+{
+    uint32_t ulHash = 2166136261U;
+    size_t xIndex;
+
+    for( xIndex = 0; ( pucData != NULL ) && ( xIndex < xSize ); xIndex++ )
+    {
+        ulHash = ( ulHash ^ pucData[ xIndex ] ) * 16777619U;
+    }
+
+    pxBlob->pucData = pucData;
+    pxBlob->xSize = ( pucData != NULL ) ? xSize : 0;
+    pxBlob->ulHash = ulHash;
+    pxBlob->xFormat = xFormat;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvBlobMatches( const TlsCredentialBlob_t * pxBlobA,
+                                  const TlsCredentialBlob_t * pxBlobB )
+{
+    return ( ( pxBlobA->pucData == pxBlobB->pucData ) &&
+             ( pxBlobA->xSize == pxBlobB->xSize ) &&
+             ( pxBlobA->ulHash == pxBlobB->ulHash ) &&
+             ( pxBlobA->xFormat == pxBlobB->xFormat ) ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static size_t prvChainHeapBytes( const mbedtls_x509_crt * pxChain )
+{
+    const mbedtls_x509_crt * pxCert;
+    size_t xBytes = 0;
+
+    /* DER copy of each certificate unless parsed in place, its public key, and
+     * the list nodes after the first. */
+    for( pxCert = pxChain; ( pxCert != NULL ) && ( pxCert->raw.len > 0 ); pxCert = pxCert->next )
+    {
+        xBytes += 2U * mbedtls_pk_get_len( &( pxCert->pk ) );
+
+        if( pxCert->own_buffer != 0 )
+        {
+            xBytes += pxCert->raw.len;
+        }
+
+        if( pxCert != pxChain )
+        {
+            xBytes += sizeof( mbedtls_x509_crt );
+        }
+    }
+
+    return xBytes;
+}
+/*-----------------------------------------------------------*/
+
+static void prvFreeEntry( struct TlsCredentialStoreEntry * pxEntry )
+{
+    mbedtls_x509_crt_free( &( pxEntry->xRootCa ) );
+    mbedtls_x509_crt_free( &( pxEntry->xClientCert ) );
+    mbedtls_pk_free( &( pxEntry->xPrivateKey ) );
+    memset( pxEntry, 0, sizeof( struct TlsCredentialStoreEntry ) );
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvParseCertificates( mbedtls_x509_crt * pxChain,
+                                     const TlsCredentialBlob_t * pxBlob )
+{
+    int32_t lMbedtlsError = 0;
+    unsigned char * pucCursor;
+    unsigned char * pucEnd;
+    unsigned char * pucCert;
+    size_t xLength;
+
+    if( pxBlob->xFormat == eTlsCredentialFormatPem )
+    {
+        lMbedtlsError = mbedtls_x509_crt_parse( pxChain, pxBlob->pucData, pxBlob->xSize );
+    }
+    else
+    {
+        /* Walk the certificates in the chain by their outer SEQUENCE, and
+         * reference each from the blob instead of copying it to the heap. */
+        pucCursor = ( unsigned char * ) pxBlob->pucData;
+        pucEnd = pucCursor + pxBlob->xSize;
+
+        while( ( lMbedtlsError == 0 ) && ( pucCursor < pucEnd ) )
+        {
+            pucCert = pucCursor;
+
+            if( ( lMbedtlsError = mbedtls_asn1_get_tag( &pucCursor, pucEnd, &xLength,
+                                                        MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE ) ) == 0 )
+            {
+                pucCursor += xLength;
+                lMbedtlsError = mbedtls_x509_crt_parse_der_nocopy( pxChain, pucCert,
+                                                                   ( size_t ) ( pucCursor - pucCert ) );
+            }
+        }
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvParseEntry( struct TlsCredentialStoreEntry * pxEntry )
+{
+    int32_t lMbedtlsError;
+    TickType_t xStart = xTaskGetTickCount();
+
+    mbedtls_x509_crt_init( &( pxEntry->xRootCa ) );
+    mbedtls_x509_crt_init( &( pxEntry->xClientCert ) );
+    mbedtls_pk_init( &( pxEntry->xPrivateKey ) );
+
+    lMbedtlsError = prvParseCertificates( &( pxEntry->xRootCa ),
+                                          &( pxEntry->xRootCaBlob ) );
+
+    if( lMbedtlsError != 0 )
+    {
+        LogError( ( "Failed to parse server root CA certificate: lMbedtlsError[%d].",
+                    lMbedtlsError ) );
+    }
+    else if( pxEntry->xHasClientCredentials == pdTRUE )
+    {
+        lMbedtlsError = prvParseCertificates( &( pxEntry->xClientCert ),
+                                              &( pxEntry->xClientCertBlob ) );
+
+        if( lMbedtlsError != 0 )
+        {
+            LogError( ( "Failed to parse the client certificate: lMbedtlsError[%d].",
+                        lMbedtlsError ) );
+        }
+        else
+        {
+            /* mbed TLS tells the encodings of a key apart itself, and only
+             * decodes PEM when the blob is NUL-terminated text. */
+            lMbedtlsError = mbedtls_pk_parse_key( &( pxEntry->xPrivateKey ),
+                                                  pxEntry->xPrivateKeyBlob.pucData,
+                                                  pxEntry->xPrivateKeyBlob.xSize,
+                                                  NULL,
+                                                  0 );
+
+            if( lMbedtlsError != 0 )
+            {
+                LogError( ( "Failed to parse the client key: lMbedtlsError[%d].",
+                            lMbedtlsError ) );
+            }
+        }
+    }
+
+    if( lMbedtlsError == 0 )
+    {
+        pxEntry->xParseTicks = xTaskGetTickCount() - xStart;
+        pxEntry->xHeapBytes = prvChainHeapBytes( &( pxEntry->xRootCa ) ) +
+                              prvChainHeapBytes( &( pxEntry->xClientCert ) ) +
+                              ( 3U * mbedtls_pk_get_len( &( pxEntry->xPrivateKey ) ) );
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static struct TlsCredentialStoreEntry * prvFindEntry( const struct TlsCredentialStoreEntry * pxKey )
+{
+    struct TlsCredentialStoreEntry * pxEntry = NULL;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < transporttlsCREDENTIAL_STORE_ENTRIES; ulIndex++ )
+    {
+        if( ( xCredentialStore[ ulIndex ].xInUse == pdTRUE ) &&
+            ( xCredentialStore[ ulIndex ].xStale == pdFALSE ) &&
+            ( xCredentialStore[ ulIndex ].xHasClientCredentials == pxKey->xHasClientCredentials ) &&
+            ( prvBlobMatches( &( xCredentialStore[ ulIndex ].xRootCaBlob ), &( pxKey->xRootCaBlob ) ) == pdTRUE ) &&
+            ( prvBlobMatches( &( xCredentialStore[ ulIndex ].xClientCertBlob ), &( pxKey->xClientCertBlob ) ) == pdTRUE ) &&
+            ( prvBlobMatches( &( xCredentialStore[ ulIndex ].xPrivateKeyBlob ), &( pxKey->xPrivateKeyBlob ) ) == pdTRUE ) )
+        {
+            pxEntry = &xCredentialStore[ ulIndex ];
+            break;
+        }
+    }
+
+    return pxEntry;
+}
+/*-----------------------------------------------------------*/
+
+static struct TlsCredentialStoreEntry * prvGetFreeEntry( void )
+{
+    struct TlsCredentialStoreEntry * pxEntry = NULL;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ( pxEntry == NULL ) && ( ulIndex < transporttlsCREDENTIAL_STORE_ENTRIES ); ulIndex++ )
+    {
+        if( xCredentialStore[ ulIndex ].xInUse == pdFALSE )
+        {
+            pxEntry = &xCredentialStore[ ulIndex ];
+        }
+    }
+
+    /* Evict a set no connection is using. */
+    for( ulIndex = 0; ( pxEntry == NULL ) && ( ulIndex < transporttlsCREDENTIAL_STORE_ENTRIES ); ulIndex++ )
+    {
+        if( xCredentialStore[ ulIndex ].ulRefCount == 0 )
+        {
+            pxEntry = &xCredentialStore[ ulIndex ];
+            prvFreeEntry( pxEntry );
+        }
+    }
+
+    if( pxEntry == NULL )
+    {
+        if( ( pxEntry = pvPortMalloc( sizeof( struct TlsCredentialStoreEntry ) ) ) != NULL )
+        {
+            memset( pxEntry, 0, sizeof( struct TlsCredentialStoreEntry ) );
+            pxEntry->xTemporary = pdTRUE;
+        }
+    }
+
+    return pxEntry;
+}
+/*-----------------------------------------------------------*/
+
+TlsCredentialHandle_t TLS_CredentialStore_Acquire( const NetworkCredentials_t * pxNetworkCredentials,
+                                                   int32_t * plMbedtlsError )
+{
+    struct TlsCredentialStoreEntry xKey;
+    struct TlsCredentialStoreEntry * pxEntry;
+    int32_t lMbedtlsError = 0;
+
+    configASSERT( pxNetworkCredentials != NULL );
+    configASSERT( pxNetworkCredentials->pucRootCa != NULL );
+    configASSERT( plMbedtlsError != NULL );
+
+    memset( &xKey, 0, sizeof( xKey ) );
+    xKey.xHasClientCredentials = ( ( pxNetworkCredentials->pucClientCert != NULL ) &&
+                                   ( pxNetworkCredentials->pucPrivateKey != NULL ) ) ? pdTRUE : pdFALSE;
+
+    prvSetBlob( &( xKey.xRootCaBlob ),
+                pxNetworkCredentials->pucRootCa,
+                pxNetworkCredentials->xRootCaSize,
+                pxNetworkCredentials->xRootCaFormat );
+
+    if( xKey.xHasClientCredentials == pdTRUE )
+    {
+        prvSetBlob( &( xKey.xClientCertBlob ),
+                    pxNetworkCredentials->pucClientCert,
+                    pxNetworkCredentials->xClientCertSize,
+                    pxNetworkCredentials->xClientCertFormat );
+        prvSetBlob( &( xKey.xPrivateKeyBlob ),
+                    pxNetworkCredentials->pucPrivateKey,
+                    pxNetworkCredentials->xPrivateKeySize,
+                    pxNetworkCredentials->xPrivateKeyFormat );
+    }
+
+    /* Parsing is done under the lock so that concurrent connects with the same
+     * credentials do not parse them twice. */
+    prvCredentialStoreLock();
+
+    if( ( pxEntry = prvFindEntry( &xKey ) ) != NULL )
+    {
+        pxEntry->ulRefCount++;
+        xCredentialStoreStats.ulReuses++;
+        xCredentialStoreStats.ullParseTicksSaved += pxEntry->xParseTicks;
+        xCredentialStoreStats.ullHeapBytesSaved += pxEntry->xHeapBytes;
+
+        LogInfo( ( "Reusing parsed credentials: saved %u ticks of parsing and ~%u bytes of heap.",
+                   ( unsigned ) pxEntry->xParseTicks, ( unsigned ) pxEntry->xHeapBytes ) );
+    }
+    else if( ( pxEntry = prvGetFreeEntry() ) == NULL )
+    {
+        LogError( ( "Failed to allocate credential store entry." ) );
+        lMbedtlsError = MBEDTLS_ERR_X509_ALLOC_FAILED;
+    }
+    else
+    {
+        pxEntry->xRootCaBlob = xKey.xRootCaBlob;
+        pxEntry->xClientCertBlob = xKey.xClientCertBlob;
+        pxEntry->xPrivateKeyBlob = xKey.xPrivateKeyBlob;
+        pxEntry->xHasClientCredentials = xKey.xHasClientCredentials;
+
+        if( ( lMbedtlsError = prvParseEntry( pxEntry ) ) != 0 )
+        {
+            BaseType_t xTemporary = pxEntry->xTemporary;
+
+            xCredentialStoreStats.ulParseFailures++;
+            prvFreeEntry( pxEntry );
+
+            if( xTemporary == pdTRUE )
+            {
+                vPortFree( pxEntry );
+            }
+
+            pxEntry = NULL;
+        }
+        else
+        {
+            pxEntry->xInUse = pdTRUE;
+            pxEntry->ulRefCount = 1;
+            xCredentialStoreStats.ulParses++;
+            xCredentialStoreStats.xLastParseTicks = pxEntry->xParseTicks;
+            xCredentialStoreStats.xLastParseHeapBytes = pxEntry->xHeapBytes;
+
+            LogInfo( ( "Parsed credentials in %u ticks, ~%u bytes of heap.",
+                       ( unsigned ) pxEntry->xParseTicks, ( unsigned ) pxEntry->xHeapBytes ) );
+        }
+    }
+
+    prvCredentialStoreUnlock();
+
+    *plMbedtlsError = lMbedtlsError;
+
+    return pxEntry;
+}
+/*-----------------------------------------------------------*/
+
+void TLS_CredentialStore_Release( TlsCredentialHandle_t xHandle )
+{
+    BaseType_t xTemporary;
+
+    if( xHandle != NULL )
+    {
+        prvCredentialStoreLock();
+
+        configASSERT( xHandle->ulRefCount > 0 );
+        xHandle->ulRefCount--;
+
+        if( ( xHandle->ulRefCount == 0 ) &&
+            ( ( xHandle->xStale == pdTRUE ) || ( xHandle->xTemporary == pdTRUE ) ) )
+        {
+            xTemporary = xHandle->xTemporary;
+            prvFreeEntry( xHandle );
+
+            if( xTemporary == pdTRUE )
+            {
+                vPortFree( xHandle );
+            }
+        }
+
+        prvCredentialStoreUnlock();
+    }
+}
+/*-----------------------------------------------------------*/
+
+mbedtls_x509_crt * TLS_CredentialStore_GetRootCa( TlsCredentialHandle_t xHandle )
+{
+    configASSERT( xHandle != NULL );
+
+    return &( xHandle->xRootCa );
+}
+/*-----------------------------------------------------------*/
+
+mbedtls_x509_crt * TLS_CredentialStore_GetClientCert( TlsCredentialHandle_t xHandle )
+{
+    configASSERT( xHandle != NULL );
+
+    return ( xHandle->xHasClientCredentials == pdTRUE ) ? &( xHandle->xClientCert ) : NULL;
+}
+/*-----------------------------------------------------------*/
+
+mbedtls_pk_context * TLS_CredentialStore_GetPrivateKey( TlsCredentialHandle_t xHandle )
+{
+    configASSERT( xHandle != NULL );
+
+    return ( xHandle->xHasClientCredentials == pdTRUE ) ? &( xHandle->xPrivateKey ) : NULL;
+}
+/*-----------------------------------------------------------*/
+
+void TLS_CredentialStore_Purge( void )
+{
+    uint32_t ulIndex;
+
+    prvCredentialStoreLock();
+
+    for( ulIndex = 0; ulIndex < transporttlsCREDENTIAL_STORE_ENTRIES; ulIndex++ )
+    {
+        if( xCredentialStore[ ulIndex ].ulRefCount == 0 )
+        {
+            prvFreeEntry( &xCredentialStore[ ulIndex ] );
+        }
+        else
+        {
+            xCredentialStore[ ulIndex ].xStale = pdTRUE;
+        }
+    }
+
+    prvCredentialStoreUnlock();
+}
+/*-----------------------------------------------------------*/
+
+void TLS_CredentialStore_GetStats( TlsCredentialStoreStats_t * pxStats )
+{
+    configASSERT( pxStats != NULL );
+
+    prvCredentialStoreLock();
+    *pxStats = xCredentialStoreStats;
+    prvCredentialStoreUnlock();
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,112 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file transport_tls_credential_store.h
+ * @brief Parse-once store for the certificates and keys in #NetworkCredentials_t.
+ *
+ * The first connect using a set of credentials parses them into mbedTLS
+ * objects; later connects presenting the same blobs attach those objects
+ * instead of parsing again. Blobs are matched by address, size and a hash of
+ * their content, so a buffer rewritten in place (e.g. by CA recovery) is
+ * parsed again.
+ */
+
+#ifndef TRANSPORT_TLS_CREDENTIAL_STORE_H
+#define TRANSPORT_TLS_CREDENTIAL_STORE_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include "mbedtls/pk.h"
+#include "mbedtls/x509_crt.h"
+
+#include "transport_tls_socket.h"
+
+/**
+ * @brief Number of parsed credential sets kept by the store.
+ *
+ * If all entries are in use, credentials are parsed into a temporary entry
+ * that is freed on release.
+ */
+#ifndef transporttlsCREDENTIAL_STORE_ENTRIES
+    #define transporttlsCREDENTIAL_STORE_ENTRIES    ( 2 )
+#endif
+
+/**
+ * @brief Handle to a parsed credential set.
+ */
+typedef struct TlsCredentialStoreEntry * TlsCredentialHandle_t;
+
+/**
+ * @brief Credential store counters.
+ */
+typedef struct TlsCredentialStoreStats
+{
+    uint32_t ulParses;           /**< Credential sets parsed. */
+    uint32_t ulReuses;           /**< Connects that attached an already parsed set. */
+    uint32_t ulParseFailures;    /**< Credential sets that failed to parse. */
+    TickType_t xLastParseTicks;  /**< Time spent parsing the last credential set, in ticks. */
+    size_t xLastParseHeapBytes;  /**< Approximate heap held by the last parsed set. */
+    uint64_t ullParseTicksSaved; /**< Parse time saved by reuse, in ticks. */
+    uint64_t ullHeapBytesSaved;  /**< Approximate heap allocations saved by reuse. */
+} TlsCredentialStoreStats_t;
+
+/**
+ * @brief Get the parsed form of a set of credentials, parsing it if needed.
+ *
+ * The client certificate and private key are only used if both are set.
+ *
+ * @param[in] pxNetworkCredentials Credentials to look up.
+ * @param[out] plMbedtlsError mbedTLS error if parsing failed; 0 otherwise.
+ * @return A handle to release with TLS_CredentialStore_Release, or NULL on failure.
+ */
+TlsCredentialHandle_t TLS_CredentialStore_Acquire( const NetworkCredentials_t * pxNetworkCredentials,
+                                                   int32_t * plMbedtlsError );
+
+/**
+ * @brief Release a handle returned by TLS_CredentialStore_Acquire.
+ *
+ * @param[in] xHandle Handle to release.
+ */
+void TLS_CredentialStore_Release( TlsCredentialHandle_t xHandle );
+
+/**
+ * @brief Get the parsed root CA chain.
+ *
+ * @param[in] xHandle Credential handle.
+ * @return Root CA chain.
+ */
+mbedtls_x509_crt * TLS_CredentialStore_GetRootCa( TlsCredentialHandle_t xHandle );
+
+/**
+ * @brief Get the parsed client certificate.
+ *
+ * @param[in] xHandle Credential handle.
+ * @return Client certificate, or NULL if the credentials have none.
+ */
+mbedtls_x509_crt * TLS_CredentialStore_GetClientCert( TlsCredentialHandle_t xHandle );
+
+/**
+ * @brief Get the parsed client private key.
+ *
+ * @param[in] xHandle Credential handle.
+ * @return Client private key, or NULL if the credentials have none.
+ */
+mbedtls_pk_context * TLS_CredentialStore_GetPrivateKey( TlsCredentialHandle_t xHandle );
+
+/**
+ * @brief Free all parsed credentials. Sets still attached to a connection are
+ * freed when their last handle is released.
+ */
+void TLS_CredentialStore_Purge( void );
+
+/**
+ * @brief Get a copy of the credential store counters.
+ *
+ * @param[out] pxStats Where the counters are copied.
+ */
+void TLS_CredentialStore_GetStats( TlsCredentialStoreStats_t * pxStats );
+
+#endif /* TRANSPORT_TLS_CREDENTIAL_STORE_H */
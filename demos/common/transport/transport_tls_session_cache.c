@@ -0,0 +1,405 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file transport_tls_session_cache.c
+ * @brief TLS session resumption cache. Sessions are kept serialized so that
+ * entries own no mbedTLS allocations between connections.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the session cache. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "TlsSessionCache"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_ERROR
+#endif
+
+/* Prototype for the function used to print to console on Windows simulator
+ * of FreeRTOS.
+ * The function prints to the console before the network is connected;
+ * then a UDP port after the network has connected. */
+extern void vLoggingPrintf( const char * pcFormatString,
+                            ... );
+
+/* Map the SdkLog macro to the logging function to enable logging
+ * on Windows simulator. */
+#ifndef SdkLog
+    #define SdkLog( message )    vLoggingPrintf message
+#endif
+
+#include "logging_stack.h"
+
+/************ End of logging configuration ****************/
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+/* Socket wrapper include, for the host name length. */
+#include "sockets_wrapper.h"
+
+#include "transport_tls_session_cache.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A cached session for one host:port.
+ */
+typedef struct TlsSessionCacheEntry
+{
+    char cHostName[ SOCKETS_MAX_HOST_NAME_LENGTH + 1 ]; /**< Host name the session was negotiated with. */
+    uint16_t usPort;                                    /**< Port the session was negotiated with. */
+    uint8_t * pucSession;                               /**< Serialized session, NULL if the entry is free. */
+    size_t xSessionLength;                              /**< Length of #TlsSessionCacheEntry_t.pucSession. */
+    TickType_t xStoredTime;                             /**< Tick count when the session was stored. */
+    TickType_t xLifetime;                               /**< Ticks after #TlsSessionCacheEntry_t.xStoredTime the session expires. */
+} TlsSessionCacheEntry_t;
+
+static TlsSessionCacheEntry_t xSessionCache[ transporttlsSESSION_CACHE_ENTRIES ];
+static TlsSessionCacheStats_t xSessionCacheStats;
+static uint64_t ullFullHandshakeTicksTotal;
+static uint64_t ullResumedHandshakeTicksTotal;
+
+static SemaphoreHandle_t xSessionCacheMutex = NULL;
+static StaticSemaphore_t xSessionCacheMutexStorage;
+
+/*-----------------------------------------------------------*/
+
+static void prvSessionCacheLock( void )
+{
+    if( xSessionCacheMutex == NULL )
+    {
+        vTaskSuspendAll();
+        {
+            if( xSessionCacheMutex == NULL )
+            {
+                xSessionCacheMutex = xSemaphoreCreateMutexStatic( &xSessionCacheMutexStorage );
+            }
+        }
+        ( void ) xTaskResumeAll();
+    }
+
+    ( void ) xSemaphoreTake( xSessionCacheMutex, portMAX_DELAY );
+}
+/*-----------------------------------------------------------*/
+
+static void prvSessionCacheUnlock( void )
+{
+    ( void ) xSemaphoreGive( xSessionCacheMutex );
+}
+/*-----------------------------------------------------------*/
+
+static void prvFreeEntry( TlsSessionCacheEntry_t * pxEntry )
+{
+    if( pxEntry->pucSession != NULL )
+    {
+        memset( pxEntry->pucSession, 0, pxEntry->xSessionLength );
+        vPortFree( pxEntry->pucSession );
+    }
+
+    memset( pxEntry, 0, sizeof( TlsSessionCacheEntry_t ) );
+}
+/*-----------------------------------------------------------*/
+
+static TlsSessionCacheEntry_t * prvFindEntry( const char * pcHostName,
+                                              uint16_t usPort )
+{
+    TlsSessionCacheEntry_t * pxEntry = NULL;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < transporttlsSESSION_CACHE_ENTRIES; ulIndex++ )
+    {
+        if( ( xSessionCache[ ulIndex ].pucSession != NULL ) &&
+            ( xSessionCache[ ulIndex ].usPort == usPort ) &&
+            ( strncmp( xSessionCache[ ulIndex ].cHostName, pcHostName,
+                       SOCKETS_MAX_HOST_NAME_LENGTH ) == 0 ) )
+        {
+            pxEntry = &xSessionCache[ ulIndex ];
+            break;
+        }
+    }
+
+    return pxEntry;
+}
+/*-----------------------------------------------------------*/
+
+static TlsSessionCacheEntry_t * prvGetEntryForStore( const char * pcHostName,
+                                                     uint16_t usPort )
+{
+    TlsSessionCacheEntry_t * pxEntry = prvFindEntry( pcHostName, usPort );
+    uint32_t ulIndex;
+
+    /* Prefer a free slot, otherwise evict the oldest session. */
+    for( ulIndex = 0; ( pxEntry == NULL ) && ( ulIndex < transporttlsSESSION_CACHE_ENTRIES ); ulIndex++ )
+    {
+        if( xSessionCache[ ulIndex ].pucSession == NULL )
+        {
+            pxEntry = &xSessionCache[ ulIndex ];
+        }
+    }
+
+    if( pxEntry == NULL )
+    {
+        pxEntry = &xSessionCache[ 0 ];
+
+        for( ulIndex = 1; ulIndex < transporttlsSESSION_CACHE_ENTRIES; ulIndex++ )
+        {
+            if( ( xTaskGetTickCount() - xSessionCache[ ulIndex ].xStoredTime ) >
+                ( xTaskGetTickCount() - pxEntry->xStoredTime ) )
+            {
+                pxEntry = &xSessionCache[ ulIndex ];
+            }
+        }
+    }
+
+    return pxEntry;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_SessionCache_Load( const char * pcHostName,
+                                  uint16_t usPort,
+                                  mbedtls_ssl_context * pxSslContext )
+{
+    BaseType_t xLoaded = pdFALSE;
+    TlsSessionCacheEntry_t * pxEntry;
+    mbedtls_ssl_session xSession;
+    int32_t lMbedtlsError;
+
+    configASSERT( pcHostName != NULL );
+    configASSERT( pxSslContext != NULL );
+
+    prvSessionCacheLock();
+
+    pxEntry = prvFindEntry( pcHostName, usPort );
+
+    if( pxEntry == NULL )
+    {
+        xSessionCacheStats.ulMisses++;
+    }
+    else if( ( xTaskGetTickCount() - pxEntry->xStoredTime ) >= pxEntry->xLifetime )
+    {
+        LogInfo( ( "Cached session for %s:%u expired.", pcHostName, usPort ) );
+        prvFreeEntry( pxEntry );
+        xSessionCacheStats.ulExpired++;
+        xSessionCacheStats.ulMisses++;
+    }
+    else
+    {
+        mbedtls_ssl_session_init( &xSession );
+
+        lMbedtlsError = mbedtls_ssl_session_load( &xSession,
+                                                  pxEntry->pucSession,
+                                                  pxEntry->xSessionLength );
+
+        if( lMbedtlsError == 0 )
+        {
+            lMbedtlsError = mbedtls_ssl_set_session( pxSslContext, &xSession );
+        }
+
+        if( lMbedtlsError != 0 )
+        {
+            LogError( ( "Failed to restore cached session for %s:%u: lMbedtlsError[%d].",
+                        pcHostName, usPort, lMbedtlsError ) );
+            prvFreeEntry( pxEntry );
+            xSessionCacheStats.ulInvalidations++;
+            xSessionCacheStats.ulMisses++;
+        }
+        else
+        {
+            xLoaded = pdTRUE;
+        }
+
+        mbedtls_ssl_session_free( &xSession );
+    }
+
+    prvSessionCacheUnlock();
+
+    return xLoaded;
+}
+/*-----------------------------------------------------------*/
+
+void TLS_SessionCache_Store( const char * pcHostName,
+                             uint16_t usPort,
+                             const mbedtls_ssl_context * pxSslContext )
+{
+    TlsSessionCacheEntry_t * pxEntry;
+    mbedtls_ssl_session xSession;
+    uint8_t * pucSession = NULL;
+    size_t xSessionLength = 0;
+    uint64_t ullLifetimeMs = transporttlsSESSION_CACHE_TTL_MS;
+    int32_t lMbedtlsError;
+
+    configASSERT( pcHostName != NULL );
+    configASSERT( pxSslContext != NULL );
+
+    mbedtls_ssl_session_init( &xSession );
+
+    if( strlen( pcHostName ) > SOCKETS_MAX_HOST_NAME_LENGTH )
+    {
+        lMbedtlsError = MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    else
+    {
+        lMbedtlsError = mbedtls_ssl_get_session( pxSslContext, &xSession );
+    }
+
+    if( lMbedtlsError == 0 )
+    {
+        #if defined( MBEDTLS_SSL_SESSION_TICKETS )
+            if( ( xSession.ticket_len > 0 ) &&
+                ( xSession.ticket_lifetime != 0 ) &&
+                ( ( ( uint64_t ) xSession.ticket_lifetime * 1000U ) < ullLifetimeMs ) )
+            {
+                ullLifetimeMs = ( uint64_t ) xSession.ticket_lifetime * 1000U;
+            }
+
+            if( ( xSession.id_len == 0 ) && ( xSession.ticket_len == 0 ) )
+        #else
+            if( xSession.id_len == 0 )
+        #endif
+        {
+            /* Server did not make the session resumable. */
+            lMbedtlsError = MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+        }
+    }
+
+    if( lMbedtlsError == 0 )
+    {
+        /* Query the serialized length first. */
+        lMbedtlsError = mbedtls_ssl_session_save( &xSession, NULL, 0, &xSessionLength );
+
+        if( lMbedtlsError == MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL )
+        {
+            if( ( pucSession = pvPortMalloc( xSessionLength ) ) == NULL )
+            {
+                lMbedtlsError = MBEDTLS_ERR_SSL_ALLOC_FAILED;
+            }
+            else
+            {
+                lMbedtlsError = mbedtls_ssl_session_save( &xSession, pucSession,
+                                                          xSessionLength, &xSessionLength );
+            }
+        }
+    }
+
+    mbedtls_ssl_session_free( &xSession );
+
+    if( lMbedtlsError != 0 )
+    {
+        LogDebug( ( "Session for %s:%u not cached: lMbedtlsError[%d].",
+                    pcHostName, usPort, lMbedtlsError ) );
+
+        if( pucSession != NULL )
+        {
+            vPortFree( pucSession );
+        }
+    }
+    else
+    {
+        prvSessionCacheLock();
+
+        pxEntry = prvGetEntryForStore( pcHostName, usPort );
+        prvFreeEntry( pxEntry );
+
+        ( void ) strcpy( pxEntry->cHostName, pcHostName );
+        pxEntry->usPort = usPort;
+        pxEntry->pucSession = pucSession;
+        pxEntry->xSessionLength = xSessionLength;
+        pxEntry->xStoredTime = xTaskGetTickCount();
+        pxEntry->xLifetime = ( TickType_t ) ( ( ullLifetimeMs * configTICK_RATE_HZ ) / 1000U );
+
+        prvSessionCacheUnlock();
+
+        LogInfo( ( "Cached %u byte session for %s:%u.",
+                   ( unsigned ) xSessionLength, pcHostName, usPort ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void TLS_SessionCache_RecordHandshake( BaseType_t xOffered,
+                                       BaseType_t xResumed,
+                                       TickType_t xHandshakeTicks )
+{
+    prvSessionCacheLock();
+
+    if( xResumed == pdTRUE )
+    {
+        xSessionCacheStats.ulHits++;
+        xSessionCacheStats.ulResumedHandshakes++;
+        ullResumedHandshakeTicksTotal += xHandshakeTicks;
+        xSessionCacheStats.xAvgResumedHandshake =
+            ( TickType_t ) ( ullResumedHandshakeTicksTotal / xSessionCacheStats.ulResumedHandshakes );
+
+        if( xSessionCacheStats.xAvgFullHandshake > xHandshakeTicks )
+        {
+            xSessionCacheStats.ullTicksSaved += xSessionCacheStats.xAvgFullHandshake - xHandshakeTicks;
+        }
+    }
+    else
+    {
+        if( xOffered == pdTRUE )
+        {
+            xSessionCacheStats.ulRejected++;
+        }
+
+        xSessionCacheStats.ulFullHandshakes++;
+        ullFullHandshakeTicksTotal += xHandshakeTicks;
+        xSessionCacheStats.xAvgFullHandshake =
+            ( TickType_t ) ( ullFullHandshakeTicksTotal / xSessionCacheStats.ulFullHandshakes );
+    }
+
+    prvSessionCacheUnlock();
+}
+/*-----------------------------------------------------------*/
+
+void TLS_SessionCache_Invalidate( const char * pcHostName,
+                                  uint16_t usPort )
+{
+    TlsSessionCacheEntry_t * pxEntry;
+
+    configASSERT( pcHostName != NULL );
+
+    prvSessionCacheLock();
+
+    if( ( pxEntry = prvFindEntry( pcHostName, usPort ) ) != NULL )
+    {
+        prvFreeEntry( pxEntry );
+        xSessionCacheStats.ulInvalidations++;
+    }
+
+    prvSessionCacheUnlock();
+}
+/*-----------------------------------------------------------*/
+
+void TLS_SessionCache_Clear( void )
+{
+    uint32_t ulIndex;
+
+    prvSessionCacheLock();
+
+    for( ulIndex = 0; ulIndex < transporttlsSESSION_CACHE_ENTRIES; ulIndex++ )
+    {
+        prvFreeEntry( &xSessionCache[ ulIndex ] );
+    }
+
+    prvSessionCacheUnlock();
+}
+/*-----------------------------------------------------------*/
+
+void TLS_SessionCache_GetStats( TlsSessionCacheStats_t * pxStats )
+{
+    configASSERT( pxStats != NULL );
+
+    prvSessionCacheLock();
+    *pxStats = xSessionCacheStats;
+    prvSessionCacheUnlock();
+}
+/*-----------------------------------------------------------*/
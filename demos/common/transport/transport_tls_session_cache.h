@@ -0,0 +1,116 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file transport_tls_session_cache.h
+ * @brief TLS session resumption cache used by the mbedTLS transport.
+ *
+ * Sessions (session ID and, when negotiated, the RFC 5077 session ticket) are
+ * saved per host:port after a successful handshake and offered back to the
+ * server on the next connect to the same endpoint, so that a reconnect can
+ * skip the key exchange and certificate verification.
+ */
+
+#ifndef TRANSPORT_TLS_SESSION_CACHE_H
+#define TRANSPORT_TLS_SESSION_CACHE_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include "mbedtls/ssl.h"
+
+/**
+ * @brief Number of host:port entries kept in the cache.
+ */
+#ifndef transporttlsSESSION_CACHE_ENTRIES
+    #define transporttlsSESSION_CACHE_ENTRIES    ( 2 )
+#endif
+
+/**
+ * @brief Maximum age of a cached session before it is no longer offered.
+ *
+ * If the server issued a session ticket with a shorter lifetime hint, the
+ * lifetime hint is used instead.
+ */
+#ifndef transporttlsSESSION_CACHE_TTL_MS
+    #define transporttlsSESSION_CACHE_TTL_MS    ( 60U * 60U * 1000U )
+#endif
+
+/**
+ * @brief Session cache counters.
+ */
+typedef struct TlsSessionCacheStats
+{
+    uint32_t ulHits;                 /**< Handshakes in which the server accepted the cached session. */
+    uint32_t ulMisses;               /**< Connects for which no valid session was cached. */
+    uint32_t ulRejected;             /**< Cached sessions offered but declined by the server. */
+    uint32_t ulExpired;              /**< Cached sessions dropped because their TTL elapsed. */
+    uint32_t ulInvalidations;        /**< Entries removed by TLS_SessionCache_Invalidate or a failed handshake. */
+    uint32_t ulFullHandshakes;       /**< Number of full handshakes timed. */
+    uint32_t ulResumedHandshakes;    /**< Number of resumed handshakes timed. */
+    TickType_t xAvgFullHandshake;    /**< Average duration of a full handshake, in ticks. */
+    TickType_t xAvgResumedHandshake; /**< Average duration of a resumed handshake, in ticks. */
+    uint64_t ullTicksSaved;          /**< Handshake time saved by resumption, in ticks. */
+} TlsSessionCacheStats_t;
+
+/**
+ * @brief Offer the cached session for host:port, if any, on a TLS context.
+ *
+ * Must be called after mbedtls_ssl_setup and before the handshake.
+ *
+ * @param[in] pcHostName Remote host name.
+ * @param[in] usPort Remote port.
+ * @param[in,out] pxSslContext mbedTLS context the session is set on.
+ * @return pdTRUE if a cached session was set on the context; otherwise, pdFALSE.
+ */
+BaseType_t TLS_SessionCache_Load( const char * pcHostName,
+                                  uint16_t usPort,
+                                  mbedtls_ssl_context * pxSslContext );
+
+/**
+ * @brief Save the session negotiated on a TLS context for host:port.
+ *
+ * Must be called after the handshake completed successfully.
+ *
+ * @param[in] pcHostName Remote host name.
+ * @param[in] usPort Remote port.
+ * @param[in] pxSslContext mbedTLS context that completed the handshake.
+ */
+void TLS_SessionCache_Store( const char * pcHostName,
+                             uint16_t usPort,
+                             const mbedtls_ssl_context * pxSslContext );
+
+/**
+ * @brief Record the outcome and duration of a handshake in the cache counters.
+ *
+ * @param[in] xOffered pdTRUE if a cached session was offered.
+ * @param[in] xResumed pdTRUE if the server resumed the offered session.
+ * @param[in] xHandshakeTicks Duration of the handshake, in ticks.
+ */
+void TLS_SessionCache_RecordHandshake( BaseType_t xOffered,
+                                       BaseType_t xResumed,
+                                       TickType_t xHandshakeTicks );
+
+/**
+ * @brief Drop the cached session for host:port.
+ *
+ * @param[in] pcHostName Remote host name.
+ * @param[in] usPort Remote port.
+ */
+void TLS_SessionCache_Invalidate( const char * pcHostName,
+                                  uint16_t usPort );
+
+/**
+ * @brief Drop all cached sessions. Counters are kept.
+ */
+void TLS_SessionCache_Clear( void );
+
+/**
+ * @brief Get a copy of the session cache counters.
+ *
+ * @param[out] pxStats Where the counters are copied.
+ */
+void TLS_SessionCache_GetStats( TlsSessionCacheStats_t * pxStats );
+
+#endif /* TRANSPORT_TLS_SESSION_CACHE_H */
@@ -1,6 +1,9 @@
 /* Copyright (c) Microsoft Corporation.
  * Licensed under the MIT License. */
 
+#ifndef TRANSPORT_TLS_SOCKET_H
+#define TRANSPORT_TLS_SOCKET_H
+
 #include "azure_iot_transport_interface.h"
 
 #include "sockets_wrapper.h"
@@ -14,10 +17,38 @@ typedef struct TlsTransportParams
 {
     SocketHandle xTCPSocket;
     SSLContextHandle xSSLContext;
+    TransportTrafficClass_t xTrafficClass; /**< Set before connecting; 0 for the defaults. */
 } TlsTransportParams_t;
 
+/**
+ * @brief Encoding of a certificate or key in #NetworkCredentials_t.
+ */
+typedef enum TlsCredentialFormat
+{
+    eTlsCredentialFormatPem = 0, /**< @brief NUL-terminated PEM text; the size includes the terminator. */
+    eTlsCredentialFormatDer      /**< @brief Binary DER. A certificate chain is the DER certificates back to back. */
+} TlsCredentialFormat_t;
+
+/**
+ * @brief Cipher suites and curves offered to the server.
+ *
+ * Suites and curves that mbed TLS is not built with are not offered, so a
+ * profile only narrows what the mbed TLS configuration allows.
+ */
+typedef enum TlsCipherProfile
+{
+    eTlsCipherProfileDefault = 0, /**< @brief The transport default, transporttlsCIPHER_PROFILE. */
+    eTlsCipherProfileLowPower,    /**< @brief ECDHE-ECDSA with AES-128-GCM or AES-128-CCM on secp256r1 only. Needs an ECDSA server certificate. */
+    eTlsCipherProfileBalanced,    /**< @brief ECDHE-ECDSA or ECDHE-RSA with AES-128 and SHA-256, on secp256r1 or secp384r1. */
+    eTlsCipherProfileCompat       /**< @brief Everything mbed TLS is built with. */
+} TlsCipherProfile_t;
+
 /**
  * @brief Contains the credentials necessary for TLS connection setup.
+ *
+ * DER certificates are parsed in place rather than copied, so a DER blob must
+ * stay unchanged while a connection uses it. Credentials held in flash, as
+ * generated by tools/pem_to_der.py, meet this.
  */
 typedef struct NetworkCredentials
 {
@@ -32,14 +63,81 @@ typedef struct NetworkCredentials
      */
     BaseType_t xDisableSni;
 
+    /**
+     * @brief Maximum fragment length to negotiate, in bytes: 512, 1024, 2048
+     * or 4096, or 16384 not to negotiate one. 0 selects the transport default,
+     * transporttlsMAX_FRAGMENT_LENGTH.
+     *
+     * When mbed TLS is built with MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH, the
+     * record buffers of the connection are shrunk to this size once the
+     * handshake is done, so smaller values use less RAM per connection.
+     */
+    uint16_t usMaxFragmentLength;
+
+    /**
+     * @brief Cipher suites and curves to offer. A narrower profile keeps the
+     * server from picking costlier key exchanges, ciphers and hashes.
+     */
+    TlsCipherProfile_t xCipherProfile;
+
     const uint8_t * pucRootCa;     /**< @brief String representing a trusted server root certificate. */
     size_t xRootCaSize;            /**< @brief Size associated with #NetworkCredentials.pRootCa. */
     const uint8_t * pucClientCert; /**< @brief String representing the client certificate. */
     size_t xClientCertSize;        /**< @brief Size associated with #NetworkCredentials.pClientCert. */
     const uint8_t * pucPrivateKey; /**< @brief String representing the client certificate's private key. */
     size_t xPrivateKeySize;        /**< @brief Size associated with #NetworkCredentials.pPrivateKey. */
+
+    TlsCredentialFormat_t xRootCaFormat;     /**< @brief Encoding of #NetworkCredentials.pucRootCa. */
+    TlsCredentialFormat_t xClientCertFormat; /**< @brief Encoding of #NetworkCredentials.pucClientCert. */
+    TlsCredentialFormat_t xPrivateKeyFormat; /**< @brief Encoding of #NetworkCredentials.pucPrivateKey. */
 } NetworkCredentials_t;
 
+/**
+ * @brief Send counters of a TLS connection.
+ */
+typedef struct TlsTransportSendStats
+{
+    uint32_t ulSendCalls;     /**< Calls to TLS_Socket_Send. */
+    uint32_t ulRecords;       /**< Application data records written. */
+    uint64_t ullPayloadBytes; /**< Application data bytes written. */
+    uint32_t ulSocketWrites;  /**< Socket sends, handshake included. */
+    uint64_t ullWireBytes;    /**< Bytes passed to the socket, handshake included. */
+} TlsTransportSendStats_t;
+
+/**
+ * @brief Receive counters of a TLS connection.
+ */
+typedef struct TlsTransportRecvStats
+{
+    uint32_t ulRecvCalls;      /**< Calls to TLS_Socket_Recv. */
+    uint32_t ulSslReads;       /**< Reads from the TLS stack. */
+    uint32_t ulReadAheadHits;  /**< Calls served from the read-ahead buffer. */
+    uint64_t ullBytesReceived; /**< Application data bytes returned. */
+    uint32_t ulRecords;        /**< Application data records decrypted. */
+    uint32_t ulSocketReads;    /**< Socket receives that returned data, handshake included. */
+    uint64_t ullWireBytes;     /**< Bytes read from the socket, handshake included. */
+    uint32_t ulBorrows;        /**< Calls to TLS_Socket_RecvBorrow that lent data. */
+    uint64_t ullBytesCopied;   /**< Decrypted bytes copied by the transport, into the read-ahead buffer or the caller's buffer. */
+} TlsTransportRecvStats_t;
+
+/**
+ * @brief Where the time went while a TLS connection was set up.
+ *
+ * Filled in when the handshake completes. Durations are in milliseconds.
+ */
+typedef struct TlsTransportConnectStats
+{
+    uint32_t ulDnsMs;               /**< Name resolution, 0 if the sockets wrapper does not report it. */
+    uint32_t ulTcpConnectMs;        /**< TCP connect, including name resolution if that is not reported. */
+    uint32_t ulHandshakeMs;         /**< TLS handshake. */
+    uint32_t ulTotalMs;             /**< From the connect call to the end of the handshake. */
+    BaseType_t xSessionResumed;     /**< Set if a cached session was resumed. */
+    const char * pcCipherSuite;     /**< Negotiated cipher suite, valid until disconnect. NULL before the handshake completes. */
+    const char * pcTlsVersion;      /**< Negotiated protocol version, valid until disconnect. NULL before the handshake completes. */
+    uint32_t ulHandshakeRoundTrips; /**< Times the handshake waited for the server after sending, 2 for a full handshake and 1 for a resumed one. */
+    uint32_t ulHandshakeYields;     /**< Times the handshake returned between elliptic curve steps, see TLS_Socket_SetEcpMaxOps. */
+} TlsTransportConnectStats_t;
+
 /**
  * @brief TLS Connect / Disconnect return status.
  */
@@ -52,7 +150,8 @@ typedef enum TlsTransportStatus
     eTLSTransportHandshakeFailed,    /**< Performing TLS handshake with server failed. */
     eTLSTransportInternalError,      /**< A call to a system API resulted in an internal error. */
     eTLSTransportConnectFailure,     /**< Initial connection to the server failed. */
-    eTLSTransportCAVerifyFailed      /**< Verification of TLS CA cert failed. */
+    eTLSTransportCAVerifyFailed,     /**< Verification of TLS CA cert failed. */
+    eTLSTransportInProgress          /**< Connection not yet established; call TLS_Socket_ConnectPoll again. */
 } TlsTransportStatus_t;
 
 /**
@@ -73,6 +172,45 @@ TlsTransportStatus_t TLS_Socket_Connect( NetworkContext_t * pxNetworkContext,
                                          uint32_t ulReceiveTimeoutMs,
                                          uint32_t ulSendTimeoutMs );
 
+/**
+ * @brief Start connecting to a TLS endpoint without blocking.
+ *
+ * Name resolution, the TCP connect and the TLS handshake are then stepped by
+ * TLS_Socket_ConnectPoll, so a task can drive several connects, or other
+ * work, while they are in flight. Name resolution and the TCP connect only
+ * run in the background on ports whose sockets wrapper supports it.
+ *
+ * @param[in] pxNetworkContext Pointer to the Network context.
+ * @param[in] pcHostName Pointer to NULL terminated hostname.
+ * @param[in] usPort Port to connect to.
+ * @param[in] pxNetworkCredentials Pointer to network credentials. The ALPN
+ * list must remain valid for the lifetime of the connection.
+ * @param[in] ulReceiveTimeoutMs Receive timeout once connected. Also bounds
+ * the time the TLS handshake may wait for the server.
+ * @param[in] ulSendTimeoutMs Send timeout once connected.
+ * @return #eTLSTransportInProgress while connecting, #eTLSTransportSuccess if
+ * the connection is already established, or another #TlsTransportStatus_t on failure.
+ */
+TlsTransportStatus_t TLS_Socket_ConnectStart( NetworkContext_t * pxNetworkContext,
+                                              const char * pcHostName,
+                                              uint16_t usPort,
+                                              const NetworkCredentials_t * pxNetworkCredentials,
+                                              uint32_t ulReceiveTimeoutMs,
+                                              uint32_t ulSendTimeoutMs );
+
+/**
+ * @brief Advance a connect started with TLS_Socket_ConnectStart.
+ *
+ * Each call does the work that is possible without waiting. On failure, the
+ * connection is cleaned up as by a failed TLS_Socket_Connect; a connect in
+ * progress can be abandoned with TLS_Socket_Disconnect.
+ *
+ * @param[in] pxNetworkContext Pointer to the Network context.
+ * @return #eTLSTransportInProgress while connecting, #eTLSTransportSuccess once
+ * the connection is established, or another #TlsTransportStatus_t on failure.
+ */
+TlsTransportStatus_t TLS_Socket_ConnectPoll( NetworkContext_t * pxNetworkContext );
+
 /**
  * @brief Disconnect the TLS connection
  *
@@ -83,6 +221,10 @@ void TLS_Socket_Disconnect( NetworkContext_t * pxNetworkContext );
 /**
  * @brief Receive data from TLS.
  *
+ * Reads smaller than the read-ahead buffer are served from decrypted data
+ * already buffered for the connection, or fill the buffer with the rest of
+ * the current TLS record.
+ *
  * @param pxNetworkContext Pointer to the Network context.
  * @param pvBuffer Buffer used for receiving data.
  * @param xBytesToRecv Size of the buffer.
@@ -92,6 +234,35 @@ int32_t TLS_Socket_Recv( NetworkContext_t * pxNetworkContext,
                          void * pvBuffer,
                          size_t xBytesToRecv );
 
+/**
+ * @brief Borrow the next decrypted data of a connection in place, instead of
+ * having it copied by TLS_Socket_Recv.
+ *
+ * Lends the data read ahead by TLS_Socket_Recv if any, otherwise the unread
+ * part of the current TLS record, decrypting the next record when none is
+ * left. The data stays valid until TLS_Socket_RecvRelease, and no other
+ * receive may be made on the connection until then. With mbed TLS 3.x the
+ * record is copied into the read-ahead buffer first, so at most
+ * transporttlsREAD_AHEAD_SIZE bytes are lent at a time.
+ *
+ * @param pxNetworkContext Pointer to the Network context.
+ * @param ppucData Set to the borrowed data.
+ * @return An #int32_t number of bytes borrowed, 0 if nothing arrived before
+ * the receive timeout, or a negative mbed TLS error.
+ */
+int32_t TLS_Socket_RecvBorrow( NetworkContext_t * pxNetworkContext,
+                               const uint8_t ** ppucData );
+
+/**
+ * @brief Give back data borrowed with TLS_Socket_RecvBorrow.
+ *
+ * @param pxNetworkContext Pointer to the Network context.
+ * @param xConsumed Bytes consumed from the start of the borrowed data, at most
+ * the number borrowed. The rest is returned by the next receive or borrow.
+ */
+void TLS_Socket_RecvRelease( NetworkContext_t * pxNetworkContext,
+                             size_t xConsumed );
+
 /**
  * @brief Send data using TLS.
  *
@@ -103,3 +274,80 @@ int32_t TLS_Socket_Recv( NetworkContext_t * pxNetworkContext,
 int32_t TLS_Socket_Send( NetworkContext_t * pxNetworkContext,
                          const void * pvBuffer,
                          size_t xBytesToSend );
+
+/**
+ * @brief Get the receive counters of a connection.
+ *
+ * @param pxNetworkContext Pointer to the Network context.
+ * @param pxStats Where the counters are copied.
+ */
+void TLS_Socket_GetRecvStats( NetworkContext_t * pxNetworkContext,
+                              TlsTransportRecvStats_t * pxStats );
+
+/**
+ * @brief Get the send counters of a connection.
+ *
+ * @param pxNetworkContext Pointer to the Network context.
+ * @param pxStats Where the counters are copied.
+ */
+void TLS_Socket_GetSendStats( NetworkContext_t * pxNetworkContext,
+                              TlsTransportSendStats_t * pxStats );
+
+/**
+ * @brief Get the connect timings and negotiated parameters of a connection.
+ *
+ * @param pxNetworkContext Pointer to the Network context.
+ * @param pxStats Where the timings are copied. Zeroed if there is no connection.
+ */
+void TLS_Socket_GetConnectStats( NetworkContext_t * pxNetworkContext,
+                                 TlsTransportConnectStats_t * pxStats );
+
+/**
+ * @brief Take a reference on the process-wide mbed TLS runtime.
+ *
+ * The runtime is the mbed TLS mutex functions and the shared random number
+ * generator. Each connection holds a reference from connect to disconnect,
+ * so this is only needed by applications that want the runtime to stay up
+ * across reconnects, or that use mbed TLS directly alongside the transport.
+ *
+ * @return #eTLSTransportSuccess, or #eTLSTransportInternalError if the random
+ * number generator could not be seeded.
+ */
+TlsTransportStatus_t TLS_Socket_RuntimeInit( void );
+
+/**
+ * @brief Drop a reference taken with TLS_Socket_RuntimeInit.
+ *
+ * The mbed TLS mutex functions are removed when the last user, including the
+ * random number generator, has gone.
+ */
+void TLS_Socket_RuntimeDeinit( void );
+
+/**
+ * @brief Number of references currently held on the mbed TLS runtime.
+ */
+uint32_t TLS_Socket_RuntimeRefs( void );
+
+/**
+ * @brief Bound the elliptic curve work done by each handshake step.
+ *
+ * When mbed TLS is built with MBEDTLS_ECP_RESTARTABLE, ECDHE and ECDSA in the
+ * handshake are split into steps of at most this many basic operations (about
+ * a point addition or doubling each). TLS_Socket_Connect yields to other tasks
+ * of its priority between steps, and TLS_Socket_ConnectPoll returns
+ * #eTLSTransportInProgress. Without MBEDTLS_ECP_RESTARTABLE this has no
+ * effect.
+ *
+ * The value is global to mbed TLS: it applies at once to every handshake in
+ * progress and to any other restartable ECC operation in the process. ECC
+ * operations started without a restart context, such as the JWS and CA
+ * recovery signature checks, are not split. The first TLS_Socket_RuntimeInit,
+ * or the first connect, applies transporttlsECP_MAX_OPS unless this was called
+ * before.
+ *
+ * @param ulMaxOps Operations per step, 0 not to split. Values below 120 are
+ * treated as 120 by mbed TLS.
+ */
+void TLS_Socket_SetEcpMaxOps( uint32_t ulMaxOps );
+
+#endif /* TRANSPORT_TLS_SOCKET_H */
@@ -40,20 +40,127 @@ extern void vLoggingPrintf( const char * pcFormatString,
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
+#include "task.h"
 
 /* TLS transport header. */
 #include "transport_tls_socket.h"
 
+/* TLS session resumption cache. */
+#include "transport_tls_session_cache.h"
+
+/* Parsed TLS credential store. */
+#include "transport_tls_credential_store.h"
+
+/* Cache of verified server certificate chains. */
+#include "transport_tls_verify_cache.h"
+
 /* FreeRTOS Socket wrapper include. */
 #include "sockets_wrapper.h"
 
+/* Process-wide random number generator. */
+#include "azure_sample_crypto.h"
+#include "mbedtls_freertos_port.h"
+
 /* mbedTLS util includes. */
-#include "mbedtls/ctr_drbg.h"
-#include "mbedtls/entropy.h"
 #include "mbedtls/ssl.h"
 #include "mbedtls/threading.h"
 #include "mbedtls/x509.h"
 #include "mbedtls/error.h"
+#include "mbedtls/platform_util.h"
+#include "mbedtls/version.h"
+
+#ifdef TRANSPORT_TLS_VERIFY_CACHE
+    #include "mbedtls/oid.h"
+    #include "mbedtls/ssl_ciphersuites.h"
+
+    #ifndef MBEDTLS_SSL_KEEP_PEER_CERTIFICATE
+        #error "TRANSPORT_TLS_VERIFY_CACHE requires MBEDTLS_SSL_KEEP_PEER_CERTIFICATE."
+    #endif
+#endif
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Size of the per-connection buffer TLS_Socket_Recv reads decrypted
+ * data ahead into, allocated on first use. Reads of at least this size go
+ * straight to mbed TLS. 0 disables read-ahead.
+ */
+#ifndef transporttlsREAD_AHEAD_SIZE
+    #define transporttlsREAD_AHEAD_SIZE    ( 256U )
+#endif
+
+/**
+ * @brief 1 if TLS_Socket_RecvBorrow lends the record buffer of mbed TLS in
+ * place. TLS_Socket_RecvRelease then consumes the record the way the end of
+ * mbedtls_ssl_read does in mbed TLS 2.x. The fields involved are private from
+ * mbed TLS 3.0, where the data is lent from the read-ahead buffer instead,
+ * after mbedtls_ssl_read copied it there.
+ */
+#if ( MBEDTLS_VERSION_NUMBER < 0x03000000 )
+    #define transporttlsBORROW_IN_PLACE    1
+#else
+    #define transporttlsBORROW_IN_PLACE    0
+#endif
+
+/**
+ * @brief Maximum fragment length negotiated when
+ * NetworkCredentials_t.usMaxFragmentLength is 0. 4096 bytes is the largest
+ * length the extension permits, see RFC 6066.
+ */
+#ifndef transporttlsMAX_FRAGMENT_LENGTH
+    #define transporttlsMAX_FRAGMENT_LENGTH    ( 4096U )
+#endif
+
+/**
+ * @brief Size of the buffer the handshake records of a flight are gathered in,
+ * so each flight leaves in one socket write instead of one per record. Only
+ * allocated during the handshake. Larger records are sent as is. 0 writes each
+ * record as mbed TLS produces it.
+ */
+#ifndef transporttlsHANDSHAKE_FLIGHT_SIZE
+    #define transporttlsHANDSHAKE_FLIGHT_SIZE    ( 2048U )
+#endif
+
+/**
+ * @brief Elliptic curve operations per handshake step, when mbed TLS is built
+ * with MBEDTLS_ECP_RESTARTABLE. 0 runs each ECC operation to completion.
+ * Changed at run time with TLS_Socket_SetEcpMaxOps.
+ */
+#ifndef transporttlsECP_MAX_OPS
+    #define transporttlsECP_MAX_OPS    ( 500U )
+#endif
+
+/**
+ * @brief Cipher profile used when NetworkCredentials_t.xCipherProfile is
+ * eTlsCipherProfileDefault.
+ */
+#ifndef transporttlsCIPHER_PROFILE
+    #define transporttlsCIPHER_PROFILE    eTlsCipherProfileCompat
+#endif
+
+/**
+ * @brief Number of connections served from contexts allocated at build time.
+ * Their SSL context, transport buffers and mbed TLS allocations, record
+ * buffers included, come from static storage, so reconnecting takes nothing
+ * from the heap. A connect fails with eTLSTransportInsufficientMemory when
+ * all are in use. 0 allocates each connection from the heap.
+ */
+#ifndef transporttlsSTATIC_CONTEXTS
+    #define transporttlsSTATIC_CONTEXTS    ( 0 )
+#endif
+
+/**
+ * @brief Storage for the mbed TLS allocations of a static context: the two
+ * record buffers, plus the handshake state and the server certificates while
+ * they are parsed. Allocations that do not fit go to the heap.
+ */
+#ifndef transporttlsSTATIC_ARENA_SIZE
+    #define transporttlsSTATIC_ARENA_SIZE    ( MBEDTLS_SSL_IN_CONTENT_LEN + MBEDTLS_SSL_OUT_CONTENT_LEN + 20480U )
+#endif
+
+#if ( transporttlsSTATIC_CONTEXTS > 0 ) && ( mbedtlsportPOOL_ALLOCATOR != 1 )
+    #error "transporttlsSTATIC_CONTEXTS needs mbedtlsportPOOL_ALLOCATOR set to 1."
+#endif
 
 /*-----------------------------------------------------------*/
 
@@ -66,21 +173,91 @@ struct NetworkContext
     void * pParams;
 };
 
+/**
+ * @brief Progress of a connect started with TLS_Socket_ConnectStart.
+ */
+typedef enum TlsConnectState
+{
+    eTlsConnectDone = 0,   /**< @brief Connected, or connecting with TLS_Socket_Connect. */
+    eTlsConnectTcp,        /**< @brief Waiting for name resolution and the TCP connect. */
+    eTlsConnectHandshake   /**< @brief Performing the TLS handshake. */
+} TlsConnectState_t;
+
 /**
  * @brief Secured connection context.
  */
 typedef struct MbedSSLContext
 {
-    mbedtls_ssl_config config;               /**< @brief SSL connection configuration. */
-    mbedtls_ssl_context context;             /**< @brief SSL connection context */
-    mbedtls_x509_crt_profile certProfile;    /**< @brief Certificate security profile for this connection. */
-    mbedtls_x509_crt rootCa;                 /**< @brief Root CA certificate context. */
-    mbedtls_x509_crt clientCert;             /**< @brief Client certificate context. */
-    mbedtls_pk_context privKey;              /**< @brief Client private key context. */
-    mbedtls_entropy_context entropyContext;  /**< @brief Entropy context for random number generation. */
-    mbedtls_ctr_drbg_context ctrDrgbContext; /**< @brief CTR DRBG context for random number generation. */
+    mbedtls_ssl_config config;                           /**< @brief SSL connection configuration. */
+    mbedtls_ssl_context context;                         /**< @brief SSL connection context */
+    mbedtls_x509_crt_profile certProfile;                /**< @brief Certificate security profile for this connection. */
+    TlsCredentialHandle_t xCredentials;                  /**< @brief Parsed root CA, client certificate and private key. */
+    BaseType_t xPeerVerified;                            /**< @brief Set when the server certificate was verified, i.e. on a full handshake. */
+    #ifdef TRANSPORT_TLS_VERIFY_CACHE
+        BaseType_t xVerifyPeer;                          /**< @brief Set if the transport verifies the server chain itself, using the verification cache. */
+        BaseType_t xCheckHostName;                       /**< @brief Set if the server certificate must match pcHostName, i.e. SNI is enabled. */
+    #endif
+    SocketHandle xSocket;                                /**< @brief TCP socket of the connection. */
+    char pcHostName[ SOCKETS_MAX_HOST_NAME_LENGTH + 1 ]; /**< @brief Remote host name, the session cache key. */
+    uint16_t usPort;                                     /**< @brief Remote port, the session cache key. */
+    TlsConnectState_t xConnectState;                     /**< @brief Progress of a non-blocking connect. */
+    TickType_t xRecvTimeout;                             /**< @brief Receive timeout once connected. */
+    TickType_t xSendTimeout;                             /**< @brief Send timeout once connected. */
+    TickType_t xConnectStart;                            /**< @brief Time the connect was requested. */
+    TickType_t xTcpConnected;                            /**< @brief Time the TCP connection was established. */
+    TickType_t xHandshakeStart;                          /**< @brief Time the handshake started. */
+    TickType_t xLastHandshakeIo;                         /**< @brief Time a non-blocking handshake last sent or received data. */
+    BaseType_t xSessionOffered;                          /**< @brief Set if a cached session was offered to the server. */
+    BaseType_t xHandshaking;                             /**< @brief Set from the start of the handshake until its last flight is sent. */
+    uint8_t * pucFlight;                                 /**< @brief Handshake records not sent yet, allocated during the handshake. */
+    size_t xFlightLength;                                /**< @brief Bytes held in pucFlight. */
+    BaseType_t xAwaitingReply;                           /**< @brief Set once a flight is sent, until the server answers. */
+    uint32_t ulHandshakeRoundTrips;                      /**< @brief Flights the server answered during the handshake. */
+    uint32_t ulHandshakeYields;                          /**< @brief Handshake steps that stopped between ECC operations. */
+    TlsTransportSendStats_t xSendStats;                  /**< @brief Send counters. */
+    uint8_t * pucReadAhead;                              /**< @brief Decrypted data read ahead, allocated on first use. */
+    size_t xReadAheadStart;                              /**< @brief Offset of the first unread byte in pucReadAhead. */
+    size_t xReadAheadEnd;                                /**< @brief Offset past the last unread byte in pucReadAhead. */
+    size_t xBorrowed;                                    /**< @brief Bytes lent by TLS_Socket_RecvBorrow, 0 if none. */
+    BaseType_t xBorrowedReadAhead;                       /**< @brief Set if the lent bytes are in pucReadAhead rather than the record buffer. */
+    TlsTransportRecvStats_t xRecvStats;                  /**< @brief Receive counters. */
+    BaseType_t xRuntimeHeld;                             /**< @brief Set while the connection holds a reference on the mbed TLS runtime. */
+    TlsTransportConnectStats_t xConnectStats;            /**< @brief Connect timings, filled in once the handshake completes. */
+    #if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+        MbedtlsArena_t xArena;                           /**< @brief Arena serving the mbed TLS allocations of the connection. */
+    #endif
+    #if ( transporttlsSTATIC_CONTEXTS > 0 )
+        BaseType_t xStatic;                              /**< @brief Set for a context of xStaticContexts. */
+    #endif
 } MbedSSLContext_t;
 
+/**
+ * @brief Per-connection buffers of the transport.
+ */
+typedef enum TlsBuffer
+{
+    eTlsBufferReadAhead = 0, /**< @brief pucReadAhead. */
+    eTlsBufferFlight         /**< @brief pucFlight. */
+} TlsBuffer_t;
+
+#if ( transporttlsSTATIC_CONTEXTS > 0 )
+
+/**
+ * @brief A connection context allocated at build time, with the storage of
+ * its buffers. The extra byte of each buffer keeps it valid when its size is
+ * configured to 0.
+ */
+    typedef struct TlsStaticContext
+    {
+        MbedSSLContext_t xContext;                                        /**< @brief The context, first so that the two share an address. */
+        BaseType_t xInUse;                                                /**< @brief Set while a connection uses the context. */
+        uint8_t ucReadAhead[ transporttlsREAD_AHEAD_SIZE + 1U ];          /**< @brief Storage of pucReadAhead. */
+        uint8_t ucFlight[ transporttlsHANDSHAKE_FLIGHT_SIZE + 1U ];       /**< @brief Storage of pucFlight. */
+        uint64_t ullArena[ ( transporttlsSTATIC_ARENA_SIZE + 7U ) / 8U ]; /**< @brief Storage of xArena. */
+    } TlsStaticContext_t;
+
+#endif /* transporttlsSTATIC_CONTEXTS > 0 */
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -95,6 +272,84 @@ static const char * pcNoHighLevelMbedTlsCodeStr = "<No-High-Level-Code>";
  */
 static const char * pcNoLowLevelMbedTlsCodeStr = "<No-Low-Level-Code>";
 
+/**
+ * @brief References held on the mbed TLS runtime, by connections and by
+ * TLS_Socket_RuntimeInit callers.
+ */
+static uint32_t ulRuntimeRefs = 0;
+
+/**
+ * @brief ECC operations per handshake step, see TLS_Socket_SetEcpMaxOps.
+ */
+static uint32_t ulEcpMaxOps = transporttlsECP_MAX_OPS;
+
+/**
+ * @brief Set once ulEcpMaxOps was handed to mbed TLS, which keeps a single
+ * value for the whole process.
+ */
+static BaseType_t xEcpMaxOpsApplied = pdFALSE;
+
+#if ( transporttlsSTATIC_CONTEXTS > 0 )
+
+/**
+ * @brief Connection contexts allocated at build time.
+ */
+    static TlsStaticContext_t xStaticContexts[ transporttlsSTATIC_CONTEXTS ];
+#endif
+
+/**
+ * @brief Cipher suites of eTlsCipherProfileLowPower: AES-128 in an AEAD mode,
+ * so records need no separate MAC, and ECDSA, the cheaper signature to verify.
+ */
+static const int pxLowPowerCipherSuites[] =
+{
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CCM,
+    0
+};
+
+/**
+ * @brief Cipher suites of eTlsCipherProfileBalanced: AES-128 with SHA-256,
+ * for ECDSA and RSA server certificates.
+ */
+static const int pxBalancedCipherSuites[] =
+{
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CCM,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256,
+    0
+};
+
+#ifdef MBEDTLS_ECP_C
+
+    /**
+     * @brief Curves of eTlsCipherProfileLowPower.
+     */
+    static const mbedtls_ecp_group_id pxLowPowerCurves[] =
+    {
+        #ifdef MBEDTLS_ECP_DP_SECP256R1_ENABLED
+            MBEDTLS_ECP_DP_SECP256R1,
+        #endif
+        MBEDTLS_ECP_DP_NONE
+    };
+
+    /**
+     * @brief Curves of eTlsCipherProfileBalanced.
+     */
+    static const mbedtls_ecp_group_id pxBalancedCurves[] =
+    {
+        #ifdef MBEDTLS_ECP_DP_SECP256R1_ENABLED
+            MBEDTLS_ECP_DP_SECP256R1,
+        #endif
+        #ifdef MBEDTLS_ECP_DP_SECP384R1_ENABLED
+            MBEDTLS_ECP_DP_SECP384R1,
+        #endif
+        MBEDTLS_ECP_DP_NONE
+    };
+#endif /* MBEDTLS_ECP_C */
+
 /**
  * @brief Utility for converting the high-level code in an mbedTLS error to string,
  * if the code-contains a high-level code; otherwise, using a default string.
@@ -128,54 +383,56 @@ static void sslContextInit( MbedSSLContext_t * pxSslContext );
 static void sslContextFree( MbedSSLContext_t * pxSslContext );
 
 /**
- * @brief Add X509 certificate to the trusted list of root certificates.
- *
- * OpenSSL does not provide a single function for reading and loading certificates
- * from files into stores, so the file API must be called. Start with the
- * root certificate.
+ * @brief Certificate verification callback, used to tell a full handshake from
+ * a resumed one. mbedTLS only verifies the server certificate on a full handshake.
  *
- * @param[out] pxSslContext SSL context to which the trusted server root CA is to be added.
- * @param[in] pucRootCa PEM-encoded string of the trusted server root CA.
- * @param[in] xRootCaSize Size of the trusted server root CA.
+ * @param[in] pvContext The #MbedSSLContext_t of the connection.
+ * @param[in] pxCertificate Certificate being verified.
+ * @param[in] lDepth Depth of the certificate in the chain.
+ * @param[in] pulFlags Verification flags, left untouched.
  *
- * @return 0 on success; otherwise, failure;
+ * @return Always 0.
  */
-static int32_t setRootCa( MbedSSLContext_t * pxSslContext,
-                          const uint8_t * pucRootCa,
-                          size_t xRootCaSize );
+static int certificateVerifyCallback( void * pvContext,
+                                      mbedtls_x509_crt * pxCertificate,
+                                      int lDepth,
+                                      uint32_t * pulFlags );
+
+#ifdef TRANSPORT_TLS_VERIFY_CACHE
 
 /**
- * @brief Set X509 certificate as client certificate for the server to authenticate.
+ * @brief Verify the certificate chain sent by the server, unless the same chain
+ * was verified for the host before.
  *
- * @param[out] pxSslContext SSL context to which the client certificate is to be set.
- * @param[in] pucClientCert PEM-encoded string of the client certificate.
- * @param[in] xClientCertSize Size of the client certificate.
+ * Used in place of the verification of mbed TLS when the verification cache is
+ * on. A chain found in the cache is only checked for expiry; the key usage of
+ * the server certificate is checked either way.
  *
- * @return 0 on success; otherwise, failure;
+ * @param[in] pxSslContext SSL context whose handshake just parsed the server
+ * Certificate message.
+ *
+ * @return 0 on success; otherwise, MBEDTLS_ERR_X509_CERT_VERIFY_FAILED.
  */
-static int32_t setClientCertificate( MbedSSLContext_t * pxSslContext,
-                                     const uint8_t * pucClientCert,
-                                     size_t xClientCertSize );
+    static int32_t verifyPeerChain( MbedSSLContext_t * pxSslContext );
 
 /**
- * @brief Set private key for the client's certificate.
+ * @brief Run the handshake as mbedtls_ssl_handshake does, verifying the server
+ * chain with verifyPeerChain once it is received.
  *
- * @param[out] pxSslContext SSL context to which the private key is to be set.
- * @param[in] pucPrivateKey PEM-encoded string of the client private key.
- * @param[in] xPrivateKeySize Size of the client private key.
+ * @param[in] pxSslContext SSL context.
  *
- * @return 0 on success; otherwise, failure;
+ * @return As mbedtls_ssl_handshake.
  */
-static int32_t setPrivateKey( MbedSSLContext_t * pxSslContext,
-                              const uint8_t * pucPrivateKey,
-                              size_t xPrivateKeySize );
+    static int32_t sslHandshake( MbedSSLContext_t * pxSslContext );
+#endif /* TRANSPORT_TLS_VERIFY_CACHE */
 
 /**
- * @brief Passes TLS credentials to the OpenSSL library.
+ * @brief Passes TLS credentials to the mbed TLS library.
  *
- * Provides the root CA certificate, client certificate, and private key to the
- * OpenSSL library. If the client certificate or private key is not NULL, mutual
- * authentication is used when performing the TLS handshake.
+ * Attaches the root CA certificate, client certificate, and private key from the
+ * credential store, parsing them on first use. If the client certificate or
+ * private key is not NULL, mutual authentication is used when performing the
+ * TLS handshake.
  *
  * @param[out] pxSslContext SSL context to which the credentials are to be imported.
  * @param[in] pxNetworkCredentials TLS credentials to be imported.
@@ -198,6 +455,27 @@ static void setOptionalConfigurations( MbedSSLContext_t * pxSslContext,
                                        const char * pcHostName,
                                        const NetworkCredentials_t * pxNetworkCredentials );
 
+/**
+ * @brief Restrict the cipher suites and curves offered to those of a profile.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ * @param[in] xProfile Profile to apply, eTlsCipherProfileDefault for
+ * transporttlsCIPHER_PROFILE.
+ */
+static void setCipherProfile( MbedSSLContext_t * pxSslContext,
+                              TlsCipherProfile_t xProfile );
+
+/**
+ * @brief Map a maximum fragment length in bytes to the mbed TLS code.
+ *
+ * @param[in] usLength Length in bytes, or 0 for transporttlsMAX_FRAGMENT_LENGTH.
+ * @param[out] pucCode The MBEDTLS_SSL_MAX_FRAG_LEN_* code.
+ *
+ * @return pdTRUE if the length can be negotiated, pdFALSE otherwise.
+ */
+static BaseType_t maxFragmentLengthCode( uint16_t usLength,
+                                         unsigned char * pucCode );
+
 /**
  * @brief Setup TLS by initializing contexts and setting configurations.
  *
@@ -212,27 +490,279 @@ static TlsTransportStatus_t tlsSetup( NetworkContext_t * pxNetworkContext,
                                       const char * pcHostName,
                                       const NetworkCredentials_t * pxNetworkCredentials );
 
+/**
+ * @brief Send callback used during a non-blocking handshake.
+ *
+ * @param[in] pvContext The #MbedSSLContext_t of the connection.
+ * @param[in] pucBuffer Data to send.
+ * @param[in] xLength Length of the data.
+ *
+ * @return Number of bytes sent, MBEDTLS_ERR_SSL_WANT_WRITE, or a negative error.
+ */
+static int asyncSend( void * pvContext,
+                      const unsigned char * pucBuffer,
+                      size_t xLength );
+
+/**
+ * @brief Receive callback used during a non-blocking handshake.
+ *
+ * @param[in] pvContext The #MbedSSLContext_t of the connection.
+ * @param[out] pucBuffer Buffer to receive into.
+ * @param[in] xLength Size of the buffer.
+ *
+ * @return Number of bytes received, MBEDTLS_ERR_SSL_WANT_READ, or a negative error.
+ */
+static int asyncRecv( void * pvContext,
+                      unsigned char * pucBuffer,
+                      size_t xLength );
+
+/**
+ * @brief Send callback used once connected and by the blocking handshake.
+ *
+ * @param[in] pvContext The #MbedSSLContext_t of the connection.
+ * @param[in] pucBuffer Data to send.
+ * @param[in] xLength Length of the data.
+ *
+ * @return Number of bytes sent, or a negative error.
+ */
+static int socketSend( void * pvContext,
+                       const unsigned char * pucBuffer,
+                       size_t xLength );
+
+/**
+ * @brief Receive callback used once connected and by the blocking handshake.
+ *
+ * @param[in] pvContext The #MbedSSLContext_t of the connection.
+ * @param[out] pucBuffer Buffer to receive into.
+ * @param[in] xLength Size of the buffer.
+ *
+ * @return Number of bytes received, or a negative error.
+ */
+static int socketRecv( void * pvContext,
+                       unsigned char * pucBuffer,
+                       size_t xLength );
+
+/**
+ * @brief Write to the socket and count the bytes written.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ * @param[in] pucBuffer Data to send.
+ * @param[in] xLength Length of the data.
+ *
+ * @return The Sockets_Send result.
+ */
+static BaseType_t socketWrite( MbedSSLContext_t * pxSslContext,
+                               const uint8_t * pucBuffer,
+                               size_t xLength );
+
+/**
+ * @brief Send the handshake records gathered so far.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ *
+ * @return SOCKETS_ERROR_NONE once all of them are sent, SOCKETS_EWOULDBLOCK if
+ * the socket did not take all of them, or a negative error.
+ */
+static BaseType_t flightFlush( MbedSSLContext_t * pxSslContext );
+
+/**
+ * @brief Send the last flight of a completed handshake and stop gathering
+ * records. Called once the socket is blocking again.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ *
+ * @return #eTLSTransportSuccess, or #eTLSTransportHandshakeFailed.
+ */
+static TlsTransportStatus_t flightFinish( MbedSSLContext_t * pxSslContext );
+
+/**
+ * @brief Write one TLS record of application data and count it.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ * @param[in] pucData Data to send.
+ * @param[in] xLength Length of the data. Data beyond the largest record
+ * payload is left for the next call.
+ *
+ * @return Number of bytes written, or an mbed TLS error.
+ */
+static int32_t sslWriteRecord( MbedSSLContext_t * pxSslContext,
+                               const uint8_t * pucData,
+                               size_t xLength );
+
+/**
+ * @brief Read application data, through the read-ahead buffer for small reads.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ * @param[out] pucBuffer Buffer to receive into.
+ * @param[in] xLength Size of the buffer.
+ *
+ * @return Number of bytes read, or an mbed TLS error.
+ */
+static int32_t sslReadBuffered( MbedSSLContext_t * pxSslContext,
+                                uint8_t * pucBuffer,
+                                size_t xLength );
+
+/**
+ * @brief Prepare the TLS handshake on a connected TCP socket.
+ *
+ * A session cached for the same host and port is offered to the server.
+ *
+ * @param[in] pxNetworkContext Network context.
+ * @param[in] xNonBlocking pdTRUE to return from the handshake instead of
+ * waiting for the socket.
+ *
+ * @return #eTLSTransportSuccess, or #eTLSTransportInternalError.
+ */
+static TlsTransportStatus_t tlsHandshakeStart( NetworkContext_t * pxNetworkContext,
+                                               BaseType_t xNonBlocking );
+
+/**
+ * @brief Advance the TLS handshake as far as the socket allows.
+ *
+ * Once the handshake is over, its outcome is recorded in the session cache and
+ * the negotiated session is cached after a successful full handshake.
+ *
+ * @param[in] pxNetworkContext Network context.
+ *
+ * @return #eTLSTransportSuccess, #eTLSTransportInProgress, #eTLSTransportHandshakeFailed,
+ * or #eTLSTransportCAVerifyFailed.
+ */
+static TlsTransportStatus_t tlsHandshakeStep( NetworkContext_t * pxNetworkContext );
+
+/**
+ * @brief Connect the socket of a connection, blocking, and note when it connected.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ * @param[in] pcHostName Remote host name.
+ * @param[in] usPort Remote port.
+ *
+ * @return The Sockets_Connect status.
+ */
+static BaseType_t socketConnect( MbedSSLContext_t * pxSslContext,
+                                 const char * pcHostName,
+                                 uint16_t usPort );
+
+/**
+ * @brief Fill in the connect timings once the handshake has completed.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ * @param[in] xSessionResumed Set if a cached session was resumed.
+ * @param[in] xNow Time the handshake completed.
+ */
+static void recordConnectStats( MbedSSLContext_t * pxSslContext,
+                                BaseType_t xSessionResumed,
+                                TickType_t xNow );
+
 /**
  * @brief Perform the TLS handshake on a TCP connection.
  *
  * @param[in] pxNetworkContext Network context.
- * @param[in] pxNetworkCredentials TLS setup parameters.
  *
  * @return #eTLSTransportSuccess, #eTLSTransportHandshakeFailed, or #eTLSTransportInternalError.
  */
-static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pxNetworkContext,
-                                          const NetworkCredentials_t * pxNetworkCredentials );
+static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pxNetworkContext );
+
+/**
+ * @brief Validate the connect parameters, and allocate the SSL context and socket.
+ *
+ * @param[in] pxNetworkContext Network context.
+ * @param[in] pcHostName Remote host name.
+ * @param[in] usPort Remote port.
+ * @param[in] pxNetworkCredentials TLS setup parameters.
+ * @param[in] ulReceiveTimeoutMs Receive timeout.
+ * @param[in] ulSendTimeoutMs Send timeout.
+ *
+ * @return #eTLSTransportSuccess, #eTLSTransportInvalidParameter, #eTLSTransportInsufficientMemory,
+ * or #eTLSTransportConnectFailure.
+ */
+static TlsTransportStatus_t connectInit( NetworkContext_t * pxNetworkContext,
+                                         const char * pcHostName,
+                                         uint16_t usPort,
+                                         const NetworkCredentials_t * pxNetworkCredentials,
+                                         uint32_t ulReceiveTimeoutMs,
+                                         uint32_t ulSendTimeoutMs );
+
+/**
+ * @brief Apply the receive and send timeouts to the socket.
+ *
+ * @param[in] pxSslContext SSL context holding the socket and timeouts.
+ *
+ * @return #eTLSTransportSuccess, or #eTLSTransportInternalError.
+ */
+static TlsTransportStatus_t setSocketTimeouts( MbedSSLContext_t * pxSslContext );
+
+/**
+ * @brief Free the SSL context and close the socket of a failed connect.
+ *
+ * @param[in] pxNetworkContext Network context.
+ */
+static void connectAbort( NetworkContext_t * pxNetworkContext );
 
 /**
  * @brief Initialize mbedTLS.
  *
- * @param[out] entropyContext mbed TLS entropy context for generation of random numbers.
- * @param[out] ctrDrgbContext mbed TLS CTR DRBG context for generation of random numbers.
+ * Takes the connection's reference on the mbed TLS runtime. Random numbers
+ * come from the process-wide CTR-DRBG, which is only seeded on its first use.
+ *
+ * @param[in] pxSslContext SSL context holding the reference.
  *
  * @return #eTLSTransportSuccess, or #eTLSTransportInternalError.
  */
-static TlsTransportStatus_t initMbedtls( mbedtls_entropy_context * pxEntropyContext,
-                                         mbedtls_ctr_drbg_context * pxCtrDrgbContext );
+static TlsTransportStatus_t initMbedtls( MbedSSLContext_t * pxSslContext );
+
+/**
+ * @brief Serve the mbed TLS allocations of the calling task from the arena of
+ * the connection, until arenaLeave.
+ *
+ * Only wraps calls whose allocations the connection frees itself; sessions
+ * stored in the session cache and parsed credentials stay on the heap.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ */
+static void arenaEnter( MbedSSLContext_t * pxSslContext );
+
+/**
+ * @brief End the scope started by arenaEnter.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ */
+static void arenaLeave( MbedSSLContext_t * pxSslContext );
+
+/**
+ * @brief Allocate a zeroed connection context, from xStaticContexts when
+ * transporttlsSTATIC_CONTEXTS is set, otherwise from the heap.
+ *
+ * @return The context, or NULL if none is left.
+ */
+static MbedSSLContext_t * contextAlloc( void );
+
+/**
+ * @brief Free a context allocated by contextAlloc.
+ *
+ * @param[in] pxSslContext The context.
+ */
+static void contextFree( MbedSSLContext_t * pxSslContext );
+
+/**
+ * @brief Allocate a per-connection buffer, from the storage of a static
+ * context or from the heap.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ * @param[in] xBuffer The buffer.
+ *
+ * @return The buffer, or NULL if out of memory.
+ */
+static uint8_t * bufferAlloc( MbedSSLContext_t * pxSslContext,
+                              TlsBuffer_t xBuffer );
+
+/**
+ * @brief Free a buffer allocated by bufferAlloc.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ * @param[in] pucBuffer The buffer.
+ */
+static void bufferFree( MbedSSLContext_t * pxSslContext,
+                        uint8_t * pucBuffer );
 
 /*-----------------------------------------------------------*/
 
@@ -241,10 +771,32 @@ static void sslContextInit( MbedSSLContext_t * pxSslContext )
     configASSERT( pxSslContext != NULL );
 
     mbedtls_ssl_config_init( &( pxSslContext->config ) );
-    mbedtls_x509_crt_init( &( pxSslContext->rootCa ) );
-    mbedtls_pk_init( &( pxSslContext->privKey ) );
-    mbedtls_x509_crt_init( &( pxSslContext->clientCert ) );
     mbedtls_ssl_init( &( pxSslContext->context ) );
+    pxSslContext->xCredentials = NULL;
+    pxSslContext->xPeerVerified = pdFALSE;
+
+    #ifdef TRANSPORT_TLS_VERIFY_CACHE
+        pxSslContext->xVerifyPeer = pdFALSE;
+        pxSslContext->xCheckHostName = pdFALSE;
+    #endif
+    pxSslContext->pucReadAhead = NULL;
+    pxSslContext->pucFlight = NULL;
+    pxSslContext->xReadAheadStart = 0;
+    pxSslContext->xReadAheadEnd = 0;
+    pxSslContext->xRuntimeHeld = pdFALSE;
+
+    #if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+        ( void ) memset( &( pxSslContext->xArena ), 0x00, sizeof( pxSslContext->xArena ) );
+    #endif
+
+    #if ( transporttlsSTATIC_CONTEXTS > 0 )
+        if( pxSslContext->xStatic == pdTRUE )
+        {
+            mbedtls_platform_arena_init_static( &( pxSslContext->xArena ),
+                                                ( ( TlsStaticContext_t * ) pxSslContext )->ullArena,
+                                                sizeof( ( ( TlsStaticContext_t * ) pxSslContext )->ullArena ) );
+        }
+    #endif
 }
 /*-----------------------------------------------------------*/
 
@@ -253,98 +805,197 @@ static void sslContextFree( MbedSSLContext_t * pxSslContext )
     configASSERT( pxSslContext != NULL );
 
     mbedtls_ssl_free( &( pxSslContext->context ) );
-    mbedtls_x509_crt_free( &( pxSslContext->rootCa ) );
-    mbedtls_x509_crt_free( &( pxSslContext->clientCert ) );
-    mbedtls_pk_free( &( pxSslContext->privKey ) );
-    mbedtls_entropy_free( &( pxSslContext->entropyContext ) );
-    mbedtls_ctr_drbg_free( &( pxSslContext->ctrDrgbContext ) );
+    TLS_CredentialStore_Release( pxSslContext->xCredentials );
+    pxSslContext->xCredentials = NULL;
     mbedtls_ssl_config_free( &( pxSslContext->config ) );
-}
-/*-----------------------------------------------------------*/
-
-static int32_t setRootCa( MbedSSLContext_t * pxSslContext,
-                          const uint8_t * pucRootCa,
-                          size_t xRootCaSize )
-{
-    int32_t lMbedtlsError = -1;
-
-    configASSERT( pxSslContext != NULL );
-    configASSERT( pucRootCa != NULL );
 
-    /* Parse the server root CA certificate into the SSL context. */
-    lMbedtlsError = mbedtls_x509_crt_parse( &( pxSslContext->rootCa ),
-                                            pucRootCa,
-                                            xRootCaSize );
+    #if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+        /* Every block of the arena has been freed with the contexts. */
+        mbedtls_platform_arena_release( &( pxSslContext->xArena ) );
+    #endif
 
-    if( lMbedtlsError != 0 )
+    if( pxSslContext->pucReadAhead != NULL )
     {
-        LogError( ( "Failed to parse server root CA certificate: lMbedtlsError[%d]= %s : %s.",
-                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+        bufferFree( pxSslContext, pxSslContext->pucReadAhead );
+        pxSslContext->pucReadAhead = NULL;
     }
-    else
+
+    if( pxSslContext->pucFlight != NULL )
     {
-        mbedtls_ssl_conf_ca_chain( &( pxSslContext->config ),
-                                   &( pxSslContext->rootCa ),
-                                   NULL );
+        bufferFree( pxSslContext, pxSslContext->pucFlight );
+        pxSslContext->pucFlight = NULL;
     }
 
-    return lMbedtlsError;
+    if( pxSslContext->xRuntimeHeld == pdTRUE )
+    {
+        TLS_Socket_RuntimeDeinit();
+        pxSslContext->xRuntimeHeld = pdFALSE;
+    }
 }
 /*-----------------------------------------------------------*/
 
-static int32_t setClientCertificate( MbedSSLContext_t * pxSslContext,
-                                     const uint8_t * pucClientCert,
-                                     size_t xClientCertSize )
+static int certificateVerifyCallback( void * pvContext,
+                                      mbedtls_x509_crt * pxCertificate,
+                                      int lDepth,
+                                      uint32_t * pulFlags )
 {
-    int32_t lMbedtlsError = -1;
-
-    configASSERT( pxSslContext != NULL );
-    configASSERT( pucClientCert != NULL );
+    MbedSSLContext_t * pxSslContext = ( MbedSSLContext_t * ) pvContext;
 
-    /* Setup the client certificate. */
-    lMbedtlsError = mbedtls_x509_crt_parse( &( pxSslContext->clientCert ),
-                                            pucClientCert,
-                                            xClientCertSize );
+    ( void ) pxCertificate;
+    ( void ) lDepth;
+    ( void ) pulFlags;
 
-    if( lMbedtlsError != 0 )
-    {
-        LogError( ( "Failed to parse the client certificate: lMbedtlsError[%d]= %s : %s.",
-                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
-    }
+    pxSslContext->xPeerVerified = pdTRUE;
 
-    return lMbedtlsError;
+    return 0;
 }
 /*-----------------------------------------------------------*/
 
-static int32_t setPrivateKey( MbedSSLContext_t * pxSslContext,
-                              const uint8_t * pucPrivateKey,
-                              size_t xPrivateKeySize )
-{
-    int32_t lMbedtlsError = -1;
-
-    configASSERT( pxSslContext != NULL );
-    configASSERT( pucPrivateKey != NULL );
-
-    /* Setup the client private key. */
-    lMbedtlsError = mbedtls_pk_parse_key( &( pxSslContext->privKey ),
-                                          pucPrivateKey,
-                                          xPrivateKeySize,
-                                          NULL,
-                                          0 );
+#ifdef TRANSPORT_TLS_VERIFY_CACHE
 
-    if( lMbedtlsError != 0 )
+    static int32_t verifyPeerChain( MbedSSLContext_t * pxSslContext )
     {
-        LogError( ( "Failed to parse the client key: lMbedtlsError[%d]= %s : %s.",
-                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
-    }
+        mbedtls_x509_crt * pxChain = pxSslContext->context.session_negotiate->peer_cert;
+        mbedtls_x509_crt * pxRootCa = TLS_CredentialStore_GetRootCa( pxSslContext->xCredentials );
+        const mbedtls_ssl_ciphersuite_t * pxCipherSuite;
+        uint8_t ucFingerprint[ 32 ];
+        int32_t lFingerprintError = -1;
+        uint32_t ulFlags = 0;
+        uint32_t ulKeyUsage = 0;
+        TickType_t xStart;
+        int32_t lMbedtlsError = 0;
+
+        if( pxChain == NULL )
+        {
+            LogError( ( "Server sent no certificate." ) );
+            lMbedtlsError = MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+        }
+        else
+        {
+            /* The key usage mbed TLS requires of the server certificate for the
+             * negotiated key exchange. */
+            pxCipherSuite = mbedtls_ssl_ciphersuite_from_id( pxSslContext->context.session_negotiate->ciphersuite );
 
-    return lMbedtlsError;
-}
+            if( pxCipherSuite != NULL )
+            {
+                switch( pxCipherSuite->key_exchange )
+                {
+                    case MBEDTLS_KEY_EXCHANGE_RSA:
+                    case MBEDTLS_KEY_EXCHANGE_RSA_PSK:
+                        ulKeyUsage = MBEDTLS_X509_KU_KEY_ENCIPHERMENT;
+                        break;
+
+                    case MBEDTLS_KEY_EXCHANGE_DHE_RSA:
+                    case MBEDTLS_KEY_EXCHANGE_ECDHE_RSA:
+                    case MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA:
+                        ulKeyUsage = MBEDTLS_X509_KU_DIGITAL_SIGNATURE;
+                        break;
+
+                    case MBEDTLS_KEY_EXCHANGE_ECDH_RSA:
+                    case MBEDTLS_KEY_EXCHANGE_ECDH_ECDSA:
+                        ulKeyUsage = MBEDTLS_X509_KU_KEY_AGREEMENT;
+                        break;
+
+                    default:
+                        break;
+                }
+            }
+
+            if( ( ( ulKeyUsage != 0U ) &&
+                  ( mbedtls_x509_crt_check_key_usage( pxChain, ( unsigned int ) ulKeyUsage ) != 0 ) ) ||
+                ( mbedtls_x509_crt_check_extended_key_usage( pxChain, MBEDTLS_OID_SERVER_AUTH,
+                                                             MBEDTLS_OID_SIZE( MBEDTLS_OID_SERVER_AUTH ) ) != 0 ) )
+            {
+                LogError( ( "Server certificate is not valid for a TLS server." ) );
+                lMbedtlsError = MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+            }
+        }
+
+        if( lMbedtlsError == 0 )
+        {
+            if( TLS_VerifyCache_IsEnabled() == pdTRUE )
+            {
+                lFingerprintError = TLS_VerifyCache_Fingerprint( pxChain, pxRootCa, ucFingerprint );
+            }
+
+            if( ( lFingerprintError == 0 ) &&
+                ( TLS_VerifyCache_Check( pxSslContext->pcHostName, ucFingerprint, pxChain ) == pdTRUE ) )
+            {
+                LogDebug( ( "Certificate chain of %s verified before.", pxSslContext->pcHostName ) );
+            }
+            else
+            {
+                /* Not cached, or the fingerprint could not be computed. As
+                 * mbed TLS does, the name is only checked when SNI sent it. */
+                xStart = xTaskGetTickCount();
+                lMbedtlsError = mbedtls_x509_crt_verify_with_profile( pxChain, pxRootCa, NULL,
+                                                                      &( pxSslContext->certProfile ),
+                                                                      ( pxSslContext->xCheckHostName == pdTRUE ) ?
+                                                                      pxSslContext->pcHostName : NULL,
+                                                                      &ulFlags, NULL, NULL );
+
+                if( lMbedtlsError != 0 )
+                {
+                    LogError( ( "Failed to verify the certificate chain of %s: flags 0x%08x.",
+                                pxSslContext->pcHostName, ( unsigned int ) ulFlags ) );
+                    lMbedtlsError = MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+                }
+                else if( ( lFingerprintError == 0 ) && ( pxSslContext->xCheckHostName == pdTRUE ) )
+                {
+                    /* A chain verified without its name must not satisfy a
+                     * later connect that checks it. */
+                    TLS_VerifyCache_Store( pxSslContext->pcHostName, ucFingerprint,
+                                           xTaskGetTickCount() - xStart );
+                }
+                else
+                {
+                    /* Empty else marker. */
+                }
+            }
+        }
+
+        if( lMbedtlsError == 0 )
+        {
+            pxSslContext->xPeerVerified = pdTRUE;
+        }
+        else
+        {
+            ( void ) mbedtls_ssl_send_alert_message( &( pxSslContext->context ),
+                                                     MBEDTLS_SSL_ALERT_LEVEL_FATAL,
+                                                     MBEDTLS_SSL_ALERT_MSG_BAD_CERT );
+        }
+
+        return lMbedtlsError;
+    }
+/*-----------------------------------------------------------*/
+
+    static int32_t sslHandshake( MbedSSLContext_t * pxSslContext )
+    {
+        int32_t lMbedtlsError = 0;
+        int lState;
+
+        while( ( lMbedtlsError == 0 ) &&
+               ( pxSslContext->context.state != MBEDTLS_SSL_HANDSHAKE_OVER ) )
+        {
+            lState = pxSslContext->context.state;
+            lMbedtlsError = mbedtls_ssl_handshake_step( &( pxSslContext->context ) );
+
+            /* The step that completes the server Certificate message moves
+             * on to the key exchange. A resumed handshake never gets there. */
+            if( ( lMbedtlsError == 0 ) &&
+                ( pxSslContext->xVerifyPeer == pdTRUE ) &&
+                ( lState == MBEDTLS_SSL_SERVER_CERTIFICATE ) )
+            {
+                lMbedtlsError = verifyPeerChain( pxSslContext );
+            }
+        }
+
+        return lMbedtlsError;
+    }
 /*-----------------------------------------------------------*/
 
+#endif /* TRANSPORT_TLS_VERIFY_CACHE */
+
 static int32_t setCredentials( MbedSSLContext_t * pxSslContext,
                                const NetworkCredentials_t * pxNetworkCredentials )
 {
@@ -357,40 +1008,49 @@ static int32_t setCredentials( MbedSSLContext_t * pxSslContext,
     pxSslContext->certProfile = mbedtls_x509_crt_profile_default;
 
     /* Set SSL authmode and the RNG context. */
-    mbedtls_ssl_conf_authmode( &( pxSslContext->config ),
-                               MBEDTLS_SSL_VERIFY_REQUIRED );
+    #ifdef TRANSPORT_TLS_VERIFY_CACHE
+        /* With the cache, the chain is verified by verifyPeerChain during the
+         * handshake rather than by mbed TLS. */
+        pxSslContext->xVerifyPeer = TLS_VerifyCache_IsEnabled();
+        mbedtls_ssl_conf_authmode( &( pxSslContext->config ),
+                                   ( pxSslContext->xVerifyPeer == pdTRUE ) ?
+                                   MBEDTLS_SSL_VERIFY_NONE : MBEDTLS_SSL_VERIFY_REQUIRED );
+    #else
+        mbedtls_ssl_conf_authmode( &( pxSslContext->config ),
+                                   MBEDTLS_SSL_VERIFY_REQUIRED );
+    #endif
     mbedtls_ssl_conf_rng( &( pxSslContext->config ),
-                          mbedtls_ctr_drbg_random,
-                          &( pxSslContext->ctrDrgbContext ) );
+                          Crypto_Random,
+                          NULL );
     mbedtls_ssl_conf_cert_profile( &( pxSslContext->config ),
                                    &( pxSslContext->certProfile ) );
+    mbedtls_ssl_conf_verify( &( pxSslContext->config ),
+                             certificateVerifyCallback,
+                             pxSslContext );
 
-    lMbedtlsError = setRootCa( pxSslContext,
-                               pxNetworkCredentials->pucRootCa,
-                               pxNetworkCredentials->xRootCaSize );
+    /* Parse the credentials, or attach the ones parsed by a previous connect. */
+    pxSslContext->xCredentials = TLS_CredentialStore_Acquire( pxNetworkCredentials,
+                                                              &lMbedtlsError );
 
-    if( ( pxNetworkCredentials->pucClientCert != NULL ) &&
-        ( pxNetworkCredentials->pucPrivateKey != NULL ) )
+    if( lMbedtlsError != 0 )
     {
-        if( lMbedtlsError == 0 )
-        {
-            lMbedtlsError = setClientCertificate( pxSslContext,
-                                                  pxNetworkCredentials->pucClientCert,
-                                                  pxNetworkCredentials->xClientCertSize );
-        }
-
-        if( lMbedtlsError == 0 )
-        {
-            lMbedtlsError = setPrivateKey( pxSslContext,
-                                           pxNetworkCredentials->pucPrivateKey,
-                                           pxNetworkCredentials->xPrivateKeySize );
-        }
+        LogError( ( "Failed to load credentials: lMbedtlsError[%d]= %s : %s.",
+                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+    }
+    else
+    {
+        mbedtls_ssl_conf_ca_chain( &( pxSslContext->config ),
+                                   TLS_CredentialStore_GetRootCa( pxSslContext->xCredentials ),
+                                   NULL );
 
-        if( lMbedtlsError == 0 )
+        if( TLS_CredentialStore_GetClientCert( pxSslContext->xCredentials ) != NULL )
         {
+            arenaEnter( pxSslContext );
             lMbedtlsError = mbedtls_ssl_conf_own_cert( &( pxSslContext->config ),
-                                                       &( pxSslContext->clientCert ),
-                                                       &( pxSslContext->privKey ) );
+                                                       TLS_CredentialStore_GetClientCert( pxSslContext->xCredentials ),
+                                                       TLS_CredentialStore_GetPrivateKey( pxSslContext->xCredentials ) );
+            arenaLeave( pxSslContext );
         }
     }
 
@@ -435,28 +1095,112 @@ static void setOptionalConfigurations( MbedSSLContext_t * pxSslContext,
                         lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
                         mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
         }
+
+        #ifdef TRANSPORT_TLS_VERIFY_CACHE
+            /* mbed TLS checks the certificate against the name it sends. */
+            pxSslContext->xCheckHostName = ( lMbedtlsError == 0 ) ? pdTRUE : pdFALSE;
+        #endif
     }
 
     /* Set Maximum Fragment Length if enabled. */
     #ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+    {
+        unsigned char ucMaxFragLenCode = MBEDTLS_SSL_MAX_FRAG_LEN_NONE;
 
-        /* Enable the max fragment extension. 4096 bytes is currently the largest fragment size permitted.
-         * See RFC 8449 https://tools.ietf.org/html/rfc8449 for more information.
-         *
-         * Smaller values can be found in "mbedtls/include/ssl.h".
+        /* Enable the max fragment extension. The length was checked by connectInit.
+         * See RFC 6066 https://tools.ietf.org/html/rfc6066 for more information.
          */
-        lMbedtlsError = mbedtls_ssl_conf_max_frag_len( &( pxSslContext->config ), MBEDTLS_SSL_MAX_FRAG_LEN_4096 );
+        ( void ) maxFragmentLengthCode( pxNetworkCredentials->usMaxFragmentLength, &ucMaxFragLenCode );
 
-        if( lMbedtlsError != 0 )
+        if( ucMaxFragLenCode != MBEDTLS_SSL_MAX_FRAG_LEN_NONE )
         {
-            LogError( ( "Failed to maximum fragment length extension: lMbedtlsError[%d]= %s : %s.",
-                        lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+            lMbedtlsError = mbedtls_ssl_conf_max_frag_len( &( pxSslContext->config ), ucMaxFragLenCode );
+
+            if( lMbedtlsError != 0 )
+            {
+                LogError( ( "Failed to maximum fragment length extension: lMbedtlsError[%d]= %s : %s.",
+                            lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                            mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+            }
         }
+    }
     #endif /* ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH */
 }
 /*-----------------------------------------------------------*/
 
+static void setCipherProfile( MbedSSLContext_t * pxSslContext,
+                              TlsCipherProfile_t xProfile )
+{
+    if( xProfile == eTlsCipherProfileDefault )
+    {
+        xProfile = transporttlsCIPHER_PROFILE;
+    }
+
+    /* The lists are only referenced by the configuration, so they must outlive it. */
+    if( xProfile == eTlsCipherProfileLowPower )
+    {
+        mbedtls_ssl_conf_ciphersuites( &( pxSslContext->config ), pxLowPowerCipherSuites );
+
+        #ifdef MBEDTLS_ECP_C
+            mbedtls_ssl_conf_curves( &( pxSslContext->config ), pxLowPowerCurves );
+        #endif
+    }
+    else if( xProfile == eTlsCipherProfileBalanced )
+    {
+        mbedtls_ssl_conf_ciphersuites( &( pxSslContext->config ), pxBalancedCipherSuites );
+
+        #ifdef MBEDTLS_ECP_C
+            mbedtls_ssl_conf_curves( &( pxSslContext->config ), pxBalancedCurves );
+        #endif
+    }
+    else
+    {
+        /* Keep the defaults set by mbedtls_ssl_config_defaults. */
+    }
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t maxFragmentLengthCode( uint16_t usLength,
+                                         unsigned char * pucCode )
+{
+    BaseType_t xValid = pdTRUE;
+
+    if( usLength == 0 )
+    {
+        usLength = transporttlsMAX_FRAGMENT_LENGTH;
+    }
+
+    switch( usLength )
+    {
+        case 512:
+            *pucCode = MBEDTLS_SSL_MAX_FRAG_LEN_512;
+            break;
+
+        case 1024:
+            *pucCode = MBEDTLS_SSL_MAX_FRAG_LEN_1024;
+            break;
+
+        case 2048:
+            *pucCode = MBEDTLS_SSL_MAX_FRAG_LEN_2048;
+            break;
+
+        case 4096:
+            *pucCode = MBEDTLS_SSL_MAX_FRAG_LEN_4096;
+            break;
+
+        case 16384:
+            *pucCode = MBEDTLS_SSL_MAX_FRAG_LEN_NONE;
+            break;
+
+        default:
+            xValid = pdFALSE;
+            break;
+    }
+
+    return xValid;
+}
+/*-----------------------------------------------------------*/
+
 static TlsTransportStatus_t tlsSetup( NetworkContext_t * pxNetworkContext,
                                       const char * pcHostName,
                                       const NetworkCredentials_t * pxNetworkCredentials )
@@ -506,6 +1250,9 @@ static TlsTransportStatus_t tlsSetup( NetworkContext_t * pxNetworkContext,
         }
         else
         {
+            setCipherProfile( pxSSLContext,
+                              pxNetworkCredentials->xCipherProfile );
+
             /* Optionally set SNI and ALPN protocols. */
             setOptionalConfigurations( pxSSLContext,
                                        pcHostName,
@@ -517,252 +1264,1075 @@ static TlsTransportStatus_t tlsSetup( NetworkContext_t * pxNetworkContext,
 }
 /*-----------------------------------------------------------*/
 
-static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pxNetworkContext,
-                                          const NetworkCredentials_t * pxNetworkCredentials )
+static int asyncSend( void * pvContext,
+                      const unsigned char * pucBuffer,
+                      size_t xLength )
 {
-    TlsTransportParams_t * pxTlsTransportParams = NULL;
-    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
-    int32_t lMbedtlsError = 0;
-    MbedSSLContext_t * pxSSLContext = NULL;
+    MbedSSLContext_t * pxSslContext = ( MbedSSLContext_t * ) pvContext;
+    BaseType_t xResult;
 
-    configASSERT( pxNetworkContext != NULL );
-    configASSERT( pxNetworkContext->pParams != NULL );
-    configASSERT( pxNetworkCredentials != NULL );
+    xResult = socketSend( pvContext, pucBuffer, xLength );
 
-    pxTlsTransportParams = ( TlsTransportParams_t * ) pxNetworkContext->pParams;
-    configASSERT( pxTlsTransportParams->xSSLContext != NULL );
+    if( ( xResult == 0 ) || ( xResult == SOCKETS_EWOULDBLOCK ) )
+    {
+        xResult = MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+    else if( xResult > 0 )
+    {
+        pxSslContext->xLastHandshakeIo = xTaskGetTickCount();
+    }
 
-    pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+    return ( int ) xResult;
+}
+/*-----------------------------------------------------------*/
 
-    /* Initialize the mbed TLS secured connection context. */
-    lMbedtlsError = mbedtls_ssl_setup( &( pxSSLContext->context ),
-                                       &( pxSSLContext->config ) );
+static int asyncRecv( void * pvContext,
+                      unsigned char * pucBuffer,
+                      size_t xLength )
+{
+    MbedSSLContext_t * pxSslContext = ( MbedSSLContext_t * ) pvContext;
+    BaseType_t xResult;
 
-    if( lMbedtlsError != 0 )
+    xResult = socketRecv( pvContext, pucBuffer, xLength );
+
+    if( ( xResult == 0 ) || ( xResult == SOCKETS_EWOULDBLOCK ) )
     {
-        LogError( ( "Failed to set up mbed TLS SSL context: lMbedtlsError[%d]= %s : %s.",
-                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+        xResult = MBEDTLS_ERR_SSL_WANT_READ;
+    }
+    else if( xResult > 0 )
+    {
+        pxSslContext->xLastHandshakeIo = xTaskGetTickCount();
+    }
 
-        xRetVal = eTLSTransportInternalError;
+    return ( int ) xResult;
+}
+/*-----------------------------------------------------------*/
+
+static int socketSend( void * pvContext,
+                       const unsigned char * pucBuffer,
+                       size_t xLength )
+{
+    MbedSSLContext_t * pxSslContext = ( MbedSSLContext_t * ) pvContext;
+    BaseType_t xResult;
+
+    configASSERT( pucBuffer != NULL );
+
+    if( pxSslContext->pucFlight == NULL )
+    {
+        xResult = socketWrite( pxSslContext, pucBuffer, xLength );
     }
     else
     {
-        /* Set the underlying IO for the TLS connection. */
+        /* Make room for the record, or send what is gathered ahead of a record
+         * too large to gather. */
+        if( xLength > ( transporttlsHANDSHAKE_FLIGHT_SIZE - pxSslContext->xFlightLength ) )
+        {
+            xResult = flightFlush( pxSslContext );
+        }
+        else
+        {
+            xResult = SOCKETS_ERROR_NONE;
+        }
 
-        /* MISRA Rule 11.2 flags the following line for casting the second
-         * parameter to void *. This rule is suppressed because
-         * #mbedtls_ssl_set_bio requires the second parameter as void *.
-         */
-        /* coverity[misra_c_2012_rule_11_2_violation] */
-        mbedtls_ssl_set_bio( &( pxSSLContext->context ),
-                             ( void * ) pxTlsTransportParams->xTCPSocket,
-                             mbedtls_platform_send,
-                             mbedtls_platform_recv,
-                             NULL );
+        if( xResult != SOCKETS_ERROR_NONE )
+        {
+            /* Returned as is, mbed TLS tries the record again. */
+        }
+        else if( xLength > transporttlsHANDSHAKE_FLIGHT_SIZE )
+        {
+            xResult = socketWrite( pxSslContext, pucBuffer, xLength );
+        }
+        else
+        {
+            /* Held until mbed TLS reads the answer, or the handshake completes. */
+            ( void ) memcpy( pxSslContext->pucFlight + pxSslContext->xFlightLength, pucBuffer, xLength );
+            pxSslContext->xFlightLength += xLength;
+            xResult = ( BaseType_t ) xLength;
+        }
     }
 
-    if( xRetVal == eTLSTransportSuccess )
+    return ( int ) xResult;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t socketWrite( MbedSSLContext_t * pxSslContext,
+                               const uint8_t * pucBuffer,
+                               size_t xLength )
+{
+    BaseType_t xResult;
+
+    xResult = Sockets_Send( pxSslContext->xSocket, pucBuffer, xLength );
+
+    if( xResult > 0 )
     {
-        /* Perform the TLS handshake. */
-        do
-        {
-            lMbedtlsError = mbedtls_ssl_handshake( &( pxSSLContext->context ) );
-        } while( ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
-                 ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) );
+        pxSslContext->xSendStats.ulSocketWrites++;
+        pxSslContext->xSendStats.ullWireBytes += ( uint64_t ) xResult;
 
-        if( lMbedtlsError != 0 )
+        if( pxSslContext->xHandshaking == pdTRUE )
         {
-            LogError( ( "Failed to perform TLS handshake: lMbedtlsError[%d]= %s : %s.",
-                        lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+            pxSslContext->xAwaitingReply = pdTRUE;
+        }
+    }
 
-            if( lMbedtlsError == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED )
-            {
-                xRetVal = eTLSTransportCAVerifyFailed;
-            }
-            else
-            {
-                xRetVal = eTLSTransportHandshakeFailed;
-            }
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t flightFlush( MbedSSLContext_t * pxSslContext )
+{
+    BaseType_t xResult = SOCKETS_ERROR_NONE;
+
+    while( ( pxSslContext->xFlightLength > 0U ) && ( xResult == SOCKETS_ERROR_NONE ) )
+    {
+        xResult = socketWrite( pxSslContext, pxSslContext->pucFlight, pxSslContext->xFlightLength );
+
+        if( xResult > 0 )
+        {
+            /* Keep what the socket did not take at the start of the buffer. */
+            pxSslContext->xFlightLength -= ( size_t ) xResult;
+            ( void ) memmove( pxSslContext->pucFlight,
+                              pxSslContext->pucFlight + xResult,
+                              pxSslContext->xFlightLength );
+            xResult = SOCKETS_ERROR_NONE;
+        }
+        else if( xResult == 0 )
+        {
+            xResult = SOCKETS_EWOULDBLOCK;
         }
         else
         {
-            LogInfo( ( "(Network connection %p) TLS handshake successful.",
-                       pxNetworkContext ) );
+            /* Empty else marker. */
         }
     }
 
-    return xRetVal;
+    return xResult;
 }
 /*-----------------------------------------------------------*/
 
-static TlsTransportStatus_t initMbedtls( mbedtls_entropy_context * pxEntropyContext,
-                                         mbedtls_ctr_drbg_context * pxCtrDrgbContext )
+static TlsTransportStatus_t flightFinish( MbedSSLContext_t * pxSslContext )
 {
     TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
-    int32_t lMbedtlsError = 0;
+    BaseType_t xResult;
 
-    /* Set the mutex functions for mbed TLS thread safety. */
-    mbedtls_threading_set_alt( mbedtls_platform_mutex_init,
-                               mbedtls_platform_mutex_free,
-                               mbedtls_platform_mutex_lock,
-                               mbedtls_platform_mutex_unlock );
+    if( ( xResult = flightFlush( pxSslContext ) ) != SOCKETS_ERROR_NONE )
+    {
+        LogError( ( "Failed to send the last TLS handshake flight to %s: %d.",
+                    pxSslContext->pcHostName,
+                    xResult ) );
+        xRetVal = eTLSTransportHandshakeFailed;
+    }
 
-    /* Initialize contexts for random number generation. */
-    mbedtls_entropy_init( pxEntropyContext );
-    mbedtls_ctr_drbg_init( pxCtrDrgbContext );
+    if( pxSslContext->pucFlight != NULL )
+    {
+        bufferFree( pxSslContext, pxSslContext->pucFlight );
+        pxSslContext->pucFlight = NULL;
+    }
 
-    /* Add a strong entropy source. At least one is required. */
-    lMbedtlsError = mbedtls_entropy_add_source( pxEntropyContext,
-                                                mbedtls_platform_entropy_poll,
-                                                NULL,
-                                                32,
-                                                MBEDTLS_ENTROPY_SOURCE_STRONG );
+    pxSslContext->xHandshaking = pdFALSE;
+    pxSslContext->xAwaitingReply = pdFALSE;
 
-    if( lMbedtlsError != 0 )
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+static int socketRecv( void * pvContext,
+                       unsigned char * pucBuffer,
+                       size_t xLength )
+{
+    MbedSSLContext_t * pxSslContext = ( MbedSSLContext_t * ) pvContext;
+    BaseType_t xResult;
+
+    configASSERT( pucBuffer != NULL );
+
+    /* mbed TLS reads once it has written the whole flight, so send it now. */
+    xResult = flightFlush( pxSslContext );
+
+    if( xResult == SOCKETS_ERROR_NONE )
     {
-        LogError( ( "Failed to add entropy source: lMbedtlsError[%d]= %s : %s.",
-                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
-        xRetVal = eTLSTransportInternalError;
+        xResult = Sockets_Recv( pxSslContext->xSocket, pucBuffer, xLength );
     }
 
-    if( xRetVal == eTLSTransportSuccess )
+    if( xResult > 0 )
     {
-        /* Seed the random number generator. */
-        lMbedtlsError = mbedtls_ctr_drbg_seed( pxCtrDrgbContext,
-                                               mbedtls_entropy_func,
-                                               pxEntropyContext,
-                                               NULL,
-                                               0 );
+        pxSslContext->xRecvStats.ulSocketReads++;
+        pxSslContext->xRecvStats.ullWireBytes += ( uint64_t ) xResult;
 
-        if( lMbedtlsError != 0 )
+        if( pxSslContext->xAwaitingReply == pdTRUE )
+        {
+            pxSslContext->ulHandshakeRoundTrips++;
+            pxSslContext->xAwaitingReply = pdFALSE;
+        }
+    }
+
+    return ( int ) xResult;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t sslWriteRecord( MbedSSLContext_t * pxSslContext,
+                               const uint8_t * pucData,
+                               size_t xLength )
+{
+    int32_t lMbedtlsError;
+
+    /* Each successful call writes a single record, holding at most the
+     * largest record payload. */
+    arenaEnter( pxSslContext );
+    lMbedtlsError = ( int32_t ) mbedtls_ssl_write( &( pxSslContext->context ),
+                                                   pucData,
+                                                   xLength );
+    arenaLeave( pxSslContext );
+
+    if( lMbedtlsError > 0 )
+    {
+        pxSslContext->xSendStats.ulRecords++;
+        pxSslContext->xSendStats.ullPayloadBytes += ( uint64_t ) lMbedtlsError;
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t sslReadBuffered( MbedSSLContext_t * pxSslContext,
+                                uint8_t * pucBuffer,
+                                size_t xLength )
+{
+    int32_t lMbedtlsError;
+    size_t xCopy;
+    BaseType_t xNewRecord;
+
+    /* With nothing left of the current record, data returned by the next read
+     * comes from a new record. */
+    xNewRecord = ( mbedtls_ssl_get_bytes_avail( &( pxSslContext->context ) ) == 0U ) ? pdTRUE : pdFALSE;
+
+    if( ( pxSslContext->pucReadAhead == NULL ) &&
+        ( transporttlsREAD_AHEAD_SIZE > 0U ) &&
+        ( xLength < transporttlsREAD_AHEAD_SIZE ) )
+    {
+        pxSslContext->pucReadAhead = bufferAlloc( pxSslContext, eTlsBufferReadAhead );
+    }
+
+    if( pxSslContext->xReadAheadStart < pxSslContext->xReadAheadEnd )
+    {
+        /* Served from memory, without calling into mbed TLS. */
+        pxSslContext->xRecvStats.ulReadAheadHits++;
+        lMbedtlsError = 0;
+    }
+    else if( ( pxSslContext->pucReadAhead == NULL ) ||
+             ( xLength >= transporttlsREAD_AHEAD_SIZE ) )
+    {
+        pxSslContext->xRecvStats.ulSslReads++;
+        arenaEnter( pxSslContext );
+        lMbedtlsError = ( int32_t ) mbedtls_ssl_read( &( pxSslContext->context ),
+                                                      pucBuffer,
+                                                      xLength );
+        arenaLeave( pxSslContext );
+        xLength = 0;
+
+        if( lMbedtlsError > 0 )
+        {
+            pxSslContext->xRecvStats.ullBytesCopied += ( uint64_t ) lMbedtlsError;
+
+            if( xNewRecord == pdTRUE )
+            {
+                pxSslContext->xRecvStats.ulRecords++;
+            }
+        }
+    }
+    else
+    {
+        /* Take in as much of the current record as fits. mbed TLS returns as
+         * soon as it has any data, so this waits no longer than the read asked for. */
+        pxSslContext->xRecvStats.ulSslReads++;
+        arenaEnter( pxSslContext );
+        lMbedtlsError = ( int32_t ) mbedtls_ssl_read( &( pxSslContext->context ),
+                                                      pxSslContext->pucReadAhead,
+                                                      transporttlsREAD_AHEAD_SIZE );
+        arenaLeave( pxSslContext );
+
+        if( lMbedtlsError > 0 )
+        {
+            if( xNewRecord == pdTRUE )
+            {
+                pxSslContext->xRecvStats.ulRecords++;
+            }
+
+            pxSslContext->xRecvStats.ullBytesCopied += ( uint64_t ) lMbedtlsError;
+            pxSslContext->xReadAheadStart = 0;
+            pxSslContext->xReadAheadEnd = ( size_t ) lMbedtlsError;
+            lMbedtlsError = 0;
+        }
+    }
+
+    if( ( lMbedtlsError == 0 ) &&
+        ( pxSslContext->xReadAheadStart < pxSslContext->xReadAheadEnd ) &&
+        ( xLength > 0U ) )
+    {
+        xCopy = pxSslContext->xReadAheadEnd - pxSslContext->xReadAheadStart;
+
+        if( xCopy > xLength )
+        {
+            xCopy = xLength;
+        }
+
+        ( void ) memcpy( pucBuffer, pxSslContext->pucReadAhead + pxSslContext->xReadAheadStart, xCopy );
+        pxSslContext->xRecvStats.ullBytesCopied += ( uint64_t ) xCopy;
+        pxSslContext->xReadAheadStart += xCopy;
+        lMbedtlsError = ( int32_t ) xCopy;
+    }
+
+    if( lMbedtlsError > 0 )
+    {
+        pxSslContext->xRecvStats.ullBytesReceived += ( uint64_t ) lMbedtlsError;
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t tlsHandshakeStart( NetworkContext_t * pxNetworkContext,
+                                               BaseType_t xNonBlocking )
+{
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    int32_t lMbedtlsError = 0;
+    MbedSSLContext_t * pxSSLContext = NULL;
+
+    configASSERT( pxNetworkContext != NULL );
+    configASSERT( pxNetworkContext->pParams != NULL );
+
+    pxTlsTransportParams = ( TlsTransportParams_t * ) pxNetworkContext->pParams;
+    configASSERT( pxTlsTransportParams->xSSLContext != NULL );
+
+    pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+
+    /* Initialize the mbed TLS secured connection context. */
+    arenaEnter( pxSSLContext );
+    lMbedtlsError = mbedtls_ssl_setup( &( pxSSLContext->context ),
+                                       &( pxSSLContext->config ) );
+    arenaLeave( pxSSLContext );
+
+    if( lMbedtlsError != 0 )
+    {
+        LogError( ( "Failed to set up mbed TLS SSL context: lMbedtlsError[%d]= %s : %s.",
+                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+
+        xRetVal = eTLSTransportInternalError;
+    }
+    else
+    {
+        /* Set the underlying IO for the TLS connection. */
+        if( xNonBlocking == pdTRUE )
+        {
+            mbedtls_ssl_set_bio( &( pxSSLContext->context ),
+                                 pxSSLContext,
+                                 asyncSend,
+                                 asyncRecv,
+                                 NULL );
+        }
+        else
+        {
+            mbedtls_ssl_set_bio( &( pxSSLContext->context ),
+                                 pxSSLContext,
+                                 socketSend,
+                                 socketRecv,
+                                 NULL );
+        }
+
+        /* Offer the session from a previous connection to this endpoint, if
+         * any. The copy belongs to the connection. */
+        arenaEnter( pxSSLContext );
+        pxSSLContext->xSessionOffered = TLS_SessionCache_Load( pxSSLContext->pcHostName,
+                                                               pxSSLContext->usPort,
+                                                               &( pxSSLContext->context ) );
+        arenaLeave( pxSSLContext );
+
+        pxSSLContext->xHandshakeStart = xTaskGetTickCount();
+        pxSSLContext->xLastHandshakeIo = pxSSLContext->xHandshakeStart;
+        pxSSLContext->xHandshaking = pdTRUE;
+
+        /* Without the buffer, each record is written as it is produced. */
+        if( transporttlsHANDSHAKE_FLIGHT_SIZE > 0U )
+        {
+            pxSSLContext->pucFlight = bufferAlloc( pxSSLContext, eTlsBufferFlight );
+        }
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t socketConnect( MbedSSLContext_t * pxSslContext,
+                                 const char * pcHostName,
+                                 uint16_t usPort )
+{
+    BaseType_t xSocketStatus;
+
+    xSocketStatus = Sockets_Connect( pxSslContext->xSocket, pcHostName, usPort );
+
+    if( xSocketStatus == 0 )
+    {
+        pxSslContext->xTcpConnected = xTaskGetTickCount();
+    }
+
+    return xSocketStatus;
+}
+/*-----------------------------------------------------------*/
+
+static void recordConnectStats( MbedSSLContext_t * pxSslContext,
+                                BaseType_t xSessionResumed,
+                                TickType_t xNow )
+{
+    TlsTransportConnectStats_t * pxStats = &( pxSslContext->xConnectStats );
+    SocketsConnectTimes_t xSocketTimes;
+
+    pxStats->ulTcpConnectMs = ( uint32_t ) ( ( pxSslContext->xTcpConnected - pxSslContext->xConnectStart ) *
+                                             portTICK_PERIOD_MS );
+    pxStats->ulHandshakeMs = ( uint32_t ) ( ( xNow - pxSslContext->xHandshakeStart ) * portTICK_PERIOD_MS );
+    pxStats->ulTotalMs = ( uint32_t ) ( ( xNow - pxSslContext->xConnectStart ) * portTICK_PERIOD_MS );
+    pxStats->xSessionResumed = xSessionResumed;
+    pxStats->pcCipherSuite = mbedtls_ssl_get_ciphersuite( &( pxSslContext->context ) );
+    pxStats->pcTlsVersion = mbedtls_ssl_get_version( &( pxSslContext->context ) );
+    pxStats->ulHandshakeRoundTrips = pxSslContext->ulHandshakeRoundTrips;
+    pxStats->ulHandshakeYields = pxSslContext->ulHandshakeYields;
+
+    /* Split name resolution out of the TCP phase where the wrapper timed it. */
+    if( Sockets_GetConnectTimes( pxSslContext->xSocket, &xSocketTimes ) == SOCKETS_ERROR_NONE )
+    {
+        pxStats->ulDnsMs = xSocketTimes.ulDnsMs;
+        pxStats->ulTcpConnectMs = xSocketTimes.ulTcpConnectMs;
+    }
+
+    LogInfo( ( "Connect to %s: DNS %u ms, TCP %u ms, TLS %u ms, total %u ms, %s.",
+               pxSslContext->pcHostName,
+               ( unsigned int ) pxStats->ulDnsMs,
+               ( unsigned int ) pxStats->ulTcpConnectMs,
+               ( unsigned int ) pxStats->ulHandshakeMs,
+               ( unsigned int ) pxStats->ulTotalMs,
+               pxStats->pcCipherSuite ) );
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t tlsHandshakeStep( NetworkContext_t * pxNetworkContext )
+{
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    int32_t lMbedtlsError = 0;
+    MbedSSLContext_t * pxSSLContext = NULL;
+    BaseType_t xSessionResumed = pdFALSE;
+    TickType_t xNow;
+
+    configASSERT( pxNetworkContext != NULL );
+    configASSERT( pxNetworkContext->pParams != NULL );
+
+    pxTlsTransportParams = ( TlsTransportParams_t * ) pxNetworkContext->pParams;
+    configASSERT( pxTlsTransportParams->xSSLContext != NULL );
+
+    pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+
+    arenaEnter( pxSSLContext );
+    #ifdef TRANSPORT_TLS_VERIFY_CACHE
+        lMbedtlsError = sslHandshake( pxSSLContext );
+    #else
+        lMbedtlsError = mbedtls_ssl_handshake( &( pxSSLContext->context ) );
+    #endif
+    arenaLeave( pxSSLContext );
+
+    if( ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
+        ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) )
+    {
+        xRetVal = eTLSTransportInProgress;
+    }
+    else if( lMbedtlsError == MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS )
+    {
+        /* An ECC operation used up its budget. It is progress, so it does not
+         * count towards the handshake timeout. */
+        pxSSLContext->ulHandshakeYields++;
+        pxSSLContext->xLastHandshakeIo = xTaskGetTickCount();
+        xRetVal = eTLSTransportInProgress;
+    }
+    else if( lMbedtlsError != 0 )
+    {
+        LogError( ( "Failed to perform TLS handshake: lMbedtlsError[%d]= %s : %s.",
+                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+
+        if( lMbedtlsError == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED )
+        {
+            xRetVal = eTLSTransportCAVerifyFailed;
+        }
+        else
+        {
+            xRetVal = eTLSTransportHandshakeFailed;
+        }
+
+        /* Do not offer the same session again. */
+        if( pxSSLContext->xSessionOffered == pdTRUE )
+        {
+            TLS_SessionCache_Invalidate( pxSSLContext->pcHostName, pxSSLContext->usPort );
+        }
+    }
+    else
+    {
+        xSessionResumed = ( ( pxSSLContext->xSessionOffered == pdTRUE ) &&
+                            ( pxSSLContext->xPeerVerified == pdFALSE ) ) ? pdTRUE : pdFALSE;
+
+        xNow = xTaskGetTickCount();
+
+        TLS_SessionCache_RecordHandshake( pxSSLContext->xSessionOffered, xSessionResumed,
+                                          xNow - pxSSLContext->xHandshakeStart );
+
+        recordConnectStats( pxSSLContext, xSessionResumed, xNow );
+
+        /* A resumed session keeps the expiry of the full handshake that created it. */
+        if( xSessionResumed == pdFALSE )
+        {
+            TLS_SessionCache_Store( pxSSLContext->pcHostName, pxSSLContext->usPort,
+                                    &( pxSSLContext->context ) );
+        }
+
+        LogInfo( ( "(Network connection %p) TLS handshake successful%s.",
+                   pxNetworkContext,
+                   ( xSessionResumed == pdTRUE ) ? " (session resumed)" : "" ) );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pxNetworkContext )
+{
+    TlsTransportParams_t * pxTlsTransportParams = ( TlsTransportParams_t * ) pxNetworkContext->pParams;
+    TlsTransportStatus_t xRetVal;
+
+    xRetVal = tlsHandshakeStart( pxNetworkContext, pdFALSE );
+
+    if( xRetVal == eTLSTransportSuccess )
+    {
+        /* Perform the TLS handshake. */
+        do
+        {
+            xRetVal = tlsHandshakeStep( pxNetworkContext );
+
+            /* The socket blocks, so this is an ECC step; let other tasks run. */
+            if( xRetVal == eTLSTransportInProgress )
+            {
+                taskYIELD();
+            }
+        } while( xRetVal == eTLSTransportInProgress );
+    }
+
+    if( xRetVal == eTLSTransportSuccess )
+    {
+        xRetVal = flightFinish( ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t initMbedtls( MbedSSLContext_t * pxSslContext )
+{
+    TlsTransportStatus_t xRetVal;
+
+    if( ( xRetVal = TLS_Socket_RuntimeInit() ) != eTLSTransportSuccess )
+    {
+        /* Error logged by TLS_Socket_RuntimeInit. */
+    }
+    else
+    {
+        pxSslContext->xRuntimeHeld = pdTRUE;
+        LogDebug( ( "Successfully initialized mbedTLS." ) );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+static void arenaEnter( MbedSSLContext_t * pxSslContext )
+{
+    #if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+        /* With no scope free, the allocations simply go to the heap. */
+        ( void ) mbedtls_platform_arena_enter( &( pxSslContext->xArena ) );
+    #else
+        ( void ) pxSslContext;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static void arenaLeave( MbedSSLContext_t * pxSslContext )
+{
+    #if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+        mbedtls_platform_arena_leave( &( pxSslContext->xArena ) );
+    #else
+        ( void ) pxSslContext;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static MbedSSLContext_t * contextAlloc( void )
+{
+    MbedSSLContext_t * pxSslContext = NULL;
+
+    #if ( transporttlsSTATIC_CONTEXTS > 0 )
+        uint32_t i;
+
+        taskENTER_CRITICAL();
+        {
+            for( i = 0; ( i < transporttlsSTATIC_CONTEXTS ) && ( pxSslContext == NULL ); i++ )
+            {
+                if( xStaticContexts[ i ].xInUse == pdFALSE )
+                {
+                    xStaticContexts[ i ].xInUse = pdTRUE;
+                    pxSslContext = &( xStaticContexts[ i ].xContext );
+                }
+            }
+        }
+        taskEXIT_CRITICAL();
+    #else
+        pxSslContext = pvPortMalloc( sizeof( MbedSSLContext_t ) );
+    #endif
+
+    if( pxSslContext != NULL )
+    {
+        /* Zero the context so that it can be freed on any failure path. */
+        ( void ) memset( pxSslContext, 0, sizeof( MbedSSLContext_t ) );
+
+        #if ( transporttlsSTATIC_CONTEXTS > 0 )
+            pxSslContext->xStatic = pdTRUE;
+        #endif
+    }
+
+    return pxSslContext;
+}
+/*-----------------------------------------------------------*/
+
+static void contextFree( MbedSSLContext_t * pxSslContext )
+{
+    #if ( transporttlsSTATIC_CONTEXTS > 0 )
+        taskENTER_CRITICAL();
+        {
+            ( ( TlsStaticContext_t * ) pxSslContext )->xInUse = pdFALSE;
+        }
+        taskEXIT_CRITICAL();
+    #else
+        vPortFree( pxSslContext );
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static uint8_t * bufferAlloc( MbedSSLContext_t * pxSslContext,
+                              TlsBuffer_t xBuffer )
+{
+    uint8_t * pucBuffer = NULL;
+
+    #if ( transporttlsSTATIC_CONTEXTS > 0 )
+        TlsStaticContext_t * pxStatic = ( TlsStaticContext_t * ) pxSslContext;
+
+        if( xBuffer == eTlsBufferReadAhead )
+        {
+            pucBuffer = pxStatic->ucReadAhead;
+        }
+        else
+        {
+            pucBuffer = pxStatic->ucFlight;
+        }
+    #else /* if ( transporttlsSTATIC_CONTEXTS > 0 ) */
+        ( void ) pxSslContext;
+
+        if( xBuffer == eTlsBufferReadAhead )
+        {
+            pucBuffer = pvPortMalloc( transporttlsREAD_AHEAD_SIZE );
+        }
+        else
+        {
+            pucBuffer = pvPortMalloc( transporttlsHANDSHAKE_FLIGHT_SIZE );
+        }
+    #endif /* transporttlsSTATIC_CONTEXTS > 0 */
+
+    return pucBuffer;
+}
+/*-----------------------------------------------------------*/
+
+static void bufferFree( MbedSSLContext_t * pxSslContext,
+                        uint8_t * pucBuffer )
+{
+    ( void ) pxSslContext;
+
+    /* Static storage goes back with its context. */
+    #if ( transporttlsSTATIC_CONTEXTS > 0 )
+        ( void ) pucBuffer;
+    #else
+        vPortFree( pucBuffer );
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t connectInit( NetworkContext_t * pxNetworkContext,
+                                         const char * pcHostName,
+                                         uint16_t usPort,
+                                         const NetworkCredentials_t * pxNetworkCredentials,
+                                         uint32_t ulReceiveTimeoutMs,
+                                         uint32_t ulSendTimeoutMs )
+{
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    BaseType_t xSocketStatus = 0;
+    MbedSSLContext_t * pxSSLContext;
+    size_t xHostNameLength;
+    unsigned char ucMaxFragLenCode;
+
+    if( ( pxNetworkContext == NULL ) ||
+        ( pxNetworkContext->pParams == NULL ) ||
+        ( pcHostName == NULL ) ||
+        ( pxNetworkCredentials == NULL ) )
+    {
+        LogError( ( "Invalid input parameter(s): Arguments cannot be NULL. pxNetworkContext=%p, "
+                    "pcHostName=%p, pxNetworkCredentials=%p.",
+                    pxNetworkCredentials,
+                    pcHostName,
+                    pxNetworkCredentials ) );
+        xRetVal = eTLSTransportInvalidParameter;
+    }
+    else if( ( pxNetworkCredentials->pucRootCa == NULL ) )
+    {
+        LogError( ( "pucRootCa cannot be NULL." ) );
+        xRetVal = eTLSTransportInvalidParameter;
+    }
+    else if( ( xHostNameLength = strlen( pcHostName ) ) > SOCKETS_MAX_HOST_NAME_LENGTH )
+    {
+        LogError( ( "Host name is longer than %d characters.", SOCKETS_MAX_HOST_NAME_LENGTH ) );
+        xRetVal = eTLSTransportInvalidParameter;
+    }
+    else if( pxNetworkCredentials->xCipherProfile > eTlsCipherProfileCompat )
+    {
+        LogError( ( "Unknown cipher profile %d.", ( int ) pxNetworkCredentials->xCipherProfile ) );
+        xRetVal = eTLSTransportInvalidParameter;
+    }
+    else if( maxFragmentLengthCode( pxNetworkCredentials->usMaxFragmentLength, &ucMaxFragLenCode ) == pdFALSE )
+    {
+        LogError( ( "Unsupported maximum fragment length %u.",
+                    ( unsigned int ) pxNetworkCredentials->usMaxFragmentLength ) );
+        xRetVal = eTLSTransportInvalidParameter;
+    }
+    else if( ( pxSSLContext = contextAlloc() ) == NULL )
+    {
+        LogError( ( "Failed to allocate mbed ssl context memmory ." ) );
+        xRetVal = eTLSTransportInsufficientMemory;
+    }
+    else
+    {
+        ( void ) memcpy( pxSSLContext->pcHostName, pcHostName, xHostNameLength + 1 );
+        pxSSLContext->usPort = usPort;
+        pxSSLContext->xRecvTimeout = pdMS_TO_TICKS( ulReceiveTimeoutMs );
+        pxSSLContext->xSendTimeout = pdMS_TO_TICKS( ulSendTimeoutMs );
+        pxSSLContext->xConnectStart = xTaskGetTickCount();
+
+        pxTlsTransportParams = pxNetworkContext->pParams;
+        pxTlsTransportParams->xSSLContext = ( SSLContextHandle ) pxSSLContext;
+
+        if( ( pxTlsTransportParams->xTCPSocket = Sockets_Open() ) == SOCKETS_INVALID_SOCKET )
+        {
+            LogError( ( "Failed to open socket." ) );
+            xRetVal = eTLSTransportConnectFailure;
+            connectAbort( pxNetworkContext );
+        }
+        else if( ( xSocketStatus = Transport_SetTrafficClass( pxTlsTransportParams->xTCPSocket,
+                                                              pxTlsTransportParams->xTrafficClass ) ) != 0 )
+        {
+            LogError( ( "Failed to set traffic class %d on socket %d.",
+                        ( int ) pxTlsTransportParams->xTrafficClass, xSocketStatus ) );
+            xRetVal = eTLSTransportInternalError;
+            connectAbort( pxNetworkContext );
+        }
+        else
+        {
+            pxSSLContext->xSocket = pxTlsTransportParams->xTCPSocket;
+        }
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t setSocketTimeouts( MbedSSLContext_t * pxSslContext )
+{
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    BaseType_t xSocketStatus = 0;
+
+    if( ( xSocketStatus = Sockets_SetSockOpt( pxSslContext->xSocket,
+                                              SOCKETS_SO_RCVTIMEO,
+                                              &( pxSslContext->xRecvTimeout ),
+                                              sizeof( pxSslContext->xRecvTimeout ) ) ) != 0 )
+    {
+        LogError( ( "Failed to set receive timeout on socket %d.", xSocketStatus ) );
+        xRetVal = eTLSTransportInternalError;
+    }
+    else if( ( xSocketStatus = Sockets_SetSockOpt( pxSslContext->xSocket,
+                                                   SOCKETS_SO_SNDTIMEO,
+                                                   &( pxSslContext->xSendTimeout ),
+                                                   sizeof( pxSslContext->xSendTimeout ) ) ) != 0 )
+    {
+        LogError( ( "Failed to set send timeout on socket %d.", xSocketStatus ) );
+        xRetVal = eTLSTransportInternalError;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+static void connectAbort( NetworkContext_t * pxNetworkContext )
+{
+    TlsTransportParams_t * pxTlsTransportParams = ( TlsTransportParams_t * ) pxNetworkContext->pParams;
+    MbedSSLContext_t * pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+
+    sslContextFree( pxSSLContext );
+    contextFree( pxSSLContext );
+    pxTlsTransportParams->xSSLContext = NULL;
+
+    if( pxTlsTransportParams->xTCPSocket != SOCKETS_INVALID_SOCKET )
+    {
+        ( void ) Sockets_Disconnect( pxTlsTransportParams->xTCPSocket );
+        ( void ) Sockets_Close( pxTlsTransportParams->xTCPSocket );
+    }
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_Socket_Connect( NetworkContext_t * pxNetworkContext,
+                                         const char * pcHostName,
+                                         uint16_t usPort,
+                                         const NetworkCredentials_t * pxNetworkCredentials,
+                                         uint32_t ulReceiveTimeoutMs,
+                                         uint32_t ulSendTimeoutMs )
+{
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    BaseType_t xSocketStatus = 0;
+    MbedSSLContext_t * pxSSLContext;
+
+    if( ( xRetVal = connectInit( pxNetworkContext, pcHostName, usPort, pxNetworkCredentials,
+                                 ulReceiveTimeoutMs, ulSendTimeoutMs ) ) == eTLSTransportSuccess )
+    {
+        pxTlsTransportParams = pxNetworkContext->pParams;
+        pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+
+        if( ( xRetVal = setSocketTimeouts( pxSSLContext ) ) != eTLSTransportSuccess )
+        {
+            /* Error logged by setSocketTimeouts. */
+        }
+        else if( ( xSocketStatus = socketConnect( pxSSLContext,
+                                                  pcHostName,
+                                                  usPort ) ) != 0 )
+        {
+            LogError( ( "Failed to connect to %s with error %d.",
+                        pcHostName,
+                        xSocketStatus ) );
+            xRetVal = eTLSTransportConnectFailure;
+        }
+        else if( ( xRetVal = initMbedtls( pxSSLContext ) ) != eTLSTransportSuccess )
+        {
+            LogError( ( "Failed to initialize Mbedtls %d.", xRetVal ) );
+        }
+        else if( ( xRetVal = tlsSetup( pxNetworkContext, pcHostName,
+                                       pxNetworkCredentials ) ) != eTLSTransportSuccess )
+        {
+            LogError( ( "Failed to setup Mbedtls %d.", xRetVal ) );
+        }
+        else if( ( xRetVal = tlsHandshake( pxNetworkContext ) ) != eTLSTransportSuccess )
+        {
+            LogError( ( "Failed to do TLS handshake %d.", xRetVal ) );
+        }
+        else
+        {
+            LogInfo( ( "(Network connection %p) Connection to %s established.",
+                       pxNetworkContext,
+                       pcHostName ) );
+        }
+
+        /* Clean up on failure. */
+        if( xRetVal != eTLSTransportSuccess )
+        {
+            connectAbort( pxNetworkContext );
+        }
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_Socket_ConnectStart( NetworkContext_t * pxNetworkContext,
+                                              const char * pcHostName,
+                                              uint16_t usPort,
+                                              const NetworkCredentials_t * pxNetworkCredentials,
+                                              uint32_t ulReceiveTimeoutMs,
+                                              uint32_t ulSendTimeoutMs )
+{
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    BaseType_t xSocketStatus = 0;
+    BaseType_t xNonBlocking = pdTRUE;
+    MbedSSLContext_t * pxSSLContext;
+
+    if( ( xRetVal = connectInit( pxNetworkContext, pcHostName, usPort, pxNetworkCredentials,
+                                 ulReceiveTimeoutMs, ulSendTimeoutMs ) ) == eTLSTransportSuccess )
+    {
+        pxTlsTransportParams = pxNetworkContext->pParams;
+        pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+
+        if( ( xSocketStatus = Sockets_SetSockOpt( pxTlsTransportParams->xTCPSocket,
+                                                  SOCKETS_SO_NONBLOCK,
+                                                  &xNonBlocking,
+                                                  sizeof( xNonBlocking ) ) ) != 0 )
+        {
+            LogError( ( "Failed to make socket non-blocking %d.", xSocketStatus ) );
+            xRetVal = eTLSTransportInternalError;
+        }
+        else if( ( xRetVal = initMbedtls( pxSSLContext ) ) != eTLSTransportSuccess )
+        {
+            LogError( ( "Failed to initialize Mbedtls %d.", xRetVal ) );
+        }
+        else if( ( xRetVal = tlsSetup( pxNetworkContext, pcHostName,
+                                       pxNetworkCredentials ) ) != eTLSTransportSuccess )
+        {
+            LogError( ( "Failed to setup Mbedtls %d.", xRetVal ) );
+        }
+        else if( ( ( xSocketStatus = Sockets_ConnectStart( pxTlsTransportParams->xTCPSocket,
+                                                           pcHostName,
+                                                           usPort ) ) != SOCKETS_ERROR_NONE ) &&
+                 ( xSocketStatus != SOCKETS_EWOULDBLOCK ) )
+        {
+            LogError( ( "Failed to connect to %s with error %d.",
+                        pcHostName,
+                        xSocketStatus ) );
+            xRetVal = eTLSTransportConnectFailure;
+        }
+        else
+        {
+            pxSSLContext->xConnectState = eTlsConnectTcp;
+        }
+
+        if( xRetVal == eTLSTransportSuccess )
+        {
+            /* Do whatever can be done without waiting; this also cleans up on failure. */
+            xRetVal = TLS_Socket_ConnectPoll( pxNetworkContext );
+        }
+        else
         {
-            LogError( ( "Failed to seed PRNG: lMbedtlsError[%d]= %s : %s.",
-                        lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
-            xRetVal = eTLSTransportInternalError;
+            connectAbort( pxNetworkContext );
         }
     }
 
-    if( xRetVal == eTLSTransportSuccess )
-    {
-        LogDebug( ( "Successfully initialized mbedTLS." ) );
-    }
-
     return xRetVal;
 }
 /*-----------------------------------------------------------*/
 
-TlsTransportStatus_t TLS_Socket_Connect( NetworkContext_t * pxNetworkContext,
-                                         const char * pcHostName,
-                                         uint16_t usPort,
-                                         const NetworkCredentials_t * pxNetworkCredentials,
-                                         uint32_t ulReceiveTimeoutMs,
-                                         uint32_t ulSendTimeoutMs )
+TlsTransportStatus_t TLS_Socket_ConnectPoll( NetworkContext_t * pxNetworkContext )
 {
     TlsTransportParams_t * pxTlsTransportParams = NULL;
     TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
     BaseType_t xSocketStatus = 0;
-    MbedSSLContext_t * pxSSLContext;
-    TickType_t xRecvTimeout = pdMS_TO_TICKS( ulReceiveTimeoutMs );
-    TickType_t xSendTimeout = pdMS_TO_TICKS( ulSendTimeoutMs );
+    BaseType_t xNonBlocking = pdFALSE;
+    MbedSSLContext_t * pxSSLContext = NULL;
 
     if( ( pxNetworkContext == NULL ) ||
         ( pxNetworkContext->pParams == NULL ) ||
-        ( pcHostName == NULL ) ||
-        ( pxNetworkCredentials == NULL ) )
-    {
-        LogError( ( "Invalid input parameter(s): Arguments cannot be NULL. pxNetworkContext=%p, "
-                    "pcHostName=%p, pxNetworkCredentials=%p.",
-                    pxNetworkCredentials,
-                    pcHostName,
-                    pxNetworkCredentials ) );
-        xRetVal = eTLSTransportInvalidParameter;
-    }
-    else if( ( pxNetworkCredentials->pucRootCa == NULL ) )
+        ( ( ( TlsTransportParams_t * ) pxNetworkContext->pParams )->xSSLContext == NULL ) )
     {
-        LogError( ( "pucRootCa cannot be NULL." ) );
+        LogError( ( "No connect in progress on network context %p.", pxNetworkContext ) );
         xRetVal = eTLSTransportInvalidParameter;
     }
-    else if( ( pxSSLContext = pvPortMalloc( sizeof( MbedSSLContext_t ) ) ) == NULL )
+    else
     {
-        LogError( ( "Failed to allocate mbed ssl context memmory ." ) );
-        xRetVal = eTLSTransportInsufficientMemory;
+        pxTlsTransportParams = ( TlsTransportParams_t * ) pxNetworkContext->pParams;
+        pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
     }
-    else
+
+    if( ( xRetVal == eTLSTransportSuccess ) &&
+        ( pxSSLContext->xConnectState == eTlsConnectTcp ) )
     {
-        pxTlsTransportParams = pxNetworkContext->pParams;
-        pxTlsTransportParams->xSSLContext = ( SSLContextHandle ) pxSSLContext;
+        xSocketStatus = Sockets_ConnectPoll( pxTlsTransportParams->xTCPSocket );
 
-        if( ( pxTlsTransportParams->xTCPSocket = Sockets_Open() ) == SOCKETS_INVALID_SOCKET )
-        {
-            LogError( ( "Failed to open socket." ) );
-            xRetVal = eTLSTransportConnectFailure;
-        }
-        else if( ( xSocketStatus = Sockets_SetSockOpt( pxTlsTransportParams->xTCPSocket,
-                                                       SOCKETS_SO_RCVTIMEO,
-                                                       &xRecvTimeout,
-                                                       sizeof( xRecvTimeout ) ) != 0 ) )
+        if( xSocketStatus == SOCKETS_EWOULDBLOCK )
         {
-            LogError( ( "Failed to set receive timeout on socket %d.", xSocketStatus ) );
-            xRetVal = eTLSTransportInternalError;
-        }
-        else if( ( xSocketStatus = Sockets_SetSockOpt( pxTlsTransportParams->xTCPSocket,
-                                                       SOCKETS_SO_SNDTIMEO,
-                                                       &xSendTimeout,
-                                                       sizeof( xSendTimeout ) ) != 0 ) )
-        {
-            LogError( ( "Failed to set send timeout on socket %d.", xSocketStatus ) );
-            xRetVal = eTLSTransportInternalError;
+            xRetVal = eTLSTransportInProgress;
         }
-        else if( ( xSocketStatus = Sockets_Connect( pxTlsTransportParams->xTCPSocket,
-                                                    pcHostName,
-                                                    usPort ) ) != 0 )
+        else if( xSocketStatus != SOCKETS_ERROR_NONE )
         {
             LogError( ( "Failed to connect to %s with error %d.",
-                        pcHostName,
+                        pxSSLContext->pcHostName,
                         xSocketStatus ) );
             xRetVal = eTLSTransportConnectFailure;
         }
-        else if( ( xRetVal = initMbedtls( &( pxSSLContext->entropyContext ),
-                                          &( pxSSLContext->ctrDrgbContext ) ) ) != eTLSTransportSuccess )
+        else
         {
-            LogError( ( "Failed to initialize Mbedtls %d.", xRetVal ) );
+            pxSSLContext->xTcpConnected = xTaskGetTickCount();
+
+            if( ( xRetVal = tlsHandshakeStart( pxNetworkContext, pdTRUE ) ) == eTLSTransportSuccess )
+            {
+                pxSSLContext->xConnectState = eTlsConnectHandshake;
+            }
         }
-        else if( ( xRetVal = tlsSetup( pxNetworkContext, pcHostName,
-                                       pxNetworkCredentials ) ) != eTLSTransportSuccess )
+    }
+
+    if( ( xRetVal == eTLSTransportSuccess ) &&
+        ( pxSSLContext->xConnectState == eTlsConnectHandshake ) )
+    {
+        xRetVal = tlsHandshakeStep( pxNetworkContext );
+
+        if( xRetVal == eTLSTransportInProgress )
         {
-            LogError( ( "Failed to setup Mbedtls %d.", xRetVal ) );
+            /* As in the blocking handshake, give up if the server is silent for
+             * longer than the receive timeout. A zero timeout waits forever. */
+            if( ( pxSSLContext->xRecvTimeout != 0U ) &&
+                ( ( xTaskGetTickCount() - pxSSLContext->xLastHandshakeIo ) > pxSSLContext->xRecvTimeout ) )
+            {
+                LogError( ( "TLS handshake with %s timed out.", pxSSLContext->pcHostName ) );
+                xRetVal = eTLSTransportHandshakeFailed;
+            }
         }
-        else if( ( xRetVal = tlsHandshake( pxNetworkContext, pxNetworkCredentials ) ) != eTLSTransportSuccess )
+        else if( xRetVal == eTLSTransportSuccess )
         {
-            LogError( ( "Failed to do TLS handshake %d.", xRetVal ) );
+            /* Hand the socket back to the blocking send and receive used once connected. */
+            mbedtls_ssl_set_bio( &( pxSSLContext->context ),
+                                 pxSSLContext,
+                                 socketSend,
+                                 socketRecv,
+                                 NULL );
+
+            if( ( xSocketStatus = Sockets_SetSockOpt( pxSSLContext->xSocket,
+                                                      SOCKETS_SO_NONBLOCK,
+                                                      &xNonBlocking,
+                                                      sizeof( xNonBlocking ) ) ) != 0 )
+            {
+                LogError( ( "Failed to make socket blocking %d.", xSocketStatus ) );
+                xRetVal = eTLSTransportInternalError;
+            }
+            else if( ( ( xRetVal = setSocketTimeouts( pxSSLContext ) ) == eTLSTransportSuccess ) &&
+                     ( ( xRetVal = flightFinish( pxSSLContext ) ) == eTLSTransportSuccess ) )
+            {
+                pxSSLContext->xConnectState = eTlsConnectDone;
+
+                LogInfo( ( "(Network connection %p) Connection to %s established.",
+                           pxNetworkContext,
+                           pxSSLContext->pcHostName ) );
+            }
+            else
+            {
+                /* Error logged by setSocketTimeouts or flightFinish. */
+            }
         }
         else
         {
-            LogInfo( ( "(Network connection %p) Connection to %s established.",
-                       pxNetworkContext,
-                       pcHostName ) );
+            LogError( ( "Failed to do TLS handshake %d.", xRetVal ) );
         }
+    }
 
-        /* Clean up on failure. */
-        if( xRetVal != eTLSTransportSuccess )
-        {
-            if( ( pxNetworkContext != NULL ) && ( pxNetworkContext->pParams != NULL ) )
-            {
-                sslContextFree( pxSSLContext );
-                vPortFree( pxSSLContext );
-                pxTlsTransportParams->xSSLContext = NULL;
-
-                if( pxTlsTransportParams->xTCPSocket != SOCKETS_INVALID_SOCKET )
-                {
-                    ( void ) Sockets_Disconnect( pxTlsTransportParams->xTCPSocket );
-                    ( void ) Sockets_Close( pxTlsTransportParams->xTCPSocket );
-                }
-            }
-        }
+    /* Clean up on failure. */
+    if( ( xRetVal != eTLSTransportSuccess ) &&
+        ( xRetVal != eTLSTransportInProgress ) &&
+        ( xRetVal != eTLSTransportInvalidParameter ) )
+    {
+        connectAbort( pxNetworkContext );
     }
 
     return xRetVal;
@@ -800,7 +2370,9 @@ void TLS_Socket_Disconnect( NetworkContext_t * pxNetworkContext )
     pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
 
     /* Attempting to terminate TLS connection. */
+    arenaEnter( pxSSLContext );
     lMbedtlsError = mbedtls_ssl_close_notify( &( pxSSLContext->context ) );
+    arenaLeave( pxSSLContext );
 
     /* Ignore the WANT_READ and WANT_WRITE return values. */
     if( ( lMbedtlsError != MBEDTLS_ERR_SSL_WANT_READ ) &&
@@ -828,16 +2400,18 @@ void TLS_Socket_Disconnect( NetworkContext_t * pxNetworkContext )
                    pxNetworkContext ) );
     }
 
-    /* Call socket shutdown function to close connection. */
-    Sockets_Disconnect( pxTlsTransportParams->xTCPSocket );
-    Sockets_Close( pxTlsTransportParams->xTCPSocket );
+    /* Shut the connection down, and let the socket wait for the server to
+     * close in the background, so a reconnect can start at once. */
+    ( void ) Sockets_CloseAsync( pxTlsTransportParams->xTCPSocket );
 
     /* Free mbed TLS contexts. */
     sslContextFree( pxSSLContext );
-    vPortFree( pxSSLContext );
+    contextFree( pxSSLContext );
+    pxTlsTransportParams->xSSLContext = NULL;
 
-    /* Clear the mutex functions for mbed TLS thread safety. */
-    mbedtls_threading_free_alt();
+    /* Dropping the connection's runtime reference removes the mbed TLS mutex
+     * functions only once no other connection, application reference or the
+     * shared random number generator is using them. */
 }
 /*-----------------------------------------------------------*/
 
@@ -857,9 +2431,10 @@ int32_t TLS_Socket_Recv( NetworkContext_t * pxNetworkContext,
     configASSERT( pxTlsTransportParams->xSSLContext != NULL );
 
     pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
-    lMbedtlsError = ( int32_t ) mbedtls_ssl_read( &( pxSSLContext->context ),
-                                                  pvBuffer,
-                                                  xBytesToRecv );
+    configASSERT( pxSSLContext->xBorrowed == 0U );
+
+    pxSSLContext->xRecvStats.ulRecvCalls++;
+    lMbedtlsError = sslReadBuffered( pxSSLContext, pvBuffer, xBytesToRecv );
 
     if( ( lMbedtlsError == MBEDTLS_ERR_SSL_TIMEOUT ) ||
         ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
@@ -889,6 +2464,189 @@ int32_t TLS_Socket_Recv( NetworkContext_t * pxNetworkContext,
 }
 /*-----------------------------------------------------------*/
 
+int32_t TLS_Socket_RecvBorrow( NetworkContext_t * pxNetworkContext,
+                               const uint8_t ** ppucData )
+{
+    int32_t lMbedtlsError = 0;
+    MbedSSLContext_t * pxSSLContext;
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+    BaseType_t xNewRecord;
+    uint8_t ucNone = 0;
+
+    configASSERT( ( pxNetworkContext != NULL ) &&
+                  ( pxNetworkContext->pParams != NULL ) );
+    configASSERT( ppucData != NULL );
+
+    pxTlsTransportParams = ( TlsTransportParams_t * ) pxNetworkContext->pParams;
+
+    configASSERT( pxTlsTransportParams->xSSLContext != NULL );
+
+    pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+    configASSERT( pxSSLContext->xBorrowed == 0U );
+
+    *ppucData = NULL;
+
+    if( pxSSLContext->xReadAheadStart < pxSSLContext->xReadAheadEnd )
+    {
+        /* Lend what a previous TLS_Socket_Recv already copied out. */
+        pxSSLContext->xRecvStats.ulReadAheadHits++;
+        *ppucData = pxSSLContext->pucReadAhead + pxSSLContext->xReadAheadStart;
+        pxSSLContext->xBorrowed = pxSSLContext->xReadAheadEnd - pxSSLContext->xReadAheadStart;
+        pxSSLContext->xBorrowedReadAhead = pdTRUE;
+    }
+    else
+    {
+        xNewRecord = ( mbedtls_ssl_get_bytes_avail( &( pxSSLContext->context ) ) == 0U ) ? pdTRUE : pdFALSE;
+
+        #if ( transporttlsBORROW_IN_PLACE == 1 )
+            if( xNewRecord == pdTRUE )
+            {
+                /* A read of nothing decrypts the next record in place, and
+                 * leaves all of it unread. mbed TLS handles alerts,
+                 * close_notify and handshake messages before returning, and
+                 * only resizes its buffers during a handshake, which cannot
+                 * start while application data is unread. */
+                pxSSLContext->xRecvStats.ulSslReads++;
+                arenaEnter( pxSSLContext );
+                lMbedtlsError = ( int32_t ) mbedtls_ssl_read( &( pxSSLContext->context ), &ucNone, 0 );
+                arenaLeave( pxSSLContext );
+            }
+
+            if( ( lMbedtlsError == 0 ) &&
+                ( mbedtls_ssl_get_bytes_avail( &( pxSSLContext->context ) ) > 0U ) )
+            {
+                if( xNewRecord == pdTRUE )
+                {
+                    pxSSLContext->xRecvStats.ulRecords++;
+                }
+
+                *ppucData = pxSSLContext->context.in_offt;
+                pxSSLContext->xBorrowed = mbedtls_ssl_get_bytes_avail( &( pxSSLContext->context ) );
+                pxSSLContext->xBorrowedReadAhead = pdFALSE;
+            }
+        #else /* if ( transporttlsBORROW_IN_PLACE == 1 ) */
+            ( void ) ucNone;
+
+            if( ( pxSSLContext->pucReadAhead == NULL ) && ( transporttlsREAD_AHEAD_SIZE > 0U ) )
+            {
+                pxSSLContext->pucReadAhead = bufferAlloc( pxSSLContext, eTlsBufferReadAhead );
+            }
+
+            if( pxSSLContext->pucReadAhead == NULL )
+            {
+                lMbedtlsError = MBEDTLS_ERR_SSL_ALLOC_FAILED;
+            }
+            else
+            {
+                /* Copy the data out with mbedtls_ssl_read, then lend the copy. */
+                pxSSLContext->xRecvStats.ulSslReads++;
+                arenaEnter( pxSSLContext );
+                lMbedtlsError = ( int32_t ) mbedtls_ssl_read( &( pxSSLContext->context ),
+                                                              pxSSLContext->pucReadAhead,
+                                                              transporttlsREAD_AHEAD_SIZE );
+                arenaLeave( pxSSLContext );
+
+                if( lMbedtlsError > 0 )
+                {
+                    if( xNewRecord == pdTRUE )
+                    {
+                        pxSSLContext->xRecvStats.ulRecords++;
+                    }
+
+                    pxSSLContext->xRecvStats.ullBytesCopied += ( uint64_t ) lMbedtlsError;
+                    pxSSLContext->xReadAheadStart = 0;
+                    pxSSLContext->xReadAheadEnd = ( size_t ) lMbedtlsError;
+                    *ppucData = pxSSLContext->pucReadAhead;
+                    pxSSLContext->xBorrowed = ( size_t ) lMbedtlsError;
+                    pxSSLContext->xBorrowedReadAhead = pdTRUE;
+                    lMbedtlsError = 0;
+                }
+            }
+        #endif /* if ( transporttlsBORROW_IN_PLACE == 1 ) */
+    }
+
+    if( pxSSLContext->xBorrowed > 0U )
+    {
+        pxSSLContext->xRecvStats.ulBorrows++;
+        lMbedtlsError = ( int32_t ) pxSSLContext->xBorrowed;
+    }
+    else if( ( lMbedtlsError == MBEDTLS_ERR_SSL_TIMEOUT ) ||
+             ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
+             ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) )
+    {
+        /* Mark these set of errors as a timeout, as TLS_Socket_Recv does. */
+        lMbedtlsError = 0;
+    }
+    else if( lMbedtlsError < 0 )
+    {
+        LogError( ( "Failed to read data: mbedTLSError[%d]= %s : %s.",
+                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+void TLS_Socket_RecvRelease( NetworkContext_t * pxNetworkContext,
+                             size_t xConsumed )
+{
+    MbedSSLContext_t * pxSSLContext;
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+
+    #if ( transporttlsBORROW_IN_PLACE == 1 )
+        mbedtls_ssl_context * pxContext;
+    #endif
+
+    configASSERT( ( pxNetworkContext != NULL ) &&
+                  ( pxNetworkContext->pParams != NULL ) );
+
+    pxTlsTransportParams = ( TlsTransportParams_t * ) pxNetworkContext->pParams;
+
+    configASSERT( pxTlsTransportParams->xSSLContext != NULL );
+
+    pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+    configASSERT( xConsumed <= pxSSLContext->xBorrowed );
+
+    if( pxSSLContext->xBorrowedReadAhead == pdTRUE )
+    {
+        pxSSLContext->xReadAheadStart += xConsumed;
+    }
+
+    #if ( transporttlsBORROW_IN_PLACE == 1 )
+        else if( xConsumed > 0U )
+        {
+            /* Consume the record the way the end of mbedtls_ssl_read does in
+             * mbed TLS 2.x, minus the copy. */
+            pxContext = &( pxSSLContext->context );
+            mbedtls_platform_zeroize( pxContext->in_offt, xConsumed );
+            pxContext->in_msglen -= xConsumed;
+
+            if( pxContext->in_msglen == 0U )
+            {
+                pxContext->in_offt = NULL;
+                pxContext->keep_current_message = 0;
+            }
+            else
+            {
+                pxContext->in_offt += xConsumed;
+            }
+        }
+    #endif /* if ( transporttlsBORROW_IN_PLACE == 1 ) */
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    pxSSLContext->xRecvStats.ullBytesReceived += ( uint64_t ) xConsumed;
+    pxSSLContext->xBorrowed = 0;
+}
+/*-----------------------------------------------------------*/
+
 int32_t TLS_Socket_Send( NetworkContext_t * pxNetworkContext,
                          const void * pvBuffer,
                          size_t xBytesToSend )
@@ -905,9 +2663,8 @@ int32_t TLS_Socket_Send( NetworkContext_t * pxNetworkContext,
     configASSERT( pxTlsTransportParams->xSSLContext != NULL );
 
     pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
-    lMbedtlsError = ( int32_t ) mbedtls_ssl_write( &( pxSSLContext->context ),
-                                                   pvBuffer,
-                                                   xBytesToSend );
+    pxSSLContext->xSendStats.ulSendCalls++;
+    lMbedtlsError = sslWriteRecord( pxSSLContext, pvBuffer, xBytesToSend );
 
     if( ( lMbedtlsError == MBEDTLS_ERR_SSL_TIMEOUT ) ||
         ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
@@ -936,3 +2693,130 @@ int32_t TLS_Socket_Send( NetworkContext_t * pxNetworkContext,
     return lMbedtlsError;
 }
 /*-----------------------------------------------------------*/
+
+void TLS_Socket_GetRecvStats( NetworkContext_t * pxNetworkContext,
+                              TlsTransportRecvStats_t * pxStats )
+{
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+
+    configASSERT( ( pxNetworkContext != NULL ) &&
+                  ( pxNetworkContext->pParams != NULL ) &&
+                  ( pxStats != NULL ) );
+
+    pxTlsTransportParams = ( TlsTransportParams_t * ) pxNetworkContext->pParams;
+
+    if( pxTlsTransportParams->xSSLContext != NULL )
+    {
+        *pxStats = ( ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext )->xRecvStats;
+    }
+    else
+    {
+        ( void ) memset( pxStats, 0, sizeof( *pxStats ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void TLS_Socket_GetSendStats( NetworkContext_t * pxNetworkContext,
+                              TlsTransportSendStats_t * pxStats )
+{
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+
+    configASSERT( ( pxNetworkContext != NULL ) &&
+                  ( pxNetworkContext->pParams != NULL ) &&
+                  ( pxStats != NULL ) );
+
+    pxTlsTransportParams = ( TlsTransportParams_t * ) pxNetworkContext->pParams;
+
+    if( pxTlsTransportParams->xSSLContext != NULL )
+    {
+        *pxStats = ( ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext )->xSendStats;
+    }
+    else
+    {
+        ( void ) memset( pxStats, 0, sizeof( *pxStats ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void TLS_Socket_GetConnectStats( NetworkContext_t * pxNetworkContext,
+                                 TlsTransportConnectStats_t * pxStats )
+{
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+
+    configASSERT( ( pxNetworkContext != NULL ) &&
+                  ( pxNetworkContext->pParams != NULL ) &&
+                  ( pxStats != NULL ) );
+
+    pxTlsTransportParams = ( TlsTransportParams_t * ) pxNetworkContext->pParams;
+
+    if( pxTlsTransportParams->xSSLContext != NULL )
+    {
+        *pxStats = ( ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext )->xConnectStats;
+    }
+    else
+    {
+        ( void ) memset( pxStats, 0, sizeof( *pxStats ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_Socket_RuntimeInit( void )
+{
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+
+    /* Install the mutex functions for mbed TLS thread safety, if this is the
+     * first user. */
+    mbedtls_platform_threading_acquire();
+
+    /* Seed the shared random number generator, if not done already. */
+    if( Crypto_Init() != 0 )
+    {
+        LogError( ( "Failed to seed PRNG." ) );
+        mbedtls_platform_threading_release();
+        xRetVal = eTLSTransportInternalError;
+    }
+    else
+    {
+        taskENTER_CRITICAL();
+        ulRuntimeRefs++;
+        taskEXIT_CRITICAL();
+
+        /* Apply the default budget once; connects must not reset a value set
+         * with TLS_Socket_SetEcpMaxOps. */
+        if( xEcpMaxOpsApplied == pdFALSE )
+        {
+            TLS_Socket_SetEcpMaxOps( ulEcpMaxOps );
+        }
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+void TLS_Socket_RuntimeDeinit( void )
+{
+    taskENTER_CRITICAL();
+    configASSERT( ulRuntimeRefs > 0 );
+    ulRuntimeRefs--;
+    taskEXIT_CRITICAL();
+
+    mbedtls_platform_threading_release();
+}
+/*-----------------------------------------------------------*/
+
+uint32_t TLS_Socket_RuntimeRefs( void )
+{
+    return ulRuntimeRefs;
+}
+/*-----------------------------------------------------------*/
+
+void TLS_Socket_SetEcpMaxOps( uint32_t ulMaxOps )
+{
+    ulEcpMaxOps = ulMaxOps;
+    xEcpMaxOpsApplied = pdTRUE;
+
+    #ifdef MBEDTLS_ECP_RESTARTABLE
+        mbedtls_ecp_set_max_ops( ( unsigned ) ulMaxOps );
+    #endif
+}
+/*-----------------------------------------------------------*/
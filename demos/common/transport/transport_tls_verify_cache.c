@@ -0,0 +1,387 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file transport_tls_verify_cache.c
+ * @brief Cache of verified server certificate chains. Entries keep only a
+ * fingerprint, so they own no mbedTLS allocations between connections.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the verification cache. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "TlsVerifyCache"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_ERROR
+#endif
+
+/* Prototype for the function used to print to console on Windows simulator
+ * of FreeRTOS.
+ * The function prints to the console before the network is connected;
+ * then a UDP port after the network has connected. */
+extern void vLoggingPrintf( const char * pcFormatString,
+                            ... );
+
+/* Map the SdkLog macro to the logging function to enable logging
+ * on Windows simulator. */
+#ifndef SdkLog
+    #define SdkLog( message )    vLoggingPrintf message
+#endif
+
+#include "logging_stack.h"
+
+/************ End of logging configuration ****************/
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+/* Socket wrapper include, for the host name length. */
+#include "sockets_wrapper.h"
+
+#include "transport_tls_verify_cache.h"
+
+/* mbedTLS includes. */
+#include "mbedtls/sha256.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Length of a chain fingerprint.
+ */
+#define verifycacheFINGERPRINT_LENGTH    ( 32U )
+
+/**
+ * @brief A verified chain for one host.
+ */
+typedef struct TlsVerifyCacheEntry
+{
+    char cHostName[ SOCKETS_MAX_HOST_NAME_LENGTH + 1 ];     /**< Host name the chain was verified for, empty if the entry is free. */
+    uint8_t ucFingerprint[ verifycacheFINGERPRINT_LENGTH ]; /**< Fingerprint of the root CAs and the chain. */
+    TickType_t xStoredTime;                                 /**< Tick count when the chain was verified. */
+} TlsVerifyCacheEntry_t;
+
+/* The extra entry keeps the array valid when the cache is configured to 0
+ * entries; it is never used. */
+static TlsVerifyCacheEntry_t xVerifyCache[ transporttlsVERIFY_CACHE_ENTRIES + 1 ];
+static TlsVerifyCacheStats_t xVerifyCacheStats;
+static uint64_t ullFullVerifyTicksTotal;
+static BaseType_t xVerifyCacheEnabled = ( transporttlsVERIFY_CACHE_ENTRIES > 0 ) ? pdTRUE : pdFALSE;
+
+static SemaphoreHandle_t xVerifyCacheMutex = NULL;
+static StaticSemaphore_t xVerifyCacheMutexStorage;
+
+/*-----------------------------------------------------------*/
+
+static void prvVerifyCacheLock( void )
+{
+    if( xVerifyCacheMutex == NULL )
+    {
+        vTaskSuspendAll();
+        {
+            if( xVerifyCacheMutex == NULL )
+            {
+                xVerifyCacheMutex = xSemaphoreCreateMutexStatic( &xVerifyCacheMutexStorage );
+            }
+        }
+        ( void ) xTaskResumeAll();
+    }
+
+    ( void ) xSemaphoreTake( xVerifyCacheMutex, portMAX_DELAY );
+}
+/*-----------------------------------------------------------*/
+
+static void prvVerifyCacheUnlock( void )
+{
+    ( void ) xSemaphoreGive( xVerifyCacheMutex );
+}
+/*-----------------------------------------------------------*/
+
+static void prvFreeEntry( TlsVerifyCacheEntry_t * pxEntry )
+{
+    memset( pxEntry, 0, sizeof( TlsVerifyCacheEntry_t ) );
+}
+/*-----------------------------------------------------------*/
+
+static TlsVerifyCacheEntry_t * prvFindEntry( const char * pcHostName )
+{
+    TlsVerifyCacheEntry_t * pxEntry = NULL;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < transporttlsVERIFY_CACHE_ENTRIES; ulIndex++ )
+    {
+        if( ( xVerifyCache[ ulIndex ].cHostName[ 0 ] != '\0' ) &&
+            ( strncmp( xVerifyCache[ ulIndex ].cHostName, pcHostName,
+                       SOCKETS_MAX_HOST_NAME_LENGTH ) == 0 ) )
+        {
+            pxEntry = &xVerifyCache[ ulIndex ];
+            break;
+        }
+    }
+
+    return pxEntry;
+}
+/*-----------------------------------------------------------*/
+
+static TlsVerifyCacheEntry_t * prvGetEntryForStore( const char * pcHostName )
+{
+    TlsVerifyCacheEntry_t * pxEntry = prvFindEntry( pcHostName );
+    uint32_t ulIndex;
+
+    /* Prefer a free slot, otherwise evict the oldest verification. */
+    for( ulIndex = 0; ( pxEntry == NULL ) && ( ulIndex < transporttlsVERIFY_CACHE_ENTRIES ); ulIndex++ )
+    {
+        if( xVerifyCache[ ulIndex ].cHostName[ 0 ] == '\0' )
+        {
+            pxEntry = &xVerifyCache[ ulIndex ];
+        }
+    }
+
+    if( pxEntry == NULL )
+    {
+        pxEntry = &xVerifyCache[ 0 ];
+
+        for( ulIndex = 1; ulIndex < transporttlsVERIFY_CACHE_ENTRIES; ulIndex++ )
+        {
+            if( ( xTaskGetTickCount() - xVerifyCache[ ulIndex ].xStoredTime ) >
+                ( xTaskGetTickCount() - pxEntry->xStoredTime ) )
+            {
+                pxEntry = &xVerifyCache[ ulIndex ];
+            }
+        }
+    }
+
+    return pxEntry;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvHashCertificates( mbedtls_sha256_context * pxSha256,
+                                    const mbedtls_x509_crt * pxCertificate )
+{
+    int32_t lMbedtlsError = 0;
+
+    for( ; ( pxCertificate != NULL ) && ( lMbedtlsError == 0 ); pxCertificate = pxCertificate->next )
+    {
+        if( pxCertificate->raw.p != NULL )
+        {
+            lMbedtlsError = mbedtls_sha256_update_ret( pxSha256, pxCertificate->raw.p,
+                                                       pxCertificate->raw.len );
+        }
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvChainWithinValidity( const mbedtls_x509_crt * pxChain )
+{
+    BaseType_t xValid = pdTRUE;
+
+    /* mbedTLS reports both as false when built without a time source, as its
+     * own verification does. */
+    for( ; ( pxChain != NULL ) && ( xValid == pdTRUE ); pxChain = pxChain->next )
+    {
+        if( ( mbedtls_x509_time_is_past( &( pxChain->valid_to ) ) != 0 ) ||
+            ( mbedtls_x509_time_is_future( &( pxChain->valid_from ) ) != 0 ) )
+        {
+            xValid = pdFALSE;
+        }
+    }
+
+    return xValid;
+}
+/*-----------------------------------------------------------*/
+
+int32_t TLS_VerifyCache_Fingerprint( const mbedtls_x509_crt * pxChain,
+                                     const mbedtls_x509_crt * pxRootCa,
+                                     uint8_t * pucFingerprint )
+{
+    mbedtls_sha256_context xSha256;
+    /* A certificate never starts with this byte, so it keeps the root CAs and
+     * the chain apart. */
+    const uint8_t ucSeparator = 0x00;
+    int32_t lMbedtlsError;
+
+    configASSERT( pxChain != NULL );
+    configASSERT( pucFingerprint != NULL );
+
+    mbedtls_sha256_init( &xSha256 );
+
+    lMbedtlsError = mbedtls_sha256_starts_ret( &xSha256, 0 );
+
+    if( lMbedtlsError == 0 )
+    {
+        lMbedtlsError = prvHashCertificates( &xSha256, pxRootCa );
+    }
+
+    if( lMbedtlsError == 0 )
+    {
+        lMbedtlsError = mbedtls_sha256_update_ret( &xSha256, &ucSeparator, sizeof( ucSeparator ) );
+    }
+
+    if( lMbedtlsError == 0 )
+    {
+        lMbedtlsError = prvHashCertificates( &xSha256, pxChain );
+    }
+
+    if( lMbedtlsError == 0 )
+    {
+        lMbedtlsError = mbedtls_sha256_finish_ret( &xSha256, pucFingerprint );
+    }
+
+    mbedtls_sha256_free( &xSha256 );
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_VerifyCache_Check( const char * pcHostName,
+                                  const uint8_t * pucFingerprint,
+                                  const mbedtls_x509_crt * pxChain )
+{
+    BaseType_t xAccepted = pdFALSE;
+    TlsVerifyCacheEntry_t * pxEntry;
+
+    configASSERT( pcHostName != NULL );
+    configASSERT( pucFingerprint != NULL );
+
+    prvVerifyCacheLock();
+
+    if( xVerifyCacheEnabled == pdFALSE )
+    {
+        /* Not counted as misses. */
+    }
+    else if( ( pxEntry = prvFindEntry( pcHostName ) ) == NULL )
+    {
+        xVerifyCacheStats.ulMisses++;
+    }
+    else if( memcmp( pxEntry->ucFingerprint, pucFingerprint, verifycacheFINGERPRINT_LENGTH ) != 0 )
+    {
+        LogInfo( ( "Certificate chain of %s changed.", pcHostName ) );
+        prvFreeEntry( pxEntry );
+        xVerifyCacheStats.ulMismatches++;
+        xVerifyCacheStats.ulMisses++;
+    }
+    else if( ( ( xTaskGetTickCount() - pxEntry->xStoredTime ) >= pdMS_TO_TICKS( transporttlsVERIFY_CACHE_TTL_MS ) ) ||
+             ( prvChainWithinValidity( pxChain ) == pdFALSE ) )
+    {
+        LogInfo( ( "Cached verification for %s expired.", pcHostName ) );
+        prvFreeEntry( pxEntry );
+        xVerifyCacheStats.ulExpired++;
+        xVerifyCacheStats.ulMisses++;
+    }
+    else
+    {
+        xVerifyCacheStats.ulHits++;
+        xVerifyCacheStats.ullTicksSaved += xVerifyCacheStats.xAvgFullVerify;
+        xAccepted = pdTRUE;
+    }
+
+    prvVerifyCacheUnlock();
+
+    return xAccepted;
+}
+/*-----------------------------------------------------------*/
+
+void TLS_VerifyCache_Store( const char * pcHostName,
+                            const uint8_t * pucFingerprint,
+                            TickType_t xVerifyTicks )
+{
+    TlsVerifyCacheEntry_t * pxEntry;
+
+    configASSERT( pcHostName != NULL );
+    configASSERT( pucFingerprint != NULL );
+
+    prvVerifyCacheLock();
+
+    xVerifyCacheStats.ulFullVerifications++;
+    ullFullVerifyTicksTotal += xVerifyTicks;
+    xVerifyCacheStats.xAvgFullVerify =
+        ( TickType_t ) ( ullFullVerifyTicksTotal / xVerifyCacheStats.ulFullVerifications );
+
+    if( ( xVerifyCacheEnabled == pdTRUE ) &&
+        ( strlen( pcHostName ) <= SOCKETS_MAX_HOST_NAME_LENGTH ) )
+    {
+        pxEntry = prvGetEntryForStore( pcHostName );
+        prvFreeEntry( pxEntry );
+
+        ( void ) strcpy( pxEntry->cHostName, pcHostName );
+        ( void ) memcpy( pxEntry->ucFingerprint, pucFingerprint, verifycacheFINGERPRINT_LENGTH );
+        pxEntry->xStoredTime = xTaskGetTickCount();
+        xVerifyCacheStats.ulStores++;
+
+        LogInfo( ( "Cached verified certificate chain of %s.", pcHostName ) );
+    }
+
+    prvVerifyCacheUnlock();
+}
+/*-----------------------------------------------------------*/
+
+void TLS_VerifyCache_Invalidate( const char * pcHostName )
+{
+    TlsVerifyCacheEntry_t * pxEntry;
+
+    configASSERT( pcHostName != NULL );
+
+    prvVerifyCacheLock();
+
+    if( ( pxEntry = prvFindEntry( pcHostName ) ) != NULL )
+    {
+        prvFreeEntry( pxEntry );
+        xVerifyCacheStats.ulInvalidations++;
+    }
+
+    prvVerifyCacheUnlock();
+}
+/*-----------------------------------------------------------*/
+
+void TLS_VerifyCache_Clear( void )
+{
+    uint32_t ulIndex;
+
+    prvVerifyCacheLock();
+
+    for( ulIndex = 0; ulIndex < transporttlsVERIFY_CACHE_ENTRIES; ulIndex++ )
+    {
+        prvFreeEntry( &xVerifyCache[ ulIndex ] );
+    }
+
+    prvVerifyCacheUnlock();
+}
+/*-----------------------------------------------------------*/
+
+void TLS_VerifyCache_SetEnabled( BaseType_t xEnabled )
+{
+    if( xEnabled == pdFALSE )
+    {
+        TLS_VerifyCache_Clear();
+    }
+
+    prvVerifyCacheLock();
+    xVerifyCacheEnabled = ( ( xEnabled == pdTRUE ) && ( transporttlsVERIFY_CACHE_ENTRIES > 0 ) ) ? pdTRUE : pdFALSE;
+    prvVerifyCacheUnlock();
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t TLS_VerifyCache_IsEnabled( void )
+{
+    return xVerifyCacheEnabled;
+}
+/*-----------------------------------------------------------*/
+
+void TLS_VerifyCache_GetStats( TlsVerifyCacheStats_t * pxStats )
+{
+    configASSERT( pxStats != NULL );
+
+    prvVerifyCacheLock();
+    *pxStats = xVerifyCacheStats;
+    prvVerifyCacheUnlock();
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,137 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file transport_tls_verify_cache.h
+ * @brief Cache of server certificate chains verified by the mbedTLS transport.
+ *
+ * After a chain is verified against the root CAs, a SHA-256 fingerprint of the
+ * root CAs and of the chain is kept per host name. When the same host presents
+ * a byte-identical chain again, the transport skips the signature checks of the
+ * chain and only checks that no certificate in it has expired. The host name
+ * check needs no repeating, as the entry only matches the host the chain was
+ * verified for.
+ *
+ * The transport uses the cache when built with TRANSPORT_TLS_VERIFY_CACHE.
+ */
+
+#ifndef TRANSPORT_TLS_VERIFY_CACHE_H
+#define TRANSPORT_TLS_VERIFY_CACHE_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include "mbedtls/x509_crt.h"
+
+/**
+ * @brief Number of host entries kept in the cache. 0 disables the cache.
+ */
+#ifndef transporttlsVERIFY_CACHE_ENTRIES
+    #define transporttlsVERIFY_CACHE_ENTRIES    ( 2 )
+#endif
+
+/**
+ * @brief Maximum age of a cached verification before the chain is verified in
+ * full again.
+ *
+ * Certificate validity is checked on every use regardless.
+ */
+#ifndef transporttlsVERIFY_CACHE_TTL_MS
+    #define transporttlsVERIFY_CACHE_TTL_MS    ( 24U * 60U * 60U * 1000U )
+#endif
+
+/**
+ * @brief Verification cache counters.
+ */
+typedef struct TlsVerifyCacheStats
+{
+    uint32_t ulHits;              /**< Chains accepted without verifying their signatures. */
+    uint32_t ulMisses;            /**< Chains for which no valid verification was cached. */
+    uint32_t ulMismatches;        /**< Chains that differed from the one cached for their host. */
+    uint32_t ulExpired;           /**< Entries dropped because their TTL elapsed or a certificate expired. */
+    uint32_t ulStores;            /**< Verified chains stored. */
+    uint32_t ulInvalidations;     /**< Entries removed by TLS_VerifyCache_Invalidate. */
+    uint32_t ulFullVerifications; /**< Number of full chain verifications timed. */
+    TickType_t xAvgFullVerify;    /**< Average duration of a full chain verification, in ticks. */
+    uint64_t ullTicksSaved;       /**< Verification time saved by the cache, in ticks. */
+} TlsVerifyCacheStats_t;
+
+/**
+ * @brief Compute the fingerprint of a server certificate chain and the root
+ * CAs it is verified against.
+ *
+ * @param[in] pxChain Certificate chain presented by the server.
+ * @param[in] pxRootCa Root CAs the chain is verified against.
+ * @param[out] pucFingerprint Where the 32 byte SHA-256 fingerprint is written.
+ *
+ * @return 0 on success; otherwise, an mbedTLS error code.
+ */
+int32_t TLS_VerifyCache_Fingerprint( const mbedtls_x509_crt * pxChain,
+                                     const mbedtls_x509_crt * pxRootCa,
+                                     uint8_t * pucFingerprint );
+
+/**
+ * @brief Check whether a chain with this fingerprint was verified for the host.
+ *
+ * The entry must be within its TTL, and every certificate of the chain within
+ * its validity period.
+ *
+ * @param[in] pcHostName Host name the chain is presented for.
+ * @param[in] pucFingerprint Fingerprint from TLS_VerifyCache_Fingerprint.
+ * @param[in] pxChain The chain the fingerprint was computed for.
+ *
+ * @return pdTRUE if the chain can be accepted without verifying it again;
+ * otherwise, pdFALSE.
+ */
+BaseType_t TLS_VerifyCache_Check( const char * pcHostName,
+                                  const uint8_t * pucFingerprint,
+                                  const mbedtls_x509_crt * pxChain );
+
+/**
+ * @brief Record a chain that passed full verification for the host.
+ *
+ * @param[in] pcHostName Host name the chain was verified for.
+ * @param[in] pucFingerprint Fingerprint from TLS_VerifyCache_Fingerprint.
+ * @param[in] xVerifyTicks Duration of the verification, in ticks.
+ */
+void TLS_VerifyCache_Store( const char * pcHostName,
+                            const uint8_t * pucFingerprint,
+                            TickType_t xVerifyTicks );
+
+/**
+ * @brief Drop the cached verification for a host.
+ *
+ * @param[in] pcHostName Host name.
+ */
+void TLS_VerifyCache_Invalidate( const char * pcHostName );
+
+/**
+ * @brief Drop all cached verifications. Counters are kept.
+ */
+void TLS_VerifyCache_Clear( void );
+
+/**
+ * @brief Turn the cache on or off at run time. It is on by default.
+ *
+ * Turning it off drops all entries; every chain is then verified in full.
+ *
+ * @param[in] xEnabled pdTRUE to use the cache, pdFALSE not to.
+ */
+void TLS_VerifyCache_SetEnabled( BaseType_t xEnabled );
+
+/**
+ * @brief Whether the cache is in use.
+ *
+ * @return pdTRUE if the cache is built in and turned on; otherwise, pdFALSE.
+ */
+BaseType_t TLS_VerifyCache_IsEnabled( void );
+
+/**
+ * @brief Get a copy of the verification cache counters.
+ *
+ * @param[out] pxStats Where the counters are copied.
+ */
+void TLS_VerifyCache_GetStats( TlsVerifyCacheStats_t * pxStats );
+
+#endif /* TRANSPORT_TLS_VERIFY_CACHE_H */
@@ -1,15 +1,53 @@
 /* Copyright (c) Microsoft Corporation.
  * Licensed under the MIT License. */
 
+#ifndef AZURE_SAMPLE_CRYPTO_H
+#define AZURE_SAMPLE_CRYPTO_H
+
+#include <stddef.h>
 #include <stdint.h>
 
 /**
  * @brief Initialize crypto
  *
+ * Seeds the process-wide random number generator used by #Crypto_Random.
+ *
  * @return An #uint32_t with result of operation.
  */
 uint32_t Crypto_Init();
 
+/**
+ * @brief Generate random bytes from the process-wide CTR-DRBG.
+ *
+ * The generator is seeded once, by #Crypto_Init or on first use, and then
+ * reseeded by policy, so callers do not pay for seeding. The signature matches
+ * the mbed TLS f_rng callback; pass NULL as its context.
+ *
+ * @param[in] pvContext Unused.
+ * @param[out] pucOutput Buffer to fill.
+ * @param[in] xOutputLength Number of bytes to generate.
+ * @return 0 on success; otherwise, an mbed TLS error code.
+ */
+int Crypto_Random( void * pvContext,
+                   unsigned char * pucOutput,
+                   size_t xOutputLength );
+
+/**
+ * @brief Reseed the process-wide CTR-DRBG from the platform entropy source now.
+ *
+ * @return An #uint32_t with result of operation.
+ */
+uint32_t Crypto_Reseed();
+
+/**
+ * @brief Free the process-wide CTR-DRBG.
+ *
+ * The generator is seeded again on its next use.
+ *
+ * @return An #uint32_t with result of operation.
+ */
+uint32_t Crypto_Deinit();
+
 /**
  * @brief Compute HMAC SHA256
  *
@@ -29,3 +67,5 @@ uint32_t Crypto_HMAC( const uint8_t * pucKey,
                       uint8_t * pucOutput,
                       uint32_t ulOutputLength,
                       uint32_t * pulBytesCopied );
+
+#endif /* AZURE_SAMPLE_CRYPTO_H */
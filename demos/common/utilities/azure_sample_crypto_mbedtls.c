@@ -3,21 +3,215 @@
 
 #include "azure_sample_crypto.h"
 
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
 #include "threading_alt.h"
+#include "mbedtls_freertos_port.h"
 
 /* mbed TLS includes. */
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
 #include "mbedtls/md.h"
 #include "mbedtls/threading.h"
 
+/**
+ * @brief Number of CTR-DRBG requests after which it reseeds itself.
+ */
+#ifndef samplecryptoDRBG_RESEED_INTERVAL
+    #define samplecryptoDRBG_RESEED_INTERVAL    MBEDTLS_CTR_DRBG_RESEED_INTERVAL
+#endif
+
+/**
+ * @brief Time after which the CTR-DRBG is reseeded on its next use. 0 disables.
+ */
+#ifndef samplecryptoDRBG_RESEED_PERIOD_MS
+    #define samplecryptoDRBG_RESEED_PERIOD_MS    ( 24U * 60U * 60U * 1000U )
+#endif
+
+#define samplecryptoDRBG_RESEED_PERIOD_TICKS \
+    ( ( TickType_t ) ( ( ( uint64_t ) samplecryptoDRBG_RESEED_PERIOD_MS * configTICK_RATE_HZ ) / 1000U ) )
+
+/**
+ * @brief Personalization string mixed into the CTR-DRBG seed.
+ */
+#define samplecryptoDRBG_PERSONALIZATION    "azure_sample_crypto"
+
+/*-----------------------------------------------------------*/
+
+static mbedtls_entropy_context xEntropyContext;
+static mbedtls_ctr_drbg_context xCtrDrbgContext;
+static BaseType_t xCtrDrbgSeeded = pdFALSE;
+static TickType_t xCtrDrbgSeedTime;
+
+static SemaphoreHandle_t xCtrDrbgMutex = NULL;
+static StaticSemaphore_t xCtrDrbgMutexStorage;
+
+/*-----------------------------------------------------------*/
+
+static void prvCtrDrbgLock( void )
+{
+    if( xCtrDrbgMutex == NULL )
+    {
+        vTaskSuspendAll();
+        {
+            if( xCtrDrbgMutex == NULL )
+            {
+                xCtrDrbgMutex = xSemaphoreCreateMutexStatic( &xCtrDrbgMutexStorage );
+            }
+        }
+        ( void ) xTaskResumeAll();
+    }
+
+    ( void ) xSemaphoreTake( xCtrDrbgMutex, portMAX_DELAY );
+}
+/*-----------------------------------------------------------*/
+
+static void prvCtrDrbgUnlock( void )
+{
+    ( void ) xSemaphoreGive( xCtrDrbgMutex );
+}
+/*-----------------------------------------------------------*/
+
+/* Must be called with the DRBG lock held. */
+static int prvCtrDrbgSeed( void )
+{
+    int lMbedtlsError;
+
+    /* The DRBG contexts hold mbed TLS mutexes, so keep the mutex functions
+     * installed for as long as they are seeded. */
+    mbedtls_platform_threading_acquire();
+
+    mbedtls_entropy_init( &xEntropyContext );
+    mbedtls_ctr_drbg_init( &xCtrDrbgContext );
+
+    lMbedtlsError = mbedtls_entropy_add_source( &xEntropyContext,
+                                                mbedtls_platform_entropy_poll,
+                                                NULL,
+                                                32,
+                                                MBEDTLS_ENTROPY_SOURCE_STRONG );
+
+    if( lMbedtlsError == 0 )
+    {
+        lMbedtlsError = mbedtls_ctr_drbg_seed( &xCtrDrbgContext,
+                                               mbedtls_entropy_func,
+                                               &xEntropyContext,
+                                               ( const unsigned char * ) samplecryptoDRBG_PERSONALIZATION,
+                                               sizeof( samplecryptoDRBG_PERSONALIZATION ) - 1 );
+    }
+
+    if( lMbedtlsError == 0 )
+    {
+        mbedtls_ctr_drbg_set_reseed_interval( &xCtrDrbgContext,
+                                              samplecryptoDRBG_RESEED_INTERVAL );
+        xCtrDrbgSeedTime = xTaskGetTickCount();
+        xCtrDrbgSeeded = pdTRUE;
+    }
+    else
+    {
+        mbedtls_ctr_drbg_free( &xCtrDrbgContext );
+        mbedtls_entropy_free( &xEntropyContext );
+        mbedtls_platform_threading_release();
+    }
+
+    return lMbedtlsError;
+}
 /*-----------------------------------------------------------*/
 
 uint32_t Crypto_Init()
 {
-    /* Set the mutex functions for mbed TLS thread safety. */
-    mbedtls_threading_set_alt( mbedtls_platform_mutex_init,
-                               mbedtls_platform_mutex_free,
-                               mbedtls_platform_mutex_lock,
-                               mbedtls_platform_mutex_unlock );
+    uint32_t ulRet = 0;
+
+    prvCtrDrbgLock();
+
+    if( ( xCtrDrbgSeeded == pdFALSE ) &&
+        ( prvCtrDrbgSeed() != 0 ) )
+    {
+        ulRet = 1;
+    }
+
+    prvCtrDrbgUnlock();
+
+    return ulRet;
+}
+/*-----------------------------------------------------------*/
+
+int Crypto_Random( void * pvContext,
+                   unsigned char * pucOutput,
+                   size_t xOutputLength )
+{
+    int lMbedtlsError = 0;
+    size_t xChunkLength;
+
+    ( void ) pvContext;
+
+    prvCtrDrbgLock();
+
+    if( xCtrDrbgSeeded == pdFALSE )
+    {
+        lMbedtlsError = prvCtrDrbgSeed();
+    }
+    else if( ( samplecryptoDRBG_RESEED_PERIOD_MS != 0 ) &&
+             ( ( xTaskGetTickCount() - xCtrDrbgSeedTime ) >= samplecryptoDRBG_RESEED_PERIOD_TICKS ) )
+    {
+        if( ( lMbedtlsError = mbedtls_ctr_drbg_reseed( &xCtrDrbgContext, NULL, 0 ) ) == 0 )
+        {
+            xCtrDrbgSeedTime = xTaskGetTickCount();
+        }
+    }
+
+    /* A single request is limited to MBEDTLS_CTR_DRBG_MAX_REQUEST bytes. */
+    while( ( lMbedtlsError == 0 ) && ( xOutputLength > 0 ) )
+    {
+        xChunkLength = ( xOutputLength > MBEDTLS_CTR_DRBG_MAX_REQUEST ) ?
+                       MBEDTLS_CTR_DRBG_MAX_REQUEST : xOutputLength;
+        lMbedtlsError = mbedtls_ctr_drbg_random( &xCtrDrbgContext, pucOutput, xChunkLength );
+        pucOutput += xChunkLength;
+        xOutputLength -= xChunkLength;
+    }
+
+    prvCtrDrbgUnlock();
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t Crypto_Reseed()
+{
+    int lMbedtlsError;
+
+    prvCtrDrbgLock();
+
+    if( xCtrDrbgSeeded == pdFALSE )
+    {
+        lMbedtlsError = prvCtrDrbgSeed();
+    }
+    else if( ( lMbedtlsError = mbedtls_ctr_drbg_reseed( &xCtrDrbgContext, NULL, 0 ) ) == 0 )
+    {
+        xCtrDrbgSeedTime = xTaskGetTickCount();
+    }
+
+    prvCtrDrbgUnlock();
+
+    return ( lMbedtlsError == 0 ) ? 0 : 1;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t Crypto_Deinit()
+{
+    prvCtrDrbgLock();
+
+    if( xCtrDrbgSeeded == pdTRUE )
+    {
+        mbedtls_ctr_drbg_free( &xCtrDrbgContext );
+        mbedtls_entropy_free( &xEntropyContext );
+        xCtrDrbgSeeded = pdFALSE;
+        mbedtls_platform_threading_release();
+    }
+
+    prvCtrDrbgUnlock();
 
     return 0;
 }
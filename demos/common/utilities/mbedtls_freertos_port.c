@@ -11,6 +11,7 @@
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
+#include "task.h"
 
 #include "sockets_wrapper.h"
 
@@ -18,9 +19,413 @@
 #include "mbedtls_config.h"
 #include "threading_alt.h"
 #include "mbedtls/entropy.h"
+#include "mbedtls/threading.h"
 
+#include "mbedtls_freertos_port.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief References on the mbed TLS threading functions.
+ */
+static uint32_t ulThreadingUsers = 0;
+
+#if ( mbedtlsportHEAP_STATS == 1 ) || ( mbedtlsportPOOL_ALLOCATOR == 1 )
+
+/**
+ * @brief Header in front of each block, sized to keep the block aligned for
+ * any mbed TLS type.
+ */
+    typedef union HeapBlockHeader
+    {
+        struct
+        {
+            size_t xSize;          /**< Size requested by mbed TLS. */
+            uint32_t ulGeneration; /**< Value of ulHeapGeneration when allocated, 0 if not counted. */
+            #if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+                uint32_t ulClass;         /**< Size class of an arena block. */
+                MbedtlsArena_t * pxArena; /**< Arena of the block, NULL for a heap block. */
+            #endif
+        } xInfo;
+        #if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+            uint64_t ullAlign[ 3 ];
+        #else
+            uint64_t ullAlign[ 2 ];
+        #endif
+    } HeapBlockHeader_t;
+
+#endif /* ( mbedtlsportHEAP_STATS == 1 ) || ( mbedtlsportPOOL_ALLOCATOR == 1 ) */
+
+#if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+
+/**
+ * @brief Size of the blocks of an arena size class.
+ */
+    #define mbedtlsportCLASS_SIZE( ulClass )    ( ( size_t ) 16U << ( ulClass ) )
+
+/**
+ * @brief A task inside an arena scope.
+ */
+    typedef struct ActiveArena
+    {
+        TaskHandle_t xTask;       /**< Task in the scope. */
+        MbedtlsArena_t * pxArena; /**< Arena serving it, NULL for a free slot. */
+    } ActiveArena_t;
+
+/**
+ * @brief Tasks inside an arena scope.
+ */
+    static ActiveArena_t xActiveArenas[ mbedtlsportARENA_MAX_ACTIVE ];
+
+/**
+ * @brief Pool allocator counters.
+ */
+    static MbedtlsPoolStats_t xPoolStats;
+
+#endif /* mbedtlsportPOOL_ALLOCATOR == 1 */
+
+#if ( mbedtlsportHEAP_STATS == 1 )
+
+/**
+ * @brief Heap counters.
+ */
+    static MbedtlsHeapStats_t xHeapStats;
+
+/**
+ * @brief Incremented on each reset, so blocks from before it are not counted.
+ */
+    static uint32_t ulHeapGeneration = 1;
+
+/**
+ * @brief Task whose allocations are counted, or NULL for every task.
+ */
+    static TaskHandle_t xHeapStatsTask = NULL;
+
+#endif /* mbedtlsportHEAP_STATS == 1 */
+
+/*-----------------------------------------------------------*/
+
+#if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+
+/**
+ * @brief Bytes an arena block takes, without its header.
+ *
+ * @param[in] pHeader The block.
+ *
+ * @return The size of its class, or the size requested rounded up for
+ * alignment for a block larger than the classes.
+ */
+    static size_t prvArenaBlockBytes( const HeapBlockHeader_t * pHeader )
+    {
+        size_t xBytes;
+
+        if( pHeader->xInfo.ulClass < mbedtlsportARENA_CLASSES )
+        {
+            xBytes = mbedtlsportCLASS_SIZE( pHeader->xInfo.ulClass );
+        }
+        else
+        {
+            xBytes = ( pHeader->xInfo.xSize + sizeof( uint64_t ) - 1U ) & ~( sizeof( uint64_t ) - 1U );
+        }
+
+        return xBytes;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Count a block handed out by an arena, or given back to it.
+ *
+ * @param[in] pxStats Counters to update.
+ * @param[in] pHeader The block.
+ * @param[in] xAdd pdTRUE when handed out, pdFALSE when given back.
+ */
+    static void prvArenaCountBlock( MbedtlsArenaStats_t * pxStats,
+                                    const HeapBlockHeader_t * pHeader,
+                                    BaseType_t xAdd )
+    {
+        if( xAdd == pdTRUE )
+        {
+            pxStats->ulAllocations++;
+            pxStats->xInUseBytes += prvArenaBlockBytes( pHeader );
+            pxStats->xRequestedBytes += pHeader->xInfo.xSize;
+
+            if( pxStats->xInUseBytes > pxStats->xPeakInUseBytes )
+            {
+                pxStats->xPeakInUseBytes = pxStats->xInUseBytes;
+            }
+        }
+        else
+        {
+            pxStats->xInUseBytes -= prvArenaBlockBytes( pHeader );
+            pxStats->xRequestedBytes -= pHeader->xInfo.xSize;
+        }
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the arena serving the calling task, if any.
+ *
+ * @return The arena, or NULL outside an arena scope.
+ */
+    static MbedtlsArena_t * prvActiveArena( void )
+    {
+        TaskHandle_t xTask = xTaskGetCurrentTaskHandle();
+        MbedtlsArena_t * pxArena = NULL;
+        uint32_t i;
+
+        taskENTER_CRITICAL();
+        {
+            for( i = 0; ( i < mbedtlsportARENA_MAX_ACTIVE ) && ( pxArena == NULL ); i++ )
+            {
+                if( xActiveArenas[ i ].xTask == xTask )
+                {
+                    pxArena = xActiveArenas[ i ].pxArena;
+                }
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        return pxArena;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Take a block from an arena.
+ *
+ * Freed blocks of the class are reused first, then the newest chunk or the
+ * static storage is carved. An arena fed from the heap takes a new chunk when
+ * the newest one is used up.
+ *
+ * @param[in] pxArena The arena.
+ * @param[in] ulClass Size class of the block, or mbedtlsportARENA_CLASSES for
+ * a block larger than the classes, only served from static storage.
+ * @param[in] xSize Size requested by mbed TLS.
+ *
+ * @return The block, or NULL if it could not be served from the arena.
+ */
+    static HeapBlockHeader_t * prvArenaAlloc( MbedtlsArena_t * pxArena,
+                                              uint32_t ulClass,
+                                              size_t xSize )
+    {
+        size_t xBlockSize = sizeof( HeapBlockHeader_t );
+        HeapBlockHeader_t * pHeader = NULL;
+        uint8_t * pucChunk;
+
+        if( ulClass < mbedtlsportARENA_CLASSES )
+        {
+            xBlockSize += mbedtlsportCLASS_SIZE( ulClass );
+        }
+        else
+        {
+            xBlockSize += ( xSize + sizeof( uint64_t ) - 1U ) & ~( sizeof( uint64_t ) - 1U );
+        }
+
+        taskENTER_CRITICAL();
+        {
+            if( ( ulClass < mbedtlsportARENA_CLASSES ) && ( pxArena->pvFreeLists[ ulClass ] != NULL ) )
+            {
+                /* A freed block keeps the next free block in its first word. */
+                pHeader = pxArena->pvFreeLists[ ulClass ];
+                pxArena->pvFreeLists[ ulClass ] = *( ( void ** ) ( pHeader + 1 ) );
+                pxArena->xStats.ulReuses++;
+                xPoolStats.xArenas.ulReuses++;
+            }
+            else if( pxArena->xChunkFree >= xBlockSize )
+            {
+                pHeader = ( HeapBlockHeader_t * ) pxArena->pucNextBlock;
+                pxArena->pucNextBlock += xBlockSize;
+                pxArena->xChunkFree -= xBlockSize;
+
+                if( ( pxArena->pucStatic != NULL ) &&
+                    ( pxArena->xStaticSize - pxArena->xChunkFree > xPoolStats.xArenas.xPeakStaticBytes ) )
+                {
+                    xPoolStats.xArenas.xPeakStaticBytes = pxArena->xStaticSize - pxArena->xChunkFree;
+                }
+            }
+            else
+            {
+                /* Empty else marker. */
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        if( ( pHeader == NULL ) && ( pxArena->pucStatic == NULL ) )
+        {
+            /* Start a new chunk, leaving the end of the previous one unused. */
+            pucChunk = pvPortMalloc( mbedtlsportARENA_CHUNK_SIZE );
+
+            if( pucChunk != NULL )
+            {
+                taskENTER_CRITICAL();
+                {
+                    if( pxArena->pvChunks == NULL )
+                    {
+                        xPoolStats.ulActiveArenas++;
+                    }
+
+                    /* The chunk list link takes the room of a block header. */
+                    *( ( void ** ) pucChunk ) = pxArena->pvChunks;
+                    pxArena->pvChunks = pucChunk;
+                    pHeader = ( HeapBlockHeader_t * ) ( pucChunk + sizeof( HeapBlockHeader_t ) );
+                    pxArena->pucNextBlock = ( uint8_t * ) pHeader + xBlockSize;
+                    pxArena->xChunkFree = mbedtlsportARENA_CHUNK_SIZE - sizeof( HeapBlockHeader_t ) - xBlockSize;
+
+                    pxArena->xStats.ulChunks++;
+                    pxArena->xStats.xChunkBytes += mbedtlsportARENA_CHUNK_SIZE;
+                    xPoolStats.xArenas.ulChunks++;
+                    xPoolStats.xArenas.xChunkBytes += mbedtlsportARENA_CHUNK_SIZE;
+
+                    if( pxArena->xStats.xChunkBytes > pxArena->xStats.xPeakChunkBytes )
+                    {
+                        pxArena->xStats.xPeakChunkBytes = pxArena->xStats.xChunkBytes;
+                    }
+
+                    if( xPoolStats.xArenas.xChunkBytes > xPoolStats.xArenas.xPeakChunkBytes )
+                    {
+                        xPoolStats.xArenas.xPeakChunkBytes = xPoolStats.xArenas.xChunkBytes;
+                    }
+                }
+                taskEXIT_CRITICAL();
+            }
+        }
+
+        if( pHeader != NULL )
+        {
+            pHeader->xInfo.ulClass = ulClass;
+            pHeader->xInfo.pxArena = pxArena;
+        }
+
+        return pHeader;
+    }
 /*-----------------------------------------------------------*/
 
+#endif /* mbedtlsportPOOL_ALLOCATOR == 1 */
+
+#if ( mbedtlsportHEAP_STATS == 1 ) || ( mbedtlsportPOOL_ALLOCATOR == 1 )
+
+/**
+ * @brief Allocate a block with a header, from the arena of the calling task
+ * if it has one and the block fits a size class, otherwise from the heap.
+ *
+ * @param[in] xSize Size requested by mbed TLS.
+ *
+ * @return The block header, or NULL if out of memory.
+ */
+    static HeapBlockHeader_t * prvBlockAlloc( size_t xSize )
+    {
+        HeapBlockHeader_t * pHeader = NULL;
+
+        #if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+            MbedtlsArena_t * pxArena = prvActiveArena();
+            uint32_t ulClass = 0;
+
+            while( ( ulClass < mbedtlsportARENA_CLASSES ) && ( mbedtlsportCLASS_SIZE( ulClass ) < xSize ) )
+            {
+                ulClass++;
+            }
+
+            /* Only static storage takes blocks larger than the classes. */
+            if( ( pxArena != NULL ) &&
+                ( ( ulClass < mbedtlsportARENA_CLASSES ) || ( pxArena->pucStatic != NULL ) ) )
+            {
+                pHeader = prvArenaAlloc( pxArena, ulClass, xSize );
+            }
+        #endif /* mbedtlsportPOOL_ALLOCATOR == 1 */
+
+        if( ( pHeader == NULL ) && ( xSize <= ( SIZE_MAX - sizeof( HeapBlockHeader_t ) ) ) )
+        {
+            pHeader = pvPortMalloc( sizeof( HeapBlockHeader_t ) + xSize );
+
+            #if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+                if( pHeader != NULL )
+                {
+                    pHeader->xInfo.pxArena = NULL;
+                }
+            #endif
+        }
+
+        if( pHeader != NULL )
+        {
+            pHeader->xInfo.xSize = xSize;
+            pHeader->xInfo.ulGeneration = 0;
+
+            #if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+                taskENTER_CRITICAL();
+                {
+                    if( pHeader->xInfo.pxArena != NULL )
+                    {
+                        prvArenaCountBlock( &( pxArena->xStats ), pHeader, pdTRUE );
+                        prvArenaCountBlock( &( xPoolStats.xArenas ), pHeader, pdTRUE );
+                    }
+                    else
+                    {
+                        if( pxArena != NULL )
+                        {
+                            pxArena->xStats.ulHeapAllocations++;
+                            xPoolStats.xArenas.ulHeapAllocations++;
+                        }
+
+                        xPoolStats.ulHeapAllocations++;
+                        xPoolStats.xHeapBytes += xSize;
+
+                        if( xPoolStats.xHeapBytes > xPoolStats.xPeakHeapBytes )
+                        {
+                            xPoolStats.xPeakHeapBytes = xPoolStats.xHeapBytes;
+                        }
+                    }
+                }
+                taskEXIT_CRITICAL();
+            #endif /* mbedtlsportPOOL_ALLOCATOR == 1 */
+        }
+
+        return pHeader;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Free a block allocated by prvBlockAlloc.
+ *
+ * @param[in] pHeader The block header.
+ */
+    static void prvBlockFree( HeapBlockHeader_t * pHeader )
+    {
+        #if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+            MbedtlsArena_t * pxArena = pHeader->xInfo.pxArena;
+
+            if( pxArena != NULL )
+            {
+                taskENTER_CRITICAL();
+                {
+                    prvArenaCountBlock( &( pxArena->xStats ), pHeader, pdFALSE );
+                    prvArenaCountBlock( &( xPoolStats.xArenas ), pHeader, pdFALSE );
+
+                    /* A block larger than the classes waits for the release. */
+                    if( pHeader->xInfo.ulClass < mbedtlsportARENA_CLASSES )
+                    {
+                        *( ( void ** ) ( pHeader + 1 ) ) = pxArena->pvFreeLists[ pHeader->xInfo.ulClass ];
+                        pxArena->pvFreeLists[ pHeader->xInfo.ulClass ] = pHeader;
+                    }
+                }
+                taskEXIT_CRITICAL();
+            }
+            else
+            {
+                taskENTER_CRITICAL();
+                {
+                    xPoolStats.xHeapBytes -= pHeader->xInfo.xSize;
+                }
+                taskEXIT_CRITICAL();
+
+                vPortFree( pHeader );
+            }
+        #else /* if ( mbedtlsportPOOL_ALLOCATOR == 1 ) */
+            vPortFree( pHeader );
+        #endif /* mbedtlsportPOOL_ALLOCATOR == 1 */
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* ( mbedtlsportHEAP_STATS == 1 ) || ( mbedtlsportPOOL_ALLOCATOR == 1 ) */
+
 /**
  * @brief Allocates memory for an array of members.
  *
@@ -41,7 +446,35 @@ void * mbedtls_platform_calloc( size_t nmemb,
         /* Overflow check. */
         if( ( totalSize / size ) == nmemb )
         {
-            pBuffer = pvPortMalloc( totalSize );
+            #if ( mbedtlsportHEAP_STATS == 1 ) || ( mbedtlsportPOOL_ALLOCATOR == 1 )
+                HeapBlockHeader_t * pHeader = prvBlockAlloc( totalSize );
+
+                if( pHeader != NULL )
+                {
+                    #if ( mbedtlsportHEAP_STATS == 1 )
+                        taskENTER_CRITICAL();
+                        {
+                            if( ( xHeapStatsTask == NULL ) ||
+                                ( xHeapStatsTask == xTaskGetCurrentTaskHandle() ) )
+                            {
+                                pHeader->xInfo.ulGeneration = ulHeapGeneration;
+                                xHeapStats.xCurrentBytes += totalSize;
+                                xHeapStats.ulAllocations++;
+
+                                if( xHeapStats.xCurrentBytes > xHeapStats.xPeakBytes )
+                                {
+                                    xHeapStats.xPeakBytes = xHeapStats.xCurrentBytes;
+                                }
+                            }
+                        }
+                        taskEXIT_CRITICAL();
+                    #endif /* mbedtlsportHEAP_STATS == 1 */
+
+                    pBuffer = pHeader + 1;
+                }
+            #else /* if ( mbedtlsportHEAP_STATS == 1 ) || ( mbedtlsportPOOL_ALLOCATOR == 1 ) */
+                pBuffer = pvPortMalloc( totalSize );
+            #endif /* ( mbedtlsportHEAP_STATS == 1 ) || ( mbedtlsportPOOL_ALLOCATOR == 1 ) */
 
             if( pBuffer != NULL )
             {
@@ -61,7 +494,29 @@ void * mbedtls_platform_calloc( size_t nmemb,
  */
 void mbedtls_platform_free( void * ptr )
 {
-    vPortFree( ptr );
+    #if ( mbedtlsportHEAP_STATS == 1 ) || ( mbedtlsportPOOL_ALLOCATOR == 1 )
+        HeapBlockHeader_t * pHeader;
+
+        if( ptr != NULL )
+        {
+            pHeader = ( ( HeapBlockHeader_t * ) ptr ) - 1;
+
+            #if ( mbedtlsportHEAP_STATS == 1 )
+                taskENTER_CRITICAL();
+                {
+                    if( pHeader->xInfo.ulGeneration == ulHeapGeneration )
+                    {
+                        xHeapStats.xCurrentBytes -= pHeader->xInfo.xSize;
+                    }
+                }
+                taskEXIT_CRITICAL();
+            #endif /* mbedtlsportHEAP_STATS == 1 */
+
+            prvBlockFree( pHeader );
+        }
+    #else /* if ( mbedtlsportHEAP_STATS == 1 ) || ( mbedtlsportPOOL_ALLOCATOR == 1 ) */
+        vPortFree( ptr );
+    #endif /* ( mbedtlsportHEAP_STATS == 1 ) || ( mbedtlsportPOOL_ALLOCATOR == 1 ) */
 }
 /*-----------------------------------------------------------*/
 
@@ -188,3 +643,254 @@ int mbedtls_platform_mutex_unlock( mbedtls_threading_mutex_t * pMutex )
     return 0;
 }
 /*-----------------------------------------------------------*/
+
+/**
+ * @brief Take a reference on the mbed TLS threading functions.
+ */
+void mbedtls_platform_threading_acquire( void )
+{
+    taskENTER_CRITICAL();
+    {
+        if( ulThreadingUsers == 0U )
+        {
+            mbedtls_threading_set_alt( mbedtls_platform_mutex_init,
+                                       mbedtls_platform_mutex_free,
+                                       mbedtls_platform_mutex_lock,
+                                       mbedtls_platform_mutex_unlock );
+        }
+
+        ulThreadingUsers++;
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Drop a reference on the mbed TLS threading functions.
+ */
+void mbedtls_platform_threading_release( void )
+{
+    taskENTER_CRITICAL();
+    {
+        configASSERT( ulThreadingUsers > 0U );
+
+        ulThreadingUsers--;
+
+        if( ulThreadingUsers == 0U )
+        {
+            mbedtls_threading_free_alt();
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the number of references on the mbed TLS threading functions.
+ *
+ * @return Number of references.
+ */
+uint32_t mbedtls_platform_threading_users( void )
+{
+    return ulThreadingUsers;
+}
+/*-----------------------------------------------------------*/
+
+#if ( mbedtlsportHEAP_STATS == 1 )
+
+/**
+ * @brief Restart the heap counters.
+ *
+ * @param[in] xTask Task whose allocations are counted, or NULL for every task.
+ */
+    void mbedtls_platform_heap_stats_reset( TaskHandle_t xTask )
+    {
+        taskENTER_CRITICAL();
+        {
+            ( void ) memset( &xHeapStats, 0x00, sizeof( xHeapStats ) );
+            xHeapStatsTask = xTask;
+
+            /* Generation 0 marks blocks that are never counted. */
+            ulHeapGeneration++;
+
+            if( ulHeapGeneration == 0U )
+            {
+                ulHeapGeneration = 1;
+            }
+        }
+        taskEXIT_CRITICAL();
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the heap counters.
+ *
+ * @param[out] pxStats Where the counters are copied.
+ */
+    void mbedtls_platform_heap_stats_get( MbedtlsHeapStats_t * pxStats )
+    {
+        configASSERT( pxStats != NULL );
+
+        taskENTER_CRITICAL();
+        {
+            *pxStats = xHeapStats;
+        }
+        taskEXIT_CRITICAL();
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* mbedtlsportHEAP_STATS == 1 */
+
+#if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+
+/**
+ * @brief Serve the allocations of the calling task from an arena.
+ *
+ * @param[in] pxArena The arena.
+ *
+ * @return pdPASS, or pdFAIL if no scope is free.
+ */
+    BaseType_t mbedtls_platform_arena_enter( MbedtlsArena_t * pxArena )
+    {
+        TaskHandle_t xTask = xTaskGetCurrentTaskHandle();
+        BaseType_t xResult = pdFAIL;
+        uint32_t i;
+
+        configASSERT( pxArena != NULL );
+
+        /* The largest block, and the chunk link, must fit in a chunk. */
+        configASSERT( mbedtlsportARENA_CHUNK_SIZE >=
+                      2U * sizeof( HeapBlockHeader_t ) + mbedtlsportCLASS_SIZE( mbedtlsportARENA_CLASSES - 1U ) );
+
+        taskENTER_CRITICAL();
+        {
+            for( i = 0; ( i < mbedtlsportARENA_MAX_ACTIVE ) && ( xResult == pdFAIL ); i++ )
+            {
+                if( xActiveArenas[ i ].pxArena == NULL )
+                {
+                    xActiveArenas[ i ].xTask = xTask;
+                    xActiveArenas[ i ].pxArena = pxArena;
+                    xResult = pdPASS;
+                }
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        return xResult;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Initialize an arena fed from static storage.
+ *
+ * @param[in] pxArena The arena.
+ * @param[in] pvStorage Storage of the arena.
+ * @param[in] xStorageSize Size of pvStorage.
+ */
+    void mbedtls_platform_arena_init_static( MbedtlsArena_t * pxArena,
+                                             void * pvStorage,
+                                             size_t xStorageSize )
+    {
+        configASSERT( pxArena != NULL );
+        configASSERT( pvStorage != NULL );
+        configASSERT( ( ( uintptr_t ) pvStorage % sizeof( uint64_t ) ) == 0U );
+
+        ( void ) memset( pxArena, 0x00, sizeof( *pxArena ) );
+        pxArena->pucStatic = pvStorage;
+        pxArena->xStaticSize = xStorageSize & ~( sizeof( uint64_t ) - 1U );
+        pxArena->pucNextBlock = pxArena->pucStatic;
+        pxArena->xChunkFree = pxArena->xStaticSize;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief End the arena scope of the calling task.
+ *
+ * @param[in] pxArena The arena passed to mbedtls_platform_arena_enter.
+ */
+    void mbedtls_platform_arena_leave( MbedtlsArena_t * pxArena )
+    {
+        TaskHandle_t xTask = xTaskGetCurrentTaskHandle();
+        uint32_t i;
+
+        taskENTER_CRITICAL();
+        {
+            for( i = 0; i < mbedtlsportARENA_MAX_ACTIVE; i++ )
+            {
+                if( ( xActiveArenas[ i ].pxArena == pxArena ) &&
+                    ( xActiveArenas[ i ].xTask == xTask ) )
+                {
+                    xActiveArenas[ i ].pxArena = NULL;
+                    xActiveArenas[ i ].xTask = NULL;
+                }
+            }
+        }
+        taskEXIT_CRITICAL();
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Return all chunks of an arena to the heap.
+ *
+ * @param[in] pxArena The arena.
+ */
+    void mbedtls_platform_arena_release( MbedtlsArena_t * pxArena )
+    {
+        void * pvChunk;
+        void * pvNext;
+        uint8_t * pucStatic;
+        size_t xStaticSize;
+
+        configASSERT( pxArena != NULL );
+
+        taskENTER_CRITICAL();
+        {
+            pvChunk = pxArena->pvChunks;
+
+            if( pvChunk != NULL )
+            {
+                xPoolStats.ulActiveArenas--;
+            }
+
+            xPoolStats.xArenas.xChunkBytes -= pxArena->xStats.xChunkBytes;
+            xPoolStats.xArenas.xInUseBytes -= pxArena->xStats.xInUseBytes;
+            xPoolStats.xArenas.xRequestedBytes -= pxArena->xStats.xRequestedBytes;
+
+            pucStatic = pxArena->pucStatic;
+            xStaticSize = pxArena->xStaticSize;
+            ( void ) memset( pxArena, 0x00, sizeof( *pxArena ) );
+        }
+        taskEXIT_CRITICAL();
+
+        if( pucStatic != NULL )
+        {
+            mbedtls_platform_arena_init_static( pxArena, pucStatic, xStaticSize );
+        }
+
+        while( pvChunk != NULL )
+        {
+            pvNext = *( ( void ** ) pvChunk );
+            vPortFree( pvChunk );
+            pvChunk = pvNext;
+        }
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the counters of the pool allocator.
+ *
+ * @param[out] pxStats Where the counters are copied.
+ */
+    void mbedtls_platform_pool_stats_get( MbedtlsPoolStats_t * pxStats )
+    {
+        configASSERT( pxStats != NULL );
+
+        taskENTER_CRITICAL();
+        {
+            *pxStats = xPoolStats;
+        }
+        taskEXIT_CRITICAL();
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* mbedtlsportPOOL_ALLOCATOR == 1 */
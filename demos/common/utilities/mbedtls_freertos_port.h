@@ -0,0 +1,224 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file mbedtls_freertos_port.h
+ * @brief mbed TLS platform functions for FreeRTOS that are not declared by
+ * mbedtls_config.h or threading_alt.h.
+ */
+
+#ifndef MBEDTLS_FREERTOS_PORT_H
+#define MBEDTLS_FREERTOS_PORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/**
+ * @brief Set to 1 to count the memory mbed TLS allocates.
+ *
+ * Each allocation then carries a small header recording its size.
+ */
+#ifndef mbedtlsportHEAP_STATS
+    #define mbedtlsportHEAP_STATS    0
+#endif
+
+/**
+ * @brief Set to 1 to serve small mbed TLS allocations made inside an arena
+ * scope from that arena.
+ *
+ * An arena hands out blocks of a few size classes, carved from chunks of
+ * mbedtlsportARENA_CHUNK_SIZE bytes and recycled through a free list per
+ * class. All its chunks go back to the heap at once when the arena is
+ * released, so the many short-lived handshake allocations do not fragment the
+ * FreeRTOS heap. Other allocations go to the heap as before.
+ */
+#ifndef mbedtlsportPOOL_ALLOCATOR
+    #define mbedtlsportPOOL_ALLOCATOR    0
+#endif
+
+/**
+ * @brief Size of the chunks an arena takes from the heap.
+ */
+#ifndef mbedtlsportARENA_CHUNK_SIZE
+    #define mbedtlsportARENA_CHUNK_SIZE    ( 4096U )
+#endif
+
+/**
+ * @brief Number of size classes of an arena. Class n holds blocks of
+ * 16 << n bytes; larger allocations go to the heap.
+ */
+#ifndef mbedtlsportARENA_CLASSES
+    #define mbedtlsportARENA_CLASSES    ( 6U )
+#endif
+
+/**
+ * @brief Number of tasks that can be inside an arena scope at the same time.
+ * Allocations of further tasks go to the heap.
+ */
+#ifndef mbedtlsportARENA_MAX_ACTIVE
+    #define mbedtlsportARENA_MAX_ACTIVE    ( 4U )
+#endif
+
+/**
+ * @brief Memory allocated by mbed TLS since the counters were last reset.
+ */
+typedef struct MbedtlsHeapStats
+{
+    size_t xCurrentBytes;   /**< Bytes currently allocated. */
+    size_t xPeakBytes;      /**< Largest value of xCurrentBytes. */
+    uint32_t ulAllocations; /**< Successful allocations. */
+} MbedtlsHeapStats_t;
+
+/**
+ * @brief Counters of an arena, or of all arenas together.
+ */
+typedef struct MbedtlsArenaStats
+{
+    size_t xChunkBytes;         /**< Heap held in chunks. */
+    size_t xPeakChunkBytes;     /**< High-water mark of xChunkBytes. */
+    size_t xInUseBytes;         /**< Bytes of the size classes of the blocks in use. */
+    size_t xPeakInUseBytes;     /**< High-water mark of xInUseBytes. */
+    size_t xRequestedBytes;     /**< Bytes requested for the blocks in use, at most xInUseBytes. */
+    uint32_t ulAllocations;     /**< Blocks handed out. */
+    uint32_t ulReuses;          /**< Blocks handed out from a free list. */
+    uint32_t ulHeapAllocations; /**< Allocations in the arena scope too large for a class, left to the heap. */
+    uint32_t ulChunks;          /**< Chunks taken from the heap. */
+    size_t xPeakStaticBytes;    /**< Most static storage a single arena has carved. */
+} MbedtlsArenaStats_t;
+
+/**
+ * @brief Memory statistics of the pool allocator, split by where the memory
+ * came from.
+ */
+typedef struct MbedtlsPoolStats
+{
+    MbedtlsArenaStats_t xArenas; /**< All arenas together. xChunkBytes and xInUseBytes are current, the rest add up over time. */
+    size_t xHeapBytes;           /**< Bytes requested from the heap, outside any arena, and not freed. */
+    size_t xPeakHeapBytes;       /**< High-water mark of xHeapBytes. */
+    uint32_t ulHeapAllocations;  /**< Allocations from the heap, outside any arena. */
+    uint32_t ulActiveArenas;     /**< Arenas holding chunks. */
+} MbedtlsPoolStats_t;
+
+/**
+ * @brief Connection-scoped allocator, see mbedtlsportPOOL_ALLOCATOR.
+ *
+ * A zeroed arena is initialized and empty.
+ */
+typedef struct MbedtlsArena
+{
+    void * pvChunks;                                /**< Chunks, linked through their first word. */
+    uint8_t * pucNextBlock;                         /**< Start of the bytes not carved yet. */
+    size_t xChunkFree;                              /**< Bytes not carved yet, in the newest chunk or the static storage. */
+    uint8_t * pucStatic;                            /**< Static storage, NULL for an arena fed from the heap. */
+    size_t xStaticSize;                             /**< Size of pucStatic. */
+    void * pvFreeLists[ mbedtlsportARENA_CLASSES ]; /**< Freed blocks of each class. */
+    MbedtlsArenaStats_t xStats;                     /**< Counters. */
+} MbedtlsArena_t;
+
+/**
+ * @brief Take a reference on the mbed TLS threading functions.
+ *
+ * The first reference installs the FreeRTOS mutex functions with
+ * mbedtls_threading_set_alt. Every user of mbed TLS objects that hold a mutex
+ * (SSL contexts, the CTR-DRBG, RSA keys) should hold a reference while those
+ * objects are in use.
+ */
+void mbedtls_platform_threading_acquire( void );
+
+/**
+ * @brief Drop a reference taken with mbedtls_platform_threading_acquire.
+ *
+ * Dropping the last reference removes the mutex functions with
+ * mbedtls_threading_free_alt.
+ */
+void mbedtls_platform_threading_release( void );
+
+/**
+ * @brief Get the number of references on the mbed TLS threading functions.
+ */
+uint32_t mbedtls_platform_threading_users( void );
+
+#if ( mbedtlsportHEAP_STATS == 1 )
+
+    /**
+     * @brief Restart the heap counters.
+     *
+     * Blocks allocated before the reset are not counted when they are freed.
+     *
+     * @param[in] xTask Only count allocations made by this task, or by every task
+     * if NULL. This keeps the server side out of loopback measurements.
+     */
+    void mbedtls_platform_heap_stats_reset( TaskHandle_t xTask );
+
+    /**
+     * @brief Get the heap counters.
+     *
+     * @param[out] pxStats Where the counters are copied.
+     */
+    void mbedtls_platform_heap_stats_get( MbedtlsHeapStats_t * pxStats );
+
+#endif /* mbedtlsportHEAP_STATS == 1 */
+
+#if ( mbedtlsportPOOL_ALLOCATOR == 1 )
+
+    /**
+     * @brief Serve the allocations of the calling task from an arena until
+     * mbedtls_platform_arena_leave.
+     *
+     * Only mbed TLS calls on objects that are freed before the arena is
+     * released may run in the scope.
+     *
+     * @param[in] pxArena The arena.
+     *
+     * @return pdPASS, or pdFAIL if mbedtlsportARENA_MAX_ACTIVE tasks are
+     * already in a scope. Allocations then go to the heap.
+     */
+    BaseType_t mbedtls_platform_arena_enter( MbedtlsArena_t * pxArena );
+
+    /**
+     * @brief Initialize an arena fed from static storage instead of heap chunks.
+     *
+     * The arena then also serves allocations larger than the size classes,
+     * which are only reclaimed when it is released. Allocations that do not
+     * fit in what is left of the storage go to the heap.
+     *
+     * @param[in] pxArena The arena.
+     * @param[in] pvStorage Storage, aligned for a uint64_t, owned by the arena
+     * until the application stops using it.
+     * @param[in] xStorageSize Size of pvStorage.
+     */
+    void mbedtls_platform_arena_init_static( MbedtlsArena_t * pxArena,
+                                             void * pvStorage,
+                                             size_t xStorageSize );
+
+    /**
+     * @brief End the arena scope of the calling task.
+     *
+     * @param[in] pxArena The arena passed to mbedtls_platform_arena_enter.
+     */
+    void mbedtls_platform_arena_leave( MbedtlsArena_t * pxArena );
+
+    /**
+     * @brief Return all chunks of an arena to the heap, and empty it. An
+     * arena fed from static storage keeps its storage.
+     *
+     * Blocks still in use are released with it, so every object allocated from
+     * the arena must be freed first.
+     *
+     * @param[in] pxArena The arena.
+     */
+    void mbedtls_platform_arena_release( MbedtlsArena_t * pxArena );
+
+    /**
+     * @brief Get the counters of the pool allocator.
+     *
+     * @param[out] pxStats Where the counters are copied.
+     */
+    void mbedtls_platform_pool_stats_get( MbedtlsPoolStats_t * pxStats );
+
+#endif /* mbedtlsportPOOL_ALLOCATOR == 1 */
+
+#endif /* MBEDTLS_FREERTOS_PORT_H */
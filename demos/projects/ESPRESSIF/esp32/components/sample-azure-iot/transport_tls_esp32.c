@@ -27,6 +27,7 @@
 
 /* Standard includes. */
 #include "errno.h"
+#include <string.h>
 
 /* FreeRTOS includes. */
 #include "freertos/FreeRTOS.h"
@@ -482,3 +483,41 @@ int32_t TLS_Socket_Send( NetworkContext_t * pNetworkContext,
     return tlsStatus;
 }
 /*-----------------------------------------------------------*/
+
+/* esp-tls does not expose the counters and timings of the mbedTLS transport;
+ * report them zeroed so the shared samples build on this port. */
+void TLS_Socket_GetRecvStats( NetworkContext_t * pNetworkContext,
+                              TlsTransportRecvStats_t * pxStats )
+{
+    ( void ) pNetworkContext;
+
+    if( pxStats != NULL )
+    {
+        memset( pxStats, 0, sizeof( *pxStats ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void TLS_Socket_GetSendStats( NetworkContext_t * pNetworkContext,
+                              TlsTransportSendStats_t * pxStats )
+{
+    ( void ) pNetworkContext;
+
+    if( pxStats != NULL )
+    {
+        memset( pxStats, 0, sizeof( *pxStats ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void TLS_Socket_GetConnectStats( NetworkContext_t * pNetworkContext,
+                                 TlsTransportConnectStats_t * pxStats )
+{
+    ( void ) pNetworkContext;
+
+    if( pxStats != NULL )
+    {
+        memset( pxStats, 0, sizeof( *pxStats ) );
+    }
+}
+/*-----------------------------------------------------------*/
@@ -216,6 +216,11 @@ extern UBaseType_t uxRand();
  * through the FreeRTOS_gethostbyname() API function. */
 #define ipconfigUSE_DNS                                1
 
+/* Set ipconfigDNS_USE_CALLBACKS to 1 to make FreeRTOS_gethostbyname_a()
+ * available, which resolves a name without blocking the calling task.  It is
+ * used by Sockets_ConnectStart(). */
+#define ipconfigDNS_USE_CALLBACKS                      1
+
 /* If ipconfigREPLY_TO_INCOMING_PINGS is set to 1 then the IP stack will
  * generate replies to incoming ICMP echo (ping) requests. */
 #define ipconfigREPLY_TO_INCOMING_PINGS                1
@@ -33,6 +33,15 @@
 #define MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED
 #define MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED
 
+/* Elliptic curve performance. MBEDTLS_ECP_FIXED_POINT_OPTIM, on by default in
+ * mbed TLS, precomputes multiples of the curve generator for faster ECDHE key
+ * generation and ECDSA signing. TRANSPORT_TLS_ECP_RESTARTABLE, set by the
+ * DEMO_TLS_ECP_RESTARTABLE CMake option, splits the ECC operations of the TLS
+ * handshake into bounded steps, see TLS_Socket_SetEcpMaxOps. */
+#ifdef TRANSPORT_TLS_ECP_RESTARTABLE
+    #define MBEDTLS_ECP_RESTARTABLE
+#endif
+
 /* Enable all SSL alert messages. */
 #define MBEDTLS_SSL_ALL_ALERT_MESSAGES
 
@@ -43,6 +52,24 @@
 #define MBEDTLS_SSL_PROTO_TLS1_2
 #define MBEDTLS_SSL_ALPN
 #define MBEDTLS_SSL_SERVER_NAME_INDICATION
+#define MBEDTLS_SSL_SESSION_TICKETS
+#define MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH
+
+/* TRANSPORT_TLS_VERIFY_CACHE, set by the DEMO_TLS_VERIFY_CACHE CMake option,
+ * lets the transport skip the signature checks of a server certificate chain
+ * it verified before. It needs the chain kept after it is parsed. */
+#ifdef TRANSPORT_TLS_VERIFY_CACHE
+    #define MBEDTLS_SSL_KEEP_PEER_CERTIFICATE
+#endif
+
+/* Largest record that can be received and sent. With a maximum fragment
+ * length negotiated, the record buffers are shrunk to it once connected. */
+#ifndef MBEDTLS_SSL_IN_CONTENT_LEN
+    #define MBEDTLS_SSL_IN_CONTENT_LEN     16384
+#endif
+#ifndef MBEDTLS_SSL_OUT_CONTENT_LEN
+    #define MBEDTLS_SSL_OUT_CONTENT_LEN    16384
+#endif
 
 /* Check certificate key usage. */
 #define MBEDTLS_X509_CHECK_KEY_USAGE
@@ -83,6 +110,13 @@
 #define MBEDTLS_X509_USE_C
 #define MBEDTLS_X509_CRT_PARSE_C
 
+/* The transport tests run an mbed TLS server on loopback sockets, which
+ * can issue session tickets. */
+#ifdef TRANSPORT_TEST_TLS_SERVER
+    #define MBEDTLS_SSL_SRV_C
+    #define MBEDTLS_SSL_TICKET_C
+#endif
+
 /* Set the memory allocation functions on FreeRTOS. */
 void * mbedtls_platform_calloc( size_t nmemb,
                                 size_t size );
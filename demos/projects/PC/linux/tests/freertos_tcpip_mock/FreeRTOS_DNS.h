@@ -0,0 +1,28 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file FreeRTOS_DNS.h
+ * @brief FreeRTOS+TCP DNS API used by sockets_wrapper_freertos_tcpip.c. The
+ * Linux tests implement the functions.
+ */
+
+#ifndef FREERTOS_TCPIP_MOCK_DNS_H
+#define FREERTOS_TCPIP_MOCK_DNS_H
+
+#include <stdint.h>
+
+#include "FreeRTOS_IP.h"
+
+typedef void ( * FOnDNSEvent )( const char * pcName,
+                                void * pvSearchID,
+                                uint32_t ulIPAddress );
+
+uint32_t FreeRTOS_gethostbyname( const char * pcHostName );
+uint32_t FreeRTOS_gethostbyname_a( const char * pcHostName,
+                                   FOnDNSEvent pCallback,
+                                   void * pvSearchID,
+                                   TickType_t uxTimeout );
+void FreeRTOS_gethostbyname_cancel( void * pvSearchID );
+
+#endif /* FREERTOS_TCPIP_MOCK_DNS_H */
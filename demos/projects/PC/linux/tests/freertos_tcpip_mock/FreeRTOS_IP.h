@@ -0,0 +1,30 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file FreeRTOS_IP.h
+ * @brief FreeRTOS+TCP configuration and IP task API used by
+ * sockets_wrapper_freertos_tcpip.c, for the Linux tests.
+ */
+
+#ifndef FREERTOS_TCPIP_MOCK_IP_H
+#define FREERTOS_TCPIP_MOCK_IP_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "FreeRTOSIPConfig.h"
+
+#ifndef ipconfigTCP_MSS
+    #define ipconfigTCP_MSS    ( 1460 )
+#endif
+
+typedef enum
+{
+    eNetworkUp,
+    eNetworkDown
+} eIPCallbackEvent_t;
+
+#define FreeRTOS_htons( x )    ( ( uint16_t ) ( ( ( ( uint16_t ) ( x ) ) << 8U ) | ( ( ( uint16_t ) ( x ) ) >> 8U ) ) )
+
+#endif /* FREERTOS_TCPIP_MOCK_IP_H */
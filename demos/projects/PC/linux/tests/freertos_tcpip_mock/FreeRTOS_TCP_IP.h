@@ -0,0 +1,29 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file FreeRTOS_TCP_IP.h
+ * @brief FreeRTOS+TCP connection states reported by FreeRTOS_connstatus, for
+ * the Linux tests.
+ */
+
+#ifndef FREERTOS_TCPIP_MOCK_TCP_IP_H
+#define FREERTOS_TCPIP_MOCK_TCP_IP_H
+
+typedef enum eTCP_STATE
+{
+    eCLOSED = 0,
+    eTCP_LISTEN,
+    eCONNECT_SYN,
+    eSYN_FIRST,
+    eSYN_RECEIVED,
+    eESTABLISHED,
+    eFIN_WAIT_1,
+    eFIN_WAIT_2,
+    eCLOSE_WAIT,
+    eCLOSING,
+    eLAST_ACK,
+    eTIME_WAIT
+} eIPTCPState_t;
+
+#endif /* FREERTOS_TCPIP_MOCK_TCP_IP_H */
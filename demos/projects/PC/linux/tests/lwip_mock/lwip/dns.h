@@ -0,0 +1,30 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file dns.h
+ * @brief lwIP DNS API used by sockets_wrapper_lwip.c. The Linux tests
+ * implement dns_gethostbyname_addrtype.
+ */
+
+#ifndef LWIP_MOCK_DNS_H
+#define LWIP_MOCK_DNS_H
+
+#include <stdint.h>
+
+#include "lwip/err.h"
+#include "lwip/ip.h"
+
+#define LWIP_DNS_ADDRTYPE_IPV4    ( 0 )
+
+typedef void ( * dns_found_callback )( const char * name,
+                                       const ip_addr_t * ipaddr,
+                                       void * callback_arg );
+
+err_t dns_gethostbyname_addrtype( const char * hostname,
+                                  ip_addr_t * addr,
+                                  dns_found_callback found,
+                                  void * callback_arg,
+                                  uint8_t dns_addrtype );
+
+#endif /* LWIP_MOCK_DNS_H */
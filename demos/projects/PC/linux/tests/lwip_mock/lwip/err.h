@@ -0,0 +1,21 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file err.h
+ * @brief lwIP error codes used by sockets_wrapper_lwip.c, for the Linux tests.
+ */
+
+#ifndef LWIP_MOCK_ERR_H
+#define LWIP_MOCK_ERR_H
+
+#include <stdint.h>
+
+typedef int8_t err_t;
+
+#define ERR_OK            ( 0 )
+#define ERR_MEM           ( -1 )
+#define ERR_INPROGRESS    ( -5 )
+#define ERR_ARG           ( -16 )
+
+#endif /* LWIP_MOCK_ERR_H */
@@ -0,0 +1,20 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file ip.h
+ * @brief lwIP address type, for the Linux tests.
+ */
+
+#ifndef LWIP_MOCK_IP_H
+#define LWIP_MOCK_IP_H
+
+#include <stdint.h>
+
+/* IPv4 only, as with LWIP_IPV6 0. */
+typedef struct ip_addr
+{
+    uint32_t addr;
+} ip_addr_t;
+
+#endif /* LWIP_MOCK_IP_H */
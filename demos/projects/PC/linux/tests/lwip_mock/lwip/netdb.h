@@ -0,0 +1,14 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file netdb.h
+ * @brief lwIP netdb API, unused by sockets_wrapper_lwip.c, for the Linux tests.
+ */
+
+#ifndef LWIP_MOCK_NETDB_H
+#define LWIP_MOCK_NETDB_H
+
+#include "lwip/sockets.h"
+
+#endif /* LWIP_MOCK_NETDB_H */
@@ -0,0 +1,39 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sockets.h
+ * @brief lwIP sockets API mapped onto the sockets of the host, to build
+ * sockets_wrapper_lwip.c in the Linux tests.
+ */
+
+#ifndef LWIP_MOCK_SOCKETS_H
+#define LWIP_MOCK_SOCKETS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/* Host sockets includes. */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#define IP_PROTO_TCP       IPPROTO_TCP
+#define LWIP_SO_RCVBUF     1
+
+#define lwip_socket        socket
+#define lwip_close         close
+#define lwip_connect       connect
+#define lwip_recv          recv
+#define lwip_send          send
+#define lwip_setsockopt    setsockopt
+#define lwip_getsockopt    getsockopt
+#define lwip_select        select
+#define lwip_fcntl         fcntl
+#define lwip_htons         htons
+
+#endif /* LWIP_MOCK_SOCKETS_H */
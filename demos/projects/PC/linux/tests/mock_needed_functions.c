@@ -75,25 +75,40 @@ BaseType_t xApplicationGetRandomNumber( uint32_t * pulNumber )
 }
 /*-----------------------------------------------------------*/
 
-/* Needed for compilation */
+/* Provides the memory used by the Idle task, for tests that start the scheduler. */
 void vApplicationGetIdleTaskMemory( StaticTask_t ** ppxIdleTaskTCBBuffer,
                                     StackType_t ** ppxIdleTaskStackBuffer,
                                     uint32_t * pulIdleTaskStackSize )
 {
-    ( void ) ppxIdleTaskStackBuffer;
-    ( void ) ppxIdleTaskStackBuffer;
-    ( void ) pulIdleTaskStackSize;
+    static StaticTask_t xIdleTaskTCB;
+    static StackType_t uxIdleTaskStack[ configMINIMAL_STACK_SIZE ];
+
+    *ppxIdleTaskTCBBuffer = &xIdleTaskTCB;
+    *ppxIdleTaskStackBuffer = uxIdleTaskStack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
 }
 /*-----------------------------------------------------------*/
 
-/* Needed for compilation */
+/* Provides the memory used by the Timer service task, for tests that start the scheduler. */
 void vApplicationGetTimerTaskMemory( StaticTask_t ** ppxTimerTaskTCBBuffer,
                                      StackType_t ** ppxTimerTaskStackBuffer,
                                      uint32_t * pulTimerTaskStackSize )
 {
-    ( void ) ppxTimerTaskStackBuffer;
-    ( void ) ppxTimerTaskStackBuffer;
-    ( void ) pulTimerTaskStackSize;
+    static StaticTask_t xTimerTaskTCB;
+    static StackType_t uxTimerTaskStack[ configTIMER_TASK_STACK_DEPTH ];
+
+    *ppxTimerTaskTCBBuffer = &xTimerTaskTCB;
+    *ppxTimerTaskStackBuffer = uxTimerTaskStack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+/*-----------------------------------------------------------*/
+
+/* Needed for compilation */
+void vAssertCalled( const char * pcFile,
+                    uint32_t ulLine )
+{
+    printf( "vAssertCalled( %s, %u\n", pcFile, ulLine );
+    assert( false );
 }
 /*-----------------------------------------------------------*/
 
@@ -102,6 +117,36 @@ uint64_t ullGetUnixTime( void )
     return ( uint64_t ) time( NULL );
 }
 /*-----------------------------------------------------------*/
+
+/* Entropy source for the tests that run TLS. */
+int mbedtls_platform_entropy_poll( void * data,
+                                   unsigned char * output,
+                                   size_t len,
+                                   size_t * olen )
+{
+    FILE * file;
+    int ret = -1;
+
+    ( ( void ) data );
+
+    *olen = 0;
+
+    file = fopen( "/dev/urandom", "rb" );
+
+    if( file != NULL )
+    {
+        if( fread( output, 1, len, file ) == len )
+        {
+            *olen = len;
+            ret = 0;
+        }
+
+        fclose( file );
+    }
+
+    return ret;
+}
+/*-----------------------------------------------------------*/
 /*-----------------------------------------------------------*/
 
 /* Needed for compilation */
@@ -0,0 +1,653 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sockets_wrapper_loopback.c
+ * @brief In-process socket wrapper for the transport tests.
+ */
+
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "stream_buffer.h"
+
+#include "sockets_wrapper_loopback.h"
+#include "sockets_linger.h"
+
+/**
+ * @brief Number of sockets, counting both ends of each connection.
+ */
+#ifndef loopbackMAX_SOCKETS
+    #define loopbackMAX_SOCKETS    ( 8 )
+#endif
+
+/**
+ * @brief Bytes buffered in each direction of a connection.
+ */
+#ifndef loopbackBUFFER_SIZE
+    #define loopbackBUFFER_SIZE    ( 8192U )
+#endif
+
+/**
+ * @brief Number of connects waiting to be accepted.
+ */
+#define loopbackACCEPT_BACKLOG      ( loopbackMAX_SOCKETS / 2 )
+
+/**
+ * @brief Longest single wait, so blocked calls notice the peer closing.
+ */
+#define loopbackWAIT_SLICE_TICKS    ( pdMS_TO_TICKS( 10U ) )
+
+/**
+ * @brief The only host name that resolves.
+ */
+#define loopbackHOST_NAME           "localhost"
+
+/*-----------------------------------------------------------*/
+
+typedef struct LoopbackSocket
+{
+    BaseType_t xInUse;
+    StreamBufferHandle_t xRxBuffer;
+    StaticStreamBuffer_t xRxBufferStorage;
+    uint8_t ucRxBuffer[ loopbackBUFFER_SIZE + 1 ];
+    struct LoopbackSocket * volatile pxPeer;
+    volatile BaseType_t xConnected;
+    volatile BaseType_t xPeerClosed;
+    BaseType_t xConnectPending;
+    TickType_t xConnectStart;
+    BaseType_t xNonBlocking;
+    TickType_t xRecvTimeout;
+    TickType_t xSendTimeout;
+    SocketsConnectTimes_t xConnectTimes;
+    LoopbackSocketOptions_t xOptions;
+} LoopbackSocket_t;
+
+/*-----------------------------------------------------------*/
+
+static LoopbackSocket_t xLoopbackSockets[ loopbackMAX_SOCKETS ];
+
+static QueueHandle_t xAcceptQueue = NULL;
+static uint16_t usListenPort = 0;
+
+/*-----------------------------------------------------------*/
+
+static LoopbackSocket_t * prvSocketAlloc( void )
+{
+    LoopbackSocket_t * pxSocket = NULL;
+    size_t xIndex;
+
+    taskENTER_CRITICAL();
+    {
+        for( xIndex = 0; xIndex < loopbackMAX_SOCKETS; xIndex++ )
+        {
+            if( xLoopbackSockets[ xIndex ].xInUse == pdFALSE )
+            {
+                pxSocket = &xLoopbackSockets[ xIndex ];
+                pxSocket->xInUse = pdTRUE;
+                break;
+            }
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    if( pxSocket != NULL )
+    {
+        pxSocket->pxPeer = NULL;
+        pxSocket->xConnected = pdFALSE;
+        pxSocket->xPeerClosed = pdFALSE;
+        pxSocket->xConnectPending = pdFALSE;
+        pxSocket->xNonBlocking = pdFALSE;
+        pxSocket->xRecvTimeout = portMAX_DELAY;
+        pxSocket->xSendTimeout = portMAX_DELAY;
+        ( void ) memset( &pxSocket->xOptions, 0, sizeof( pxSocket->xOptions ) );
+
+        if( pxSocket->xRxBuffer == NULL )
+        {
+            pxSocket->xRxBuffer = xStreamBufferCreateStatic( loopbackBUFFER_SIZE, 1,
+                                                             pxSocket->ucRxBuffer,
+                                                             &pxSocket->xRxBufferStorage );
+        }
+        else
+        {
+            ( void ) xStreamBufferReset( pxSocket->xRxBuffer );
+        }
+    }
+
+    return pxSocket;
+}
+/*-----------------------------------------------------------*/
+
+static TickType_t prvWaitTicks( TickType_t xTimeout,
+                                TickType_t xStart )
+{
+    TickType_t xElapsed = xTaskGetTickCount() - xStart;
+    TickType_t xWait = 0;
+
+    if( xElapsed < xTimeout )
+    {
+        xWait = xTimeout - xElapsed;
+
+        if( xWait > loopbackWAIT_SLICE_TICKS )
+        {
+            xWait = loopbackWAIT_SLICE_TICKS;
+        }
+    }
+
+    return xWait;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Loopback_Listen( uint16_t usPort )
+{
+    BaseType_t xRetVal = SOCKETS_ERROR_NONE;
+
+    if( xAcceptQueue == NULL )
+    {
+        xAcceptQueue = xQueueCreate( loopbackACCEPT_BACKLOG, sizeof( LoopbackSocket_t * ) );
+    }
+
+    if( xAcceptQueue == NULL )
+    {
+        xRetVal = SOCKETS_ENOMEM;
+    }
+    else
+    {
+        usListenPort = usPort;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+SocketHandle Loopback_Accept( TickType_t xTimeout )
+{
+    LoopbackSocket_t * pxSocket = NULL;
+    SocketHandle xSocket = SOCKETS_INVALID_SOCKET;
+
+    if( ( xAcceptQueue != NULL ) &&
+        ( xQueueReceive( xAcceptQueue, &pxSocket, xTimeout ) == pdPASS ) )
+    {
+        xSocket = ( SocketHandle ) pxSocket;
+    }
+
+    return xSocket;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * A socket closed with Sockets_CloseAsync lingers until its peer closes too.
+ */
+static BaseType_t prvLingerPoll( SocketHandle xSocket )
+{
+    LoopbackSocket_t * pxSocket = ( LoopbackSocket_t * ) xSocket;
+
+    /* Discard data the peer sent before it closed. */
+    ( void ) xStreamBufferReset( pxSocket->xRxBuffer );
+
+    return ( pxSocket->xPeerClosed || ( pxSocket->pxPeer == NULL ) ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvLingerRelease( SocketHandle xSocket )
+{
+    ( void ) Sockets_Close( xSocket );
+}
+/*-----------------------------------------------------------*/
+
+void Loopback_GetOptions( SocketHandle xSocket,
+                          LoopbackSocketOptions_t * pxOptions )
+{
+    *pxOptions = ( ( LoopbackSocket_t * ) xSocket )->xOptions;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Init()
+{
+    return SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_DeInit()
+{
+    return SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
+SocketHandle Sockets_Open()
+{
+    LoopbackSocket_t * pxSocket = prvSocketAlloc();
+
+    return ( pxSocket == NULL ) ? SOCKETS_INVALID_SOCKET : ( SocketHandle ) pxSocket;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Close( SocketHandle xSocket )
+{
+    LoopbackSocket_t * pxSocket = ( LoopbackSocket_t * ) xSocket;
+
+    Sockets_Disconnect( xSocket );
+    pxSocket->xInUse = pdFALSE;
+
+    return SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Connect( SocketHandle xSocket,
+                            const char * pcHostName,
+                            uint16_t usPort )
+{
+    BaseType_t xRetVal = Sockets_ConnectStart( xSocket, pcHostName, usPort );
+
+    while( xRetVal == SOCKETS_EWOULDBLOCK )
+    {
+        vTaskDelay( 1 );
+        xRetVal = Sockets_ConnectPoll( xSocket );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectStart( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort )
+{
+    LoopbackSocket_t * pxSocket = ( LoopbackSocket_t * ) xSocket;
+    BaseType_t xRetVal;
+
+    if( ( pxSocket == NULL ) || ( pcHostName == NULL ) )
+    {
+        xRetVal = SOCKETS_EINVAL;
+    }
+    else if( pxSocket->xConnected || pxSocket->xConnectPending )
+    {
+        xRetVal = Sockets_ConnectPoll( xSocket );
+    }
+    else if( ( strcmp( pcHostName, loopbackHOST_NAME ) != 0 ) ||
+             ( xAcceptQueue == NULL ) ||
+             ( usPort != usListenPort ) )
+    {
+        /* Unknown host or nothing listening. */
+        xRetVal = SOCKETS_SOCKET_ERROR;
+    }
+    else
+    {
+        pxSocket->xConnectPending = pdTRUE;
+        pxSocket->xConnectStart = xTaskGetTickCount();
+        xRetVal = Sockets_ConnectPoll( xSocket );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectPoll( SocketHandle xSocket )
+{
+    LoopbackSocket_t * pxSocket = ( LoopbackSocket_t * ) xSocket;
+    LoopbackSocket_t * pxServer;
+    BaseType_t xRetVal;
+
+    if( pxSocket->xConnected )
+    {
+        xRetVal = SOCKETS_ERROR_NONE;
+    }
+    else if( pxSocket->xConnectPending == pdFALSE )
+    {
+        xRetVal = SOCKETS_ENOTCONN;
+    }
+    else if( ( xTaskGetTickCount() - pxSocket->xConnectStart ) <
+             pdMS_TO_TICKS( loopbackCONNECT_LATENCY_MS ) )
+    {
+        xRetVal = SOCKETS_EWOULDBLOCK;
+    }
+    else if( uxQueueSpacesAvailable( xAcceptQueue ) == 0 )
+    {
+        /* Backlog full, refuse the connect. */
+        pxSocket->xConnectPending = pdFALSE;
+        xRetVal = SOCKETS_SOCKET_ERROR;
+    }
+    else if( ( pxServer = prvSocketAlloc() ) == NULL )
+    {
+        pxSocket->xConnectPending = pdFALSE;
+        xRetVal = SOCKETS_ENOMEM;
+    }
+    else
+    {
+        pxSocket->xConnectPending = pdFALSE;
+        pxServer->pxPeer = pxSocket;
+        pxServer->xConnected = pdTRUE;
+        pxSocket->pxPeer = pxServer;
+        pxSocket->xConnected = pdTRUE;
+
+        /* Only "localhost" resolves, at once. */
+        pxSocket->xConnectTimes.ulDnsMs = 0;
+        pxSocket->xConnectTimes.ulTcpConnectMs =
+            ( uint32_t ) ( ( xTaskGetTickCount() - pxSocket->xConnectStart ) * portTICK_PERIOD_MS );
+
+        ( void ) xQueueSend( xAcceptQueue, &pxServer, 0 );
+        xRetVal = SOCKETS_ERROR_NONE;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_Disconnect( SocketHandle xSocket )
+{
+    LoopbackSocket_t * pxSocket = ( LoopbackSocket_t * ) xSocket;
+
+    taskENTER_CRITICAL();
+    {
+        if( pxSocket->pxPeer != NULL )
+        {
+            pxSocket->pxPeer->xPeerClosed = pdTRUE;
+            pxSocket->pxPeer->pxPeer = NULL;
+            pxSocket->pxPeer = NULL;
+        }
+
+        pxSocket->xConnected = pdFALSE;
+        pxSocket->xConnectPending = pdFALSE;
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_CloseAsync( SocketHandle xSocket )
+{
+    LoopbackSocket_t * pxSocket = ( LoopbackSocket_t * ) xSocket;
+
+    /* Half close: the peer sees the connection closed, this end waits for the
+     * peer to close as well. */
+    taskENTER_CRITICAL();
+    {
+        pxSocket->xConnectPending = pdFALSE;
+
+        if( pxSocket->pxPeer != NULL )
+        {
+            pxSocket->pxPeer->xPeerClosed = pdTRUE;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    if( ( Sockets_Linger_Init( prvLingerPoll, prvLingerRelease ) != pdPASS ) ||
+        ( Sockets_Linger_Add( xSocket ) != pdPASS ) )
+    {
+        ( void ) Sockets_Close( xSocket );
+    }
+
+    return SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Recv( SocketHandle xSocket,
+                         uint8_t * pucReceiveBuffer,
+                         size_t xReceiveBufferLength )
+{
+    LoopbackSocket_t * pxSocket = ( LoopbackSocket_t * ) xSocket;
+    TickType_t xTimeout = pxSocket->xNonBlocking ? 0 : pxSocket->xRecvTimeout;
+    TickType_t xStart = xTaskGetTickCount();
+    BaseType_t xRetVal;
+    size_t xReceived;
+
+    if( ( pxSocket->xConnected == pdFALSE ) && ( pxSocket->xPeerClosed == pdFALSE ) )
+    {
+        xRetVal = SOCKETS_ENOTCONN;
+    }
+    else
+    {
+        do
+        {
+            xReceived = xStreamBufferReceive( pxSocket->xRxBuffer, pucReceiveBuffer,
+                                              xReceiveBufferLength,
+                                              prvWaitTicks( xTimeout, xStart ) );
+        } while( ( xReceived == 0 ) &&
+                 ( pxSocket->xPeerClosed == pdFALSE ) &&
+                 ( prvWaitTicks( xTimeout, xStart ) != 0 ) );
+
+        if( ( xReceived == 0 ) && pxSocket->xPeerClosed )
+        {
+            /* Pick up anything sent just before the peer closed. */
+            xReceived = xStreamBufferReceive( pxSocket->xRxBuffer, pucReceiveBuffer,
+                                              xReceiveBufferLength, 0 );
+            xRetVal = ( xReceived == 0 ) ? SOCKETS_ECLOSED : ( BaseType_t ) xReceived;
+        }
+        else
+        {
+            xRetVal = ( BaseType_t ) xReceived;
+        }
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Send( SocketHandle xSocket,
+                         const uint8_t * pucData,
+                         size_t xDataLength )
+{
+    LoopbackSocket_t * pxSocket = ( LoopbackSocket_t * ) xSocket;
+    LoopbackSocket_t * pxPeer = pxSocket->pxPeer;
+    TickType_t xTimeout = pxSocket->xNonBlocking ? 0 : pxSocket->xSendTimeout;
+    TickType_t xStart = xTaskGetTickCount();
+    BaseType_t xRetVal;
+    size_t xSent;
+
+    if( pxSocket->xPeerClosed )
+    {
+        xRetVal = SOCKETS_ECLOSED;
+    }
+    else if( ( pxSocket->xConnected == pdFALSE ) || ( pxPeer == NULL ) )
+    {
+        xRetVal = SOCKETS_ENOTCONN;
+    }
+    else
+    {
+        do
+        {
+            xSent = xStreamBufferSend( pxPeer->xRxBuffer, pucData, xDataLength,
+                                       prvWaitTicks( xTimeout, xStart ) );
+        } while( ( xSent == 0 ) &&
+                 ( pxSocket->xPeerClosed == pdFALSE ) &&
+                 ( prvWaitTicks( xTimeout, xStart ) != 0 ) );
+
+        if( xSent != 0 )
+        {
+            xRetVal = ( BaseType_t ) xSent;
+        }
+        else if( pxSocket->xPeerClosed )
+        {
+            xRetVal = SOCKETS_ECLOSED;
+        }
+        else
+        {
+            xRetVal = pxSocket->xNonBlocking ? SOCKETS_EWOULDBLOCK : 0;
+        }
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
+                               int32_t lOptionName,
+                               const void * pvOptionValue,
+                               size_t xOptionLength )
+{
+    LoopbackSocket_t * pxSocket = ( LoopbackSocket_t * ) xSocket;
+    BaseType_t xRetVal = SOCKETS_ERROR_NONE;
+    TickType_t xTimeout;
+
+    ( void ) xOptionLength;
+
+    switch( lOptionName )
+    {
+        case SOCKETS_SO_RCVTIMEO:
+        case SOCKETS_SO_SNDTIMEO:
+            /* Comply with Berkeley standard - a 0 timeout is wait forever. */
+            xTimeout = *( ( const TickType_t * ) pvOptionValue );
+
+            if( xTimeout == 0U )
+            {
+                xTimeout = portMAX_DELAY;
+            }
+
+            if( lOptionName == SOCKETS_SO_RCVTIMEO )
+            {
+                pxSocket->xRecvTimeout = xTimeout;
+            }
+            else
+            {
+                pxSocket->xSendTimeout = xTimeout;
+            }
+
+            break;
+
+        case SOCKETS_SO_NONBLOCK:
+            pxSocket->xNonBlocking = *( ( const BaseType_t * ) pvOptionValue ) ? pdTRUE : pdFALSE;
+            break;
+
+        /* Options without effect on loopback connections are only recorded,
+         * for Loopback_GetOptions. */
+        case SOCKETS_SO_NODELAY:
+            pxSocket->xOptions.xNoDelay = *( ( const BaseType_t * ) pvOptionValue ) ? pdTRUE : pdFALSE;
+            break;
+
+        case SOCKETS_SO_KEEPALIVE:
+            pxSocket->xOptions.xKeepAlive = *( ( const BaseType_t * ) pvOptionValue ) ? pdTRUE : pdFALSE;
+            break;
+
+        case SOCKETS_SO_SNDBUF:
+        case SOCKETS_SO_RCVBUF:
+        case SOCKETS_SO_WINDOW:
+
+            /* As on a TCP/IP stack, buffers are sized before connecting. */
+            if( pxSocket->xConnected || pxSocket->xConnectPending )
+            {
+                xRetVal = SOCKETS_EISCONN;
+            }
+            else if( lOptionName == SOCKETS_SO_SNDBUF )
+            {
+                pxSocket->xOptions.xWindow.ulSendBufferBytes = *( ( const uint32_t * ) pvOptionValue );
+            }
+            else if( lOptionName == SOCKETS_SO_RCVBUF )
+            {
+                pxSocket->xOptions.xWindow.ulReceiveBufferBytes = *( ( const uint32_t * ) pvOptionValue );
+            }
+            else
+            {
+                pxSocket->xOptions.xWindow = *( ( const SocketsWindow_t * ) pvOptionValue );
+            }
+
+            break;
+
+        default:
+            xRetVal = SOCKETS_ENOPROTOOPT;
+            break;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvPollSocket( LoopbackSocket_t * pxSocket,
+                               uint32_t ulEvents )
+{
+    LoopbackSocket_t * pxPeer;
+    uint32_t ulRevents = 0;
+
+    /* Complete a connect in progress, as a write event reports it. */
+    if( pxSocket->xConnectPending )
+    {
+        ( void ) Sockets_ConnectPoll( ( SocketHandle ) pxSocket );
+    }
+
+    pxPeer = pxSocket->pxPeer;
+
+    if( ( ( ulEvents & SOCKETS_POLL_READ ) != 0U ) &&
+        ( ( xStreamBufferBytesAvailable( pxSocket->xRxBuffer ) > 0U ) || pxSocket->xPeerClosed ) )
+    {
+        ulRevents |= SOCKETS_POLL_READ;
+    }
+
+    if( ( ( ulEvents & SOCKETS_POLL_WRITE ) != 0U ) &&
+        ( pxSocket->xPeerClosed ||
+          ( pxSocket->xConnected && ( pxPeer != NULL ) &&
+            ( xStreamBufferSpacesAvailable( pxPeer->xRxBuffer ) > 0U ) ) ) )
+    {
+        ulRevents |= SOCKETS_POLL_WRITE;
+    }
+
+    /* Never connected, or the connect failed. */
+    if( ( pxSocket->xConnected == pdFALSE ) && ( pxSocket->xConnectPending == pdFALSE ) &&
+        ( pxSocket->xPeerClosed == pdFALSE ) )
+    {
+        ulRevents |= SOCKETS_POLL_ERROR;
+    }
+
+    return ulRevents;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Poll( SocketsPollFd_t * pxSockets,
+                         size_t xSocketCount,
+                         uint32_t ulTimeoutMs )
+{
+    TickType_t xTimeout = ( ulTimeoutMs == SOCKETS_POLL_WAIT_FOREVER ) ?
+                          portMAX_DELAY : pdMS_TO_TICKS( ulTimeoutMs );
+    TickType_t xStart = xTaskGetTickCount();
+    BaseType_t xRetVal;
+    size_t xIndex;
+
+    for( ; ; )
+    {
+        xRetVal = 0;
+
+        for( xIndex = 0; xIndex < xSocketCount; xIndex++ )
+        {
+            pxSockets[ xIndex ].ulRevents = prvPollSocket( ( LoopbackSocket_t * ) pxSockets[ xIndex ].xSocket,
+                                                           pxSockets[ xIndex ].ulEvents );
+
+            if( pxSockets[ xIndex ].ulRevents != 0U )
+            {
+                xRetVal++;
+            }
+        }
+
+        if( ( xRetVal != 0 ) || ( prvWaitTicks( xTimeout, xStart ) == 0 ) )
+        {
+            break;
+        }
+
+        vTaskDelay( 1 );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_GetConnectTimes( SocketHandle xSocket,
+                                    SocketsConnectTimes_t * pxTimes )
+{
+    LoopbackSocket_t * pxSocket = ( LoopbackSocket_t * ) xSocket;
+    BaseType_t xRetVal = SOCKETS_ENOTCONN;
+
+    if( pxSocket->xConnected )
+    {
+        *pxTimes = pxSocket->xConnectTimes;
+        xRetVal = SOCKETS_ERROR_NONE;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_Prefetch( const char * pcHostName )
+{
+    /* Loopback sockets resolve no names. */
+    ( void ) pcHostName;
+}
+/*-----------------------------------------------------------*/
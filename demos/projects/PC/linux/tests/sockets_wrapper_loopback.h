@@ -0,0 +1,63 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sockets_wrapper_loopback.h
+ * @brief In-process implementation of sockets_wrapper.h used by the transport
+ * tests. Connections are pairs of stream buffers between tasks, so a TLS client
+ * and server can run in the same FreeRTOS process without a network.
+ */
+
+#ifndef SOCKETS_WRAPPER_LOOPBACK_H
+#define SOCKETS_WRAPPER_LOOPBACK_H
+
+#include "FreeRTOS.h"
+
+#include "sockets_wrapper.h"
+
+/**
+ * @brief Time a connect stays in progress before the listener sees it.
+ */
+#ifndef loopbackCONNECT_LATENCY_MS
+    #define loopbackCONNECT_LATENCY_MS    ( 20U )
+#endif
+
+/**
+ * @brief Socket options recorded by Sockets_SetSockOpt, which loopback
+ * connections do not act on.
+ */
+typedef struct LoopbackSocketOptions
+{
+    BaseType_t xNoDelay;     /**< Last #SOCKETS_SO_NODELAY value. */
+    BaseType_t xKeepAlive;   /**< Last #SOCKETS_SO_KEEPALIVE value. */
+    SocketsWindow_t xWindow; /**< Sizes set with #SOCKETS_SO_SNDBUF, #SOCKETS_SO_RCVBUF and #SOCKETS_SO_WINDOW. */
+} LoopbackSocketOptions_t;
+
+/**
+ * @brief Accept connects to a port.
+ *
+ * Only one port can be listened on at a time.
+ *
+ * @param[in] usPort Port to listen on.
+ * @return SOCKETS_ERROR_NONE on success, or a negative error code.
+ */
+BaseType_t Loopback_Listen( uint16_t usPort );
+
+/**
+ * @brief Wait for a connect to the listening port.
+ *
+ * @param[in] xTimeout Ticks to wait.
+ * @return Server side socket of the connection, or SOCKETS_INVALID_SOCKET on timeout.
+ */
+SocketHandle Loopback_Accept( TickType_t xTimeout );
+
+/**
+ * @brief Get the options set on a socket.
+ *
+ * @param[in] xSocket Socket.
+ * @param[out] pxOptions Where the options are copied.
+ */
+void Loopback_GetOptions( SocketHandle xSocket,
+                          LoopbackSocketOptions_t * pxOptions );
+
+#endif /* SOCKETS_WRAPPER_LOOPBACK_H */
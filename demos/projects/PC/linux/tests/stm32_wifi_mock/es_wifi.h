@@ -0,0 +1,15 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file es_wifi.h
+ * @brief Inventek driver limits used by sockets_wrapper_stm32l475.c, for the
+ * Linux tests.
+ */
+
+#ifndef STM32_WIFI_MOCK_ES_WIFI_H
+#define STM32_WIFI_MOCK_ES_WIFI_H
+
+#define ES_WIFI_PAYLOAD_SIZE    1200
+
+#endif /* STM32_WIFI_MOCK_ES_WIFI_H */
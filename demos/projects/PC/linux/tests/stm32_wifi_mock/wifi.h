@@ -0,0 +1,54 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file wifi.h
+ * @brief Inventek WiFi API used by sockets_wrapper_stm32l475.c. The Linux
+ * tests implement the functions.
+ */
+
+#ifndef STM32_WIFI_MOCK_WIFI_H
+#define STM32_WIFI_MOCK_WIFI_H
+
+#include <stdint.h>
+
+#include "es_wifi.h"
+
+typedef enum
+{
+    WIFI_TCP_PROTOCOL = 0,
+    WIFI_UDP_PROTOCOL = 1,
+} WIFI_Protocol_t;
+
+typedef enum
+{
+    WIFI_STATUS_OK = 0,
+    WIFI_STATUS_ERROR = 1,
+    WIFI_STATUS_NOT_SUPPORTED = 2,
+    WIFI_STATUS_JOINED = 3,
+    WIFI_STATUS_ASSIGNED = 4,
+    WIFI_STATUS_TIMEOUT = 5,
+} WIFI_Status_t;
+
+WIFI_Status_t WIFI_GetHostAddress( const char * location,
+                                   uint8_t * ipaddr );
+WIFI_Status_t WIFI_OpenClientConnection( uint32_t socket,
+                                         WIFI_Protocol_t type,
+                                         const char * name,
+                                         uint8_t * ipaddr,
+                                         uint16_t port,
+                                         uint16_t local_port );
+WIFI_Status_t WIFI_CloseClientConnection( uint32_t socket );
+WIFI_Status_t WIFI_SendData( uint8_t socket,
+                             uint8_t * pdata,
+                             uint16_t Reqlen,
+                             uint16_t * SentDatalen,
+                             uint32_t Timeout );
+WIFI_Status_t WIFI_ReceiveData( uint8_t socket,
+                                uint8_t * pdata,
+                                uint16_t Reqlen,
+                                uint16_t * RcvDatalen,
+                                uint32_t Timeout );
+WIFI_Status_t WIFI_ResetModule( void );
+
+#endif /* STM32_WIFI_MOCK_WIFI_H */
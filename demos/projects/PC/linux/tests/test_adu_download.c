@@ -0,0 +1,382 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  TEST OF THE ADU IMAGE DOWNLOAD OVER A KEEP-ALIVE CONNECTION
+ *
+ *  Downloads a multi-megabyte image from an in-process HTTP/1.1 server on
+ *  loopback sockets, in ranges, the way the ADU sample does. Compares the time
+ *  and the number of connections with one connection per request, and checks
+ *  that a server that closes the connection after a few requests is handled by
+ *  reconnecting and repeating the request.
+ *
+ *  Over HTTPS, checks that reconnects resume the TLS session, and measures the
+ *  throughput and the CPU time of the downloading task per megabyte, for HTTP
+ *  and HTTPS.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "transport_socket.h"
+#include "transport_tls_socket.h"
+#include "transport_tls_session_cache.h"
+#include "sample_azure_iot_adu_download.h"
+#include "test_tls_server.h"
+#include "test_http_server.h"
+
+#define TEST_ADU_DOWNLOAD_SUCCESS    0
+#define TEST_ADU_DOWNLOAD_FAIL       1
+
+#define TEST_PORT                    ( 8443 )
+#define TEST_HOST_NAME               "localhost"
+#define TEST_PATH                    "/update/image.bin"
+#define TEST_CHUNK_SIZE              ( 16U * 1024U )
+#define TEST_CHUNKS                  ( ( testhttpIMAGE_SIZE + TEST_CHUNK_SIZE - 1U ) / TEST_CHUNK_SIZE )
+#define TEST_SERVER_CLOSE_AFTER      ( 5U )
+
+#define TEST_TASK_STACK_SIZE         ( 8 * 1024 )
+#define TEST_TASK_PRIORITY           ( tskIDLE_PRIORITY + 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+static const NetworkCredentials_t xTestCredentials =
+{
+    .pucRootCa   = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA,
+    .xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA )
+};
+
+static char cDownloadBuffer[ TEST_CHUNK_SIZE + 1024U ];
+static char cHeaderBuffer[ 512 ];
+
+/*-----------------------------------------------------------*/
+
+/* CPU time of the calling task; each task is a thread on this port. */
+static uint64_t prvTaskCpuUs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_THREAD_CPUTIME_ID, &xNow );
+
+    return ( uint64_t ) xNow.tv_sec * 1000000U + ( uint64_t ) xNow.tv_nsec / 1000U;
+}
+/*-----------------------------------------------------------*/
+
+/* Download the whole image and check its bytes. */
+static int prvDownload( BaseType_t xHttps,
+                        uint32_t ulMaxRequestsPerConnection,
+                        SampleADUDownloadStats_t * pxStats,
+                        uint64_t * pullCpuUs )
+{
+    SampleADUDownload_t xDownload;
+    NetworkContext_t xNetworkContext = { 0 };
+    SocketTransportParams_t xSocketTransportParams = { 0 };
+    TlsTransportParams_t xTlsTransportParams = { 0 };
+    char * pcData;
+    uint32_t ulDataLength;
+    uint32_t ulOffset = 0;
+    uint32_t i;
+    int32_t lSize;
+    uint64_t ullCpuStart = prvTaskCpuUs();
+    int lResult = TEST_ADU_DOWNLOAD_SUCCESS;
+
+    TestHttpServer_SetTls( xHttps );
+    xNetworkContext.pParams = ( xHttps == pdTRUE ) ? ( void * ) &xTlsTransportParams : ( void * ) &xSocketTransportParams;
+
+    SampleADUDownload_Init( &xDownload, &xNetworkContext,
+                            ( xHttps == pdTRUE ) ? &xTestCredentials : NULL,
+                            TEST_HOST_NAME, sizeof( TEST_HOST_NAME ) - 1,
+                            TEST_PATH, sizeof( TEST_PATH ) - 1,
+                            TEST_PORT, cHeaderBuffer, sizeof( cHeaderBuffer ) );
+    xDownload.ulMaxRequestsPerConnection = ulMaxRequestsPerConnection;
+
+    lSize = SampleADUDownload_GetSize( &xDownload, cDownloadBuffer, sizeof( cDownloadBuffer ) );
+
+    if( lSize != ( int32_t ) testhttpIMAGE_SIZE )
+    {
+        printf( "\tImage size %d!\n", ( int ) lSize );
+        lResult = TEST_ADU_DOWNLOAD_FAIL;
+    }
+
+    while( ( lResult == TEST_ADU_DOWNLOAD_SUCCESS ) && ( ulOffset < testhttpIMAGE_SIZE ) )
+    {
+        if( SampleADUDownload_GetRange( &xDownload, ulOffset, ulOffset + TEST_CHUNK_SIZE - 1U,
+                                        cDownloadBuffer, sizeof( cDownloadBuffer ),
+                                        &pcData, &ulDataLength ) != eAzureIoTSuccess )
+        {
+            printf( "\tRange at %u failed!\n", ( unsigned ) ulOffset );
+            lResult = TEST_ADU_DOWNLOAD_FAIL;
+            break;
+        }
+
+        for( i = 0; i < ulDataLength; i++ )
+        {
+            if( ( uint8_t ) pcData[ i ] != TestHttpServer_ImageByte( ulOffset + i ) )
+            {
+                printf( "\tWrong byte at %u!\n", ( unsigned ) ( ulOffset + i ) );
+                lResult = TEST_ADU_DOWNLOAD_FAIL;
+                break;
+            }
+        }
+
+        ulOffset += ulDataLength;
+    }
+
+    SampleADUDownload_GetStats( &xDownload, pxStats );
+    SampleADUDownload_Deinit( &xDownload );
+
+    if( pullCpuUs != NULL )
+    {
+        *pullCpuUs = prvTaskCpuUs() - ullCpuStart;
+    }
+
+    if( ( lResult == TEST_ADU_DOWNLOAD_SUCCESS ) &&
+        ( ( pxStats->ullBytes != testhttpIMAGE_SIZE ) || ( pxStats->ulRequests != TEST_CHUNKS + 1U ) ) )
+    {
+        printf( "\t%u bytes in %u requests!\n",
+                ( unsigned ) pxStats->ullBytes, ( unsigned ) pxStats->ulRequests );
+        lResult = TEST_ADU_DOWNLOAD_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvKBytesPerSecond( const SampleADUDownloadStats_t * pxStats )
+{
+    uint32_t ulElapsedMs = ( uint32_t ) ( pxStats->xElapsed * portTICK_PERIOD_MS );
+
+    return ulElapsedMs == 0U ? 0U : ( uint32_t ) ( pxStats->ullBytes / ulElapsedMs );
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestKeepAlive( void )
+{
+    SampleADUDownloadStats_t xKeepAlive;
+    SampleADUDownloadStats_t xPerRequest;
+    uint32_t ulConnections;
+    int lResult = TEST_ADU_DOWNLOAD_SUCCESS;
+
+    printf( "Image download over one connection and over one per request\n" );
+
+    ulConnections = TestHttpServer_GetConnections();
+
+    if( prvDownload( pdFALSE, 0, &xKeepAlive, NULL ) != TEST_ADU_DOWNLOAD_SUCCESS )
+    {
+        return TEST_ADU_DOWNLOAD_FAIL;
+    }
+
+    if( ( xKeepAlive.ulConnections != 1U ) ||
+        ( TestHttpServer_GetConnections() - ulConnections != 1U ) ||
+        ( xKeepAlive.ulReconnects != 0U ) )
+    {
+        printf( "\tKeep-alive: %u connections, %u accepted, %u reconnects!\n",
+                ( unsigned ) xKeepAlive.ulConnections,
+                ( unsigned ) ( TestHttpServer_GetConnections() - ulConnections ),
+                ( unsigned ) xKeepAlive.ulReconnects );
+        lResult = TEST_ADU_DOWNLOAD_FAIL;
+    }
+
+    if( prvDownload( pdFALSE, 1, &xPerRequest, NULL ) != TEST_ADU_DOWNLOAD_SUCCESS )
+    {
+        return TEST_ADU_DOWNLOAD_FAIL;
+    }
+
+    if( ( xPerRequest.ulConnections != TEST_CHUNKS + 1U ) || ( xPerRequest.ulReconnects != 0U ) )
+    {
+        printf( "\tPer request: %u connections, %u reconnects!\n",
+                ( unsigned ) xPerRequest.ulConnections, ( unsigned ) xPerRequest.ulReconnects );
+        lResult = TEST_ADU_DOWNLOAD_FAIL;
+    }
+
+    printf( "\t%u bytes: %u ms over 1 connection (%u KB/s), %u ms over %u connections (%u KB/s)\n",
+            ( unsigned ) testhttpIMAGE_SIZE,
+            ( unsigned ) ( xKeepAlive.xElapsed * portTICK_PERIOD_MS ),
+            ( unsigned ) prvKBytesPerSecond( &xKeepAlive ),
+            ( unsigned ) ( xPerRequest.xElapsed * portTICK_PERIOD_MS ),
+            ( unsigned ) xPerRequest.ulConnections,
+            ( unsigned ) prvKBytesPerSecond( &xPerRequest ) );
+
+    /* Every connection costs at least loopbackCONNECT_LATENCY_MS. */
+    if( xKeepAlive.xElapsed >= xPerRequest.xElapsed )
+    {
+        printf( "\tKeep-alive download not faster!\n" );
+        lResult = TEST_ADU_DOWNLOAD_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestServerClose( void )
+{
+    SampleADUDownloadStats_t xStats;
+    uint32_t ulConnections;
+    int lResult = TEST_ADU_DOWNLOAD_SUCCESS;
+
+    printf( "Server closing the connection every %u requests\n", ( unsigned ) TEST_SERVER_CLOSE_AFTER );
+
+    TestHttpServer_SetCloseAfter( TEST_SERVER_CLOSE_AFTER );
+    ulConnections = TestHttpServer_GetConnections();
+
+    if( prvDownload( pdFALSE, 0, &xStats, NULL ) != TEST_ADU_DOWNLOAD_SUCCESS )
+    {
+        lResult = TEST_ADU_DOWNLOAD_FAIL;
+    }
+    else if( ( xStats.ulConnections != TestHttpServer_GetConnections() - ulConnections ) ||
+             ( xStats.ulConnections < ( TEST_CHUNKS + 1U ) / TEST_SERVER_CLOSE_AFTER ) ||
+             ( xStats.ulReconnects != xStats.ulConnections - 1U ) ||
+             ( xStats.ulFailedRequests != xStats.ulReconnects ) )
+    {
+        printf( "\t%u connections, %u accepted, %u reconnects, %u failed requests!\n",
+                ( unsigned ) xStats.ulConnections,
+                ( unsigned ) ( TestHttpServer_GetConnections() - ulConnections ),
+                ( unsigned ) xStats.ulReconnects, ( unsigned ) xStats.ulFailedRequests );
+        lResult = TEST_ADU_DOWNLOAD_FAIL;
+    }
+    else
+    {
+        printf( "\t%u connections, %u reconnects\n",
+                ( unsigned ) xStats.ulConnections, ( unsigned ) xStats.ulReconnects );
+    }
+
+    TestHttpServer_SetCloseAfter( 0 );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestHttpsResumption( void )
+{
+    SampleADUDownloadStats_t xStats;
+    TlsSessionCacheStats_t xBefore;
+    TlsSessionCacheStats_t xAfter;
+    uint32_t ulHandshakes;
+    int lResult = TEST_ADU_DOWNLOAD_SUCCESS;
+
+    printf( "HTTPS download with the server closing the connection every %u requests\n",
+            ( unsigned ) TEST_SERVER_CLOSE_AFTER );
+
+    TLS_SessionCache_Invalidate( TEST_HOST_NAME, TEST_PORT );
+    TestHttpServer_SetCloseAfter( TEST_SERVER_CLOSE_AFTER );
+    TLS_SessionCache_GetStats( &xBefore );
+    ulHandshakes = TestTlsServer_GetHandshakes();
+
+    if( prvDownload( pdTRUE, 0, &xStats, NULL ) != TEST_ADU_DOWNLOAD_SUCCESS )
+    {
+        lResult = TEST_ADU_DOWNLOAD_FAIL;
+    }
+
+    TLS_SessionCache_GetStats( &xAfter );
+    TestHttpServer_SetCloseAfter( 0 );
+
+    /* Only the first connection makes a full handshake. */
+    if( ( lResult == TEST_ADU_DOWNLOAD_SUCCESS ) &&
+        ( ( xStats.ulConnections != TestTlsServer_GetHandshakes() - ulHandshakes ) ||
+          ( xAfter.ulFullHandshakes - xBefore.ulFullHandshakes != 1U ) ||
+          ( xAfter.ulHits - xBefore.ulHits != xStats.ulReconnects ) ) )
+    {
+        printf( "\t%u connections, %u handshakes, %u full, %u resumed!\n",
+                ( unsigned ) xStats.ulConnections,
+                ( unsigned ) ( TestTlsServer_GetHandshakes() - ulHandshakes ),
+                ( unsigned ) ( xAfter.ulFullHandshakes - xBefore.ulFullHandshakes ),
+                ( unsigned ) ( xAfter.ulHits - xBefore.ulHits ) );
+        lResult = TEST_ADU_DOWNLOAD_FAIL;
+    }
+    else if( lResult == TEST_ADU_DOWNLOAD_SUCCESS )
+    {
+        printf( "\t%u connections, %u resumed; full handshake %u ms, resumed %u ms\n",
+                ( unsigned ) xStats.ulConnections,
+                ( unsigned ) ( xAfter.ulHits - xBefore.ulHits ),
+                ( unsigned ) ( xAfter.xAvgFullHandshake * portTICK_PERIOD_MS ),
+                ( unsigned ) ( xAfter.xAvgResumedHandshake * portTICK_PERIOD_MS ) );
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestBenchmark( void )
+{
+    static const char * const pcSchemes[] = { "HTTP ", "HTTPS" };
+    SampleADUDownloadStats_t xStats;
+    uint64_t ullCpuUs;
+    uint32_t ulElapsedMs;
+    uint32_t ulRate100;
+    uint32_t ulMBytes100 = ( uint32_t ) ( ( ( uint64_t ) testhttpIMAGE_SIZE * 100U ) / ( 1024U * 1024U ) );
+    BaseType_t xHttps;
+
+    printf( "Throughput and CPU time per MB of the downloading task, keep-alive\n" );
+
+    for( xHttps = pdFALSE; xHttps <= pdTRUE; xHttps++ )
+    {
+        if( prvDownload( xHttps, 0, &xStats, &ullCpuUs ) != TEST_ADU_DOWNLOAD_SUCCESS )
+        {
+            return TEST_ADU_DOWNLOAD_FAIL;
+        }
+
+        ulElapsedMs = ( uint32_t ) ( xStats.xElapsed * portTICK_PERIOD_MS );
+        ulRate100 = ( ulElapsedMs == 0U ) ? 0U : ( ulMBytes100 * 1000U / ulElapsedMs );
+
+        printf( "\t%s: %u.%02u MB in %u ms, %u.%02u MB/s, %u us CPU per MB\n",
+                pcSchemes[ xHttps ],
+                ( unsigned ) ( ulMBytes100 / 100U ), ( unsigned ) ( ulMBytes100 % 100U ),
+                ( unsigned ) ulElapsedMs,
+                ( unsigned ) ( ulRate100 / 100U ), ( unsigned ) ( ulRate100 % 100U ),
+                ( unsigned ) ( ullCpuUs * 100U / ulMBytes100 ) );
+    }
+
+    return TEST_ADU_DOWNLOAD_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_ADU_DOWNLOAD_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( TestHttpServer_Start( TEST_PORT ) != pdPASS )
+    {
+        printf( "Failed to start the test server!\n" );
+        lResult = TEST_ADU_DOWNLOAD_FAIL;
+    }
+    else if( ( prvTestKeepAlive() != TEST_ADU_DOWNLOAD_SUCCESS ) ||
+             ( prvTestServerClose() != TEST_ADU_DOWNLOAD_SUCCESS ) ||
+             ( prvTestHttpsResumption() != TEST_ADU_DOWNLOAD_SUCCESS ) ||
+             ( prvTestBenchmark() != TEST_ADU_DOWNLOAD_SUCCESS ) )
+    {
+        lResult = TEST_ADU_DOWNLOAD_FAIL;
+    }
+
+    printf( lResult == TEST_ADU_DOWNLOAD_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "AduDownload", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_ADU_DOWNLOAD_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_ADU_DOWNLOAD_FAIL;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,327 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file test_http_server.c
+ * @brief HTTP/1.1 server on the loopback sockets, for the ADU download tests.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* mbed TLS includes. */
+#include "mbedtls/ssl.h"
+
+#include "sockets_wrapper_loopback.h"
+#include "test_tls_server.h"
+#include "test_http_server.h"
+
+#define testhttpSERVER_STACK_SIZE      ( 8 * 1024 )
+#define testhttpSERVER_PRIORITY        ( tskIDLE_PRIORITY + 1 )
+#define testhttpREQUEST_SIZE           ( 1024U )
+#define testhttpSEND_SIZE              ( 2048U )
+
+/*-----------------------------------------------------------*/
+
+typedef struct HttpConnection
+{
+    SocketHandle xSocket;
+    mbedtls_ssl_context * pxSsl; /**< NULL over plain TCP. */
+} HttpConnection_t;
+
+/*-----------------------------------------------------------*/
+
+static volatile BaseType_t xServeTls = pdFALSE;
+static volatile uint32_t ulCloseAfter = 0;
+static volatile uint32_t ulConnections = 0;
+
+/*-----------------------------------------------------------*/
+
+static int32_t prvRecv( HttpConnection_t * pxConnection,
+                        uint8_t * pucBuffer,
+                        size_t xLength )
+{
+    int32_t lRet;
+
+    if( pxConnection->pxSsl == NULL )
+    {
+        lRet = Sockets_Recv( pxConnection->xSocket, pucBuffer, xLength );
+    }
+    else
+    {
+        do
+        {
+            lRet = mbedtls_ssl_read( pxConnection->pxSsl, pucBuffer, xLength );
+        } while( ( lRet == MBEDTLS_ERR_SSL_WANT_READ ) ||
+                 ( lRet == MBEDTLS_ERR_SSL_WANT_WRITE ) );
+
+        /* The client closed the connection. */
+        if( lRet == 0 )
+        {
+            lRet = -1;
+        }
+    }
+
+    return lRet;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvSendAll( HttpConnection_t * pxConnection,
+                              const uint8_t * pucData,
+                              size_t xLength )
+{
+    int32_t lSent;
+
+    while( xLength > 0U )
+    {
+        if( pxConnection->pxSsl == NULL )
+        {
+            lSent = Sockets_Send( pxConnection->xSocket, pucData, xLength );
+        }
+        else
+        {
+            lSent = mbedtls_ssl_write( pxConnection->pxSsl, pucData, xLength );
+
+            if( ( lSent == MBEDTLS_ERR_SSL_WANT_READ ) ||
+                ( lSent == MBEDTLS_ERR_SSL_WANT_WRITE ) )
+            {
+                continue;
+            }
+        }
+
+        if( lSent <= 0 )
+        {
+            return pdFAIL;
+        }
+
+        pucData += lSent;
+        xLength -= ( size_t ) lSent;
+    }
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+/* Send bytes [ulStart, ulEnd] of the image. */
+static BaseType_t prvSendImage( HttpConnection_t * pxConnection,
+                                uint32_t ulStart,
+                                uint32_t ulEnd )
+{
+    uint8_t ucChunk[ testhttpSEND_SIZE ];
+    uint32_t ulLength;
+    uint32_t i;
+    BaseType_t xStatus = pdPASS;
+
+    while( ( ulStart <= ulEnd ) && ( xStatus == pdPASS ) )
+    {
+        ulLength = ulEnd - ulStart + 1U;
+
+        if( ulLength > sizeof( ucChunk ) )
+        {
+            ulLength = sizeof( ucChunk );
+        }
+
+        for( i = 0; i < ulLength; i++ )
+        {
+            ucChunk[ i ] = TestHttpServer_ImageByte( ulStart + i );
+        }
+
+        xStatus = prvSendAll( pxConnection, ucChunk, ulLength );
+        ulStart += ulLength;
+    }
+
+    return xStatus;
+}
+/*-----------------------------------------------------------*/
+
+/* Read one request, up to the end of its headers. Requests have no body. */
+static BaseType_t prvReadRequest( HttpConnection_t * pxConnection,
+                                  char * pcRequest,
+                                  size_t xRequestSize )
+{
+    size_t xLength = 0;
+    int32_t lReceived;
+
+    pcRequest[ 0 ] = '\0';
+
+    while( strstr( pcRequest, "\r\n\r\n" ) == NULL )
+    {
+        if( xLength == xRequestSize - 1U )
+        {
+            return pdFAIL;
+        }
+
+        lReceived = prvRecv( pxConnection, ( uint8_t * ) &pcRequest[ xLength ],
+                             xRequestSize - 1U - xLength );
+
+        if( lReceived < 0 )
+        {
+            /* The client closed the connection. */
+            return pdFAIL;
+        }
+
+        xLength += ( size_t ) lReceived;
+        pcRequest[ xLength ] = '\0';
+    }
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+/* Answer HEAD and GET requests for the image, honoring a "Range: bytes=a-b"
+ * header. */
+static BaseType_t prvServeRequest( HttpConnection_t * pxConnection,
+                                   const char * pcRequest )
+{
+    char cHeaders[ 256 ];
+    const char * pcRange;
+    unsigned long ulStart = 0;
+    unsigned long ulEnd = testhttpIMAGE_SIZE - 1U;
+    BaseType_t xHead = ( strncmp( pcRequest, "HEAD ", 5 ) == 0 ) ? pdTRUE : pdFALSE;
+    BaseType_t xRange = pdFALSE;
+    int lLength;
+
+    pcRange = strstr( pcRequest, "Range: bytes=" );
+
+    if( ( pcRange != NULL ) &&
+        ( sscanf( pcRange, "Range: bytes=%lu-%lu", &ulStart, &ulEnd ) == 2 ) )
+    {
+        xRange = pdTRUE;
+
+        if( ulEnd >= testhttpIMAGE_SIZE )
+        {
+            ulEnd = testhttpIMAGE_SIZE - 1U;
+        }
+    }
+
+    if( xRange == pdTRUE )
+    {
+        lLength = snprintf( cHeaders, sizeof( cHeaders ),
+                            "HTTP/1.1 206 Partial Content\r\n"
+                            "Content-Range: bytes %lu-%lu/%u\r\n"
+                            "Content-Length: %lu\r\n"
+                            "\r\n",
+                            ulStart, ulEnd, ( unsigned ) testhttpIMAGE_SIZE,
+                            ulEnd - ulStart + 1U );
+    }
+    else
+    {
+        lLength = snprintf( cHeaders, sizeof( cHeaders ),
+                            "HTTP/1.1 200 OK\r\n"
+                            "Content-Length: %u\r\n"
+                            "\r\n",
+                            ( unsigned ) testhttpIMAGE_SIZE );
+    }
+
+    if( prvSendAll( pxConnection, ( const uint8_t * ) cHeaders, ( size_t ) lLength ) != pdPASS )
+    {
+        return pdFAIL;
+    }
+
+    return ( xHead == pdTRUE ) ? pdPASS : prvSendImage( pxConnection, ulStart, ulEnd );
+}
+/*-----------------------------------------------------------*/
+
+static void prvServeConnection( HttpConnection_t * pxConnection )
+{
+    char cRequest[ testhttpREQUEST_SIZE ];
+    uint32_t ulRequests = 0;
+
+    while( ( prvReadRequest( pxConnection, cRequest, sizeof( cRequest ) ) == pdPASS ) &&
+           ( prvServeRequest( pxConnection, cRequest ) == pdPASS ) )
+    {
+        ulRequests++;
+
+        if( ( ulCloseAfter != 0U ) && ( ulRequests >= ulCloseAfter ) )
+        {
+            break;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvServerTask( void * pvParameters )
+{
+    HttpConnection_t xConnection;
+    mbedtls_ssl_context xSsl;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        xConnection.xSocket = Loopback_Accept( portMAX_DELAY );
+
+        if( xConnection.xSocket == SOCKETS_INVALID_SOCKET )
+        {
+            continue;
+        }
+
+        ulConnections++;
+
+        if( xServeTls == pdFALSE )
+        {
+            xConnection.pxSsl = NULL;
+            prvServeConnection( &xConnection );
+        }
+        else
+        {
+            xConnection.pxSsl = &xSsl;
+
+            if( TestTlsServer_Handshake( xConnection.xSocket, &xSsl ) == 0 )
+            {
+                prvServeConnection( &xConnection );
+                ( void ) mbedtls_ssl_close_notify( &xSsl );
+            }
+
+            mbedtls_ssl_free( &xSsl );
+        }
+
+        Sockets_Disconnect( xConnection.xSocket );
+        ( void ) Sockets_Close( xConnection.xSocket );
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t TestHttpServer_Start( uint16_t usPort )
+{
+    BaseType_t xResult = pdFAIL;
+
+    if( ( TestTlsServer_Init() == pdPASS ) &&
+        ( Loopback_Listen( usPort ) == SOCKETS_ERROR_NONE ) &&
+        ( xTaskCreate( prvServerTask, "HttpServer", testhttpSERVER_STACK_SIZE,
+                       NULL, testhttpSERVER_PRIORITY, NULL ) == pdPASS ) )
+    {
+        xResult = pdPASS;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+void TestHttpServer_SetTls( BaseType_t xTls )
+{
+    xServeTls = xTls;
+}
+/*-----------------------------------------------------------*/
+
+void TestHttpServer_SetCloseAfter( uint32_t ulRequests )
+{
+    ulCloseAfter = ulRequests;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t TestHttpServer_GetConnections( void )
+{
+    return ulConnections;
+}
+/*-----------------------------------------------------------*/
+
+uint8_t TestHttpServer_ImageByte( uint32_t ulOffset )
+{
+    return ( uint8_t ) ( ( ulOffset * 2654435761U ) >> 24 );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,62 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file test_http_server.h
+ * @brief HTTP/1.1 server on the loopback sockets, serving one generated image
+ * in ranges, over plain TCP or TLS, for the ADU download tests.
+ */
+
+#ifndef TEST_HTTP_SERVER_H
+#define TEST_HTTP_SERVER_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/**
+ * @brief Size of the image served, in bytes.
+ */
+#ifndef testhttpIMAGE_SIZE
+    #define testhttpIMAGE_SIZE    ( 2U * 1024U * 1024U )
+#endif
+
+/**
+ * @brief Start the server.
+ *
+ * Connections are served one at a time, as long as the client keeps them
+ * open. HEAD and GET requests for any path get the image, or the range of it
+ * asked for with a "Range: bytes=a-b" header.
+ *
+ * @param[in] usPort Port to listen on.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t TestHttpServer_Start( uint16_t usPort );
+
+/**
+ * @brief Serve the connections accepted from now on over TLS, with the
+ * certificate of test_tls_server.h, or over plain TCP.
+ *
+ * @param[in] xTls pdTRUE for TLS, pdFALSE for plain TCP.
+ */
+void TestHttpServer_SetTls( BaseType_t xTls );
+
+/**
+ * @brief Close each connection after this many requests, as servers with a
+ * keep-alive limit do.
+ *
+ * @param[in] ulRequests Requests per connection, 0 for no limit.
+ */
+void TestHttpServer_SetCloseAfter( uint32_t ulRequests );
+
+/**
+ * @brief Number of connections the server has accepted.
+ */
+uint32_t TestHttpServer_GetConnections( void );
+
+/**
+ * @brief Byte of the image at an offset, to check downloads against.
+ */
+uint8_t TestHttpServer_ImageByte( uint32_t ulOffset );
+
+#endif /* TEST_HTTP_SERVER_H */
@@ -0,0 +1,462 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  TEST OF THE SOCKETS WRAPPER DNS CACHE
+ *
+ *  Runs the cache against a resolver that takes TEST_RESOLVE_MS per lookup.
+ *  Checks that cached and stale lookups do not wait for it, that names are
+ *  resolved again in the background before their TTL elapses and after it
+ *  elapsed, that addresses past the stale window are not returned, and that
+ *  the least recently used name is evicted, that names nobody looks up are
+ *  dropped, and that a prefetched name that never resolves is dropped after
+ *  socketsDNS_CACHE_MAX_RETRIES attempts.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sockets_dns_cache.h"
+
+#define TEST_SOCKETS_DNS_CACHE_SUCCESS    0
+#define TEST_SOCKETS_DNS_CACHE_FAIL       1
+
+#define TEST_HUB_HOST_NAME                "hub.test"
+#define TEST_DPS_HOST_NAME                "dps.test"
+#define TEST_UNKNOWN_HOST_NAME            "unknown.test"
+#define TEST_RESOLVE_MS                   ( 100U )
+#define TEST_LONG_TTL_S                   ( 100U )
+
+/* Lookups faster than this did not wait for the resolver. */
+#define TEST_CACHED_MS                    ( TEST_RESOLVE_MS / 4U )
+
+#define TEST_TASK_STACK_SIZE              ( 8 * 1024 )
+#define TEST_TASK_PRIORITY                ( tskIDLE_PRIORITY + 2 )
+
+/*-----------------------------------------------------------*/
+
+static volatile uint32_t ulResolverAddress = 0x0100000AU;
+static volatile uint32_t ulResolverTtl = TEST_LONG_TTL_S;
+static volatile BaseType_t xResolverFails = pdFALSE;
+static volatile uint32_t ulResolverCalls = 0;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvTestResolver( const char * pcHostName,
+                                 uint32_t * pulTtlSeconds )
+{
+    ( void ) pcHostName;
+
+    ulResolverCalls++;
+    vTaskDelay( pdMS_TO_TICKS( TEST_RESOLVE_MS ) );
+    *pulTtlSeconds = ulResolverTtl;
+
+    return ( xResolverFails == pdTRUE ) ? 0U : ulResolverAddress;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvResolveTimed( const char * pcHostName,
+                                 uint32_t * pulMs )
+{
+    TickType_t xStart = xTaskGetTickCount();
+    uint32_t ulAddress = Sockets_DnsCache_Resolve( pcHostName );
+
+    *pulMs = ( uint32_t ) ( ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS );
+
+    return ulAddress;
+}
+/*-----------------------------------------------------------*/
+
+static void prvResetResolver( uint32_t ulAddress,
+                              uint32_t ulTtl )
+{
+    /* Let a background resolution of the previous test finish, as it stores
+     * its name again. */
+    Sockets_DnsCache_Clear();
+    vTaskDelay( pdMS_TO_TICKS( 2U * TEST_RESOLVE_MS ) );
+    Sockets_DnsCache_Clear();
+
+    ulResolverAddress = ulAddress;
+    ulResolverTtl = ulTtl;
+    xResolverFails = pdFALSE;
+    ulResolverCalls = 0;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestMissThenHit( void )
+{
+    SocketsDnsCacheStats_t xBefore;
+    SocketsDnsCacheStats_t xAfter;
+    uint32_t ulMissMs;
+    uint32_t ulHitMs;
+    int lResult = TEST_SOCKETS_DNS_CACHE_SUCCESS;
+
+    printf( "Lookup, then lookups from the cache\n" );
+
+    prvResetResolver( 0x0100000AU, TEST_LONG_TTL_S );
+    Sockets_DnsCache_GetStats( &xBefore );
+
+    if( prvResolveTimed( TEST_HUB_HOST_NAME, &ulMissMs ) != 0x0100000AU )
+    {
+        printf( "\tWrong address on the first lookup!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    if( ( prvResolveTimed( TEST_HUB_HOST_NAME, &ulHitMs ) != 0x0100000AU ) ||
+        ( prvResolveTimed( TEST_HUB_HOST_NAME, &ulHitMs ) != 0x0100000AU ) )
+    {
+        printf( "\tWrong cached address!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    Sockets_DnsCache_GetStats( &xAfter );
+
+    printf( "\tFirst lookup: %u ms, cached lookup: %u ms\n",
+            ( unsigned ) ulMissMs, ( unsigned ) ulHitMs );
+
+    if( ( ulResolverCalls != 1U ) || ( ulHitMs >= TEST_CACHED_MS ) )
+    {
+        printf( "\tCached lookup went to the resolver!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    if( ( xAfter.ulMisses - xBefore.ulMisses != 1U ) ||
+        ( xAfter.ulFreshHits - xBefore.ulFreshHits != 2U ) )
+    {
+        printf( "\tUnexpected counters: %u misses, %u fresh hits!\n",
+                ( unsigned ) ( xAfter.ulMisses - xBefore.ulMisses ),
+                ( unsigned ) ( xAfter.ulFreshHits - xBefore.ulFreshHits ) );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestPrefetch( void )
+{
+    SocketsDnsCacheStats_t xBefore;
+    SocketsDnsCacheStats_t xAfter;
+    uint32_t ulMs;
+    int lResult = TEST_SOCKETS_DNS_CACHE_SUCCESS;
+
+    printf( "Prefetch, and resolution before the TTL elapses\n" );
+
+    prvResetResolver( 0x0200000AU, 1U );
+
+    if( Sockets_DnsCache_Prefetch( TEST_DPS_HOST_NAME ) != pdPASS )
+    {
+        printf( "\tPrefetch failed!\n" );
+        return TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    vTaskDelay( pdMS_TO_TICKS( 2U * TEST_RESOLVE_MS ) );
+
+    if( ( prvResolveTimed( TEST_DPS_HOST_NAME, &ulMs ) != 0x0200000AU ) ||
+        ( ulMs >= TEST_CACHED_MS ) )
+    {
+        printf( "\tPrefetched name not cached!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    /* With a TTL of 1 s, the name is resolved again about every 0.8 s and
+     * never goes stale. */
+    Sockets_DnsCache_GetStats( &xBefore );
+    vTaskDelay( pdMS_TO_TICKS( 2500U ) );
+
+    if( ( prvResolveTimed( TEST_DPS_HOST_NAME, &ulMs ) != 0x0200000AU ) ||
+        ( ulMs >= TEST_CACHED_MS ) )
+    {
+        printf( "\tName not kept in the cache!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    Sockets_DnsCache_GetStats( &xAfter );
+
+    printf( "\t%u background resolutions in 2.5 s\n",
+            ( unsigned ) ( xAfter.ulRefreshes - xBefore.ulRefreshes ) );
+
+    if( ( xAfter.ulRefreshes - xBefore.ulRefreshes < 2U ) ||
+        ( xAfter.ulFreshHits - xBefore.ulFreshHits != 1U ) ||
+        ( xAfter.ulStaleHits != xBefore.ulStaleHits ) )
+    {
+        printf( "\tName not resolved again before its TTL elapsed!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestStaleWhileRevalidate( void )
+{
+    SocketsDnsCacheStats_t xBefore;
+    SocketsDnsCacheStats_t xAfter;
+    uint32_t ulMs;
+    int lResult = TEST_SOCKETS_DNS_CACHE_SUCCESS;
+
+    printf( "Stale address while the name is resolved again\n" );
+
+    prvResetResolver( 0x0300000AU, 1U );
+
+    if( Sockets_DnsCache_Resolve( TEST_HUB_HOST_NAME ) != 0x0300000AU )
+    {
+        printf( "\tLookup failed!\n" );
+        return TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    /* The resolution before the TTL elapses fails, so the address goes
+     * stale. It is retried 1 s later. */
+    xResolverFails = pdTRUE;
+    Sockets_DnsCache_GetStats( &xBefore );
+    vTaskDelay( pdMS_TO_TICKS( 1300U ) );
+
+    if( ( prvResolveTimed( TEST_HUB_HOST_NAME, &ulMs ) != 0x0300000AU ) ||
+        ( ulMs >= TEST_CACHED_MS ) )
+    {
+        printf( "\tStale address not returned at once!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    /* The retry gets the new address. */
+    ulResolverAddress = 0x0400000AU;
+    ulResolverTtl = TEST_LONG_TTL_S;
+    xResolverFails = pdFALSE;
+    vTaskDelay( pdMS_TO_TICKS( 1000U ) );
+
+    if( ( prvResolveTimed( TEST_HUB_HOST_NAME, &ulMs ) != 0x0400000AU ) ||
+        ( ulMs >= TEST_CACHED_MS ) )
+    {
+        printf( "\tAddress not resolved again!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    Sockets_DnsCache_GetStats( &xAfter );
+
+    if( ( xAfter.ulStaleHits - xBefore.ulStaleHits != 1U ) ||
+        ( xAfter.ulRefreshFailures == xBefore.ulRefreshFailures ) ||
+        ( xAfter.ulRefreshes - xBefore.ulRefreshes != 1U ) )
+    {
+        printf( "\tUnexpected counters: %u stale hits, %u failures, %u refreshes!\n",
+                ( unsigned ) ( xAfter.ulStaleHits - xBefore.ulStaleHits ),
+                ( unsigned ) ( xAfter.ulRefreshFailures - xBefore.ulRefreshFailures ),
+                ( unsigned ) ( xAfter.ulRefreshes - xBefore.ulRefreshes ) );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestStaleWindow( void )
+{
+    int lResult = TEST_SOCKETS_DNS_CACHE_SUCCESS;
+
+    printf( "No address once the stale window elapsed\n" );
+
+    prvResetResolver( 0x0500000AU, 1U );
+
+    if( Sockets_DnsCache_Resolve( TEST_HUB_HOST_NAME ) != 0x0500000AU )
+    {
+        printf( "\tLookup failed!\n" );
+        return TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    xResolverFails = pdTRUE;
+    vTaskDelay( pdMS_TO_TICKS( ( 1U + socketsDNS_CACHE_MAX_STALE_S ) * 1000U + 500U ) );
+
+    if( ( Sockets_DnsCache_Lookup( TEST_HUB_HOST_NAME ) != 0U ) ||
+        ( Sockets_DnsCache_Resolve( TEST_HUB_HOST_NAME ) != 0U ) )
+    {
+        printf( "\tAddress returned past the stale window!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestRefreshAndEviction( void )
+{
+    SocketsDnsCacheStats_t xBefore;
+    SocketsDnsCacheStats_t xAfter;
+    char cHostName[ 16 ];
+    uint32_t ulCalls;
+    uint32_t i;
+    int lResult = TEST_SOCKETS_DNS_CACHE_SUCCESS;
+
+    printf( "Refresh on demand, and eviction\n" );
+
+    prvResetResolver( 0x0600000AU, TEST_LONG_TTL_S );
+
+    ( void ) Sockets_DnsCache_Resolve( TEST_HUB_HOST_NAME );
+    ulResolverAddress = 0x0700000AU;
+    Sockets_DnsCache_Refresh( TEST_HUB_HOST_NAME );
+
+    /* The cached address is kept until the name resolved again. */
+    if( Sockets_DnsCache_Lookup( TEST_HUB_HOST_NAME ) != 0x0600000AU )
+    {
+        printf( "\tAddress dropped on refresh!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    vTaskDelay( pdMS_TO_TICKS( 2U * TEST_RESOLVE_MS ) );
+
+    if( Sockets_DnsCache_Lookup( TEST_HUB_HOST_NAME ) != 0x0700000AU )
+    {
+        printf( "\tName not resolved again on refresh!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    /* Fill the cache with other names; the hub name stays in use. */
+    Sockets_DnsCache_GetStats( &xBefore );
+
+    for( i = 0; i < socketsDNS_CACHE_ENTRIES; i++ )
+    {
+        ( void ) snprintf( cHostName, sizeof( cHostName ), "host%u.test", ( unsigned ) i );
+        vTaskDelay( 1 );
+        ( void ) Sockets_DnsCache_Resolve( cHostName );
+        ( void ) Sockets_DnsCache_Lookup( TEST_HUB_HOST_NAME );
+    }
+
+    Sockets_DnsCache_GetStats( &xAfter );
+    ulCalls = ulResolverCalls;
+
+    if( ( xAfter.ulEvictions - xBefore.ulEvictions != 1U ) ||
+        ( Sockets_DnsCache_Lookup( TEST_HUB_HOST_NAME ) == 0U ) ||
+        ( Sockets_DnsCache_Lookup( "host0.test" ) != 0U ) ||
+        ( ulResolverCalls != ulCalls ) )
+    {
+        printf( "\tLeast recently used name not evicted!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestIdleDrop( void )
+{
+    SocketsDnsCacheStats_t xBefore;
+    SocketsDnsCacheStats_t xAfter;
+    int lResult = TEST_SOCKETS_DNS_CACHE_SUCCESS;
+
+    printf( "Idle name dropped\n" );
+
+    prvResetResolver( 0x0800000AU, 1U );
+    Sockets_DnsCache_GetStats( &xBefore );
+
+    if( Sockets_DnsCache_Resolve( TEST_DPS_HOST_NAME ) != 0x0800000AU )
+    {
+        printf( "\tLookup failed!\n" );
+        return TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    /* Resolved again in the background until it went unused for
+     * socketsDNS_CACHE_IDLE_TTLS TTLs of 1 s. */
+    vTaskDelay( pdMS_TO_TICKS( socketsDNS_CACHE_IDLE_TTLS * 1000U + 1500U ) );
+
+    Sockets_DnsCache_GetStats( &xAfter );
+
+    if( ( xAfter.ulIdleDrops - xBefore.ulIdleDrops != 1U ) ||
+        ( Sockets_DnsCache_Lookup( TEST_DPS_HOST_NAME ) != 0U ) )
+    {
+        printf( "\tIdle name not dropped!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestFailureDrop( void )
+{
+    SocketsDnsCacheStats_t xBefore;
+    SocketsDnsCacheStats_t xAfter;
+    uint32_t ulCalls;
+    int lResult = TEST_SOCKETS_DNS_CACHE_SUCCESS;
+
+    printf( "Name that never resolves dropped\n" );
+
+    prvResetResolver( 0x0900000AU, 1U );
+    xResolverFails = pdTRUE;
+    Sockets_DnsCache_GetStats( &xBefore );
+
+    if( Sockets_DnsCache_Prefetch( TEST_UNKNOWN_HOST_NAME ) != pdPASS )
+    {
+        printf( "\tPrefetch failed!\n" );
+        return TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    /* Tried at once, then every socketsDNS_CACHE_RETRY_S of 1 s. */
+    vTaskDelay( pdMS_TO_TICKS( socketsDNS_CACHE_MAX_RETRIES * ( 1000U + TEST_RESOLVE_MS ) + 500U ) );
+    Sockets_DnsCache_GetStats( &xAfter );
+    ulCalls = ulResolverCalls;
+
+    if( ( xAfter.ulFailureDrops - xBefore.ulFailureDrops != 1U ) ||
+        ( ulCalls != socketsDNS_CACHE_MAX_RETRIES ) )
+    {
+        printf( "\tName not dropped after %u failures: %u attempts!\n",
+                ( unsigned ) socketsDNS_CACHE_MAX_RETRIES, ( unsigned ) ulCalls );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    vTaskDelay( pdMS_TO_TICKS( 1500U ) );
+
+    if( ulResolverCalls != ulCalls )
+    {
+        printf( "\tDropped name still resolved!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_SOCKETS_DNS_CACHE_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( Sockets_DnsCache_Init( prvTestResolver ) != pdPASS )
+    {
+        printf( "Failed to start the DNS cache!\n" );
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+    else if( ( prvTestMissThenHit() != TEST_SOCKETS_DNS_CACHE_SUCCESS ) ||
+             ( prvTestPrefetch() != TEST_SOCKETS_DNS_CACHE_SUCCESS ) ||
+             ( prvTestStaleWhileRevalidate() != TEST_SOCKETS_DNS_CACHE_SUCCESS ) ||
+             ( prvTestStaleWindow() != TEST_SOCKETS_DNS_CACHE_SUCCESS ) ||
+             ( prvTestRefreshAndEviction() != TEST_SOCKETS_DNS_CACHE_SUCCESS ) ||
+             ( prvTestIdleDrop() != TEST_SOCKETS_DNS_CACHE_SUCCESS ) ||
+             ( prvTestFailureDrop() != TEST_SOCKETS_DNS_CACHE_SUCCESS ) )
+    {
+        lResult = TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    printf( lResult == TEST_SOCKETS_DNS_CACHE_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "SocketsDnsCache", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_SOCKETS_DNS_CACHE_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_SOCKETS_DNS_CACHE_FAIL;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,906 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  TEST OF THE FREERTOS+TCP SOCKETS WRAPPER
+ *
+ *  Runs sockets_wrapper_freertos_tcpip.c against mocked FreeRTOS+TCP headers.
+ *  The mocked sockets record the calls of the wrapper and report the events
+ *  the test sets. Checks that Sockets_Poll selects the events asked for, waits
+ *  for the timeout given, reports the events FreeRTOS_select found, and
+ *  releases its socket set. Checks that Sockets_CloseAsync shuts a connected
+ *  socket down without closing it, and that the linger task drains it without
+ *  blocking and closes it once the peer closed or socketsLINGER_TIMEOUT_MS
+ *  passed. Checks that Sockets_SetSockOpt maps each SOCKETS_SO_* option onto
+ *  the FREERTOS_SO_* option and value FreeRTOS+TCP expects.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* FreeRTOS+TCP includes. */
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_Sockets.h"
+#include "FreeRTOS_DNS.h"
+#include "FreeRTOS_TCP_IP.h"
+
+#include "sockets_wrapper.h"
+#include "sockets_linger.h"
+
+#define TEST_FREERTOS_TCPIP_SUCCESS    0
+#define TEST_FREERTOS_TCPIP_FAIL       1
+
+#define TEST_MAX_SOCKETS               ( 4 )
+#define TEST_ADDRESS                   ( 0x0100007FU )
+#define TEST_PENDING_BYTES             ( 40U )
+#define TEST_LINGER_WAIT_MS            ( socketsLINGER_POLL_MS * 3U )
+#define TEST_MAX_OPTIONS               ( 4 )
+
+/* Sliding window of a buffer, in segments. */
+#define TEST_SEGMENTS( bytes )    ( ( ( bytes ) + ipconfigTCP_MSS - 1 ) / ipconfigTCP_MSS )
+
+#define TEST_TASK_STACK_SIZE           ( 8 * 1024 )
+#define TEST_TASK_PRIORITY             ( tskIDLE_PRIORITY + 2 )
+
+/*
+ * A mocked FreeRTOS+TCP socket.
+ */
+struct xSOCKET
+{
+    BaseType_t xInUse;
+    volatile BaseType_t xConnected;
+    EventBits_t xReady;        /* Events FreeRTOS_select finds. */
+    EventBits_t xSelectBits;   /* Events the socket is selected for. */
+    EventBits_t xSelectedBits; /* Events it was selected for by the last FreeRTOS_select. */
+    SocketSet_t xSocketSet;    /* Set the socket belongs to, if any. */
+    volatile size_t uxPending; /* Bytes FreeRTOS_recv returns. */
+    BaseType_t xRecvFlags;     /* Flags of the last FreeRTOS_recv. */
+    uint32_t ulShutdowns;      /* FreeRTOS_shutdown calls with FREERTOS_SHUT_RDWR. */
+};
+
+/*
+ * A mocked FreeRTOS+TCP socket set.
+ */
+struct xSOCKET_SET
+{
+    BaseType_t xInUse;
+};
+
+/*
+ * A FreeRTOS_setsockopt call.
+ */
+typedef struct TestOption
+{
+    int32_t lOptionName;
+    size_t uxOptionLength;
+
+    union
+    {
+        TickType_t xTicks;
+        BaseType_t xFlag;
+        uint32_t ulBytes;
+        WinProperties_t xWindow;
+    } xValue;
+} TestOption_t;
+
+static struct xSOCKET xTestSockets[ TEST_MAX_SOCKETS ];
+static struct xSOCKET_SET xTestSocketSet;
+static BaseType_t xTestSocketSetFails = pdFALSE;
+static uint32_t ulTestSocketSetsCreated = 0;
+static TickType_t xTestSelectTicks = 0;
+static TestOption_t xTestOptions[ TEST_MAX_OPTIONS ];
+static size_t xTestOptionCount = 0;
+static BaseType_t xTestSetSockOptFails = pdFALSE;
+
+/*-----------------------------------------------------------*/
+
+Socket_t FreeRTOS_socket( BaseType_t xDomain,
+                          BaseType_t xType,
+                          BaseType_t xProtocol )
+{
+    Socket_t xSocket = FREERTOS_INVALID_SOCKET;
+    size_t xIndex;
+
+    ( void ) xDomain;
+    ( void ) xType;
+    ( void ) xProtocol;
+
+    taskENTER_CRITICAL();
+    {
+        for( xIndex = 0; xIndex < TEST_MAX_SOCKETS; xIndex++ )
+        {
+            if( xTestSockets[ xIndex ].xInUse == pdFALSE )
+            {
+                ( void ) memset( &xTestSockets[ xIndex ], 0, sizeof( xTestSockets[ xIndex ] ) );
+                xTestSockets[ xIndex ].xInUse = pdTRUE;
+                xSocket = &xTestSockets[ xIndex ];
+                break;
+            }
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return xSocket;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t FreeRTOS_closesocket( Socket_t xSocket )
+{
+    taskENTER_CRITICAL();
+    {
+        xSocket->xInUse = pdFALSE;
+    }
+    taskEXIT_CRITICAL();
+
+    return 1;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t FreeRTOS_connect( Socket_t xClientSocket,
+                             struct freertos_sockaddr * pxAddress,
+                             uint32_t xAddressLength )
+{
+    ( void ) pxAddress;
+    ( void ) xAddressLength;
+
+    xClientSocket->xConnected = pdTRUE;
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t FreeRTOS_shutdown( Socket_t xSocket,
+                              BaseType_t xHow )
+{
+    if( xHow == FREERTOS_SHUT_RDWR )
+    {
+        xSocket->ulShutdowns++;
+    }
+
+    return ( xSocket->xConnected == pdTRUE ) ? 0 : -pdFREERTOS_ERRNO_ENOTCONN;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t FreeRTOS_recv( Socket_t xSocket,
+                          void * pvBuffer,
+                          size_t uxBufferLength,
+                          BaseType_t xFlags )
+{
+    BaseType_t xReceived;
+
+    taskENTER_CRITICAL();
+    {
+        xSocket->xRecvFlags = xFlags;
+
+        if( xSocket->uxPending > 0U )
+        {
+            xReceived = ( BaseType_t ) ( ( uxBufferLength < xSocket->uxPending ) ?
+                                         uxBufferLength : xSocket->uxPending );
+            ( void ) memset( pvBuffer, 0, ( size_t ) xReceived );
+            xSocket->uxPending -= ( size_t ) xReceived;
+        }
+        else
+        {
+            xReceived = ( xSocket->xConnected == pdTRUE ) ? 0 : -pdFREERTOS_ERRNO_ENOTCONN;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return xReceived;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t FreeRTOS_send( Socket_t xSocket,
+                          const void * pvBuffer,
+                          size_t uxDataLength,
+                          BaseType_t xFlags )
+{
+    ( void ) pvBuffer;
+    ( void ) xFlags;
+
+    return ( xSocket->xConnected == pdTRUE ) ? ( BaseType_t ) uxDataLength : -pdFREERTOS_ERRNO_ENOTCONN;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t FreeRTOS_setsockopt( Socket_t xSocket,
+                                int32_t lLevel,
+                                int32_t lOptionName,
+                                const void * pvOptionValue,
+                                size_t uxOptionLength )
+{
+    TestOption_t * pxOption;
+
+    ( void ) xSocket;
+    ( void ) lLevel;
+
+    if( xTestOptionCount < TEST_MAX_OPTIONS )
+    {
+        pxOption = &xTestOptions[ xTestOptionCount ];
+        pxOption->lOptionName = lOptionName;
+        pxOption->uxOptionLength = uxOptionLength;
+        ( void ) memcpy( &pxOption->xValue, pvOptionValue,
+                         ( uxOptionLength < sizeof( pxOption->xValue ) ) ? uxOptionLength : sizeof( pxOption->xValue ) );
+    }
+
+    xTestOptionCount++;
+
+    return ( xTestSetSockOptFails == pdFALSE ) ? 0 : FREERTOS_EINVAL;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t FreeRTOS_issocketconnected( Socket_t xSocket )
+{
+    return xSocket->xConnected;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t FreeRTOS_connstatus( Socket_t xSocket )
+{
+    return ( xSocket->xConnected == pdTRUE ) ? ( BaseType_t ) eESTABLISHED : ( BaseType_t ) eCLOSED;
+}
+/*-----------------------------------------------------------*/
+
+SocketSet_t FreeRTOS_CreateSocketSet( void )
+{
+    SocketSet_t xSocketSet = NULL;
+
+    if( ( xTestSocketSetFails == pdFALSE ) && ( xTestSocketSet.xInUse == pdFALSE ) )
+    {
+        xTestSocketSet.xInUse = pdTRUE;
+        xSocketSet = &xTestSocketSet;
+        ulTestSocketSetsCreated++;
+    }
+
+    return xSocketSet;
+}
+/*-----------------------------------------------------------*/
+
+void FreeRTOS_DeleteSocketSet( SocketSet_t xSocketSet )
+{
+    xSocketSet->xInUse = pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+void FreeRTOS_FD_SET( Socket_t xSocket,
+                      SocketSet_t xSocketSet,
+                      EventBits_t xBitsToSet )
+{
+    xSocket->xSocketSet = xSocketSet;
+    xSocket->xSelectBits |= ( xBitsToSet & ( EventBits_t ) eSELECT_ALL );
+}
+/*-----------------------------------------------------------*/
+
+void FreeRTOS_FD_CLR( Socket_t xSocket,
+                      SocketSet_t xSocketSet,
+                      EventBits_t xBitsToClear )
+{
+    ( void ) xSocketSet;
+
+    xSocket->xSelectBits &= ~xBitsToClear;
+
+    if( xSocket->xSelectBits == 0U )
+    {
+        xSocket->xSocketSet = NULL;
+    }
+}
+/*-----------------------------------------------------------*/
+
+EventBits_t FreeRTOS_FD_ISSET( Socket_t xSocket,
+                               SocketSet_t xSocketSet )
+{
+    return ( xSocket->xSocketSet == xSocketSet ) ? ( xSocket->xReady & xSocket->xSelectBits ) : 0U;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t FreeRTOS_select( SocketSet_t xSocketSet,
+                            TickType_t xBlockTimeTicks )
+{
+    BaseType_t xReady = 0;
+    size_t xIndex;
+
+    xTestSelectTicks = xBlockTimeTicks;
+
+    for( xIndex = 0; xIndex < TEST_MAX_SOCKETS; xIndex++ )
+    {
+        if( xTestSockets[ xIndex ].xSocketSet == xSocketSet )
+        {
+            xTestSockets[ xIndex ].xSelectedBits = xTestSockets[ xIndex ].xSelectBits;
+
+            if( ( xTestSockets[ xIndex ].xReady & xTestSockets[ xIndex ].xSelectBits ) != 0U )
+            {
+                xReady++;
+            }
+        }
+    }
+
+    return xReady;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t FreeRTOS_gethostbyname( const char * pcHostName )
+{
+    ( void ) pcHostName;
+
+    return TEST_ADDRESS;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t FreeRTOS_gethostbyname_a( const char * pcHostName,
+                                   FOnDNSEvent pCallback,
+                                   void * pvSearchID,
+                                   TickType_t uxTimeout )
+{
+    ( void ) pcHostName;
+    ( void ) pCallback;
+    ( void ) pvSearchID;
+    ( void ) uxTimeout;
+
+    return TEST_ADDRESS;
+}
+/*-----------------------------------------------------------*/
+
+void FreeRTOS_gethostbyname_cancel( void * pvSearchID )
+{
+    ( void ) pvSearchID;
+}
+/*-----------------------------------------------------------*/
+
+static int prvOpenConnected( SocketHandle * pxSockets,
+                             size_t xCount )
+{
+    int lResult = TEST_FREERTOS_TCPIP_SUCCESS;
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < xCount; xIndex++ )
+    {
+        pxSockets[ xIndex ] = Sockets_Open();
+
+        if( pxSockets[ xIndex ] == SOCKETS_INVALID_SOCKET )
+        {
+            printf( "\tFailed to open a socket!\n" );
+            lResult = TEST_FREERTOS_TCPIP_FAIL;
+        }
+        else
+        {
+            ( ( Socket_t ) pxSockets[ xIndex ] )->xConnected = pdTRUE;
+        }
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvCloseAll( SocketHandle * pxSockets,
+                         size_t xCount )
+{
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < xCount; xIndex++ )
+    {
+        ( void ) Sockets_Close( pxSockets[ xIndex ] );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvSocketsReleased( void )
+{
+    BaseType_t xReleased = ( xTestSocketSet.xInUse == pdFALSE ) ? pdTRUE : pdFALSE;
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < TEST_MAX_SOCKETS; xIndex++ )
+    {
+        if( xTestSockets[ xIndex ].xSocketSet != NULL )
+        {
+            xReleased = pdFALSE;
+        }
+    }
+
+    return xReleased;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestPollEvents( void )
+{
+    SocketHandle xSockets[ 3 ];
+    SocketsPollFd_t xPollSockets[ 3 ];
+    BaseType_t xReady;
+    int lResult = TEST_FREERTOS_TCPIP_SUCCESS;
+
+    printf( "Poll selects the events asked for and reports those found\n" );
+
+    if( prvOpenConnected( xSockets, 3 ) != TEST_FREERTOS_TCPIP_SUCCESS )
+    {
+        return TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    xPollSockets[ 0 ].xSocket = xSockets[ 0 ];
+    xPollSockets[ 0 ].ulEvents = SOCKETS_POLL_READ;
+    xPollSockets[ 1 ].xSocket = xSockets[ 1 ];
+    xPollSockets[ 1 ].ulEvents = SOCKETS_POLL_WRITE;
+    xPollSockets[ 2 ].xSocket = xSockets[ 2 ];
+    xPollSockets[ 2 ].ulEvents = SOCKETS_POLL_READ | SOCKETS_POLL_WRITE;
+
+    /* The second socket has data, but is only polled for sending. */
+    ( ( Socket_t ) xSockets[ 0 ] )->xReady = eSELECT_READ | eSELECT_WRITE;
+    ( ( Socket_t ) xSockets[ 1 ] )->xReady = eSELECT_READ;
+    ( ( Socket_t ) xSockets[ 2 ] )->xReady = eSELECT_WRITE | eSELECT_EXCEPT;
+
+    xReady = Sockets_Poll( xPollSockets, 3, 250U );
+
+    if( ( ( ( Socket_t ) xSockets[ 0 ] )->xSelectedBits != ( eSELECT_READ | eSELECT_EXCEPT ) ) ||
+        ( ( ( Socket_t ) xSockets[ 1 ] )->xSelectedBits != ( eSELECT_WRITE | eSELECT_EXCEPT ) ) ||
+        ( ( ( Socket_t ) xSockets[ 2 ] )->xSelectedBits != ( eSELECT_READ | eSELECT_WRITE | eSELECT_EXCEPT ) ) )
+    {
+        printf( "\tWrong events selected!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    if( xTestSelectTicks != pdMS_TO_TICKS( 250U ) )
+    {
+        printf( "\tWrong select timeout: %u ticks!\n", ( unsigned ) xTestSelectTicks );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    if( ( xReady != 2 ) ||
+        ( xPollSockets[ 0 ].ulRevents != SOCKETS_POLL_READ ) ||
+        ( xPollSockets[ 1 ].ulRevents != 0U ) ||
+        ( xPollSockets[ 2 ].ulRevents != ( SOCKETS_POLL_WRITE | SOCKETS_POLL_ERROR ) ) )
+    {
+        printf( "\tWrong events reported: %d ready, %x %x %x!\n", ( int ) xReady,
+                ( unsigned ) xPollSockets[ 0 ].ulRevents, ( unsigned ) xPollSockets[ 1 ].ulRevents,
+                ( unsigned ) xPollSockets[ 2 ].ulRevents );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    if( prvSocketsReleased() == pdFALSE )
+    {
+        printf( "\tSocket set not released!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    prvCloseAll( xSockets, 3 );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestPollIdle( void )
+{
+    SocketHandle xSockets[ 2 ];
+    SocketsPollFd_t xPollSockets[ 2 ];
+    BaseType_t xReady;
+    int lResult = TEST_FREERTOS_TCPIP_SUCCESS;
+
+    printf( "Poll without events, waiting forever or not at all\n" );
+
+    if( prvOpenConnected( xSockets, 2 ) != TEST_FREERTOS_TCPIP_SUCCESS )
+    {
+        return TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    xPollSockets[ 0 ].xSocket = xSockets[ 0 ];
+    xPollSockets[ 0 ].ulEvents = SOCKETS_POLL_READ;
+    xPollSockets[ 0 ].ulRevents = SOCKETS_POLL_READ;
+    xPollSockets[ 1 ].xSocket = xSockets[ 1 ];
+    xPollSockets[ 1 ].ulEvents = SOCKETS_POLL_READ;
+    xPollSockets[ 1 ].ulRevents = SOCKETS_POLL_ERROR;
+
+    xReady = Sockets_Poll( xPollSockets, 2, SOCKETS_POLL_WAIT_FOREVER );
+
+    if( xTestSelectTicks != portMAX_DELAY )
+    {
+        printf( "\tWait forever not passed on!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    if( ( xReady != 0 ) ||
+        ( xPollSockets[ 0 ].ulRevents != 0U ) ||
+        ( xPollSockets[ 1 ].ulRevents != 0U ) )
+    {
+        printf( "\tEvents reported on idle sockets!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    ( void ) Sockets_Poll( xPollSockets, 2, 0U );
+
+    if( xTestSelectTicks != 0U )
+    {
+        printf( "\tPoll without waiting waited!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    if( prvSocketsReleased() == pdFALSE )
+    {
+        printf( "\tSocket set not released!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    prvCloseAll( xSockets, 2 );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestPollErrors( void )
+{
+    SocketHandle xSocket;
+    SocketsPollFd_t xPollSocket;
+    uint32_t ulSetsCreated = ulTestSocketSetsCreated;
+    int lResult = TEST_FREERTOS_TCPIP_SUCCESS;
+
+    printf( "Poll errors\n" );
+
+    if( prvOpenConnected( &xSocket, 1 ) != TEST_FREERTOS_TCPIP_SUCCESS )
+    {
+        return TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    if( ( Sockets_Poll( NULL, 1, 0U ) != SOCKETS_EINVAL ) ||
+        ( ulTestSocketSetsCreated != ulSetsCreated ) )
+    {
+        printf( "\tNo sockets not rejected!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    xPollSocket.xSocket = xSocket;
+    xPollSocket.ulEvents = SOCKETS_POLL_READ;
+    xTestSocketSetFails = pdTRUE;
+
+    if( ( Sockets_Poll( &xPollSocket, 1, 0U ) != SOCKETS_ENOMEM ) ||
+        ( ( ( Socket_t ) xSocket )->xSocketSet != NULL ) )
+    {
+        printf( "\tNo socket set not reported!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    xTestSocketSetFails = pdFALSE;
+    prvCloseAll( &xSocket, 1 );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestCloseAsync( void )
+{
+    SocketHandle xSocket;
+    Socket_t xTcpSocket;
+    SocketsLingerStats_t xStats;
+    uint32_t ulClosed;
+    int lResult = TEST_FREERTOS_TCPIP_SUCCESS;
+
+    printf( "Close without waiting for the peer\n" );
+
+    if( prvOpenConnected( &xSocket, 1 ) != TEST_FREERTOS_TCPIP_SUCCESS )
+    {
+        return TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    xTcpSocket = ( Socket_t ) xSocket;
+    xTcpSocket->uxPending = TEST_PENDING_BYTES;
+    Sockets_Linger_GetStats( &xStats );
+    ulClosed = xStats.ulClosed;
+
+    if( ( Sockets_CloseAsync( xSocket ) != SOCKETS_ERROR_NONE ) ||
+        ( xTcpSocket->ulShutdowns != 1U ) ||
+        ( xTcpSocket->xInUse == pdFALSE ) )
+    {
+        printf( "\tSocket not shut down, or closed at once!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    vTaskDelay( pdMS_TO_TICKS( TEST_LINGER_WAIT_MS ) );
+
+    if( ( xTcpSocket->xInUse == pdFALSE ) ||
+        ( xTcpSocket->uxPending != 0U ) ||
+        ( xTcpSocket->xRecvFlags != FREERTOS_MSG_DONTWAIT ) )
+    {
+        printf( "\tLingering socket not drained without blocking, or closed before its peer!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    /* The FIN of the peer arrives. */
+    xTcpSocket->xConnected = pdFALSE;
+    vTaskDelay( pdMS_TO_TICKS( TEST_LINGER_WAIT_MS ) );
+    Sockets_Linger_GetStats( &xStats );
+
+    if( ( xTcpSocket->xInUse != pdFALSE ) ||
+        ( xStats.ulClosed != ulClosed + 1U ) )
+    {
+        printf( "\tSocket not closed once its peer closed!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestCloseAsyncTimeout( void )
+{
+    SocketHandle xSocket;
+    Socket_t xTcpSocket;
+    SocketsLingerStats_t xStats;
+    uint32_t ulTimedOut;
+    int lResult = TEST_FREERTOS_TCPIP_SUCCESS;
+
+    printf( "Close a socket whose peer never closes\n" );
+
+    if( prvOpenConnected( &xSocket, 1 ) != TEST_FREERTOS_TCPIP_SUCCESS )
+    {
+        return TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    xTcpSocket = ( Socket_t ) xSocket;
+    Sockets_Linger_GetStats( &xStats );
+    ulTimedOut = xStats.ulTimedOut;
+
+    ( void ) Sockets_CloseAsync( xSocket );
+    vTaskDelay( pdMS_TO_TICKS( socketsLINGER_TIMEOUT_MS + TEST_LINGER_WAIT_MS ) );
+    Sockets_Linger_GetStats( &xStats );
+
+    if( ( xTcpSocket->xInUse != pdFALSE ) ||
+        ( xStats.ulTimedOut != ulTimedOut + 1U ) )
+    {
+        printf( "\tSocket not closed after the linger timeout!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestCloseAsyncNotConnected( void )
+{
+    SocketHandle xSocket = Sockets_Open();
+    int lResult = TEST_FREERTOS_TCPIP_SUCCESS;
+
+    printf( "Close a socket that is not connected\n" );
+
+    if( xSocket == SOCKETS_INVALID_SOCKET )
+    {
+        printf( "\tFailed to open a socket!\n" );
+        return TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    if( ( Sockets_CloseAsync( xSocket ) != SOCKETS_ERROR_NONE ) ||
+        ( ( ( Socket_t ) xSocket )->xInUse != pdFALSE ) )
+    {
+        printf( "\tSocket not closed at once!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Set an option, and check how many FreeRTOS_setsockopt calls it made.
+ */
+static BaseType_t prvSetOption( SocketHandle xSocket,
+                                int32_t lOptionName,
+                                const void * pvOptionValue,
+                                size_t xOptionLength,
+                                BaseType_t xExpected,
+                                size_t xExpectedCalls )
+{
+    BaseType_t xRetVal;
+
+    xTestOptionCount = 0;
+    ( void ) memset( xTestOptions, 0, sizeof( xTestOptions ) );
+
+    xRetVal = Sockets_SetSockOpt( xSocket, lOptionName, pvOptionValue, xOptionLength );
+
+    if( ( xRetVal != xExpected ) || ( xTestOptionCount != xExpectedCalls ) )
+    {
+        printf( "\tOption %d returned %d after %u calls!\n", ( int ) lOptionName,
+                ( int ) xRetVal, ( unsigned ) xTestOptionCount );
+
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestSetSockOpt( void )
+{
+    SocketHandle xSocket = Sockets_Open();
+    TickType_t xTicks;
+    BaseType_t xFlag;
+    uint32_t ulBytes;
+    SocketsWindow_t xWindow = { 0 };
+    int lResult = TEST_FREERTOS_TCPIP_SUCCESS;
+
+    printf( "Socket options mapped onto FreeRTOS+TCP\n" );
+
+    if( xSocket == SOCKETS_INVALID_SOCKET )
+    {
+        printf( "\tFailed to open a socket!\n" );
+        return TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    /* A timeout of 0 waits forever. */
+    xTicks = 0U;
+
+    if( ( prvSetOption( xSocket, SOCKETS_SO_RCVTIMEO, &xTicks, sizeof( xTicks ), SOCKETS_ERROR_NONE, 1 ) == pdFALSE ) ||
+        ( xTestOptions[ 0 ].lOptionName != FREERTOS_SO_RCVTIMEO ) ||
+        ( xTestOptions[ 0 ].xValue.xTicks != portMAX_DELAY ) )
+    {
+        printf( "\tReceive timeout not mapped!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    xTicks = 100U;
+
+    if( ( prvSetOption( xSocket, SOCKETS_SO_SNDTIMEO, &xTicks, sizeof( xTicks ), SOCKETS_ERROR_NONE, 1 ) == pdFALSE ) ||
+        ( xTestOptions[ 0 ].lOptionName != FREERTOS_SO_SNDTIMEO ) ||
+        ( xTestOptions[ 0 ].xValue.xTicks != 100U ) )
+    {
+        printf( "\tSend timeout not mapped!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    /* Non-blocking mode sets both timeouts. */
+    xFlag = pdTRUE;
+
+    if( ( prvSetOption( xSocket, SOCKETS_SO_NONBLOCK, &xFlag, sizeof( xFlag ), SOCKETS_ERROR_NONE, 2 ) == pdFALSE ) ||
+        ( xTestOptions[ 0 ].lOptionName != FREERTOS_SO_RCVTIMEO ) ||
+        ( xTestOptions[ 0 ].xValue.xTicks != 0U ) ||
+        ( xTestOptions[ 1 ].lOptionName != FREERTOS_SO_SNDTIMEO ) ||
+        ( xTestOptions[ 1 ].xValue.xTicks != 0U ) )
+    {
+        printf( "\tNon-blocking mode not mapped!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    xFlag = pdFALSE;
+
+    if( ( prvSetOption( xSocket, SOCKETS_SO_NONBLOCK, &xFlag, sizeof( xFlag ), SOCKETS_ERROR_NONE, 2 ) == pdFALSE ) ||
+        ( xTestOptions[ 0 ].xValue.xTicks != portMAX_DELAY ) ||
+        ( xTestOptions[ 1 ].xValue.xTicks != portMAX_DELAY ) )
+    {
+        printf( "\tBlocking mode not restored!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    /* FreeRTOS+TCP sends at once unless told to wait for full segments. */
+    xFlag = pdTRUE;
+
+    if( ( prvSetOption( xSocket, SOCKETS_SO_NODELAY, &xFlag, sizeof( xFlag ), SOCKETS_ERROR_NONE, 1 ) == pdFALSE ) ||
+        ( xTestOptions[ 0 ].lOptionName != FREERTOS_SO_SET_FULL_SIZE ) ||
+        ( xTestOptions[ 0 ].xValue.xFlag != pdFALSE ) )
+    {
+        printf( "\tNo delay not mapped!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    xFlag = pdFALSE;
+
+    if( prvSetOption( xSocket, SOCKETS_SO_NODELAY, &xFlag, sizeof( xFlag ), SOCKETS_ENOPROTOOPT, 0 ) == pdFALSE )
+    {
+        printf( "\tCoalescing small segments not rejected!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    /* Keep-alive is set for all sockets by ipconfigTCP_KEEP_ALIVE. */
+    xFlag = pdTRUE;
+
+    if( prvSetOption( xSocket, SOCKETS_SO_KEEPALIVE, &xFlag, sizeof( xFlag ),
+                      ( ipconfigTCP_KEEP_ALIVE == 1 ) ? SOCKETS_ERROR_NONE : SOCKETS_ENOPROTOOPT, 0 ) == pdFALSE )
+    {
+        printf( "\tKeep-alive not reported as configured!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    ulBytes = 4096U;
+
+    if( ( prvSetOption( xSocket, SOCKETS_SO_SNDBUF, &ulBytes, sizeof( ulBytes ), SOCKETS_ERROR_NONE, 1 ) == pdFALSE ) ||
+        ( xTestOptions[ 0 ].lOptionName != FREERTOS_SO_SNDBUF ) ||
+        ( xTestOptions[ 0 ].uxOptionLength != sizeof( uint32_t ) ) ||
+        ( xTestOptions[ 0 ].xValue.ulBytes != 4096U ) )
+    {
+        printf( "\tSend buffer not mapped!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    ulBytes = 8192U;
+
+    if( ( prvSetOption( xSocket, SOCKETS_SO_RCVBUF, &ulBytes, sizeof( ulBytes ), SOCKETS_ERROR_NONE, 1 ) == pdFALSE ) ||
+        ( xTestOptions[ 0 ].lOptionName != FREERTOS_SO_RCVBUF ) ||
+        ( xTestOptions[ 0 ].uxOptionLength != sizeof( uint32_t ) ) ||
+        ( xTestOptions[ 0 ].xValue.ulBytes != 8192U ) )
+    {
+        printf( "\tReceive buffer not mapped!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    #if ( ipconfigUSE_TCP_WIN == 1 )
+
+        /* Buffers of 0 keep the defaults, windows of 0 span the buffers. */
+        xWindow.ulSendBufferBytes = 0U;
+        xWindow.ulSendWindowBytes = 0U;
+        xWindow.ulReceiveBufferBytes = 8000U;
+        xWindow.ulReceiveWindowBytes = 3000U;
+
+        if( ( prvSetOption( xSocket, SOCKETS_SO_WINDOW, &xWindow, sizeof( xWindow ), SOCKETS_ERROR_NONE, 1 ) == pdFALSE ) ||
+            ( xTestOptions[ 0 ].lOptionName != FREERTOS_SO_WIN_PROPERTIES ) ||
+            ( xTestOptions[ 0 ].xValue.xWindow.lTxBufSize != ipconfigTCP_TX_BUFFER_LENGTH ) ||
+            ( xTestOptions[ 0 ].xValue.xWindow.lTxWinSize != TEST_SEGMENTS( ipconfigTCP_TX_BUFFER_LENGTH ) ) ||
+            ( xTestOptions[ 0 ].xValue.xWindow.lRxBufSize != 8000 ) ||
+            ( xTestOptions[ 0 ].xValue.xWindow.lRxWinSize != TEST_SEGMENTS( 3000 ) ) )
+        {
+            printf( "\tWindow not mapped!\n" );
+            lResult = TEST_FREERTOS_TCPIP_FAIL;
+        }
+    #else
+        if( prvSetOption( xSocket, SOCKETS_SO_WINDOW, &xWindow, sizeof( xWindow ), SOCKETS_ENOPROTOOPT, 0 ) == pdFALSE )
+        {
+            printf( "\tWindow not rejected!\n" );
+            lResult = TEST_FREERTOS_TCPIP_FAIL;
+        }
+    #endif /* ipconfigUSE_TCP_WIN == 1 */
+
+    if( prvSetOption( xSocket, SOCKETS_SO_WINDOW + 100, &ulBytes, sizeof( ulBytes ), SOCKETS_ENOPROTOOPT, 0 ) == pdFALSE )
+    {
+        printf( "\tUnknown option not rejected!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    /* FreeRTOS+TCP rejects buffer sizes once connected. */
+    xTestSetSockOptFails = pdTRUE;
+
+    if( prvSetOption( xSocket, SOCKETS_SO_RCVBUF, &ulBytes, sizeof( ulBytes ), SOCKETS_EINVAL, 1 ) == pdFALSE )
+    {
+        printf( "\tFailed option not reported!\n" );
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    xTestSetSockOptFails = pdFALSE;
+    ( void ) Sockets_Close( xSocket );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_FREERTOS_TCPIP_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( ( prvTestPollEvents() != TEST_FREERTOS_TCPIP_SUCCESS ) ||
+        ( prvTestPollIdle() != TEST_FREERTOS_TCPIP_SUCCESS ) ||
+        ( prvTestPollErrors() != TEST_FREERTOS_TCPIP_SUCCESS ) ||
+        ( prvTestCloseAsync() != TEST_FREERTOS_TCPIP_SUCCESS ) ||
+        ( prvTestCloseAsyncTimeout() != TEST_FREERTOS_TCPIP_SUCCESS ) ||
+        ( prvTestCloseAsyncNotConnected() != TEST_FREERTOS_TCPIP_SUCCESS ) ||
+        ( prvTestSetSockOpt() != TEST_FREERTOS_TCPIP_SUCCESS ) )
+    {
+        lResult = TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    printf( lResult == TEST_FREERTOS_TCPIP_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "SocketsFreeRTOSTcpip", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_FREERTOS_TCPIP_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_FREERTOS_TCPIP_FAIL;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,254 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  TEST OF SOCKETS_CLOSEASYNC
+ *
+ *  Closes loopback connections with Sockets_CloseAsync. Checks that the call
+ *  returns at once while the peer sees the connection closed, that the socket
+ *  is released once the peer closed too, that a socket whose peer never closes
+ *  is released after socketsLINGER_TIMEOUT_MS, and that a socket closed while
+ *  all linger entries are taken is released at once.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sockets_wrapper_loopback.h"
+#include "sockets_linger.h"
+
+#define TEST_SOCKETS_LINGER_SUCCESS    0
+#define TEST_SOCKETS_LINGER_FAIL       1
+
+#define TEST_HOST_NAME                 "localhost"
+#define TEST_PORT                      ( 8443U )
+#define TEST_PEER_CLOSE_DELAY_MS       ( 300U )
+
+/* Closes faster than this did not wait for the peer. */
+#define TEST_ASYNC_CLOSE_MS            ( 10U )
+
+#define TEST_TASK_STACK_SIZE           ( 8 * 1024 )
+#define TEST_TASK_PRIORITY             ( tskIDLE_PRIORITY + 2 )
+
+/*-----------------------------------------------------------*/
+
+static int prvConnect( SocketHandle * pxClient,
+                       SocketHandle * pxServer )
+{
+    int lResult = TEST_SOCKETS_LINGER_SUCCESS;
+
+    *pxClient = Sockets_Open();
+
+    if( ( *pxClient == SOCKETS_INVALID_SOCKET ) ||
+        ( Sockets_Connect( *pxClient, TEST_HOST_NAME, TEST_PORT ) != SOCKETS_ERROR_NONE ) ||
+        ( ( *pxServer = Loopback_Accept( 0 ) ) == SOCKETS_INVALID_SOCKET ) )
+    {
+        printf( "\tFailed to connect!\n" );
+        lResult = TEST_SOCKETS_LINGER_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvCloseAsyncTimed( SocketHandle xSocket )
+{
+    TickType_t xStart = xTaskGetTickCount();
+
+    ( void ) Sockets_CloseAsync( xSocket );
+
+    return ( uint32_t ) ( ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS );
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestPeerCloses( void )
+{
+    SocketHandle xClient;
+    SocketHandle xServer;
+    SocketsLingerStats_t xStats;
+    uint8_t ucBuffer[ 16 ];
+    uint32_t ulMs;
+    int lResult = TEST_SOCKETS_LINGER_SUCCESS;
+
+    printf( "Socket released once the peer closed\n" );
+
+    if( prvConnect( &xClient, &xServer ) != TEST_SOCKETS_LINGER_SUCCESS )
+    {
+        return TEST_SOCKETS_LINGER_FAIL;
+    }
+
+    ulMs = prvCloseAsyncTimed( xClient );
+    Sockets_Linger_GetStats( &xStats );
+
+    if( ulMs >= TEST_ASYNC_CLOSE_MS )
+    {
+        printf( "\tClose waited %u ms!\n", ( unsigned ) ulMs );
+        lResult = TEST_SOCKETS_LINGER_FAIL;
+    }
+    else if( Sockets_Recv( xServer, ucBuffer, sizeof( ucBuffer ) ) != SOCKETS_ECLOSED )
+    {
+        printf( "\tPeer did not see the connection closed!\n" );
+        lResult = TEST_SOCKETS_LINGER_FAIL;
+    }
+    else if( xStats.ulLingering != 1U )
+    {
+        printf( "\tSocket not lingering!\n" );
+        lResult = TEST_SOCKETS_LINGER_FAIL;
+    }
+
+    vTaskDelay( pdMS_TO_TICKS( TEST_PEER_CLOSE_DELAY_MS ) );
+    Sockets_Disconnect( xServer );
+    ( void ) Sockets_Close( xServer );
+    vTaskDelay( pdMS_TO_TICKS( 2U * socketsLINGER_POLL_MS ) );
+
+    Sockets_Linger_GetStats( &xStats );
+
+    printf( "\tLingered %u ms\n", ( unsigned ) xStats.ulMaxLingerMs );
+
+    if( ( xStats.ulClosed != 1U ) || ( xStats.ulLingering != 0U ) ||
+        ( xStats.ulMaxLingerMs < TEST_PEER_CLOSE_DELAY_MS ) ||
+        ( xStats.ulMaxLingerMs > TEST_PEER_CLOSE_DELAY_MS + 2U * socketsLINGER_POLL_MS ) )
+    {
+        printf( "\tSocket not released once the peer closed!\n" );
+        lResult = TEST_SOCKETS_LINGER_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestTimeout( void )
+{
+    SocketHandle xClient;
+    SocketHandle xServer;
+    SocketsLingerStats_t xStats;
+    int lResult = TEST_SOCKETS_LINGER_SUCCESS;
+
+    printf( "Socket released after the linger timeout\n" );
+
+    if( prvConnect( &xClient, &xServer ) != TEST_SOCKETS_LINGER_SUCCESS )
+    {
+        return TEST_SOCKETS_LINGER_FAIL;
+    }
+
+    ( void ) prvCloseAsyncTimed( xClient );
+    vTaskDelay( pdMS_TO_TICKS( socketsLINGER_TIMEOUT_MS + 2U * socketsLINGER_POLL_MS ) );
+
+    Sockets_Linger_GetStats( &xStats );
+
+    if( ( xStats.ulTimedOut != 1U ) || ( xStats.ulLingering != 0U ) ||
+        ( xStats.ulMaxLingerMs < socketsLINGER_TIMEOUT_MS ) )
+    {
+        printf( "\tSocket not released after the timeout!\n" );
+        lResult = TEST_SOCKETS_LINGER_FAIL;
+    }
+
+    Sockets_Disconnect( xServer );
+    ( void ) Sockets_Close( xServer );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestOverflow( void )
+{
+    SocketHandle xClients[ socketsLINGER_MAX_SOCKETS + 1 ];
+    SocketHandle xServers[ socketsLINGER_MAX_SOCKETS + 1 ];
+    SocketsLingerStats_t xStats;
+    uint8_t ucBuffer[ 16 ];
+    size_t xIndex;
+    int lResult = TEST_SOCKETS_LINGER_SUCCESS;
+
+    printf( "Socket released at once when all linger entries are taken\n" );
+
+    for( xIndex = 0; xIndex <= socketsLINGER_MAX_SOCKETS; xIndex++ )
+    {
+        if( prvConnect( &xClients[ xIndex ], &xServers[ xIndex ] ) != TEST_SOCKETS_LINGER_SUCCESS )
+        {
+            return TEST_SOCKETS_LINGER_FAIL;
+        }
+    }
+
+    for( xIndex = 0; xIndex <= socketsLINGER_MAX_SOCKETS; xIndex++ )
+    {
+        ( void ) prvCloseAsyncTimed( xClients[ xIndex ] );
+    }
+
+    Sockets_Linger_GetStats( &xStats );
+
+    if( ( xStats.ulOverflows != 1U ) ||
+        ( xStats.ulLingering != socketsLINGER_MAX_SOCKETS ) ||
+        ( xStats.ulMaxLingering != socketsLINGER_MAX_SOCKETS ) )
+    {
+        printf( "\tLingering sockets not bounded!\n" );
+        lResult = TEST_SOCKETS_LINGER_FAIL;
+    }
+
+    for( xIndex = 0; xIndex <= socketsLINGER_MAX_SOCKETS; xIndex++ )
+    {
+        if( Sockets_Recv( xServers[ xIndex ], ucBuffer, sizeof( ucBuffer ) ) != SOCKETS_ECLOSED )
+        {
+            printf( "\tPeer %u did not see the connection closed!\n", ( unsigned ) xIndex );
+            lResult = TEST_SOCKETS_LINGER_FAIL;
+        }
+
+        Sockets_Disconnect( xServers[ xIndex ] );
+        ( void ) Sockets_Close( xServers[ xIndex ] );
+    }
+
+    vTaskDelay( pdMS_TO_TICKS( 2U * socketsLINGER_POLL_MS ) );
+    Sockets_Linger_GetStats( &xStats );
+
+    if( ( xStats.ulClosed != 1U + socketsLINGER_MAX_SOCKETS ) || ( xStats.ulLingering != 0U ) )
+    {
+        printf( "\tSockets not released once their peers closed!\n" );
+        lResult = TEST_SOCKETS_LINGER_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_SOCKETS_LINGER_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( Loopback_Listen( TEST_PORT ) != SOCKETS_ERROR_NONE )
+    {
+        printf( "Failed to listen!\n" );
+        lResult = TEST_SOCKETS_LINGER_FAIL;
+    }
+    else if( ( prvTestPeerCloses() != TEST_SOCKETS_LINGER_SUCCESS ) ||
+             ( prvTestTimeout() != TEST_SOCKETS_LINGER_SUCCESS ) ||
+             ( prvTestOverflow() != TEST_SOCKETS_LINGER_SUCCESS ) )
+    {
+        lResult = TEST_SOCKETS_LINGER_FAIL;
+    }
+
+    printf( lResult == TEST_SOCKETS_LINGER_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "SocketsLinger", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_SOCKETS_LINGER_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_SOCKETS_LINGER_FAIL;
+}
+/*-----------------------------------------------------------*/
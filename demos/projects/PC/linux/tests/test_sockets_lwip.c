@@ -0,0 +1,370 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  TEST OF THE LWIP SOCKETS WRAPPER
+ *
+ *  Runs sockets_wrapper_lwip.c against mocked lwIP headers, which map the
+ *  lwIP sockets onto the sockets of the host, and connects it to a listener on
+ *  the loopback interface. Checks that Sockets_Poll reports through
+ *  lwip_select only the sockets that have data or can send, that a peer
+ *  closing is reported readable, and that it rejects a missing socket array.
+ *  Checks that the receive buffer set through SOCKETS_SO_RCVBUF or
+ *  SOCKETS_SO_WINDOW reaches SO_RCVBUF, and that the send buffer is rejected.
+ *
+ *  lwip_select is the select() of the host here, which a signal of the
+ *  FreeRTOS POSIX port may interrupt, so the test only polls without waiting.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lwip/sockets.h"
+#include "lwip/dns.h"
+
+#include "sockets_wrapper.h"
+
+#define TEST_LWIP_SUCCESS       0
+#define TEST_LWIP_FAIL          1
+
+#define TEST_HOST_NAME          "localhost"
+#define TEST_CONNECTIONS        ( 2 )
+#define TEST_ACCEPT_TRIES       ( 100 )
+#define TEST_DELIVERY_MS        ( 20U )
+#define TEST_RCVBUF_BYTES       ( 4096U )
+
+#define TEST_TASK_STACK_SIZE    ( 8 * 1024 )
+#define TEST_TASK_PRIORITY      ( tskIDLE_PRIORITY + 2 )
+
+/*-----------------------------------------------------------*/
+
+static int lListener = -1;
+static uint16_t usListenerPort = 0;
+
+static SocketHandle xClientSockets[ TEST_CONNECTIONS ];
+static int lServerSockets[ TEST_CONNECTIONS ];
+static SocketsPollFd_t xPollSockets[ TEST_CONNECTIONS ];
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Every name resolves to the loopback address, as if lwIP had it cached.
+ */
+err_t dns_gethostbyname_addrtype( const char * hostname,
+                                  ip_addr_t * addr,
+                                  dns_found_callback found,
+                                  void * callback_arg,
+                                  uint8_t dns_addrtype )
+{
+    ( void ) hostname;
+    ( void ) found;
+    ( void ) callback_arg;
+    ( void ) dns_addrtype;
+
+    addr->addr = htonl( INADDR_LOOPBACK );
+
+    return ERR_OK;
+}
+/*-----------------------------------------------------------*/
+
+static int prvListen( void )
+{
+    struct sockaddr_in xAddress = { 0 };
+    socklen_t xAddressLength = sizeof( xAddress );
+    int lResult = TEST_LWIP_SUCCESS;
+
+    xAddress.sin_family = AF_INET;
+    xAddress.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    xAddress.sin_port = 0;
+
+    if( ( ( lListener = socket( AF_INET, SOCK_STREAM, 0 ) ) < 0 ) ||
+        ( bind( lListener, ( struct sockaddr * ) &xAddress, sizeof( xAddress ) ) != 0 ) ||
+        ( listen( lListener, TEST_CONNECTIONS ) != 0 ) ||
+        ( fcntl( lListener, F_SETFL, O_NONBLOCK ) != 0 ) ||
+        ( getsockname( lListener, ( struct sockaddr * ) &xAddress, &xAddressLength ) != 0 ) )
+    {
+        printf( "Failed to listen!\n" );
+        lResult = TEST_LWIP_FAIL;
+    }
+    else
+    {
+        usListenerPort = ntohs( xAddress.sin_port );
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvAccept( void )
+{
+    int lSocket = -1;
+    int lTries;
+
+    for( lTries = 0; ( lSocket < 0 ) && ( lTries < TEST_ACCEPT_TRIES ); lTries++ )
+    {
+        if( ( lSocket = accept( lListener, NULL, NULL ) ) < 0 )
+        {
+            vTaskDelay( 1 );
+        }
+    }
+
+    return lSocket;
+}
+/*-----------------------------------------------------------*/
+
+static int prvConnectAll( void )
+{
+    int lResult = TEST_LWIP_SUCCESS;
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < TEST_CONNECTIONS; xIndex++ )
+    {
+        xClientSockets[ xIndex ] = SOCKETS_INVALID_SOCKET;
+        lServerSockets[ xIndex ] = -1;
+    }
+
+    for( xIndex = 0; ( lResult == TEST_LWIP_SUCCESS ) && ( xIndex < TEST_CONNECTIONS ); xIndex++ )
+    {
+        xClientSockets[ xIndex ] = Sockets_Open();
+
+        if( ( xClientSockets[ xIndex ] == SOCKETS_INVALID_SOCKET ) ||
+            ( Sockets_Connect( xClientSockets[ xIndex ], TEST_HOST_NAME, usListenerPort ) != SOCKETS_ERROR_NONE ) ||
+            ( ( lServerSockets[ xIndex ] = prvAccept() ) < 0 ) )
+        {
+            printf( "\tFailed to connect!\n" );
+            lResult = TEST_LWIP_FAIL;
+        }
+        else
+        {
+            xPollSockets[ xIndex ].xSocket = xClientSockets[ xIndex ];
+        }
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvPoll( uint32_t ulEvents )
+{
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < TEST_CONNECTIONS; xIndex++ )
+    {
+        xPollSockets[ xIndex ].ulEvents = ulEvents;
+    }
+
+    return Sockets_Poll( xPollSockets, TEST_CONNECTIONS, 0U );
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestPoll( void )
+{
+    uint8_t ucData[ 4 ] = { 1, 2, 3, 4 };
+    BaseType_t xReady;
+    int lResult = TEST_LWIP_SUCCESS;
+
+    printf( "Poll through lwip_select\n" );
+
+    if( ( xReady = prvPoll( SOCKETS_POLL_READ ) ) != 0 )
+    {
+        printf( "\t%d idle sockets reported readable!\n", ( int ) xReady );
+        lResult = TEST_LWIP_FAIL;
+    }
+
+    if( ( ( xReady = prvPoll( SOCKETS_POLL_WRITE ) ) != TEST_CONNECTIONS ) ||
+        ( xPollSockets[ 0 ].ulRevents != SOCKETS_POLL_WRITE ) ||
+        ( xPollSockets[ 1 ].ulRevents != SOCKETS_POLL_WRITE ) )
+    {
+        printf( "\tConnected sockets not reported writable!\n" );
+        lResult = TEST_LWIP_FAIL;
+    }
+
+    /* Only the second connection gets data. */
+    if( send( lServerSockets[ 1 ], ucData, sizeof( ucData ), 0 ) != ( ssize_t ) sizeof( ucData ) )
+    {
+        printf( "\tFailed to send!\n" );
+        return TEST_LWIP_FAIL;
+    }
+
+    vTaskDelay( pdMS_TO_TICKS( TEST_DELIVERY_MS ) );
+
+    if( ( ( xReady = prvPoll( SOCKETS_POLL_READ ) ) != 1 ) ||
+        ( xPollSockets[ 0 ].ulRevents != 0U ) ||
+        ( xPollSockets[ 1 ].ulRevents != SOCKETS_POLL_READ ) )
+    {
+        printf( "\tWrong sockets reported readable: %d ready, %x %x!\n", ( int ) xReady,
+                ( unsigned ) xPollSockets[ 0 ].ulRevents, ( unsigned ) xPollSockets[ 1 ].ulRevents );
+        lResult = TEST_LWIP_FAIL;
+    }
+
+    if( ( ( xReady = prvPoll( SOCKETS_POLL_READ | SOCKETS_POLL_WRITE ) ) != TEST_CONNECTIONS ) ||
+        ( xPollSockets[ 0 ].ulRevents != SOCKETS_POLL_WRITE ) ||
+        ( xPollSockets[ 1 ].ulRevents != ( SOCKETS_POLL_READ | SOCKETS_POLL_WRITE ) ) )
+    {
+        printf( "\tWrong events reported: %x %x!\n",
+                ( unsigned ) xPollSockets[ 0 ].ulRevents, ( unsigned ) xPollSockets[ 1 ].ulRevents );
+        lResult = TEST_LWIP_FAIL;
+    }
+
+    /* The first peer closes. */
+    ( void ) close( lServerSockets[ 0 ] );
+    lServerSockets[ 0 ] = -1;
+    vTaskDelay( pdMS_TO_TICKS( TEST_DELIVERY_MS ) );
+
+    if( ( prvPoll( SOCKETS_POLL_READ ) != TEST_CONNECTIONS ) ||
+        ( xPollSockets[ 0 ].ulRevents != SOCKETS_POLL_READ ) )
+    {
+        printf( "\tPeer closing not reported readable!\n" );
+        lResult = TEST_LWIP_FAIL;
+    }
+
+    if( Sockets_Poll( NULL, TEST_CONNECTIONS, 0U ) != SOCKETS_EINVAL )
+    {
+        printf( "\tNo sockets not rejected!\n" );
+        lResult = TEST_LWIP_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvGetRcvBuf( SocketHandle xSocket )
+{
+    int lBytes = -1;
+    socklen_t xLength = sizeof( lBytes );
+
+    ( void ) getsockopt( ( int ) ( intptr_t ) xSocket, SOL_SOCKET, SO_RCVBUF, &lBytes, &xLength );
+
+    return lBytes;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestRcvBuf( void )
+{
+    SocketHandle xSocket = Sockets_Open();
+    SocketsWindow_t xWindow = { 0 };
+    uint32_t ulBytes;
+    int lDefault;
+    int lResult = TEST_LWIP_SUCCESS;
+
+    printf( "Receive buffer set through SO_RCVBUF\n" );
+
+    if( xSocket == SOCKETS_INVALID_SOCKET )
+    {
+        printf( "\tFailed to open a socket!\n" );
+        return TEST_LWIP_FAIL;
+    }
+
+    /* A size of 0 keeps the default. */
+    lDefault = prvGetRcvBuf( xSocket );
+    ulBytes = 0U;
+
+    if( ( Sockets_SetSockOpt( xSocket, SOCKETS_SO_RCVBUF, &ulBytes, sizeof( ulBytes ) ) != SOCKETS_ERROR_NONE ) ||
+        ( prvGetRcvBuf( xSocket ) != lDefault ) )
+    {
+        printf( "\tDefault receive buffer changed!\n" );
+        lResult = TEST_LWIP_FAIL;
+    }
+
+    /* The host may round the size up, or double it for its bookkeeping. */
+    ulBytes = TEST_RCVBUF_BYTES;
+
+    if( ( Sockets_SetSockOpt( xSocket, SOCKETS_SO_RCVBUF, &ulBytes, sizeof( ulBytes ) ) != SOCKETS_ERROR_NONE ) ||
+        ( prvGetRcvBuf( xSocket ) == lDefault ) ||
+        ( prvGetRcvBuf( xSocket ) < ( int ) TEST_RCVBUF_BYTES ) )
+    {
+        printf( "\tReceive buffer not set: %d bytes!\n", prvGetRcvBuf( xSocket ) );
+        lResult = TEST_LWIP_FAIL;
+    }
+
+    /* Only the receive buffer of a window is set. */
+    xWindow.ulSendBufferBytes = TEST_RCVBUF_BYTES;
+    xWindow.ulReceiveBufferBytes = TEST_RCVBUF_BYTES * 2U;
+
+    if( ( Sockets_SetSockOpt( xSocket, SOCKETS_SO_WINDOW, &xWindow, sizeof( xWindow ) ) != SOCKETS_ERROR_NONE ) ||
+        ( prvGetRcvBuf( xSocket ) < ( int ) ( TEST_RCVBUF_BYTES * 2U ) ) )
+    {
+        printf( "\tWindow receive buffer not set: %d bytes!\n", prvGetRcvBuf( xSocket ) );
+        lResult = TEST_LWIP_FAIL;
+    }
+
+    if( Sockets_SetSockOpt( xSocket, SOCKETS_SO_SNDBUF, &ulBytes, sizeof( ulBytes ) ) != SOCKETS_ENOPROTOOPT )
+    {
+        printf( "\tSend buffer not rejected!\n" );
+        lResult = TEST_LWIP_FAIL;
+    }
+
+    ( void ) Sockets_Close( xSocket );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvCloseAll( void )
+{
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < TEST_CONNECTIONS; xIndex++ )
+    {
+        if( xClientSockets[ xIndex ] != SOCKETS_INVALID_SOCKET )
+        {
+            ( void ) Sockets_Close( xClientSockets[ xIndex ] );
+        }
+
+        if( lServerSockets[ xIndex ] >= 0 )
+        {
+            ( void ) close( lServerSockets[ xIndex ] );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_LWIP_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( ( Sockets_Init() != SOCKETS_ERROR_NONE ) ||
+        ( prvListen() != TEST_LWIP_SUCCESS ) )
+    {
+        lResult = TEST_LWIP_FAIL;
+    }
+    else
+    {
+        if( ( prvTestRcvBuf() != TEST_LWIP_SUCCESS ) ||
+            ( prvConnectAll() != TEST_LWIP_SUCCESS ) ||
+            ( prvTestPoll() != TEST_LWIP_SUCCESS ) )
+        {
+            lResult = TEST_LWIP_FAIL;
+        }
+
+        prvCloseAll();
+    }
+
+    printf( lResult == TEST_LWIP_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "SocketsLwip", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_LWIP_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_LWIP_FAIL;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,479 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  TEST OF THE NAME RESOLUTION OF THE LWIP SOCKETS WRAPPER
+ *
+ *  Resolves host names from several tasks at once through the lwIP sockets
+ *  wrapper, built against mocked lwIP headers. The mocked
+ *  dns_gethostbyname_addrtype queues each query, and a task standing for the
+ *  lwIP thread answers it after a latency, or holds the answers back. Names in
+ *  the lwIP cache are answered at once, without a callback.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lwip/dns.h"
+
+#define TEST_LWIP_DNS_SUCCESS          0
+#define TEST_LWIP_DNS_FAIL             1
+
+#define TEST_LATENCY_MS                ( 200U )
+#define TEST_MAX_QUERIES               ( 8 )
+#define TEST_MAX_RESOLVERS             ( 3 )
+#define TEST_CACHED_HOST_NAME          "cached.test"
+
+#define TEST_TASK_STACK_SIZE           ( 8 * 1024 )
+#define TEST_TASK_PRIORITY             ( tskIDLE_PRIORITY + 2 )
+#define TEST_LWIP_TASK_PRIORITY        ( tskIDLE_PRIORITY + 3 )
+
+/*
+ * Defined in sockets_wrapper_lwip.c.
+ */
+extern uint32_t prvGetHostByName( const char * pcHostName );
+
+/*
+ * A query handed to the mocked lwIP.
+ */
+typedef struct TestQuery
+{
+    BaseType_t xInUse;
+    const char * pcHostName;
+    dns_found_callback xCallback;
+    void * pvCallbackArg;
+    TickType_t xAnswerTime;
+} TestQuery_t;
+
+/*
+ * A task resolving a host name.
+ */
+typedef struct TestResolver
+{
+    const char * pcHostName;
+    uint32_t ulAddress;
+    volatile BaseType_t xDone;
+} TestResolver_t;
+
+/*
+ * Host names known to the mocked lwIP.
+ */
+static const struct
+{
+    const char * pcHostName;
+    uint32_t ulAddress;
+} xTestHosts[] =
+{
+    { "hub.test",  0x0100000AU },
+    { "adu.test",  0x0200000AU },
+    { "dps.test",  0x0300000AU },
+    { "late.test", 0x0400000AU },
+    { TEST_CACHED_HOST_NAME, 0x0500000AU }
+};
+
+static TestQuery_t xTestQueries[ TEST_MAX_QUERIES ];
+static volatile uint32_t ulTestQueryCount = 0;
+static volatile BaseType_t xTestHoldAnswers = pdFALSE;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvTestAddress( const char * pcHostName )
+{
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < sizeof( xTestHosts ) / sizeof( xTestHosts[ 0 ] ); xIndex++ )
+    {
+        if( strcmp( xTestHosts[ xIndex ].pcHostName, pcHostName ) == 0 )
+        {
+            return xTestHosts[ xIndex ].ulAddress;
+        }
+    }
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+err_t dns_gethostbyname_addrtype( const char * hostname,
+                                  ip_addr_t * addr,
+                                  dns_found_callback found,
+                                  void * callback_arg,
+                                  uint8_t dns_addrtype )
+{
+    err_t xResult = ERR_MEM;
+    size_t xIndex;
+
+    ( void ) dns_addrtype;
+
+    if( strcmp( hostname, TEST_CACHED_HOST_NAME ) == 0 )
+    {
+        ulTestQueryCount++;
+        addr->addr = prvTestAddress( hostname );
+        return ERR_OK;
+    }
+
+    taskENTER_CRITICAL();
+    {
+        for( xIndex = 0; xIndex < TEST_MAX_QUERIES; xIndex++ )
+        {
+            if( xTestQueries[ xIndex ].xInUse == pdFALSE )
+            {
+                xTestQueries[ xIndex ].pcHostName = hostname;
+                xTestQueries[ xIndex ].xCallback = found;
+                xTestQueries[ xIndex ].pvCallbackArg = callback_arg;
+                xTestQueries[ xIndex ].xAnswerTime = xTaskGetTickCount() + pdMS_TO_TICKS( TEST_LATENCY_MS );
+                xTestQueries[ xIndex ].xInUse = pdTRUE;
+                ulTestQueryCount++;
+                xResult = ERR_INPROGRESS;
+                break;
+            }
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Stands for the lwIP thread: answers the queries that are due unless the
+ * answers are held back.
+ */
+static void prvLwipTask( void * pvParameters )
+{
+    ip_addr_t xAddress;
+    size_t xIndex;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        vTaskDelay( 1 );
+
+        for( xIndex = 0; xIndex < TEST_MAX_QUERIES; xIndex++ )
+        {
+            if( ( xTestQueries[ xIndex ].xInUse == pdTRUE ) &&
+                ( xTestHoldAnswers == pdFALSE ) &&
+                ( ( int32_t ) ( xTaskGetTickCount() - xTestQueries[ xIndex ].xAnswerTime ) >= 0 ) )
+            {
+                xAddress.addr = prvTestAddress( xTestQueries[ xIndex ].pcHostName );
+                xTestQueries[ xIndex ].xCallback( xTestQueries[ xIndex ].pcHostName,
+                                                  ( xAddress.addr != 0U ) ? &xAddress : NULL,
+                                                  xTestQueries[ xIndex ].pvCallbackArg );
+                xTestQueries[ xIndex ].xInUse = pdFALSE;
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvResolverTask( void * pvParameters )
+{
+    TestResolver_t * pxResolver = ( TestResolver_t * ) pvParameters;
+
+    pxResolver->ulAddress = prvGetHostByName( pxResolver->pcHostName );
+    pxResolver->xDone = pdTRUE;
+
+    vTaskDelete( NULL );
+}
+/*-----------------------------------------------------------*/
+
+static int prvStartResolver( TestResolver_t * pxResolver,
+                             const char * pcHostName )
+{
+    pxResolver->pcHostName = pcHostName;
+    pxResolver->ulAddress = 0;
+    pxResolver->xDone = pdFALSE;
+
+    return ( xTaskCreate( prvResolverTask, "Resolver", TEST_TASK_STACK_SIZE,
+                          pxResolver, TEST_TASK_PRIORITY, NULL ) == pdPASS ) ?
+           TEST_LWIP_DNS_SUCCESS : TEST_LWIP_DNS_FAIL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvWaitResolvers( TestResolver_t * pxResolvers,
+                              size_t xCount )
+{
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < xCount; xIndex++ )
+    {
+        while( pxResolvers[ xIndex ].xDone == pdFALSE )
+        {
+            vTaskDelay( 1 );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestDifferentNames( void )
+{
+    TestResolver_t xResolvers[ TEST_MAX_RESOLVERS ];
+    uint32_t ulQueries = ulTestQueryCount;
+    TickType_t xStart = xTaskGetTickCount();
+    TickType_t xElapsed;
+
+    printf( "Different names resolved at once\n" );
+
+    if( ( prvStartResolver( &xResolvers[ 0 ], "hub.test" ) != TEST_LWIP_DNS_SUCCESS ) ||
+        ( prvStartResolver( &xResolvers[ 1 ], "adu.test" ) != TEST_LWIP_DNS_SUCCESS ) ||
+        ( prvStartResolver( &xResolvers[ 2 ], "dps.test" ) != TEST_LWIP_DNS_SUCCESS ) )
+    {
+        printf( "\tFailed to start the resolvers!\n" );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    prvWaitResolvers( xResolvers, TEST_MAX_RESOLVERS );
+    xElapsed = xTaskGetTickCount() - xStart;
+
+    if( ( xResolvers[ 0 ].ulAddress != prvTestAddress( "hub.test" ) ) ||
+        ( xResolvers[ 1 ].ulAddress != prvTestAddress( "adu.test" ) ) ||
+        ( xResolvers[ 2 ].ulAddress != prvTestAddress( "dps.test" ) ) )
+    {
+        printf( "\tWrong addresses 0x%08x, 0x%08x, 0x%08x!\n",
+                ( unsigned ) xResolvers[ 0 ].ulAddress,
+                ( unsigned ) xResolvers[ 1 ].ulAddress,
+                ( unsigned ) xResolvers[ 2 ].ulAddress );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    if( ulTestQueryCount - ulQueries != 3U )
+    {
+        printf( "\t%u queries sent, expected 3!\n", ( unsigned ) ( ulTestQueryCount - ulQueries ) );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    /* The lookups overlap, so they take about one latency, not three. */
+    if( xElapsed >= pdMS_TO_TICKS( 2 * TEST_LATENCY_MS ) )
+    {
+        printf( "\tLookups took %u ms, not run side by side!\n", ( unsigned ) ( xElapsed * portTICK_PERIOD_MS ) );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    return TEST_LWIP_DNS_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestSameName( void )
+{
+    TestResolver_t xResolvers[ TEST_MAX_RESOLVERS ];
+    uint32_t ulQueries = ulTestQueryCount;
+    size_t xIndex;
+
+    printf( "Same name resolved at once\n" );
+
+    for( xIndex = 0; xIndex < TEST_MAX_RESOLVERS; xIndex++ )
+    {
+        if( prvStartResolver( &xResolvers[ xIndex ], "hub.test" ) != TEST_LWIP_DNS_SUCCESS )
+        {
+            printf( "\tFailed to start the resolvers!\n" );
+            return TEST_LWIP_DNS_FAIL;
+        }
+    }
+
+    prvWaitResolvers( xResolvers, TEST_MAX_RESOLVERS );
+
+    for( xIndex = 0; xIndex < TEST_MAX_RESOLVERS; xIndex++ )
+    {
+        if( xResolvers[ xIndex ].ulAddress != prvTestAddress( "hub.test" ) )
+        {
+            printf( "\tWrong address 0x%08x!\n", ( unsigned ) xResolvers[ xIndex ].ulAddress );
+            return TEST_LWIP_DNS_FAIL;
+        }
+    }
+
+    if( ulTestQueryCount - ulQueries != 1U )
+    {
+        printf( "\t%u queries sent, expected 1!\n", ( unsigned ) ( ulTestQueryCount - ulQueries ) );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    return TEST_LWIP_DNS_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestUnknownName( void )
+{
+    printf( "Unknown name\n" );
+
+    if( prvGetHostByName( "unknown.test" ) != 0U )
+    {
+        printf( "\tResolved an unknown name!\n" );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    return TEST_LWIP_DNS_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestCachedName( void )
+{
+    uint32_t ulAddress;
+
+    printf( "Name in the lwIP cache\n" );
+
+    ulAddress = prvGetHostByName( TEST_CACHED_HOST_NAME );
+
+    if( ulAddress != prvTestAddress( TEST_CACHED_HOST_NAME ) )
+    {
+        printf( "\tWrong address 0x%08x!\n", ( unsigned ) ulAddress );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    /* The lookup completed in this task, so no notification is left for the
+     * next wait of the task to take. */
+    if( ulTaskNotifyTake( pdTRUE, 0 ) != 0U )
+    {
+        printf( "\tNotification left after the lookup!\n" );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    return TEST_LWIP_DNS_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestTooManyLookups( void )
+{
+    TestResolver_t xResolvers[ TEST_MAX_RESOLVERS ];
+    uint32_t ulQueries = ulTestQueryCount;
+    TickType_t xStart;
+
+    printf( "Too many lookups in progress\n" );
+
+    xTestHoldAnswers = pdTRUE;
+
+    if( ( prvStartResolver( &xResolvers[ 0 ], "hub.test" ) != TEST_LWIP_DNS_SUCCESS ) ||
+        ( prvStartResolver( &xResolvers[ 1 ], "adu.test" ) != TEST_LWIP_DNS_SUCCESS ) ||
+        ( prvStartResolver( &xResolvers[ 2 ], "dps.test" ) != TEST_LWIP_DNS_SUCCESS ) )
+    {
+        printf( "\tFailed to start the resolvers!\n" );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    /* The table holds three lookups, so a fourth name fails at once, without
+     * a query. */
+    vTaskDelay( pdMS_TO_TICKS( TEST_LATENCY_MS ) );
+    xStart = xTaskGetTickCount();
+
+    if( ( prvGetHostByName( "late.test" ) != 0U ) ||
+        ( xTaskGetTickCount() - xStart >= pdMS_TO_TICKS( TEST_LATENCY_MS ) ) )
+    {
+        printf( "\tLookup not rejected with the table full!\n" );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    xTestHoldAnswers = pdFALSE;
+    prvWaitResolvers( xResolvers, TEST_MAX_RESOLVERS );
+
+    if( ( xResolvers[ 0 ].ulAddress != prvTestAddress( "hub.test" ) ) ||
+        ( xResolvers[ 1 ].ulAddress != prvTestAddress( "adu.test" ) ) ||
+        ( xResolvers[ 2 ].ulAddress != prvTestAddress( "dps.test" ) ) ||
+        ( ulTestQueryCount - ulQueries != 3U ) )
+    {
+        printf( "\tWrong addresses 0x%08x, 0x%08x, 0x%08x, or %u queries!\n",
+                ( unsigned ) xResolvers[ 0 ].ulAddress,
+                ( unsigned ) xResolvers[ 1 ].ulAddress,
+                ( unsigned ) xResolvers[ 2 ].ulAddress,
+                ( unsigned ) ( ulTestQueryCount - ulQueries ) );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    return TEST_LWIP_DNS_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestLateAnswer( void )
+{
+    TestResolver_t xResolver;
+    uint32_t ulQueries = ulTestQueryCount;
+    uint32_t ulAddress;
+
+    printf( "Answer after the lookup timed out\n" );
+
+    xTestHoldAnswers = pdTRUE;
+
+    if( prvGetHostByName( "late.test" ) != 0U )
+    {
+        printf( "\tResolved a name without an answer!\n" );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    /* The query is still with lwIP, so a new lookup waits for its answer. */
+    if( prvStartResolver( &xResolver, "late.test" ) != TEST_LWIP_DNS_SUCCESS )
+    {
+        printf( "\tFailed to start the resolver!\n" );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    vTaskDelay( pdMS_TO_TICKS( TEST_LATENCY_MS ) );
+    xTestHoldAnswers = pdFALSE;
+    prvWaitResolvers( &xResolver, 1 );
+
+    if( ( xResolver.ulAddress != prvTestAddress( "late.test" ) ) ||
+        ( ulTestQueryCount - ulQueries != 1U ) )
+    {
+        printf( "\tWrong address 0x%08x, or %u queries!\n",
+                ( unsigned ) xResolver.ulAddress,
+                ( unsigned ) ( ulTestQueryCount - ulQueries ) );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    /* The answered lookup is done with, so the next one sends a query. */
+    ulAddress = prvGetHostByName( "late.test" );
+
+    if( ( ulAddress != prvTestAddress( "late.test" ) ) ||
+        ( ulTestQueryCount - ulQueries != 2U ) )
+    {
+        printf( "\tWrong address 0x%08x, or %u queries!\n",
+                ( unsigned ) ulAddress,
+                ( unsigned ) ( ulTestQueryCount - ulQueries ) );
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    return TEST_LWIP_DNS_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_LWIP_DNS_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( ( prvTestDifferentNames() != TEST_LWIP_DNS_SUCCESS ) ||
+        ( prvTestSameName() != TEST_LWIP_DNS_SUCCESS ) ||
+        ( prvTestUnknownName() != TEST_LWIP_DNS_SUCCESS ) ||
+        ( prvTestCachedName() != TEST_LWIP_DNS_SUCCESS ) ||
+        ( prvTestTooManyLookups() != TEST_LWIP_DNS_SUCCESS ) ||
+        ( prvTestLateAnswer() != TEST_LWIP_DNS_SUCCESS ) )
+    {
+        lResult = TEST_LWIP_DNS_FAIL;
+    }
+
+    printf( lResult == TEST_LWIP_DNS_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( ( xTaskCreate( prvLwipTask, "LwipMock", TEST_TASK_STACK_SIZE,
+                       NULL, TEST_LWIP_TASK_PRIORITY, NULL ) != pdPASS ) ||
+        ( xTaskCreate( prvTestTask, "LwipDns", TEST_TASK_STACK_SIZE,
+                       NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS ) )
+    {
+        return TEST_LWIP_DNS_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_LWIP_DNS_FAIL;
+}
+/*-----------------------------------------------------------*/
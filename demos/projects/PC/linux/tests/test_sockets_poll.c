@@ -0,0 +1,331 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  TEST OF SOCKETS_POLL
+ *
+ *  Serves TEST_CONNECTIONS loopback connections from one task with
+ *  Sockets_Poll. Checks that an idle poll times out, that only the sockets
+ *  with data are reported readable, that a socket whose peer has no room left
+ *  is not reported writable, that a poll waiting forever wakes up when data
+ *  arrives, that a peer closing is reported readable, and that a socket that
+ *  is not connected is reported in error.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sockets_wrapper_loopback.h"
+
+#define TEST_SOCKETS_POLL_SUCCESS    0
+#define TEST_SOCKETS_POLL_FAIL       1
+
+#define TEST_HOST_NAME               "localhost"
+#define TEST_PORT                    ( 8443U )
+#define TEST_CONNECTIONS             ( 3U )
+#define TEST_POLL_TIMEOUT_MS         ( 100U )
+#define TEST_SEND_DELAY_MS           ( 50U )
+
+#define TEST_TASK_STACK_SIZE         ( 8 * 1024 )
+#define TEST_TASK_PRIORITY           ( tskIDLE_PRIORITY + 2 )
+
+/*-----------------------------------------------------------*/
+
+static SocketHandle xClientSockets[ TEST_CONNECTIONS ];
+static SocketsPollFd_t xPollSockets[ TEST_CONNECTIONS ];
+
+static uint8_t ucFillBuffer[ 1024 ];
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvPollTimed( uint32_t ulEvents,
+                                uint32_t ulTimeoutMs,
+                                uint32_t * pulMs )
+{
+    TickType_t xStart = xTaskGetTickCount();
+    BaseType_t xReady;
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < TEST_CONNECTIONS; xIndex++ )
+    {
+        xPollSockets[ xIndex ].ulEvents = ulEvents;
+    }
+
+    xReady = Sockets_Poll( xPollSockets, TEST_CONNECTIONS, ulTimeoutMs );
+    *pulMs = ( uint32_t ) ( ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS );
+
+    return xReady;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSendTask( void * pvParameters )
+{
+    static const uint8_t ucData[] = "late";
+
+    ( void ) pvParameters;
+
+    vTaskDelay( pdMS_TO_TICKS( TEST_SEND_DELAY_MS ) );
+    ( void ) Sockets_Send( xClientSockets[ 0 ], ucData, sizeof( ucData ) );
+
+    vTaskDelete( NULL );
+}
+/*-----------------------------------------------------------*/
+
+static int prvConnect( void )
+{
+    size_t xIndex;
+    int lResult = TEST_SOCKETS_POLL_SUCCESS;
+
+    if( Loopback_Listen( TEST_PORT ) != SOCKETS_ERROR_NONE )
+    {
+        printf( "Failed to listen!\n" );
+        return TEST_SOCKETS_POLL_FAIL;
+    }
+
+    for( xIndex = 0; ( xIndex < TEST_CONNECTIONS ) && ( lResult == TEST_SOCKETS_POLL_SUCCESS ); xIndex++ )
+    {
+        xClientSockets[ xIndex ] = Sockets_Open();
+
+        if( ( xClientSockets[ xIndex ] == SOCKETS_INVALID_SOCKET ) ||
+            ( Sockets_Connect( xClientSockets[ xIndex ], TEST_HOST_NAME, TEST_PORT ) != SOCKETS_ERROR_NONE ) ||
+            ( ( xPollSockets[ xIndex ].xSocket = Loopback_Accept( 0 ) ) == SOCKETS_INVALID_SOCKET ) )
+        {
+            printf( "Failed to connect %u!\n", ( unsigned ) xIndex );
+            lResult = TEST_SOCKETS_POLL_FAIL;
+        }
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestTimeout( void )
+{
+    uint32_t ulMs;
+    int lResult = TEST_SOCKETS_POLL_SUCCESS;
+
+    printf( "Idle poll times out\n" );
+
+    if( ( prvPollTimed( SOCKETS_POLL_READ, TEST_POLL_TIMEOUT_MS, &ulMs ) != 0 ) ||
+        ( ulMs < TEST_POLL_TIMEOUT_MS ) )
+    {
+        printf( "\tPoll returned after %u ms!\n", ( unsigned ) ulMs );
+        lResult = TEST_SOCKETS_POLL_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestRead( void )
+{
+    static const uint8_t ucData[] = "telemetry";
+    uint8_t ucReceived[ sizeof( ucData ) ];
+    uint32_t ulMs;
+    int lResult = TEST_SOCKETS_POLL_SUCCESS;
+
+    printf( "Only the socket with data is readable\n" );
+
+    ( void ) Sockets_Send( xClientSockets[ 1 ], ucData, sizeof( ucData ) );
+
+    if( ( prvPollTimed( SOCKETS_POLL_READ, TEST_POLL_TIMEOUT_MS, &ulMs ) != 1 ) ||
+        ( xPollSockets[ 0 ].ulRevents != 0U ) ||
+        ( xPollSockets[ 1 ].ulRevents != SOCKETS_POLL_READ ) ||
+        ( xPollSockets[ 2 ].ulRevents != 0U ) )
+    {
+        printf( "\tWrong sockets reported readable!\n" );
+        lResult = TEST_SOCKETS_POLL_FAIL;
+    }
+    else if( ( Sockets_Recv( xPollSockets[ 1 ].xSocket, ucReceived, sizeof( ucReceived ) ) != sizeof( ucData ) ) ||
+             ( memcmp( ucReceived, ucData, sizeof( ucData ) ) != 0 ) )
+    {
+        printf( "\tData not received!\n" );
+        lResult = TEST_SOCKETS_POLL_FAIL;
+    }
+    else if( prvPollTimed( SOCKETS_POLL_READ, 0U, &ulMs ) != 0 )
+    {
+        printf( "\tSocket still readable once drained!\n" );
+        lResult = TEST_SOCKETS_POLL_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestWrite( void )
+{
+    BaseType_t xNonBlocking = pdTRUE;
+    uint8_t ucReceived[ sizeof( ucFillBuffer ) ];
+    uint32_t ulMs;
+    int lResult = TEST_SOCKETS_POLL_SUCCESS;
+
+    printf( "A socket whose peer has no room left is not writable\n" );
+
+    if( prvPollTimed( SOCKETS_POLL_WRITE, 0U, &ulMs ) != ( BaseType_t ) TEST_CONNECTIONS )
+    {
+        printf( "\tConnected sockets not writable!\n" );
+        return TEST_SOCKETS_POLL_FAIL;
+    }
+
+    ( void ) Sockets_SetSockOpt( xPollSockets[ 2 ].xSocket, SOCKETS_SO_NONBLOCK,
+                                 &xNonBlocking, sizeof( xNonBlocking ) );
+
+    while( Sockets_Send( xPollSockets[ 2 ].xSocket, ucFillBuffer, sizeof( ucFillBuffer ) ) > 0 )
+    {
+    }
+
+    if( ( prvPollTimed( SOCKETS_POLL_WRITE, 0U, &ulMs ) != ( BaseType_t ) TEST_CONNECTIONS - 1 ) ||
+        ( xPollSockets[ 2 ].ulRevents != 0U ) )
+    {
+        printf( "\tFull socket reported writable!\n" );
+        lResult = TEST_SOCKETS_POLL_FAIL;
+    }
+
+    ( void ) Sockets_SetSockOpt( xClientSockets[ 2 ], SOCKETS_SO_NONBLOCK,
+                                 &xNonBlocking, sizeof( xNonBlocking ) );
+
+    while( Sockets_Recv( xClientSockets[ 2 ], ucReceived, sizeof( ucReceived ) ) > 0 )
+    {
+    }
+
+    if( prvPollTimed( SOCKETS_POLL_WRITE, 0U, &ulMs ) != ( BaseType_t ) TEST_CONNECTIONS )
+    {
+        printf( "\tDrained socket not writable!\n" );
+        lResult = TEST_SOCKETS_POLL_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestWaitForever( void )
+{
+    uint8_t ucReceived[ 16 ];
+    uint32_t ulMs;
+    int lResult = TEST_SOCKETS_POLL_SUCCESS;
+
+    printf( "Poll waiting forever wakes up on data\n" );
+
+    if( xTaskCreate( prvSendTask, "PollSend", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        printf( "\tFailed to start the sending task!\n" );
+        return TEST_SOCKETS_POLL_FAIL;
+    }
+
+    if( ( prvPollTimed( SOCKETS_POLL_READ, SOCKETS_POLL_WAIT_FOREVER, &ulMs ) != 1 ) ||
+        ( xPollSockets[ 0 ].ulRevents != SOCKETS_POLL_READ ) )
+    {
+        printf( "\tData not reported!\n" );
+        lResult = TEST_SOCKETS_POLL_FAIL;
+    }
+    else
+    {
+        printf( "\tWoke up after %u ms\n", ( unsigned ) ulMs );
+        ( void ) Sockets_Recv( xPollSockets[ 0 ].xSocket, ucReceived, sizeof( ucReceived ) );
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestPeerClosed( void )
+{
+    uint8_t ucReceived[ 16 ];
+    uint32_t ulMs;
+    int lResult = TEST_SOCKETS_POLL_SUCCESS;
+
+    printf( "A peer closing is reported readable\n" );
+
+    ( void ) Sockets_Close( xClientSockets[ 1 ] );
+
+    if( ( prvPollTimed( SOCKETS_POLL_READ, TEST_POLL_TIMEOUT_MS, &ulMs ) != 1 ) ||
+        ( xPollSockets[ 1 ].ulRevents != SOCKETS_POLL_READ ) )
+    {
+        printf( "\tClose not reported!\n" );
+        lResult = TEST_SOCKETS_POLL_FAIL;
+    }
+    else if( Sockets_Recv( xPollSockets[ 1 ].xSocket, ucReceived, sizeof( ucReceived ) ) != SOCKETS_ECLOSED )
+    {
+        printf( "\tClosed socket did not return SOCKETS_ECLOSED!\n" );
+        lResult = TEST_SOCKETS_POLL_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestNotConnected( void )
+{
+    SocketsPollFd_t xPollSocket;
+    int lResult = TEST_SOCKETS_POLL_SUCCESS;
+
+    printf( "A socket that is not connected is in error\n" );
+
+    xPollSocket.xSocket = Sockets_Open();
+    xPollSocket.ulEvents = SOCKETS_POLL_READ | SOCKETS_POLL_WRITE;
+
+    if( xPollSocket.xSocket == SOCKETS_INVALID_SOCKET )
+    {
+        printf( "\tFailed to open a socket!\n" );
+        lResult = TEST_SOCKETS_POLL_FAIL;
+    }
+    else
+    {
+        if( ( Sockets_Poll( &xPollSocket, 1, 0U ) != 1 ) ||
+            ( xPollSocket.ulRevents != SOCKETS_POLL_ERROR ) )
+        {
+            printf( "\tSocket not reported in error!\n" );
+            lResult = TEST_SOCKETS_POLL_FAIL;
+        }
+
+        ( void ) Sockets_Close( xPollSocket.xSocket );
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_SOCKETS_POLL_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( ( prvConnect() != TEST_SOCKETS_POLL_SUCCESS ) ||
+        ( prvTestTimeout() != TEST_SOCKETS_POLL_SUCCESS ) ||
+        ( prvTestRead() != TEST_SOCKETS_POLL_SUCCESS ) ||
+        ( prvTestWrite() != TEST_SOCKETS_POLL_SUCCESS ) ||
+        ( prvTestWaitForever() != TEST_SOCKETS_POLL_SUCCESS ) ||
+        ( prvTestPeerClosed() != TEST_SOCKETS_POLL_SUCCESS ) ||
+        ( prvTestNotConnected() != TEST_SOCKETS_POLL_SUCCESS ) )
+    {
+        lResult = TEST_SOCKETS_POLL_FAIL;
+    }
+
+    printf( lResult == TEST_SOCKETS_POLL_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "SocketsPoll", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_SOCKETS_POLL_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_SOCKETS_POLL_FAIL;
+}
+/*-----------------------------------------------------------*/
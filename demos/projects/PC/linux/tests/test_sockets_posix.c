@@ -0,0 +1,376 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  TEST OF THE POSIX SOCKETS WRAPPER
+ *
+ *  Connects through sockets_wrapper_posix.c to a server on the loopback
+ *  interface of the host, served from the test task with non-blocking host
+ *  sockets. Checks sending and receiving, the receive timeout, Sockets_Poll,
+ *  a peer that closes, and a connect that is refused.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Host sockets includes. */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sockets_wrapper.h"
+
+#define TEST_SOCKETS_POSIX_SUCCESS    0
+#define TEST_SOCKETS_POSIX_FAIL       1
+
+#define TEST_HOST_NAME                "localhost"
+#define TEST_PORT                     ( 18443U )
+#define TEST_REFUSED_PORT             ( 18444U )
+#define TEST_DATA_LENGTH              ( 256U * 1024U )
+#define TEST_RECEIVE_TIMEOUT_MS       ( 200U )
+#define TEST_WAIT_MS                  ( 2000U )
+
+#define TEST_TASK_STACK_SIZE          ( 8 * 1024 )
+#define TEST_TASK_PRIORITY            ( tskIDLE_PRIORITY + 2 )
+
+static uint8_t ucSendBuffer[ TEST_DATA_LENGTH ];
+static uint8_t ucReceiveBuffer[ TEST_DATA_LENGTH ];
+static uint8_t ucServerBuffer[ TEST_DATA_LENGTH ];
+
+/*-----------------------------------------------------------*/
+
+static int prvListen( void )
+{
+    struct sockaddr_in xAddress;
+    int lReuse = 1;
+    int lListener = socket( AF_INET, SOCK_STREAM, 0 );
+
+    ( void ) memset( &xAddress, 0, sizeof( xAddress ) );
+    xAddress.sin_family = AF_INET;
+    xAddress.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    xAddress.sin_port = htons( TEST_PORT );
+
+    if( ( lListener < 0 ) ||
+        ( setsockopt( lListener, SOL_SOCKET, SO_REUSEADDR, &lReuse, sizeof( lReuse ) ) != 0 ) ||
+        ( bind( lListener, ( struct sockaddr * ) &xAddress, sizeof( xAddress ) ) != 0 ) ||
+        ( listen( lListener, 1 ) != 0 ) ||
+        ( fcntl( lListener, F_SETFL, O_NONBLOCK ) != 0 ) )
+    {
+        lListener = -1;
+    }
+
+    return lListener;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Accept a connection, delaying the task between tries so the scheduler runs.
+ */
+static int prvAccept( int lListener )
+{
+    TickType_t xStart = xTaskGetTickCount();
+    int lServer;
+
+    while( ( ( lServer = accept( lListener, NULL, NULL ) ) < 0 ) &&
+           ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_WAIT_MS ) ) )
+    {
+        vTaskDelay( 1 );
+    }
+
+    if( ( lServer >= 0 ) && ( fcntl( lServer, F_SETFL, O_NONBLOCK ) != 0 ) )
+    {
+        ( void ) close( lServer );
+        lServer = -1;
+    }
+
+    return lServer;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Send from the wrapper and echo back from the server until all the data went
+ * both ways. Both ends are non-blocking, as one task serves both.
+ */
+static int prvTestEcho( SocketHandle xClient,
+                        int lServer )
+{
+    size_t xSent = 0;
+    size_t xReceived = 0;
+    size_t xServerReceived = 0;
+    size_t xEchoed = 0;
+    BaseType_t xNonBlocking = pdTRUE;
+    BaseType_t xResult;
+    ssize_t xCount;
+    TickType_t xStart = xTaskGetTickCount();
+
+    printf( "Data sent and received\n" );
+
+    ( void ) Sockets_SetSockOpt( xClient, SOCKETS_SO_NONBLOCK, &xNonBlocking, sizeof( xNonBlocking ) );
+
+    while( ( xReceived < TEST_DATA_LENGTH ) &&
+           ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_WAIT_MS ) ) )
+    {
+        if( ( xSent < TEST_DATA_LENGTH ) &&
+            ( ( xResult = Sockets_Send( xClient, &ucSendBuffer[ xSent ], TEST_DATA_LENGTH - xSent ) ) > 0 ) )
+        {
+            xSent += ( size_t ) xResult;
+        }
+
+        if( ( xCount = recv( lServer, &ucServerBuffer[ xServerReceived ], TEST_DATA_LENGTH - xServerReceived, 0 ) ) > 0 )
+        {
+            xServerReceived += ( size_t ) xCount;
+        }
+
+        if( ( xEchoed < xServerReceived ) &&
+            ( ( xCount = send( lServer, &ucServerBuffer[ xEchoed ], xServerReceived - xEchoed, 0 ) ) > 0 ) )
+        {
+            xEchoed += ( size_t ) xCount;
+        }
+
+        if( ( xResult = Sockets_Recv( xClient, &ucReceiveBuffer[ xReceived ], TEST_DATA_LENGTH - xReceived ) ) > 0 )
+        {
+            xReceived += ( size_t ) xResult;
+        }
+        else
+        {
+            vTaskDelay( 1 );
+        }
+    }
+
+    xNonBlocking = pdFALSE;
+    ( void ) Sockets_SetSockOpt( xClient, SOCKETS_SO_NONBLOCK, &xNonBlocking, sizeof( xNonBlocking ) );
+
+    if( ( xReceived != TEST_DATA_LENGTH ) ||
+        ( memcmp( ucSendBuffer, ucReceiveBuffer, TEST_DATA_LENGTH ) != 0 ) )
+    {
+        printf( "\tReceived %u bytes, expected %u!\n", ( unsigned ) xReceived, ( unsigned ) TEST_DATA_LENGTH );
+        return TEST_SOCKETS_POSIX_FAIL;
+    }
+
+    return TEST_SOCKETS_POSIX_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestReceiveTimeout( SocketHandle xClient )
+{
+    TickType_t xStart = xTaskGetTickCount();
+    uint32_t ulMs;
+    BaseType_t xResult = Sockets_Recv( xClient, ucReceiveBuffer, sizeof( ucReceiveBuffer ) );
+
+    ulMs = ( uint32_t ) ( ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS );
+
+    printf( "Receive timeout\n" );
+
+    if( ( xResult != 0 ) || ( ulMs < TEST_RECEIVE_TIMEOUT_MS ) || ( ulMs > 2U * TEST_RECEIVE_TIMEOUT_MS ) )
+    {
+        printf( "\tReceive returned %d after %u ms!\n", ( int ) xResult, ( unsigned ) ulMs );
+        return TEST_SOCKETS_POSIX_FAIL;
+    }
+
+    return TEST_SOCKETS_POSIX_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestPoll( SocketHandle xClient,
+                        int lServer )
+{
+    SocketsPollFd_t xPollFd = { 0 };
+    BaseType_t xResult;
+
+    printf( "Poll\n" );
+
+    xPollFd.xSocket = xClient;
+    xPollFd.ulEvents = SOCKETS_POLL_READ;
+
+    if( ( xResult = Sockets_Poll( &xPollFd, 1, 0 ) ) != 0 )
+    {
+        printf( "\tReadable without data: %d!\n", ( int ) xResult );
+        return TEST_SOCKETS_POSIX_FAIL;
+    }
+
+    ( void ) send( lServer, "x", 1, 0 );
+
+    if( ( ( xResult = Sockets_Poll( &xPollFd, 1, TEST_WAIT_MS ) ) != 1 ) ||
+        ( xPollFd.ulRevents != SOCKETS_POLL_READ ) ||
+        ( Sockets_Recv( xClient, ucReceiveBuffer, sizeof( ucReceiveBuffer ) ) != 1 ) )
+    {
+        printf( "\tData not reported: %d, events 0x%x!\n", ( int ) xResult, ( unsigned ) xPollFd.ulRevents );
+        return TEST_SOCKETS_POSIX_FAIL;
+    }
+
+    return TEST_SOCKETS_POSIX_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestPeerClose( SocketHandle xClient,
+                             int lServer )
+{
+    BaseType_t xResult;
+
+    printf( "Peer closes\n" );
+
+    ( void ) close( lServer );
+
+    if( ( xResult = Sockets_Recv( xClient, ucReceiveBuffer, sizeof( ucReceiveBuffer ) ) ) != SOCKETS_ECLOSED )
+    {
+        printf( "\tReceive returned %d!\n", ( int ) xResult );
+        return TEST_SOCKETS_POSIX_FAIL;
+    }
+
+    return TEST_SOCKETS_POSIX_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestConnectRefused( void )
+{
+    SocketHandle xClient = Sockets_Open();
+    BaseType_t xNonBlocking = pdTRUE;
+    BaseType_t xResult;
+    TickType_t xStart = xTaskGetTickCount();
+
+    printf( "Connect refused\n" );
+
+    if( xClient == SOCKETS_INVALID_SOCKET )
+    {
+        return TEST_SOCKETS_POSIX_FAIL;
+    }
+
+    ( void ) Sockets_SetSockOpt( xClient, SOCKETS_SO_NONBLOCK, &xNonBlocking, sizeof( xNonBlocking ) );
+    xResult = Sockets_ConnectStart( xClient, TEST_HOST_NAME, TEST_REFUSED_PORT );
+
+    while( ( xResult == SOCKETS_EWOULDBLOCK ) &&
+           ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_WAIT_MS ) ) )
+    {
+        vTaskDelay( 1 );
+        xResult = Sockets_ConnectPoll( xClient );
+    }
+
+    ( void ) Sockets_Close( xClient );
+
+    if( ( xResult == SOCKETS_ERROR_NONE ) || ( xResult == SOCKETS_EWOULDBLOCK ) )
+    {
+        printf( "\tConnect returned %d!\n", ( int ) xResult );
+        return TEST_SOCKETS_POSIX_FAIL;
+    }
+
+    return TEST_SOCKETS_POSIX_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvRunTests( int lListener )
+{
+    SocketHandle xClient;
+    SocketsConnectTimes_t xTimes;
+    TickType_t xTimeout = pdMS_TO_TICKS( TEST_RECEIVE_TIMEOUT_MS );
+    BaseType_t xEnable = pdTRUE;
+    int lServer = -1;
+    int lResult = TEST_SOCKETS_POSIX_SUCCESS;
+
+    printf( "Connect\n" );
+
+    if( ( ( xClient = Sockets_Open() ) == SOCKETS_INVALID_SOCKET ) ||
+        ( Sockets_SetSockOpt( xClient, SOCKETS_SO_RCVTIMEO, &xTimeout, sizeof( xTimeout ) ) != SOCKETS_ERROR_NONE ) ||
+        ( Sockets_SetSockOpt( xClient, SOCKETS_SO_SNDTIMEO, &xTimeout, sizeof( xTimeout ) ) != SOCKETS_ERROR_NONE ) ||
+        ( Sockets_SetSockOpt( xClient, SOCKETS_SO_NODELAY, &xEnable, sizeof( xEnable ) ) != SOCKETS_ERROR_NONE ) ||
+        ( Sockets_SetSockOpt( xClient, SOCKETS_SO_KEEPALIVE, &xEnable, sizeof( xEnable ) ) != SOCKETS_ERROR_NONE ) ||
+        ( Sockets_Connect( xClient, TEST_HOST_NAME, TEST_PORT ) != SOCKETS_ERROR_NONE ) ||
+        ( ( lServer = prvAccept( lListener ) ) < 0 ) )
+    {
+        printf( "\tFailed to connect!\n" );
+        lResult = TEST_SOCKETS_POSIX_FAIL;
+    }
+    else if( Sockets_GetConnectTimes( xClient, &xTimes ) != SOCKETS_ERROR_NONE )
+    {
+        printf( "\tConnect not timed!\n" );
+        lResult = TEST_SOCKETS_POSIX_FAIL;
+    }
+    else if( ( prvTestEcho( xClient, lServer ) != TEST_SOCKETS_POSIX_SUCCESS ) ||
+             ( prvTestReceiveTimeout( xClient ) != TEST_SOCKETS_POSIX_SUCCESS ) ||
+             ( prvTestPoll( xClient, lServer ) != TEST_SOCKETS_POSIX_SUCCESS ) )
+    {
+        lResult = TEST_SOCKETS_POSIX_FAIL;
+    }
+    else
+    {
+        lResult = prvTestPeerClose( xClient, lServer );
+        lServer = -1;
+    }
+
+    if( lServer >= 0 )
+    {
+        ( void ) close( lServer );
+    }
+
+    if( xClient != SOCKETS_INVALID_SOCKET )
+    {
+        ( void ) Sockets_CloseAsync( xClient );
+    }
+
+    if( ( lResult == TEST_SOCKETS_POSIX_SUCCESS ) &&
+        ( prvTestConnectRefused() != TEST_SOCKETS_POSIX_SUCCESS ) )
+    {
+        lResult = TEST_SOCKETS_POSIX_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lListener;
+    int lResult;
+    size_t xIndex;
+
+    ( void ) pvParameters;
+
+    for( xIndex = 0; xIndex < TEST_DATA_LENGTH; xIndex++ )
+    {
+        ucSendBuffer[ xIndex ] = ( uint8_t ) ( xIndex * 7U );
+    }
+
+    if( Sockets_Init() != SOCKETS_ERROR_NONE )
+    {
+        printf( "Failed to initialize the sockets!\n" );
+        lResult = TEST_SOCKETS_POSIX_FAIL;
+    }
+    else if( ( lListener = prvListen() ) < 0 )
+    {
+        printf( "Failed to listen: %d!\n", errno );
+        lResult = TEST_SOCKETS_POSIX_FAIL;
+    }
+    else
+    {
+        lResult = prvRunTests( lListener );
+        ( void ) close( lListener );
+    }
+
+    printf( lResult == TEST_SOCKETS_POSIX_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "SocketsPosix", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_SOCKETS_POSIX_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_SOCKETS_POSIX_FAIL;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,457 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  TEST OF THE STM32L475 SOCKETS WRAPPER
+ *
+ *  Runs the Inventek sockets wrapper of the B-L475E-IOT01A port against a
+ *  mocked WiFi driver, which queues the data the test sets for each socket.
+ *  Checks that Sockets_Poll reads ahead into the poll buffer of a socket to
+ *  find out whether it has data, that Sockets_Recv returns that data first and
+ *  in order, that a poll waits for data, that a socket that is not connected
+ *  is reported in error, and that a missing socket array is rejected. Checks
+ *  that Sockets_CloseAsync returns the socket to the pool once, so that a
+ *  socket opened again in its place stays open.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+#include "wifi.h"
+
+#include "sockets_wrapper.h"
+
+#define TEST_STM32_SUCCESS          0
+#define TEST_STM32_FAIL             1
+
+#define TEST_HOST_NAME              "hub.test"
+#define TEST_PORT                   ( 8883U )
+#define TEST_MODULE_SOCKETS         ( 4 )
+#define TEST_DATA_SIZE              ( 100U )
+#define TEST_SEND_DELAY_MS          ( 50U )
+
+/* stsecuresocketsPOLL_BUFFER_SIZE of the wrapper. */
+#define TEST_POLL_BUFFER_SIZE       ( 64U )
+
+#define TEST_TASK_STACK_SIZE        ( 8 * 1024 )
+#define TEST_TASK_PRIORITY          ( tskIDLE_PRIORITY + 2 )
+
+/*
+ * Data queued in the mocked module for a socket.
+ */
+typedef struct TestModuleSocket
+{
+    uint8_t ucData[ TEST_DATA_SIZE ];
+    volatile size_t xLength;
+    size_t xOffset;
+    uint16_t usLastRequest;
+} TestModuleSocket_t;
+
+/*-----------------------------------------------------------*/
+
+xSemaphoreHandle xWifiSemaphoreHandle;
+
+static TestModuleSocket_t xModuleSockets[ TEST_MODULE_SOCKETS ];
+static volatile uint32_t ulReceiveCalls = 0;
+static uint32_t ulCloseCalls = 0;
+
+/*-----------------------------------------------------------*/
+
+WIFI_Status_t WIFI_GetHostAddress( const char * location,
+                                   uint8_t * ipaddr )
+{
+    static const uint8_t ucAddress[ 4 ] = { 10, 0, 0, 1 };
+
+    ( void ) location;
+
+    ( void ) memcpy( ipaddr, ucAddress, sizeof( ucAddress ) );
+
+    return WIFI_STATUS_OK;
+}
+/*-----------------------------------------------------------*/
+
+WIFI_Status_t WIFI_OpenClientConnection( uint32_t socket,
+                                         WIFI_Protocol_t type,
+                                         const char * name,
+                                         uint8_t * ipaddr,
+                                         uint16_t port,
+                                         uint16_t local_port )
+{
+    ( void ) type;
+    ( void ) name;
+    ( void ) ipaddr;
+    ( void ) port;
+    ( void ) local_port;
+
+    ( void ) memset( &xModuleSockets[ socket ], 0, sizeof( xModuleSockets[ socket ] ) );
+
+    return WIFI_STATUS_OK;
+}
+/*-----------------------------------------------------------*/
+
+WIFI_Status_t WIFI_CloseClientConnection( uint32_t socket )
+{
+    ( void ) socket;
+
+    ulCloseCalls++;
+
+    return WIFI_STATUS_OK;
+}
+/*-----------------------------------------------------------*/
+
+WIFI_Status_t WIFI_SendData( uint8_t socket,
+                             uint8_t * pdata,
+                             uint16_t Reqlen,
+                             uint16_t * SentDatalen,
+                             uint32_t Timeout )
+{
+    ( void ) socket;
+    ( void ) pdata;
+    ( void ) Timeout;
+
+    *SentDatalen = Reqlen;
+
+    return WIFI_STATUS_OK;
+}
+/*-----------------------------------------------------------*/
+
+WIFI_Status_t WIFI_ReceiveData( uint8_t socket,
+                                uint8_t * pdata,
+                                uint16_t Reqlen,
+                                uint16_t * RcvDatalen,
+                                uint32_t Timeout )
+{
+    TestModuleSocket_t * pxModuleSocket = &xModuleSockets[ socket ];
+    size_t xLength = pxModuleSocket->xLength - pxModuleSocket->xOffset;
+
+    ( void ) Timeout;
+
+    ulReceiveCalls++;
+    pxModuleSocket->usLastRequest = Reqlen;
+
+    if( xLength > Reqlen )
+    {
+        xLength = Reqlen;
+    }
+
+    ( void ) memcpy( pdata, &pxModuleSocket->ucData[ pxModuleSocket->xOffset ], xLength );
+    pxModuleSocket->xOffset += xLength;
+    *RcvDatalen = ( uint16_t ) xLength;
+
+    return WIFI_STATUS_OK;
+}
+/*-----------------------------------------------------------*/
+
+WIFI_Status_t WIFI_ResetModule( void )
+{
+    return WIFI_STATUS_ERROR;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Queue data in the module for a socket, as if the peer sent it.
+ */
+static void prvModuleQueue( SocketHandle xSocket )
+{
+    TestModuleSocket_t * pxModuleSocket = &xModuleSockets[ ( uint32_t ) xSocket ];
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < TEST_DATA_SIZE; xIndex++ )
+    {
+        pxModuleSocket->ucData[ xIndex ] = ( uint8_t ) xIndex;
+    }
+
+    pxModuleSocket->xOffset = 0;
+    pxModuleSocket->xLength = TEST_DATA_SIZE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSendTask( void * pvParameters )
+{
+    vTaskDelay( pdMS_TO_TICKS( TEST_SEND_DELAY_MS ) );
+    prvModuleQueue( ( SocketHandle ) pvParameters );
+    vTaskDelete( NULL );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvCheckData( const uint8_t * pucData,
+                                size_t xLength,
+                                size_t xOffset )
+{
+    BaseType_t xMatches = pdTRUE;
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < xLength; xIndex++ )
+    {
+        if( pucData[ xIndex ] != ( uint8_t ) ( xOffset + xIndex ) )
+        {
+            xMatches = pdFALSE;
+        }
+    }
+
+    return xMatches;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestReadAhead( SocketHandle xSocket )
+{
+    SocketsPollFd_t xPollSocket;
+    uint8_t ucBuffer[ TEST_DATA_SIZE ];
+    BaseType_t xReceived;
+    uint32_t ulCalls;
+    int lResult = TEST_STM32_SUCCESS;
+
+    printf( "Poll reads ahead, and receive returns the data read first\n" );
+
+    xPollSocket.xSocket = xSocket;
+    xPollSocket.ulEvents = SOCKETS_POLL_READ | SOCKETS_POLL_WRITE;
+
+    if( ( Sockets_Poll( &xPollSocket, 1, 0U ) != 1 ) ||
+        ( xPollSocket.ulRevents != SOCKETS_POLL_WRITE ) )
+    {
+        printf( "\tIdle socket not reported writable only!\n" );
+        lResult = TEST_STM32_FAIL;
+    }
+
+    prvModuleQueue( xSocket );
+
+    if( ( Sockets_Poll( &xPollSocket, 1, 0U ) != 1 ) ||
+        ( xPollSocket.ulRevents != ( SOCKETS_POLL_READ | SOCKETS_POLL_WRITE ) ) ||
+        ( xModuleSockets[ ( uint32_t ) xSocket ].usLastRequest != TEST_POLL_BUFFER_SIZE ) )
+    {
+        printf( "\tData not read ahead!\n" );
+        return TEST_STM32_FAIL;
+    }
+
+    /* The read-ahead data is returned without asking the module, and polling
+     * again keeps it. */
+    ulCalls = ulReceiveCalls;
+    xReceived = Sockets_Recv( xSocket, ucBuffer, 10 );
+
+    if( ( xReceived != 10 ) || ( prvCheckData( ucBuffer, 10, 0 ) == pdFALSE ) ||
+        ( Sockets_Poll( &xPollSocket, 1, 0U ) != 1 ) ||
+        ( xPollSocket.ulRevents != ( SOCKETS_POLL_READ | SOCKETS_POLL_WRITE ) ) ||
+        ( ulReceiveCalls != ulCalls ) )
+    {
+        printf( "\tRead-ahead data not returned first!\n" );
+        lResult = TEST_STM32_FAIL;
+    }
+
+    xReceived = Sockets_Recv( xSocket, ucBuffer, sizeof( ucBuffer ) );
+
+    if( ( xReceived != ( BaseType_t ) ( TEST_POLL_BUFFER_SIZE - 10 ) ) ||
+        ( prvCheckData( ucBuffer, ( size_t ) xReceived, 10 ) == pdFALSE ) ||
+        ( ulReceiveCalls != ulCalls ) )
+    {
+        printf( "\tRest of the read-ahead data not returned: %d bytes!\n", ( int ) xReceived );
+        lResult = TEST_STM32_FAIL;
+    }
+
+    /* The rest comes from the module. */
+    xReceived = Sockets_Recv( xSocket, ucBuffer, sizeof( ucBuffer ) );
+
+    if( ( xReceived != ( BaseType_t ) ( TEST_DATA_SIZE - TEST_POLL_BUFFER_SIZE ) ) ||
+        ( prvCheckData( ucBuffer, ( size_t ) xReceived, TEST_POLL_BUFFER_SIZE ) == pdFALSE ) )
+    {
+        printf( "\tData after the read-ahead not received: %d bytes!\n", ( int ) xReceived );
+        lResult = TEST_STM32_FAIL;
+    }
+
+    xPollSocket.ulEvents = SOCKETS_POLL_READ;
+
+    if( ( Sockets_Poll( &xPollSocket, 1, 0U ) != 0 ) ||
+        ( xPollSocket.ulRevents != 0U ) )
+    {
+        printf( "\tSocket still reported readable!\n" );
+        lResult = TEST_STM32_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestWait( SocketHandle xSocket )
+{
+    SocketsPollFd_t xPollSocket;
+    TickType_t xStart;
+    uint32_t ulMs;
+    int lResult = TEST_STM32_SUCCESS;
+
+    printf( "Poll waits for data\n" );
+
+    xPollSocket.xSocket = xSocket;
+    xPollSocket.ulEvents = SOCKETS_POLL_READ;
+
+    xStart = xTaskGetTickCount();
+
+    if( ( Sockets_Poll( &xPollSocket, 1, TEST_SEND_DELAY_MS ) != 0 ) ||
+        ( ( ulMs = ( uint32_t ) ( ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS ) ) < TEST_SEND_DELAY_MS ) )
+    {
+        printf( "\tIdle poll did not time out!\n" );
+        lResult = TEST_STM32_FAIL;
+    }
+
+    if( xTaskCreate( prvSendTask, "Send", TEST_TASK_STACK_SIZE, ( void * ) xSocket,
+                     TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        printf( "\tFailed to create the send task!\n" );
+        return TEST_STM32_FAIL;
+    }
+
+    xStart = xTaskGetTickCount();
+
+    if( ( Sockets_Poll( &xPollSocket, 1, SOCKETS_POLL_WAIT_FOREVER ) != 1 ) ||
+        ( xPollSocket.ulRevents != SOCKETS_POLL_READ ) )
+    {
+        printf( "\tPoll did not wake up when data arrived!\n" );
+        lResult = TEST_STM32_FAIL;
+    }
+
+    ulMs = ( uint32_t ) ( ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS );
+    printf( "\tWoke up after %u ms\n", ( unsigned ) ulMs );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestErrors( SocketHandle xSocket )
+{
+    SocketsPollFd_t xPollSockets[ 2 ];
+    SocketHandle xUnconnected = Sockets_Open();
+    int lResult = TEST_STM32_SUCCESS;
+
+    printf( "Poll errors\n" );
+
+    xPollSockets[ 0 ].xSocket = xSocket;
+    xPollSockets[ 0 ].ulEvents = SOCKETS_POLL_WRITE;
+    xPollSockets[ 1 ].xSocket = xUnconnected;
+    xPollSockets[ 1 ].ulEvents = SOCKETS_POLL_READ;
+
+    if( ( Sockets_Poll( xPollSockets, 2, 0U ) != 2 ) ||
+        ( xPollSockets[ 1 ].ulRevents != SOCKETS_POLL_ERROR ) )
+    {
+        printf( "\tSocket that is not connected not reported in error!\n" );
+        lResult = TEST_STM32_FAIL;
+    }
+
+    if( Sockets_Poll( NULL, 1, 0U ) != SOCKETS_EINVAL )
+    {
+        printf( "\tNo sockets not rejected!\n" );
+        lResult = TEST_STM32_FAIL;
+    }
+
+    ( void ) Sockets_Close( xUnconnected );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestCloseAsync( void )
+{
+    SocketHandle xClosed = Sockets_Open();
+    SocketHandle xReopened = SOCKETS_INVALID_SOCKET;
+    SocketHandle xOther = SOCKETS_INVALID_SOCKET;
+    uint8_t ucData[ 4 ] = { 0 };
+    uint32_t ulClosed = ulCloseCalls;
+    int lResult = TEST_STM32_SUCCESS;
+
+    printf( "Close without waiting for the peer\n" );
+
+    if( ( xClosed == SOCKETS_INVALID_SOCKET ) ||
+        ( Sockets_Connect( xClosed, TEST_HOST_NAME, TEST_PORT ) != SOCKETS_ERROR_NONE ) )
+    {
+        printf( "\tFailed to connect!\n" );
+        return TEST_STM32_FAIL;
+    }
+
+    if( ( Sockets_CloseAsync( xClosed ) != SOCKETS_ERROR_NONE ) ||
+        ( ulCloseCalls != ulClosed + 1U ) )
+    {
+        printf( "\tConnection not closed once!\n" );
+        lResult = TEST_STM32_FAIL;
+    }
+
+    /* The socket is opened again in the same slot. It must stay taken, so the
+     * next socket gets another slot. */
+    xReopened = Sockets_Open();
+    xOther = Sockets_Open();
+
+    if( ( xReopened != xClosed ) ||
+        ( xOther == SOCKETS_INVALID_SOCKET ) ||
+        ( xOther == xReopened ) )
+    {
+        printf( "\tSlot of the closed socket not reused once!\n" );
+        lResult = TEST_STM32_FAIL;
+    }
+
+    if( ( Sockets_Connect( xReopened, TEST_HOST_NAME, TEST_PORT ) != SOCKETS_ERROR_NONE ) ||
+        ( Sockets_Send( xReopened, ucData, sizeof( ucData ) ) != ( BaseType_t ) sizeof( ucData ) ) )
+    {
+        printf( "\tSocket opened in the slot of the closed socket not usable!\n" );
+        lResult = TEST_STM32_FAIL;
+    }
+
+    if( xOther != SOCKETS_INVALID_SOCKET )
+    {
+        ( void ) Sockets_Close( xOther );
+    }
+
+    if( xReopened != SOCKETS_INVALID_SOCKET )
+    {
+        ( void ) Sockets_Close( xReopened );
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    SocketHandle xSocket = SOCKETS_INVALID_SOCKET;
+    int lResult = TEST_STM32_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( ( ( xWifiSemaphoreHandle = xSemaphoreCreateMutex() ) == NULL ) ||
+        ( Sockets_Init() != SOCKETS_ERROR_NONE ) ||
+        ( ( xSocket = Sockets_Open() ) == SOCKETS_INVALID_SOCKET ) ||
+        ( Sockets_Connect( xSocket, TEST_HOST_NAME, TEST_PORT ) != SOCKETS_ERROR_NONE ) )
+    {
+        printf( "Failed to connect!\n" );
+        lResult = TEST_STM32_FAIL;
+    }
+    else if( ( prvTestReadAhead( xSocket ) != TEST_STM32_SUCCESS ) ||
+             ( prvTestWait( xSocket ) != TEST_STM32_SUCCESS ) ||
+             ( prvTestErrors( xSocket ) != TEST_STM32_SUCCESS ) ||
+             ( prvTestCloseAsync() != TEST_STM32_SUCCESS ) )
+    {
+        lResult = TEST_STM32_FAIL;
+    }
+
+    printf( lResult == TEST_STM32_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "SocketsStm32", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_STM32_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_STM32_FAIL;
+}
+/*-----------------------------------------------------------*/
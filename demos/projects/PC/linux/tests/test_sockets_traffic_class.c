@@ -0,0 +1,169 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  TEST OF THE TRANSPORT TRAFFIC CLASSES
+ *
+ *  Connects loopback sockets through the socket transport with each traffic
+ *  class and checks the options set on the socket before it connected. Also
+ *  checks that buffer sizes cannot be changed once a socket is connected.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "transport_socket.h"
+#include "sockets_wrapper_loopback.h"
+
+#define TEST_TRAFFIC_CLASS_SUCCESS    0
+#define TEST_TRAFFIC_CLASS_FAIL       1
+
+#define TEST_HOST_NAME                "localhost"
+#define TEST_PORT                     ( 8443U )
+#define TEST_TIMEOUT_MS               ( 1000U )
+
+#define TEST_TASK_STACK_SIZE          ( 8 * 1024 )
+#define TEST_TASK_PRIORITY            ( tskIDLE_PRIORITY + 2 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+/*-----------------------------------------------------------*/
+
+static int prvTestTrafficClass( const char * pcName,
+                                TransportTrafficClass_t xTrafficClass,
+                                BaseType_t xNoDelay,
+                                BaseType_t xKeepAlive,
+                                uint32_t ulReceiveBufferBytes )
+{
+    SocketTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { 0 };
+    LoopbackSocketOptions_t xOptions;
+    SocketHandle xServer;
+    int lResult = TEST_TRAFFIC_CLASS_SUCCESS;
+
+    printf( "Traffic class %s\n", pcName );
+
+    xParams.xTrafficClass = xTrafficClass;
+    xNetworkContext.pParams = &xParams;
+
+    if( ( Azure_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT,
+                                TEST_TIMEOUT_MS, TEST_TIMEOUT_MS ) != eSocketTransportSuccess ) ||
+        ( ( xServer = Loopback_Accept( 0 ) ) == SOCKETS_INVALID_SOCKET ) )
+    {
+        printf( "\tFailed to connect!\n" );
+        return TEST_TRAFFIC_CLASS_FAIL;
+    }
+
+    Loopback_GetOptions( xParams.xTCPSocket, &xOptions );
+
+    if( ( xOptions.xNoDelay != xNoDelay ) || ( xOptions.xKeepAlive != xKeepAlive ) )
+    {
+        printf( "\tNo delay %d, keep-alive %d!\n", ( int ) xOptions.xNoDelay, ( int ) xOptions.xKeepAlive );
+        lResult = TEST_TRAFFIC_CLASS_FAIL;
+    }
+    else if( ( xOptions.xWindow.ulReceiveBufferBytes != ulReceiveBufferBytes ) ||
+             ( xOptions.xWindow.ulSendBufferBytes != 0U ) )
+    {
+        printf( "\tReceive buffer %u, send buffer %u!\n",
+                ( unsigned ) xOptions.xWindow.ulReceiveBufferBytes,
+                ( unsigned ) xOptions.xWindow.ulSendBufferBytes );
+        lResult = TEST_TRAFFIC_CLASS_FAIL;
+    }
+
+    Azure_Socket_Close( &xNetworkContext );
+    Sockets_Disconnect( xServer );
+    ( void ) Sockets_Close( xServer );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestBufferAfterConnect( void )
+{
+    SocketHandle xClient;
+    SocketHandle xServer;
+    uint32_t ulBufferBytes = 4096U;
+    SocketsWindow_t xWindow = { 0 };
+    int lResult = TEST_TRAFFIC_CLASS_SUCCESS;
+
+    printf( "Buffer sizes rejected once connected\n" );
+
+    xClient = Sockets_Open();
+
+    if( ( xClient == SOCKETS_INVALID_SOCKET ) ||
+        ( Sockets_Connect( xClient, TEST_HOST_NAME, TEST_PORT ) != SOCKETS_ERROR_NONE ) ||
+        ( ( xServer = Loopback_Accept( 0 ) ) == SOCKETS_INVALID_SOCKET ) )
+    {
+        printf( "\tFailed to connect!\n" );
+        return TEST_TRAFFIC_CLASS_FAIL;
+    }
+
+    if( ( Sockets_SetSockOpt( xClient, SOCKETS_SO_RCVBUF, &ulBufferBytes, sizeof( ulBufferBytes ) ) != SOCKETS_EISCONN ) ||
+        ( Sockets_SetSockOpt( xClient, SOCKETS_SO_SNDBUF, &ulBufferBytes, sizeof( ulBufferBytes ) ) != SOCKETS_EISCONN ) ||
+        ( Sockets_SetSockOpt( xClient, SOCKETS_SO_WINDOW, &xWindow, sizeof( xWindow ) ) != SOCKETS_EISCONN ) )
+    {
+        printf( "\tBuffer size changed on a connected socket!\n" );
+        lResult = TEST_TRAFFIC_CLASS_FAIL;
+    }
+
+    ( void ) Sockets_CloseAsync( xClient );
+    Sockets_Disconnect( xServer );
+    ( void ) Sockets_Close( xServer );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_TRAFFIC_CLASS_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( Loopback_Listen( TEST_PORT ) != SOCKETS_ERROR_NONE )
+    {
+        printf( "Failed to listen!\n" );
+        lResult = TEST_TRAFFIC_CLASS_FAIL;
+    }
+    else if( ( prvTestTrafficClass( "default", eTransportTrafficClassDefault,
+                                    pdFALSE, pdFALSE, 0U ) != TEST_TRAFFIC_CLASS_SUCCESS ) ||
+             ( prvTestTrafficClass( "control", eTransportTrafficClassControl,
+                                    pdTRUE, pdTRUE, 0U ) != TEST_TRAFFIC_CLASS_SUCCESS ) ||
+             ( prvTestTrafficClass( "telemetry", eTransportTrafficClassTelemetry,
+                                    pdFALSE, pdTRUE, 0U ) != TEST_TRAFFIC_CLASS_SUCCESS ) ||
+             ( prvTestTrafficClass( "bulk", eTransportTrafficClassBulk,
+                                    pdFALSE, pdFALSE, transportBULK_RECEIVE_BUFFER_BYTES ) != TEST_TRAFFIC_CLASS_SUCCESS ) ||
+             ( prvTestBufferAfterConnect() != TEST_TRAFFIC_CLASS_SUCCESS ) )
+    {
+        lResult = TEST_TRAFFIC_CLASS_FAIL;
+    }
+
+    printf( lResult == TEST_TRAFFIC_CLASS_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "TrafficClass", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_TRAFFIC_CLASS_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_TRAFFIC_CLASS_FAIL;
+}
+/*-----------------------------------------------------------*/
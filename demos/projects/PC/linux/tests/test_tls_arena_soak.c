@@ -0,0 +1,232 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  SOAK TEST OF THE MBED TLS CONNECTION ARENAS
+ *
+ *  Opens and closes TLS connections many times with the pool allocator
+ *  enabled. Every arena must be handed back whole on disconnect, and the
+ *  mbed TLS heap must not grow once warmed up. Reports the arena high-water
+ *  marks, fragmentation and the share of allocations the arenas served.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "transport_tls_socket.h"
+#include "transport_tls_session_cache.h"
+#include "mbedtls_freertos_port.h"
+#include "test_tls_server.h"
+
+#define TEST_TLS_ARENA_SOAK_SUCCESS    0
+#define TEST_TLS_ARENA_SOAK_FAIL       1
+
+#define TEST_PORT                      ( 8883 )
+#define TEST_HOST_NAME                 "localhost"
+#define TEST_TIMEOUT_MS                ( 20000U )
+#define TEST_CYCLES                    ( 10000U )
+#define TEST_ECHO_MESSAGE              "arena soak echo"
+
+/* Cycles before the heap is expected to have settled. */
+#define TEST_WARM_UP_CYCLES            ( 100U )
+
+/* A full handshake every so many cycles, the others are resumed. */
+#define TEST_FULL_HANDSHAKE_INTERVAL   ( 50U )
+
+/* The in-process server may not have freed its side of the last connection
+ * yet when the heap is sampled. */
+#define TEST_HEAP_SLACK_BYTES          ( 4096U )
+
+#define TEST_TASK_STACK_SIZE           ( 8 * 1024 )
+#define TEST_TASK_PRIORITY             ( tskIDLE_PRIORITY + 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+static const NetworkCredentials_t xTestCredentials =
+{
+    .pucRootCa   = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA,
+    .xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA )
+};
+
+/*-----------------------------------------------------------*/
+
+static int prvConnectEchoClose( uint32_t ulCycle )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    uint8_t ucBuffer[ sizeof( TEST_ECHO_MESSAGE ) ];
+    size_t xReceived = 0;
+    int32_t lRet;
+    int lResult = TEST_TLS_ARENA_SOAK_SUCCESS;
+
+    if( ( ulCycle % TEST_FULL_HANDSHAKE_INTERVAL ) == 0U )
+    {
+        TLS_SessionCache_Invalidate( TEST_HOST_NAME, TEST_PORT );
+    }
+
+    if( TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xTestCredentials,
+                            TEST_TIMEOUT_MS, TEST_TIMEOUT_MS ) != eTLSTransportSuccess )
+    {
+        printf( "\tCycle %u: connect failed!\n", ( unsigned ) ulCycle );
+        return TEST_TLS_ARENA_SOAK_FAIL;
+    }
+
+    if( TLS_Socket_Send( &xNetworkContext, TEST_ECHO_MESSAGE, sizeof( TEST_ECHO_MESSAGE ) ) !=
+        ( int32_t ) sizeof( TEST_ECHO_MESSAGE ) )
+    {
+        printf( "\tCycle %u: send failed!\n", ( unsigned ) ulCycle );
+        lResult = TEST_TLS_ARENA_SOAK_FAIL;
+    }
+
+    while( ( lResult == TEST_TLS_ARENA_SOAK_SUCCESS ) && ( xReceived < sizeof( ucBuffer ) ) )
+    {
+        lRet = TLS_Socket_Recv( &xNetworkContext, ucBuffer + xReceived, sizeof( ucBuffer ) - xReceived );
+
+        if( lRet <= 0 )
+        {
+            printf( "\tCycle %u: receive failed: %d\n", ( unsigned ) ulCycle, ( int ) lRet );
+            lResult = TEST_TLS_ARENA_SOAK_FAIL;
+        }
+        else
+        {
+            xReceived += ( size_t ) lRet;
+        }
+    }
+
+    if( ( lResult == TEST_TLS_ARENA_SOAK_SUCCESS ) &&
+        ( memcmp( ucBuffer, TEST_ECHO_MESSAGE, sizeof( ucBuffer ) ) != 0 ) )
+    {
+        printf( "\tCycle %u: echo does not match!\n", ( unsigned ) ulCycle );
+        lResult = TEST_TLS_ARENA_SOAK_FAIL;
+    }
+
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestSoak( void )
+{
+    MbedtlsPoolStats_t xPoolStats;
+    size_t xWarmHeapBytes = 0;
+    uint32_t ulTotalAllocations;
+    uint32_t ulPeakInUseShare;
+    int lResult = TEST_TLS_ARENA_SOAK_SUCCESS;
+    uint32_t i;
+
+    printf( "%u connect and disconnect cycles\n", ( unsigned ) TEST_CYCLES );
+
+    for( i = 0; ( i < TEST_CYCLES ) && ( lResult == TEST_TLS_ARENA_SOAK_SUCCESS ); i++ )
+    {
+        lResult = prvConnectEchoClose( i );
+
+        mbedtls_platform_pool_stats_get( &xPoolStats );
+
+        /* The client arena is gone; the server does not use one. */
+        if( ( xPoolStats.xArenas.xChunkBytes != 0U ) ||
+            ( xPoolStats.xArenas.xInUseBytes != 0U ) ||
+            ( xPoolStats.ulActiveArenas != 0U ) )
+        {
+            printf( "\tCycle %u: %u chunk bytes and %u bytes in use left in %u arenas!\n",
+                    ( unsigned ) i,
+                    ( unsigned ) xPoolStats.xArenas.xChunkBytes,
+                    ( unsigned ) xPoolStats.xArenas.xInUseBytes,
+                    ( unsigned ) xPoolStats.ulActiveArenas );
+            lResult = TEST_TLS_ARENA_SOAK_FAIL;
+        }
+
+        if( i < TEST_WARM_UP_CYCLES )
+        {
+            if( xPoolStats.xHeapBytes > xWarmHeapBytes )
+            {
+                xWarmHeapBytes = xPoolStats.xHeapBytes;
+            }
+        }
+        else if( xPoolStats.xHeapBytes > xWarmHeapBytes + TEST_HEAP_SLACK_BYTES )
+        {
+            printf( "\tCycle %u: heap grew to %u bytes, %u after warm-up!\n",
+                    ( unsigned ) i,
+                    ( unsigned ) xPoolStats.xHeapBytes,
+                    ( unsigned ) xWarmHeapBytes );
+            lResult = TEST_TLS_ARENA_SOAK_FAIL;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+
+    if( lResult == TEST_TLS_ARENA_SOAK_SUCCESS )
+    {
+        ulTotalAllocations = xPoolStats.xArenas.ulAllocations + xPoolStats.ulHeapAllocations;
+        ulPeakInUseShare = ( uint32_t ) ( ( uint64_t ) xPoolStats.xArenas.xPeakInUseBytes * 100U /
+                                          ( xPoolStats.xArenas.xPeakChunkBytes + 1U ) );
+
+        printf( "\tarena high-water: %u chunk bytes, %u bytes in use (%u%% of the chunks)\n",
+                ( unsigned ) xPoolStats.xArenas.xPeakChunkBytes,
+                ( unsigned ) xPoolStats.xArenas.xPeakInUseBytes,
+                ( unsigned ) ulPeakInUseShare );
+        printf( "\theap high-water: %u bytes, %u after warm-up\n",
+                ( unsigned ) xPoolStats.xPeakHeapBytes,
+                ( unsigned ) xWarmHeapBytes );
+        printf( "\tper connection: %u arena allocations (%u reused), %u chunks, %u too large for a class\n",
+                ( unsigned ) ( xPoolStats.xArenas.ulAllocations / TEST_CYCLES ),
+                ( unsigned ) ( xPoolStats.xArenas.ulReuses / TEST_CYCLES ),
+                ( unsigned ) ( xPoolStats.xArenas.ulChunks / TEST_CYCLES ),
+                ( unsigned ) ( xPoolStats.xArenas.ulHeapAllocations / TEST_CYCLES ) );
+        printf( "\tarenas served %u%% of %u mbed TLS allocations\n",
+                ( unsigned ) ( ( uint64_t ) xPoolStats.xArenas.ulAllocations * 100U / ( ulTotalAllocations + 1U ) ),
+                ( unsigned ) ulTotalAllocations );
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_TLS_ARENA_SOAK_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( TestTlsServer_Start( TEST_PORT ) != pdPASS )
+    {
+        printf( "Failed to start the test server!\n" );
+        lResult = TEST_TLS_ARENA_SOAK_FAIL;
+    }
+    else
+    {
+        lResult = prvTestSoak();
+    }
+
+    printf( lResult == TEST_TLS_ARENA_SOAK_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "TlsArenaSoak", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_TLS_ARENA_SOAK_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_TLS_ARENA_SOAK_FAIL;
+}
+/*-----------------------------------------------------------*/
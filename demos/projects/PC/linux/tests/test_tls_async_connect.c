@@ -0,0 +1,316 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  UNIT TESTS FOR THE NON-BLOCKING TLS CONNECT
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "transport_tls_socket.h"
+#include "test_tls_server.h"
+
+#define TEST_TLS_ASYNC_SUCCESS       0
+#define TEST_TLS_ASYNC_FAIL          1
+
+#define TEST_PORT                    ( 8883 )
+#define TEST_UNUSED_PORT             ( 8884 )
+#define TEST_HOST_NAME               "localhost"
+#define TEST_CONNECTIONS             ( 2 )
+#define TEST_TIMEOUT_MS              ( 20000U )
+#define TEST_ECHO_MESSAGE            "async connect echo"
+
+#define TEST_TASK_STACK_SIZE         ( 8 * 1024 )
+#define TEST_TASK_PRIORITY           ( tskIDLE_PRIORITY + 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+static const NetworkCredentials_t xTestCredentials =
+{
+    .pucRootCa   = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA,
+    .xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA )
+};
+
+/*-----------------------------------------------------------*/
+
+static int prvEcho( NetworkContext_t * pxNetworkContext )
+{
+    uint8_t ucBuffer[ sizeof( TEST_ECHO_MESSAGE ) ];
+    size_t xReceived = 0;
+    int32_t lRet;
+    TickType_t xStart = xTaskGetTickCount();
+
+    lRet = TLS_Socket_Send( pxNetworkContext, TEST_ECHO_MESSAGE, sizeof( TEST_ECHO_MESSAGE ) );
+
+    if( lRet != ( int32_t ) sizeof( TEST_ECHO_MESSAGE ) )
+    {
+        printf( "\tSend failed: %d\n", ( int ) lRet );
+        return TEST_TLS_ASYNC_FAIL;
+    }
+
+    while( ( xReceived < sizeof( ucBuffer ) ) &&
+           ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_TIMEOUT_MS ) ) )
+    {
+        lRet = TLS_Socket_Recv( pxNetworkContext, ucBuffer + xReceived, sizeof( ucBuffer ) - xReceived );
+
+        if( lRet < 0 )
+        {
+            printf( "\tReceive failed: %d\n", ( int ) lRet );
+            return TEST_TLS_ASYNC_FAIL;
+        }
+
+        xReceived += ( size_t ) lRet;
+    }
+
+    if( ( xReceived != sizeof( ucBuffer ) ) ||
+        ( memcmp( ucBuffer, TEST_ECHO_MESSAGE, sizeof( ucBuffer ) ) != 0 ) )
+    {
+        printf( "\tEcho mismatch!\n" );
+        return TEST_TLS_ASYNC_FAIL;
+    }
+
+    return TEST_TLS_ASYNC_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestBlockingConnect( void )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    TlsTransportStatus_t xStatus;
+    int lResult;
+
+    printf( "Blocking connect\n" );
+
+    xStatus = TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT,
+                                  &xTestCredentials, TEST_TIMEOUT_MS, TEST_TIMEOUT_MS );
+
+    if( xStatus != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed: %d\n", xStatus );
+        return TEST_TLS_ASYNC_FAIL;
+    }
+
+    lResult = prvEcho( &xNetworkContext );
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestConcurrentConnects( void )
+{
+    TlsTransportParams_t xParams[ TEST_CONNECTIONS ] = { 0 };
+    NetworkContext_t xNetworkContext[ TEST_CONNECTIONS ];
+    TlsTransportStatus_t xStatus[ TEST_CONNECTIONS ];
+    uint32_t ulHandshakesBefore = TestTlsServer_GetHandshakes();
+    uint32_t ulPollsWithAllInProgress = 0;
+    uint32_t ulOtherWork = 0;
+    TickType_t xStart = xTaskGetTickCount();
+    BaseType_t xInProgress;
+    int lResult = TEST_TLS_ASYNC_SUCCESS;
+    size_t i;
+
+    printf( "Concurrent non-blocking connects\n" );
+
+    for( i = 0; i < TEST_CONNECTIONS; i++ )
+    {
+        xNetworkContext[ i ].pParams = &xParams[ i ];
+        xStatus[ i ] = TLS_Socket_ConnectStart( &xNetworkContext[ i ], TEST_HOST_NAME, TEST_PORT,
+                                                &xTestCredentials, TEST_TIMEOUT_MS, TEST_TIMEOUT_MS );
+
+        if( xStatus[ i ] != eTLSTransportInProgress )
+        {
+            printf( "\tConnect %u did not start in the background: %d\n", ( unsigned ) i, xStatus[ i ] );
+            lResult = TEST_TLS_ASYNC_FAIL;
+        }
+    }
+
+    /* Drive all connects from this task, which stays free for other work. */
+    do
+    {
+        xInProgress = pdFALSE;
+
+        for( i = 0; i < TEST_CONNECTIONS; i++ )
+        {
+            if( xStatus[ i ] == eTLSTransportInProgress )
+            {
+                xStatus[ i ] = TLS_Socket_ConnectPoll( &xNetworkContext[ i ] );
+            }
+        }
+
+        if( ( xStatus[ 0 ] == eTLSTransportInProgress ) &&
+            ( xStatus[ 1 ] == eTLSTransportInProgress ) )
+        {
+            ulPollsWithAllInProgress++;
+        }
+
+        for( i = 0; i < TEST_CONNECTIONS; i++ )
+        {
+            xInProgress |= ( xStatus[ i ] == eTLSTransportInProgress );
+        }
+
+        ulOtherWork++;
+        vTaskDelay( 1 );
+    } while( xInProgress &&
+             ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_TIMEOUT_MS ) ) );
+
+    for( i = 0; i < TEST_CONNECTIONS; i++ )
+    {
+        if( xStatus[ i ] == eTLSTransportSuccess )
+        {
+            if( prvEcho( &xNetworkContext[ i ] ) != TEST_TLS_ASYNC_SUCCESS )
+            {
+                lResult = TEST_TLS_ASYNC_FAIL;
+            }
+
+            TLS_Socket_Disconnect( &xNetworkContext[ i ] );
+        }
+        else
+        {
+            printf( "\tConnect %u failed: %d\n", ( unsigned ) i, xStatus[ i ] );
+
+            if( xStatus[ i ] == eTLSTransportInProgress )
+            {
+                TLS_Socket_Disconnect( &xNetworkContext[ i ] );
+            }
+
+            lResult = TEST_TLS_ASYNC_FAIL;
+        }
+    }
+
+    if( ulPollsWithAllInProgress == 0 )
+    {
+        printf( "\tConnects never overlapped!\n" );
+        lResult = TEST_TLS_ASYNC_FAIL;
+    }
+
+    if( TestTlsServer_GetHandshakes() - ulHandshakesBefore != TEST_CONNECTIONS )
+    {
+        printf( "\tServer saw %u handshakes\n",
+                ( unsigned ) ( TestTlsServer_GetHandshakes() - ulHandshakesBefore ) );
+        lResult = TEST_TLS_ASYNC_FAIL;
+    }
+
+    printf( "\t%u polls, %u with all connects in progress\n",
+            ( unsigned ) ulOtherWork, ( unsigned ) ulPollsWithAllInProgress );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestConnectFailure( void )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    TlsTransportStatus_t xStatus;
+    TickType_t xStart = xTaskGetTickCount();
+
+    printf( "Non-blocking connect to a closed port\n" );
+
+    xStatus = TLS_Socket_ConnectStart( &xNetworkContext, TEST_HOST_NAME, TEST_UNUSED_PORT,
+                                       &xTestCredentials, TEST_TIMEOUT_MS, TEST_TIMEOUT_MS );
+
+    while( ( xStatus == eTLSTransportInProgress ) &&
+           ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_TIMEOUT_MS ) ) )
+    {
+        vTaskDelay( 1 );
+        xStatus = TLS_Socket_ConnectPoll( &xNetworkContext );
+    }
+
+    if( xStatus != eTLSTransportConnectFailure )
+    {
+        printf( "\tUnexpected status: %d\n", xStatus );
+        return TEST_TLS_ASYNC_FAIL;
+    }
+
+    if( xParams.xSSLContext != NULL )
+    {
+        printf( "\tContext not freed!\n" );
+        return TEST_TLS_ASYNC_FAIL;
+    }
+
+    return TEST_TLS_ASYNC_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestAbandonConnect( void )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    TlsTransportStatus_t xStatus;
+
+    printf( "Abandoning a non-blocking connect\n" );
+
+    xStatus = TLS_Socket_ConnectStart( &xNetworkContext, TEST_HOST_NAME, TEST_PORT,
+                                       &xTestCredentials, TEST_TIMEOUT_MS, TEST_TIMEOUT_MS );
+
+    if( xStatus != eTLSTransportInProgress )
+    {
+        printf( "\tUnexpected status: %d\n", xStatus );
+        return TEST_TLS_ASYNC_FAIL;
+    }
+
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    if( xParams.xSSLContext != NULL )
+    {
+        printf( "\tContext not freed!\n" );
+        return TEST_TLS_ASYNC_FAIL;
+    }
+
+    /* The socket must have been returned, so a new connect works. */
+    return prvTestBlockingConnect();
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_TLS_ASYNC_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( TestTlsServer_Start( TEST_PORT ) != pdPASS )
+    {
+        printf( "Failed to start the test server!\n" );
+        lResult = TEST_TLS_ASYNC_FAIL;
+    }
+    else if( ( prvTestBlockingConnect() != TEST_TLS_ASYNC_SUCCESS ) ||
+             ( prvTestConcurrentConnects() != TEST_TLS_ASYNC_SUCCESS ) ||
+             ( prvTestConnectFailure() != TEST_TLS_ASYNC_SUCCESS ) ||
+             ( prvTestAbandonConnect() != TEST_TLS_ASYNC_SUCCESS ) )
+    {
+        lResult = TEST_TLS_ASYNC_FAIL;
+    }
+
+    printf( lResult == TEST_TLS_ASYNC_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "TlsAsyncTest", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_TLS_ASYNC_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_TLS_ASYNC_FAIL;
+}
+/*-----------------------------------------------------------*/
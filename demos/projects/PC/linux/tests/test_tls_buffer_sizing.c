@@ -0,0 +1,278 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  MEASUREMENT HARNESS FOR THE TLS RECORD BUFFER SIZING
+ *
+ *  For each maximum fragment length, connects to the echo server, then
+ *  reports the peak mbed TLS heap of the client during the handshake, the
+ *  heap it keeps once connected, and the echo throughput. Only allocations
+ *  made by the client task are counted.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "transport_tls_socket.h"
+#include "mbedtls_freertos_port.h"
+#include "test_tls_server.h"
+
+#define TEST_TLS_BUFFER_SIZING_SUCCESS    0
+#define TEST_TLS_BUFFER_SIZING_FAIL       1
+
+#define TEST_PORT                         ( 8883 )
+#define TEST_HOST_NAME                    "localhost"
+#define TEST_TIMEOUT_MS                   ( 20000U )
+#define TEST_CHUNK_SIZE                   ( 2048 )
+#define TEST_TRANSFER_SIZE                ( 256 * 1024 )
+
+#define TEST_TASK_STACK_SIZE              ( 8 * 1024 )
+#define TEST_TASK_PRIORITY                ( tskIDLE_PRIORITY + 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+typedef struct TestResult
+{
+    size_t xHandshakePeakBytes;
+    size_t xConnectedBytes;
+    uint32_t ulKBytesPerSecond;
+} TestResult_t;
+
+static const uint16_t usFragmentLengths[] = { 16384, 4096, 2048, 1024, 512 };
+
+static uint8_t ucSendBuffer[ TEST_CHUNK_SIZE ];
+static uint8_t ucRecvBuffer[ TEST_CHUNK_SIZE ];
+
+/*-----------------------------------------------------------*/
+
+static int prvSendAll( NetworkContext_t * pxNetworkContext,
+                       const uint8_t * pucBuffer,
+                       size_t xLength )
+{
+    size_t xSent = 0;
+    int32_t lRet;
+    TickType_t xStart = xTaskGetTickCount();
+
+    /* With small fragments a send may only take part of the buffer. */
+    while( ( xSent < xLength ) &&
+           ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_TIMEOUT_MS ) ) )
+    {
+        lRet = TLS_Socket_Send( pxNetworkContext, pucBuffer + xSent, xLength - xSent );
+
+        if( lRet < 0 )
+        {
+            printf( "\tSend failed: %d\n", ( int ) lRet );
+            return TEST_TLS_BUFFER_SIZING_FAIL;
+        }
+
+        xSent += ( size_t ) lRet;
+    }
+
+    return ( xSent == xLength ) ? TEST_TLS_BUFFER_SIZING_SUCCESS : TEST_TLS_BUFFER_SIZING_FAIL;
+}
+/*-----------------------------------------------------------*/
+
+static int prvRecvAll( NetworkContext_t * pxNetworkContext,
+                       uint8_t * pucBuffer,
+                       size_t xLength )
+{
+    size_t xReceived = 0;
+    int32_t lRet;
+    TickType_t xStart = xTaskGetTickCount();
+
+    while( ( xReceived < xLength ) &&
+           ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_TIMEOUT_MS ) ) )
+    {
+        lRet = TLS_Socket_Recv( pxNetworkContext, pucBuffer + xReceived, xLength - xReceived );
+
+        if( lRet < 0 )
+        {
+            printf( "\tReceive failed: %d\n", ( int ) lRet );
+            return TEST_TLS_BUFFER_SIZING_FAIL;
+        }
+
+        xReceived += ( size_t ) lRet;
+    }
+
+    return ( xReceived == xLength ) ? TEST_TLS_BUFFER_SIZING_SUCCESS : TEST_TLS_BUFFER_SIZING_FAIL;
+}
+/*-----------------------------------------------------------*/
+
+static int prvMeasure( uint16_t usMaxFragmentLength,
+                       TestResult_t * pxResult )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    NetworkCredentials_t xCredentials = { 0 };
+    MbedtlsHeapStats_t xHeapStats;
+    TickType_t xStart;
+    TickType_t xElapsed;
+    size_t xTransferred;
+    int lResult = TEST_TLS_BUFFER_SIZING_SUCCESS;
+
+    xCredentials.pucRootCa = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA;
+    xCredentials.xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA );
+    xCredentials.usMaxFragmentLength = usMaxFragmentLength;
+
+    mbedtls_platform_heap_stats_reset( xTaskGetCurrentTaskHandle() );
+
+    if( TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xCredentials,
+                            TEST_TIMEOUT_MS, TEST_TIMEOUT_MS ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect with %u byte fragments failed!\n", ( unsigned ) usMaxFragmentLength );
+        return TEST_TLS_BUFFER_SIZING_FAIL;
+    }
+
+    mbedtls_platform_heap_stats_get( &xHeapStats );
+    pxResult->xHandshakePeakBytes = xHeapStats.xPeakBytes;
+    pxResult->xConnectedBytes = xHeapStats.xCurrentBytes;
+
+    xStart = xTaskGetTickCount();
+
+    for( xTransferred = 0;
+         ( xTransferred < TEST_TRANSFER_SIZE ) && ( lResult == TEST_TLS_BUFFER_SIZING_SUCCESS );
+         xTransferred += TEST_CHUNK_SIZE )
+    {
+        ( void ) memset( ucSendBuffer, ( int ) ( xTransferred / TEST_CHUNK_SIZE ), sizeof( ucSendBuffer ) );
+
+        if( ( prvSendAll( &xNetworkContext, ucSendBuffer, sizeof( ucSendBuffer ) ) != TEST_TLS_BUFFER_SIZING_SUCCESS ) ||
+            ( prvRecvAll( &xNetworkContext, ucRecvBuffer, sizeof( ucRecvBuffer ) ) != TEST_TLS_BUFFER_SIZING_SUCCESS ) ||
+            ( memcmp( ucSendBuffer, ucRecvBuffer, sizeof( ucSendBuffer ) ) != 0 ) )
+        {
+            printf( "\tEcho with %u byte fragments failed!\n", ( unsigned ) usMaxFragmentLength );
+            lResult = TEST_TLS_BUFFER_SIZING_FAIL;
+        }
+    }
+
+    xElapsed = xTaskGetTickCount() - xStart;
+    pxResult->ulKBytesPerSecond = ( uint32_t ) ( ( ( uint64_t ) xTransferred * configTICK_RATE_HZ ) /
+                                                 ( ( uint64_t ) ( xElapsed + 1 ) * 1024U ) );
+
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestFragmentLengths( void )
+{
+    TestResult_t xResults[ sizeof( usFragmentLengths ) / sizeof( usFragmentLengths[ 0 ] ) ];
+    TestResult_t xWarmUp;
+    size_t i;
+    int lResult = TEST_TLS_BUFFER_SIZING_SUCCESS;
+
+    printf( "Heap per connection against throughput\n" );
+
+    /* Parse the credentials once, so each setting pays the same. */
+    if( prvMeasure( 0, &xWarmUp ) != TEST_TLS_BUFFER_SIZING_SUCCESS )
+    {
+        return TEST_TLS_BUFFER_SIZING_FAIL;
+    }
+
+    printf( "\t%10s %16s %16s %10s\n", "fragment", "handshake peak", "connected", "KB/s" );
+
+    for( i = 0; i < sizeof( usFragmentLengths ) / sizeof( usFragmentLengths[ 0 ] ); i++ )
+    {
+        if( prvMeasure( usFragmentLengths[ i ], &xResults[ i ] ) != TEST_TLS_BUFFER_SIZING_SUCCESS )
+        {
+            lResult = TEST_TLS_BUFFER_SIZING_FAIL;
+        }
+        else
+        {
+            printf( "\t%10u %16u %16u %10u\n",
+                    ( unsigned ) usFragmentLengths[ i ],
+                    ( unsigned ) xResults[ i ].xHandshakePeakBytes,
+                    ( unsigned ) xResults[ i ].xConnectedBytes,
+                    ( unsigned ) xResults[ i ].ulKBytesPerSecond );
+        }
+    }
+
+    /* The record buffers must have been shrunk to the fragment length. */
+    for( i = 1; ( lResult == TEST_TLS_BUFFER_SIZING_SUCCESS ) &&
+         ( i < sizeof( usFragmentLengths ) / sizeof( usFragmentLengths[ 0 ] ) ); i++ )
+    {
+        if( xResults[ i ].xConnectedBytes >= xResults[ i - 1 ].xConnectedBytes )
+        {
+            printf( "\tConnected heap did not drop from %u to %u byte fragments!\n",
+                    ( unsigned ) usFragmentLengths[ i - 1 ], ( unsigned ) usFragmentLengths[ i ] );
+            lResult = TEST_TLS_BUFFER_SIZING_FAIL;
+        }
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestInvalidFragmentLength( void )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    NetworkCredentials_t xCredentials = { 0 };
+    TlsTransportStatus_t xStatus;
+
+    printf( "Unsupported fragment length\n" );
+
+    xCredentials.pucRootCa = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA;
+    xCredentials.xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA );
+    xCredentials.usMaxFragmentLength = 3000;
+
+    xStatus = TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xCredentials,
+                                  TEST_TIMEOUT_MS, TEST_TIMEOUT_MS );
+
+    if( xStatus != eTLSTransportInvalidParameter )
+    {
+        printf( "\tUnexpected status: %d\n", xStatus );
+        return TEST_TLS_BUFFER_SIZING_FAIL;
+    }
+
+    return TEST_TLS_BUFFER_SIZING_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_TLS_BUFFER_SIZING_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( TestTlsServer_Start( TEST_PORT ) != pdPASS )
+    {
+        printf( "Failed to start the test server!\n" );
+        lResult = TEST_TLS_BUFFER_SIZING_FAIL;
+    }
+    else if( ( prvTestFragmentLengths() != TEST_TLS_BUFFER_SIZING_SUCCESS ) ||
+             ( prvTestInvalidFragmentLength() != TEST_TLS_BUFFER_SIZING_SUCCESS ) )
+    {
+        lResult = TEST_TLS_BUFFER_SIZING_FAIL;
+    }
+
+    printf( lResult == TEST_TLS_BUFFER_SIZING_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "TlsBufferSizing", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_TLS_BUFFER_SIZING_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_TLS_BUFFER_SIZING_FAIL;
+}
+/*-----------------------------------------------------------*/
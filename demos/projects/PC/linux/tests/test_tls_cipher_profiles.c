@@ -0,0 +1,259 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  BENCHMARK OF THE TLS CIPHER PROFILES
+ *
+ *  For each profile, measures the full handshake time and bytes, and the bulk
+ *  echo throughput, against the in-process mbed TLS server.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "transport_tls_socket.h"
+#include "transport_tls_session_cache.h"
+#include "test_tls_server.h"
+
+#define TEST_TLS_CIPHER_PROFILES_SUCCESS    0
+#define TEST_TLS_CIPHER_PROFILES_FAIL       1
+
+#define TEST_PORT                           ( 8883 )
+#define TEST_HOST_NAME                      "localhost"
+#define TEST_TIMEOUT_MS                     ( 20000U )
+#define TEST_HANDSHAKES                     ( 5 )
+#define TEST_BULK_BYTES                     ( 64 * 1024 )
+#define TEST_CHUNK_SIZE                     ( 1024 )
+
+#define TEST_TASK_STACK_SIZE                ( 8 * 1024 )
+#define TEST_TASK_PRIORITY                  ( tskIDLE_PRIORITY + 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+/* A profile, and what its negotiated cipher suite must contain. */
+typedef struct TestProfile
+{
+    const char * pcName;
+    TlsCipherProfile_t xProfile;
+    const char * pcExpectedKeyExchange;
+    const char * pcExpectedCipher;
+} TestProfile_t;
+
+static const TestProfile_t xTestProfiles[] =
+{
+    { "low-power", eTlsCipherProfileLowPower, "ECDHE-ECDSA", "AES-128" },
+    { "balanced",  eTlsCipherProfileBalanced, "ECDHE",       "AES-128" },
+    { "compat",    eTlsCipherProfileCompat,   "",            ""        }
+};
+
+static uint8_t ucSendBuffer[ TEST_CHUNK_SIZE ];
+static uint8_t ucRecvBuffer[ TEST_CHUNK_SIZE ];
+
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t prvConnect( NetworkContext_t * pxNetworkContext,
+                                        TlsCipherProfile_t xProfile )
+{
+    NetworkCredentials_t xCredentials = { 0 };
+
+    xCredentials.pucRootCa = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA;
+    xCredentials.xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA );
+    xCredentials.xCipherProfile = xProfile;
+
+    /* Measure full handshakes only. */
+    TLS_SessionCache_Invalidate( TEST_HOST_NAME, TEST_PORT );
+
+    return TLS_Socket_Connect( pxNetworkContext, TEST_HOST_NAME, TEST_PORT, &xCredentials,
+                               TEST_TIMEOUT_MS, TEST_TIMEOUT_MS );
+}
+/*-----------------------------------------------------------*/
+
+static int prvEchoChunk( NetworkContext_t * pxNetworkContext )
+{
+    size_t xReceived = 0;
+    int32_t lRet;
+
+    if( TLS_Socket_Send( pxNetworkContext, ucSendBuffer, sizeof( ucSendBuffer ) ) != ( int32_t ) sizeof( ucSendBuffer ) )
+    {
+        printf( "\tSend failed!\n" );
+        return TEST_TLS_CIPHER_PROFILES_FAIL;
+    }
+
+    while( xReceived < sizeof( ucRecvBuffer ) )
+    {
+        lRet = TLS_Socket_Recv( pxNetworkContext, ucRecvBuffer + xReceived, sizeof( ucRecvBuffer ) - xReceived );
+
+        if( lRet <= 0 )
+        {
+            printf( "\tReceive failed: %d\n", ( int ) lRet );
+            return TEST_TLS_CIPHER_PROFILES_FAIL;
+        }
+
+        xReceived += ( size_t ) lRet;
+    }
+
+    if( memcmp( ucSendBuffer, ucRecvBuffer, sizeof( ucRecvBuffer ) ) != 0 )
+    {
+        printf( "\tEcho does not match!\n" );
+        return TEST_TLS_CIPHER_PROFILES_FAIL;
+    }
+
+    return TEST_TLS_CIPHER_PROFILES_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvBenchmarkProfile( const TestProfile_t * pxProfile )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    TlsTransportConnectStats_t xConnectStats;
+    TlsTransportSendStats_t xSendStats;
+    TlsTransportRecvStats_t xRecvStats;
+    uint32_t ulHandshakeMs = 0;
+    uint64_t ullHandshakeBytes = 0;
+    TickType_t xStart;
+    uint32_t ulBulkMs;
+    int lResult = TEST_TLS_CIPHER_PROFILES_SUCCESS;
+    int i;
+
+    for( i = 0; ( i < TEST_HANDSHAKES ) && ( lResult == TEST_TLS_CIPHER_PROFILES_SUCCESS ); i++ )
+    {
+        if( prvConnect( &xNetworkContext, pxProfile->xProfile ) != eTLSTransportSuccess )
+        {
+            printf( "\t%s: connect failed!\n", pxProfile->pcName );
+            return TEST_TLS_CIPHER_PROFILES_FAIL;
+        }
+
+        TLS_Socket_GetConnectStats( &xNetworkContext, &xConnectStats );
+        TLS_Socket_GetSendStats( &xNetworkContext, &xSendStats );
+        TLS_Socket_GetRecvStats( &xNetworkContext, &xRecvStats );
+
+        ulHandshakeMs += xConnectStats.ulHandshakeMs;
+        ullHandshakeBytes += xSendStats.ullWireBytes + xRecvStats.ullWireBytes;
+
+        if( ( strstr( xConnectStats.pcCipherSuite, pxProfile->pcExpectedKeyExchange ) == NULL ) ||
+            ( strstr( xConnectStats.pcCipherSuite, pxProfile->pcExpectedCipher ) == NULL ) )
+        {
+            printf( "\t%s: negotiated %s!\n", pxProfile->pcName, xConnectStats.pcCipherSuite );
+            lResult = TEST_TLS_CIPHER_PROFILES_FAIL;
+        }
+
+        /* Keep the last connection for the throughput run. */
+        if( ( i + 1 < TEST_HANDSHAKES ) || ( lResult != TEST_TLS_CIPHER_PROFILES_SUCCESS ) )
+        {
+            TLS_Socket_Disconnect( &xNetworkContext );
+        }
+    }
+
+    if( lResult == TEST_TLS_CIPHER_PROFILES_SUCCESS )
+    {
+        xStart = xTaskGetTickCount();
+
+        for( i = 0; ( i < TEST_BULK_BYTES / TEST_CHUNK_SIZE ) && ( lResult == TEST_TLS_CIPHER_PROFILES_SUCCESS ); i++ )
+        {
+            ( void ) memset( ucSendBuffer, i, sizeof( ucSendBuffer ) );
+            lResult = prvEchoChunk( &xNetworkContext );
+        }
+
+        ulBulkMs = ( uint32_t ) ( ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS );
+        TLS_Socket_Disconnect( &xNetworkContext );
+
+        printf( "\t%-10s %-42s handshake %u ms, %u bytes; echo %u KB in %u ms (%u KB/s)\n",
+                pxProfile->pcName,
+                xConnectStats.pcCipherSuite,
+                ( unsigned ) ( ulHandshakeMs / TEST_HANDSHAKES ),
+                ( unsigned ) ( ullHandshakeBytes / TEST_HANDSHAKES ),
+                ( unsigned ) ( TEST_BULK_BYTES / 1024 ),
+                ( unsigned ) ulBulkMs,
+                ( unsigned ) ( ( uint32_t ) TEST_BULK_BYTES / 1024U * 1000U / ( ulBulkMs + 1U ) ) );
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestProfiles( void )
+{
+    int lResult = TEST_TLS_CIPHER_PROFILES_SUCCESS;
+    size_t i;
+
+    printf( "Cipher profiles\n" );
+
+    for( i = 0; i < sizeof( xTestProfiles ) / sizeof( xTestProfiles[ 0 ] ); i++ )
+    {
+        if( prvBenchmarkProfile( &xTestProfiles[ i ] ) != TEST_TLS_CIPHER_PROFILES_SUCCESS )
+        {
+            lResult = TEST_TLS_CIPHER_PROFILES_FAIL;
+        }
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestUnknownProfile( void )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+
+    printf( "Unknown profile\n" );
+
+    if( prvConnect( &xNetworkContext, ( TlsCipherProfile_t ) ( eTlsCipherProfileCompat + 1 ) ) !=
+        eTLSTransportInvalidParameter )
+    {
+        printf( "\tUnknown profile accepted!\n" );
+        TLS_Socket_Disconnect( &xNetworkContext );
+        return TEST_TLS_CIPHER_PROFILES_FAIL;
+    }
+
+    return TEST_TLS_CIPHER_PROFILES_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_TLS_CIPHER_PROFILES_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( TestTlsServer_Start( TEST_PORT ) != pdPASS )
+    {
+        printf( "Failed to start the test server!\n" );
+        lResult = TEST_TLS_CIPHER_PROFILES_FAIL;
+    }
+    else if( ( prvTestProfiles() != TEST_TLS_CIPHER_PROFILES_SUCCESS ) ||
+             ( prvTestUnknownProfile() != TEST_TLS_CIPHER_PROFILES_SUCCESS ) )
+    {
+        lResult = TEST_TLS_CIPHER_PROFILES_FAIL;
+    }
+
+    printf( lResult == TEST_TLS_CIPHER_PROFILES_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "TlsCipherProfiles", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_TLS_CIPHER_PROFILES_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_TLS_CIPHER_PROFILES_FAIL;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,261 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  UNIT TESTS FOR THE TLS CONNECT TIMINGS AND TRAFFIC COUNTERS
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "transport_tls_socket.h"
+#include "sockets_wrapper_loopback.h"
+#include "test_tls_server.h"
+
+#define TEST_TLS_CONNECT_STATS_SUCCESS    0
+#define TEST_TLS_CONNECT_STATS_FAIL       1
+
+#define TEST_PORT                         ( 8883 )
+#define TEST_HOST_NAME                    "localhost"
+#define TEST_TIMEOUT_MS                   ( 20000U )
+#define TEST_MESSAGES                     ( 10 )
+#define TEST_MESSAGE_SIZE                 ( 100 )
+
+#define TEST_TASK_STACK_SIZE              ( 8 * 1024 )
+#define TEST_TASK_PRIORITY                ( tskIDLE_PRIORITY + 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+static const NetworkCredentials_t xTestCredentials =
+{
+    .pucRootCa   = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA,
+    .xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA )
+};
+
+static uint8_t ucSendBuffer[ TEST_MESSAGE_SIZE ];
+static uint8_t ucRecvBuffer[ TEST_MESSAGE_SIZE ];
+
+/*-----------------------------------------------------------*/
+
+static int prvEcho( NetworkContext_t * pxNetworkContext )
+{
+    size_t xReceived = 0;
+    int32_t lRet;
+    TickType_t xStart = xTaskGetTickCount();
+
+    if( TLS_Socket_Send( pxNetworkContext, ucSendBuffer, sizeof( ucSendBuffer ) ) != ( int32_t ) sizeof( ucSendBuffer ) )
+    {
+        printf( "\tSend failed!\n" );
+        return TEST_TLS_CONNECT_STATS_FAIL;
+    }
+
+    while( ( xReceived < sizeof( ucRecvBuffer ) ) &&
+           ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_TIMEOUT_MS ) ) )
+    {
+        lRet = TLS_Socket_Recv( pxNetworkContext, ucRecvBuffer + xReceived, sizeof( ucRecvBuffer ) - xReceived );
+
+        if( lRet < 0 )
+        {
+            printf( "\tReceive failed: %d\n", ( int ) lRet );
+            return TEST_TLS_CONNECT_STATS_FAIL;
+        }
+
+        xReceived += ( size_t ) lRet;
+    }
+
+    return ( xReceived == sizeof( ucRecvBuffer ) ) ? TEST_TLS_CONNECT_STATS_SUCCESS : TEST_TLS_CONNECT_STATS_FAIL;
+}
+/*-----------------------------------------------------------*/
+
+static int prvCheckStats( NetworkContext_t * pxNetworkContext )
+{
+    TlsTransportConnectStats_t xConnectStats;
+    TlsTransportSendStats_t xSendStats;
+    TlsTransportRecvStats_t xRecvStats;
+    int lResult = TEST_TLS_CONNECT_STATS_SUCCESS;
+    int i;
+
+    TLS_Socket_GetConnectStats( pxNetworkContext, &xConnectStats );
+
+    printf( "\tDNS %u ms, TCP %u ms, TLS %u ms, total %u ms, %s %s\n",
+            ( unsigned ) xConnectStats.ulDnsMs,
+            ( unsigned ) xConnectStats.ulTcpConnectMs,
+            ( unsigned ) xConnectStats.ulHandshakeMs,
+            ( unsigned ) xConnectStats.ulTotalMs,
+            ( xConnectStats.pcTlsVersion != NULL ) ? xConnectStats.pcTlsVersion : "(none)",
+            ( xConnectStats.pcCipherSuite != NULL ) ? xConnectStats.pcCipherSuite : "(none)" );
+
+    if( ( xConnectStats.pcCipherSuite == NULL ) || ( xConnectStats.pcTlsVersion == NULL ) )
+    {
+        printf( "\tNegotiated parameters not recorded!\n" );
+        lResult = TEST_TLS_CONNECT_STATS_FAIL;
+    }
+
+    /* The loopback wrapper delays every connect by a fixed latency. */
+    if( xConnectStats.ulTcpConnectMs < loopbackCONNECT_LATENCY_MS )
+    {
+        printf( "\tTCP connect shorter than the loopback latency!\n" );
+        lResult = TEST_TLS_CONNECT_STATS_FAIL;
+    }
+
+    if( xConnectStats.ulTotalMs < xConnectStats.ulDnsMs + xConnectStats.ulTcpConnectMs +
+        xConnectStats.ulHandshakeMs )
+    {
+        printf( "\tPhases add up to more than the total!\n" );
+        lResult = TEST_TLS_CONNECT_STATS_FAIL;
+    }
+
+    for( i = 0; ( i < TEST_MESSAGES ) && ( lResult == TEST_TLS_CONNECT_STATS_SUCCESS ); i++ )
+    {
+        ( void ) memset( ucSendBuffer, i, sizeof( ucSendBuffer ) );
+        lResult = prvEcho( pxNetworkContext );
+    }
+
+    TLS_Socket_GetSendStats( pxNetworkContext, &xSendStats );
+    TLS_Socket_GetRecvStats( pxNetworkContext, &xRecvStats );
+
+    printf( "\tout: %u records, %u wire bytes; in: %u records, %u wire bytes\n",
+            ( unsigned ) xSendStats.ulRecords, ( unsigned ) xSendStats.ullWireBytes,
+            ( unsigned ) xRecvStats.ulRecords, ( unsigned ) xRecvStats.ullWireBytes );
+
+    if( ( xSendStats.ulRecords != TEST_MESSAGES ) || ( xRecvStats.ulRecords != TEST_MESSAGES ) )
+    {
+        printf( "\tExpected one record per message each way!\n" );
+        lResult = TEST_TLS_CONNECT_STATS_FAIL;
+    }
+
+    /* The wire carries the handshake and the record overhead on top of the payload. */
+    if( ( xSendStats.ullWireBytes <= ( uint64_t ) TEST_MESSAGES * TEST_MESSAGE_SIZE ) ||
+        ( xRecvStats.ullWireBytes <= ( uint64_t ) TEST_MESSAGES * TEST_MESSAGE_SIZE ) ||
+        ( xRecvStats.ulSocketReads == 0 ) )
+    {
+        printf( "\tWire bytes not counted!\n" );
+        lResult = TEST_TLS_CONNECT_STATS_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestBlockingConnect( void )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    int lResult;
+
+    printf( "Blocking connect\n" );
+
+    if( TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xTestCredentials,
+                            TEST_TIMEOUT_MS, TEST_TIMEOUT_MS ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_CONNECT_STATS_FAIL;
+    }
+
+    lResult = prvCheckStats( &xNetworkContext );
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestNonBlockingConnect( void )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    TlsTransportConnectStats_t xConnectStats;
+    TlsTransportStatus_t xStatus;
+    TickType_t xStart = xTaskGetTickCount();
+    int lResult;
+
+    printf( "Non-blocking connect\n" );
+
+    xStatus = TLS_Socket_ConnectStart( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xTestCredentials,
+                                       TEST_TIMEOUT_MS, TEST_TIMEOUT_MS );
+
+    /* Nothing is reported before the handshake completes. */
+    if( xStatus == eTLSTransportInProgress )
+    {
+        TLS_Socket_GetConnectStats( &xNetworkContext, &xConnectStats );
+
+        if( xConnectStats.pcCipherSuite != NULL )
+        {
+            printf( "\tStats reported while connecting!\n" );
+            TLS_Socket_Disconnect( &xNetworkContext );
+            return TEST_TLS_CONNECT_STATS_FAIL;
+        }
+    }
+
+    while( ( xStatus == eTLSTransportInProgress ) &&
+           ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_TIMEOUT_MS ) ) )
+    {
+        vTaskDelay( 1 );
+        xStatus = TLS_Socket_ConnectPoll( &xNetworkContext );
+    }
+
+    if( xStatus != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed: %d\n", xStatus );
+
+        if( xStatus == eTLSTransportInProgress )
+        {
+            TLS_Socket_Disconnect( &xNetworkContext );
+        }
+
+        return TEST_TLS_CONNECT_STATS_FAIL;
+    }
+
+    lResult = prvCheckStats( &xNetworkContext );
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_TLS_CONNECT_STATS_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( TestTlsServer_Start( TEST_PORT ) != pdPASS )
+    {
+        printf( "Failed to start the test server!\n" );
+        lResult = TEST_TLS_CONNECT_STATS_FAIL;
+    }
+    else if( ( prvTestBlockingConnect() != TEST_TLS_CONNECT_STATS_SUCCESS ) ||
+             ( prvTestNonBlockingConnect() != TEST_TLS_CONNECT_STATS_SUCCESS ) )
+    {
+        lResult = TEST_TLS_CONNECT_STATS_FAIL;
+    }
+
+    printf( lResult == TEST_TLS_CONNECT_STATS_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "TlsConnectStats", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_TLS_CONNECT_STATS_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_TLS_CONNECT_STATS_FAIL;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,333 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  UNIT TESTS FOR DER CREDENTIALS
+ *
+ *  The test root CA is converted to DER at startup, the way tools/pem_to_der.py
+ *  does at build time, then parsed and used to connect in both encodings.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "transport_tls_socket.h"
+#include "transport_tls_credential_store.h"
+#include "mbedtls_freertos_port.h"
+#include "test_tls_server.h"
+
+#define TEST_TLS_DER_SUCCESS    0
+#define TEST_TLS_DER_FAIL       1
+
+#define TEST_PORT               ( 8883 )
+#define TEST_HOST_NAME          "localhost"
+#define TEST_TIMEOUT_MS         ( 20000U )
+#define TEST_ECHO_MESSAGE       "der credentials echo"
+#define TEST_CHAIN_LENGTH       ( 2 )
+#define TEST_DER_BUFFER_SIZE    ( 2048 )
+
+#define TEST_TASK_STACK_SIZE    ( 8 * 1024 )
+#define TEST_TASK_PRIORITY      ( tskIDLE_PRIORITY + 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+static uint8_t ucRootCaDer[ TEST_DER_BUFFER_SIZE ];
+static size_t xRootCaDerSize;
+
+/* The root CA twice, back to back, as a chain. */
+static uint8_t ucChainDer[ TEST_CHAIN_LENGTH * TEST_DER_BUFFER_SIZE ];
+static size_t xChainDerSize;
+
+/*-----------------------------------------------------------*/
+
+static int prvConvertRootCa( void )
+{
+    mbedtls_x509_crt xCert;
+    size_t i;
+    int lResult = TEST_TLS_DER_FAIL;
+
+    mbedtls_x509_crt_init( &xCert );
+
+    if( ( mbedtls_x509_crt_parse( &xCert, ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA,
+                                  sizeof( TEST_TLS_SERVER_ROOT_CA ) ) == 0 ) &&
+        ( xCert.raw.len <= sizeof( ucRootCaDer ) ) )
+    {
+        ( void ) memcpy( ucRootCaDer, xCert.raw.p, xCert.raw.len );
+        xRootCaDerSize = xCert.raw.len;
+
+        for( i = 0; i < TEST_CHAIN_LENGTH; i++ )
+        {
+            ( void ) memcpy( ucChainDer + ( i * xRootCaDerSize ), ucRootCaDer, xRootCaDerSize );
+        }
+
+        xChainDerSize = TEST_CHAIN_LENGTH * xRootCaDerSize;
+        lResult = TEST_TLS_DER_SUCCESS;
+    }
+
+    mbedtls_x509_crt_free( &xCert );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvMeasureParse( const NetworkCredentials_t * pxCredentials,
+                            MbedtlsHeapStats_t * pxHeapStats )
+{
+    TlsCredentialHandle_t xHandle;
+    int32_t lMbedtlsError;
+
+    mbedtls_platform_heap_stats_reset( xTaskGetCurrentTaskHandle() );
+
+    xHandle = TLS_CredentialStore_Acquire( pxCredentials, &lMbedtlsError );
+
+    mbedtls_platform_heap_stats_get( pxHeapStats );
+
+    if( xHandle == NULL )
+    {
+        printf( "\tParse failed: %d\n", ( int ) lMbedtlsError );
+        return TEST_TLS_DER_FAIL;
+    }
+
+    TLS_CredentialStore_Release( xHandle );
+
+    return TEST_TLS_DER_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestParseHeap( void )
+{
+    NetworkCredentials_t xPemCredentials = { 0 };
+    NetworkCredentials_t xDerCredentials = { 0 };
+    MbedtlsHeapStats_t xPemHeap;
+    MbedtlsHeapStats_t xDerHeap;
+
+    printf( "Heap held by the parsed root CA\n" );
+
+    xPemCredentials.pucRootCa = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA;
+    xPemCredentials.xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA );
+
+    xDerCredentials.pucRootCa = ucRootCaDer;
+    xDerCredentials.xRootCaSize = xRootCaDerSize;
+    xDerCredentials.xRootCaFormat = eTlsCredentialFormatDer;
+
+    if( ( prvMeasureParse( &xPemCredentials, &xPemHeap ) != TEST_TLS_DER_SUCCESS ) ||
+        ( prvMeasureParse( &xDerCredentials, &xDerHeap ) != TEST_TLS_DER_SUCCESS ) )
+    {
+        return TEST_TLS_DER_FAIL;
+    }
+
+    printf( "\tPEM: %u bytes blob, %u bytes held, %u bytes peak\n",
+            ( unsigned ) sizeof( TEST_TLS_SERVER_ROOT_CA ),
+            ( unsigned ) xPemHeap.xCurrentBytes, ( unsigned ) xPemHeap.xPeakBytes );
+    printf( "\tDER: %u bytes blob, %u bytes held, %u bytes peak\n",
+            ( unsigned ) xRootCaDerSize,
+            ( unsigned ) xDerHeap.xCurrentBytes, ( unsigned ) xDerHeap.xPeakBytes );
+
+    /* The DER certificate is referenced in place rather than copied. */
+    if( xDerHeap.xCurrentBytes + xRootCaDerSize > xPemHeap.xCurrentBytes )
+    {
+        printf( "\tDER certificate was copied to the heap!\n" );
+        return TEST_TLS_DER_FAIL;
+    }
+
+    /* And there is no base64 decode buffer. */
+    if( xDerHeap.xPeakBytes >= xPemHeap.xPeakBytes )
+    {
+        printf( "\tDER parse peak not below PEM!\n" );
+        return TEST_TLS_DER_FAIL;
+    }
+
+    return TEST_TLS_DER_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestChain( void )
+{
+    NetworkCredentials_t xCredentials = { 0 };
+    TlsCredentialHandle_t xHandle;
+    const mbedtls_x509_crt * pxCert;
+    int32_t lMbedtlsError;
+    size_t xCount = 0;
+    int lResult = TEST_TLS_DER_SUCCESS;
+
+    printf( "DER certificate chain\n" );
+
+    xCredentials.pucRootCa = ucChainDer;
+    xCredentials.xRootCaSize = xChainDerSize;
+    xCredentials.xRootCaFormat = eTlsCredentialFormatDer;
+
+    if( ( xHandle = TLS_CredentialStore_Acquire( &xCredentials, &lMbedtlsError ) ) == NULL )
+    {
+        printf( "\tParse failed: %d\n", ( int ) lMbedtlsError );
+        return TEST_TLS_DER_FAIL;
+    }
+
+    for( pxCert = TLS_CredentialStore_GetRootCa( xHandle );
+         ( pxCert != NULL ) && ( pxCert->raw.len > 0 );
+         pxCert = pxCert->next )
+    {
+        if( pxCert->raw.p != ucChainDer + ( xCount * xRootCaDerSize ) )
+        {
+            printf( "\tCertificate %u not parsed in place!\n", ( unsigned ) xCount );
+            lResult = TEST_TLS_DER_FAIL;
+        }
+
+        xCount++;
+    }
+
+    if( xCount != TEST_CHAIN_LENGTH )
+    {
+        printf( "\tParsed %u certificates!\n", ( unsigned ) xCount );
+        lResult = TEST_TLS_DER_FAIL;
+    }
+
+    TLS_CredentialStore_Release( xHandle );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestConnect( void )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    NetworkCredentials_t xCredentials = { 0 };
+    uint8_t ucBuffer[ sizeof( TEST_ECHO_MESSAGE ) ];
+    size_t xReceived = 0;
+    int32_t lRet;
+    TickType_t xStart;
+    int lResult = TEST_TLS_DER_SUCCESS;
+
+    printf( "Connect with a DER root CA\n" );
+
+    xCredentials.pucRootCa = ucRootCaDer;
+    xCredentials.xRootCaSize = xRootCaDerSize;
+    xCredentials.xRootCaFormat = eTlsCredentialFormatDer;
+
+    if( TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xCredentials,
+                            TEST_TIMEOUT_MS, TEST_TIMEOUT_MS ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_DER_FAIL;
+    }
+
+    if( TLS_Socket_Send( &xNetworkContext, TEST_ECHO_MESSAGE, sizeof( TEST_ECHO_MESSAGE ) ) !=
+        ( int32_t ) sizeof( TEST_ECHO_MESSAGE ) )
+    {
+        printf( "\tSend failed!\n" );
+        lResult = TEST_TLS_DER_FAIL;
+    }
+
+    xStart = xTaskGetTickCount();
+
+    while( ( lResult == TEST_TLS_DER_SUCCESS ) &&
+           ( xReceived < sizeof( ucBuffer ) ) &&
+           ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_TIMEOUT_MS ) ) )
+    {
+        lRet = TLS_Socket_Recv( &xNetworkContext, ucBuffer + xReceived, sizeof( ucBuffer ) - xReceived );
+
+        if( lRet < 0 )
+        {
+            printf( "\tReceive failed: %d\n", ( int ) lRet );
+            lResult = TEST_TLS_DER_FAIL;
+        }
+        else
+        {
+            xReceived += ( size_t ) lRet;
+        }
+    }
+
+    if( ( lResult == TEST_TLS_DER_SUCCESS ) &&
+        ( ( xReceived != sizeof( ucBuffer ) ) ||
+          ( memcmp( ucBuffer, TEST_ECHO_MESSAGE, sizeof( ucBuffer ) ) != 0 ) ) )
+    {
+        printf( "\tEcho mismatch!\n" );
+        lResult = TEST_TLS_DER_FAIL;
+    }
+
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestWrongFormat( void )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    NetworkCredentials_t xCredentials = { 0 };
+    TlsTransportStatus_t xStatus;
+
+    printf( "PEM root CA flagged as DER\n" );
+
+    xCredentials.pucRootCa = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA;
+    xCredentials.xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA );
+    xCredentials.xRootCaFormat = eTlsCredentialFormatDer;
+
+    xStatus = TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xCredentials,
+                                  TEST_TIMEOUT_MS, TEST_TIMEOUT_MS );
+
+    if( xStatus != eTLSTransportInvalidCredentials )
+    {
+        printf( "\tUnexpected status: %d\n", xStatus );
+        return TEST_TLS_DER_FAIL;
+    }
+
+    return TEST_TLS_DER_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_TLS_DER_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( TestTlsServer_Start( TEST_PORT ) != pdPASS )
+    {
+        printf( "Failed to start the test server!\n" );
+        lResult = TEST_TLS_DER_FAIL;
+    }
+    else if( prvConvertRootCa() != TEST_TLS_DER_SUCCESS )
+    {
+        printf( "Failed to convert the root CA to DER!\n" );
+        lResult = TEST_TLS_DER_FAIL;
+    }
+    else if( ( prvTestParseHeap() != TEST_TLS_DER_SUCCESS ) ||
+             ( prvTestChain() != TEST_TLS_DER_SUCCESS ) ||
+             ( prvTestConnect() != TEST_TLS_DER_SUCCESS ) ||
+             ( prvTestWrongFormat() != TEST_TLS_DER_SUCCESS ) )
+    {
+        lResult = TEST_TLS_DER_FAIL;
+    }
+
+    printf( lResult == TEST_TLS_DER_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "TlsDerCredentials", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_TLS_DER_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_TLS_DER_FAIL;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,248 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  BENCHMARK OF THE TLS HANDSHAKE WITH RESTARTABLE ECC
+ *
+ *  For a range of ECC step budgets, measures the handshake time and the
+ *  longest time a single call into the handshake kept the CPU.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "transport_tls_socket.h"
+#include "transport_tls_session_cache.h"
+#include "test_tls_server.h"
+
+#define TEST_TLS_ECP_RESTARTABLE_SUCCESS    0
+#define TEST_TLS_ECP_RESTARTABLE_FAIL       1
+
+#define TEST_PORT                           ( 8883 )
+#define TEST_HOST_NAME                      "localhost"
+#define TEST_TIMEOUT_MS                     ( 20000U )
+#define TEST_HANDSHAKES                     ( 3 )
+
+/* The smallest budget mbed TLS accepts. */
+#define TEST_MIN_MAX_OPS                    ( 120U )
+
+#define TEST_TASK_STACK_SIZE                ( 8 * 1024 )
+#define TEST_TASK_PRIORITY                  ( tskIDLE_PRIORITY + 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+static const NetworkCredentials_t xTestCredentials =
+{
+    .pucRootCa   = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA,
+    .xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA )
+};
+
+/* ECC operations per step; 0 runs each operation to completion. */
+static const uint32_t ulTestBudgets[] = { 0U, 2000U, 500U, TEST_MIN_MAX_OPS };
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowUs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( uint64_t ) xNow.tv_sec * 1000000U + ( uint64_t ) xNow.tv_nsec / 1000U;
+}
+/*-----------------------------------------------------------*/
+
+/* Full handshake without blocking; the longest call is the longest time the
+ * handshake kept other tasks of its priority from running. */
+static int prvNonBlockingHandshake( uint64_t * pullLongestUs,
+                                    TlsTransportConnectStats_t * pxConnectStats )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    TlsTransportStatus_t xStatus;
+    TickType_t xStart = xTaskGetTickCount();
+    uint64_t ullCallStart;
+    uint64_t ullCallUs;
+
+    TLS_SessionCache_Invalidate( TEST_HOST_NAME, TEST_PORT );
+
+    ullCallStart = prvNowUs();
+    xStatus = TLS_Socket_ConnectStart( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xTestCredentials,
+                                       TEST_TIMEOUT_MS, TEST_TIMEOUT_MS );
+    *pullLongestUs = prvNowUs() - ullCallStart;
+
+    while( ( xStatus == eTLSTransportInProgress ) &&
+           ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_TIMEOUT_MS ) ) )
+    {
+        /* Let the server run. */
+        taskYIELD();
+
+        ullCallStart = prvNowUs();
+        xStatus = TLS_Socket_ConnectPoll( &xNetworkContext );
+        ullCallUs = prvNowUs() - ullCallStart;
+
+        if( ullCallUs > *pullLongestUs )
+        {
+            *pullLongestUs = ullCallUs;
+        }
+    }
+
+    if( xStatus != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed: %d\n", xStatus );
+
+        if( xStatus == eTLSTransportInProgress )
+        {
+            TLS_Socket_Disconnect( &xNetworkContext );
+        }
+
+        return TEST_TLS_ECP_RESTARTABLE_FAIL;
+    }
+
+    TLS_Socket_GetConnectStats( &xNetworkContext, pxConnectStats );
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    return TEST_TLS_ECP_RESTARTABLE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestBudgets( void )
+{
+    TlsTransportConnectStats_t xConnectStats;
+    uint64_t ullLongestUs;
+    uint64_t ullMaxLongestUs;
+    uint32_t ulHandshakeMs;
+    uint32_t ulYields;
+    int lResult = TEST_TLS_ECP_RESTARTABLE_SUCCESS;
+    size_t i;
+    int j;
+
+    printf( "Non-blocking handshakes by ECC step budget\n" );
+
+    for( i = 0; ( i < sizeof( ulTestBudgets ) / sizeof( ulTestBudgets[ 0 ] ) ) &&
+         ( lResult == TEST_TLS_ECP_RESTARTABLE_SUCCESS ); i++ )
+    {
+        TLS_Socket_SetEcpMaxOps( ulTestBudgets[ i ] );
+        ullMaxLongestUs = 0;
+        ulHandshakeMs = 0;
+        ulYields = 0;
+
+        for( j = 0; ( j < TEST_HANDSHAKES ) && ( lResult == TEST_TLS_ECP_RESTARTABLE_SUCCESS ); j++ )
+        {
+            lResult = prvNonBlockingHandshake( &ullLongestUs, &xConnectStats );
+
+            if( ullLongestUs > ullMaxLongestUs )
+            {
+                ullMaxLongestUs = ullLongestUs;
+            }
+
+            ulHandshakeMs += xConnectStats.ulHandshakeMs;
+            ulYields += xConnectStats.ulHandshakeYields;
+        }
+
+        if( lResult != TEST_TLS_ECP_RESTARTABLE_SUCCESS )
+        {
+            break;
+        }
+
+        printf( "\tmax ops %5u: handshake %u ms, longest call %u us, %u yields\n",
+                ( unsigned ) ulTestBudgets[ i ],
+                ( unsigned ) ( ulHandshakeMs / TEST_HANDSHAKES ),
+                ( unsigned ) ullMaxLongestUs,
+                ( unsigned ) ( ulYields / TEST_HANDSHAKES ) );
+
+        if( ( ulTestBudgets[ i ] == 0U ) && ( ulYields != 0U ) )
+        {
+            printf( "\tYields without a budget!\n" );
+            lResult = TEST_TLS_ECP_RESTARTABLE_FAIL;
+        }
+
+        /* Each ECDHE and ECDSA operation takes more than the smallest budget. */
+        if( ( ulTestBudgets[ i ] == TEST_MIN_MAX_OPS ) && ( ulYields == 0U ) )
+        {
+            printf( "\tNo yields with the smallest budget!\n" );
+            lResult = TEST_TLS_ECP_RESTARTABLE_FAIL;
+        }
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestBlockingHandshake( void )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    TlsTransportConnectStats_t xConnectStats;
+
+    printf( "Blocking handshake with the smallest budget\n" );
+
+    TLS_Socket_SetEcpMaxOps( TEST_MIN_MAX_OPS );
+    TLS_SessionCache_Invalidate( TEST_HOST_NAME, TEST_PORT );
+
+    if( TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xTestCredentials,
+                            TEST_TIMEOUT_MS, TEST_TIMEOUT_MS ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_ECP_RESTARTABLE_FAIL;
+    }
+
+    TLS_Socket_GetConnectStats( &xNetworkContext, &xConnectStats );
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    printf( "\thandshake %u ms, %u yields\n",
+            ( unsigned ) xConnectStats.ulHandshakeMs,
+            ( unsigned ) xConnectStats.ulHandshakeYields );
+
+    return ( xConnectStats.ulHandshakeYields > 0U ) ? TEST_TLS_ECP_RESTARTABLE_SUCCESS : TEST_TLS_ECP_RESTARTABLE_FAIL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_TLS_ECP_RESTARTABLE_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( TestTlsServer_Start( TEST_PORT ) != pdPASS )
+    {
+        printf( "Failed to start the test server!\n" );
+        lResult = TEST_TLS_ECP_RESTARTABLE_FAIL;
+    }
+    else if( ( prvTestBudgets() != TEST_TLS_ECP_RESTARTABLE_SUCCESS ) ||
+             ( prvTestBlockingHandshake() != TEST_TLS_ECP_RESTARTABLE_SUCCESS ) )
+    {
+        lResult = TEST_TLS_ECP_RESTARTABLE_FAIL;
+    }
+
+    printf( lResult == TEST_TLS_ECP_RESTARTABLE_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "TlsEcpRestart", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_TLS_ECP_RESTARTABLE_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_TLS_ECP_RESTARTABLE_FAIL;
+}
+/*-----------------------------------------------------------*/
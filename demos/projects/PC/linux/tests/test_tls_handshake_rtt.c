@@ -0,0 +1,207 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  BENCHMARK OF FULL AND RESUMED TLS HANDSHAKES
+ *
+ *  Counts the round trips and socket writes of each kind of handshake, and
+ *  projects the connect time over a high-latency link from them.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "transport_tls_socket.h"
+#include "transport_tls_session_cache.h"
+#include "test_tls_server.h"
+
+#define TEST_TLS_HANDSHAKE_RTT_SUCCESS    0
+#define TEST_TLS_HANDSHAKE_RTT_FAIL       1
+
+#define TEST_PORT                         ( 8883 )
+#define TEST_HOST_NAME                    "localhost"
+#define TEST_TIMEOUT_MS                   ( 20000U )
+#define TEST_ITERATIONS                   ( 5 )
+
+/* Round-trip time of a geostationary satellite link, used for the projection. */
+#define TEST_PROJECTED_RTT_MS             ( 600U )
+
+/* Client flights: ClientHello, then the key exchange and Finished (full) or
+ * ChangeCipherSpec and Finished (resumed). */
+#define TEST_FLIGHTS_PER_HANDSHAKE        ( 2U )
+
+#define TEST_TASK_STACK_SIZE              ( 8 * 1024 )
+#define TEST_TASK_PRIORITY                ( tskIDLE_PRIORITY + 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+/* Totals over the connects of one kind of handshake. */
+typedef struct TestHandshakeTotals
+{
+    uint32_t ulRoundTrips;
+    uint32_t ulSocketWrites;
+    uint32_t ulHandshakeMs;
+    uint64_t ullWireBytes;
+} TestHandshakeTotals_t;
+
+static const NetworkCredentials_t xTestCredentials =
+{
+    .pucRootCa   = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA,
+    .xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA )
+};
+
+/*-----------------------------------------------------------*/
+
+static int prvConnectOnce( BaseType_t xExpectResumed,
+                           uint32_t ulExpectedRoundTrips,
+                           TestHandshakeTotals_t * pxTotals )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    TlsTransportConnectStats_t xConnectStats;
+    TlsTransportSendStats_t xSendStats;
+    TlsTransportRecvStats_t xRecvStats;
+    int lResult = TEST_TLS_HANDSHAKE_RTT_SUCCESS;
+
+    if( TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xTestCredentials,
+                            TEST_TIMEOUT_MS, TEST_TIMEOUT_MS ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_HANDSHAKE_RTT_FAIL;
+    }
+
+    /* Nothing but the handshake has been sent or received yet. */
+    TLS_Socket_GetConnectStats( &xNetworkContext, &xConnectStats );
+    TLS_Socket_GetSendStats( &xNetworkContext, &xSendStats );
+    TLS_Socket_GetRecvStats( &xNetworkContext, &xRecvStats );
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    if( xConnectStats.xSessionResumed != xExpectResumed )
+    {
+        printf( "\tSession %sresumed!\n", ( xConnectStats.xSessionResumed == pdTRUE ) ? "" : "not " );
+        lResult = TEST_TLS_HANDSHAKE_RTT_FAIL;
+    }
+
+    if( xConnectStats.ulHandshakeRoundTrips != ulExpectedRoundTrips )
+    {
+        printf( "\t%u round trips, expected %u!\n",
+                ( unsigned ) xConnectStats.ulHandshakeRoundTrips,
+                ( unsigned ) ulExpectedRoundTrips );
+        lResult = TEST_TLS_HANDSHAKE_RTT_FAIL;
+    }
+
+    /* Each flight leaves in a single write. */
+    if( xSendStats.ulSocketWrites != TEST_FLIGHTS_PER_HANDSHAKE )
+    {
+        printf( "\t%u socket writes, expected one per flight!\n", ( unsigned ) xSendStats.ulSocketWrites );
+        lResult = TEST_TLS_HANDSHAKE_RTT_FAIL;
+    }
+
+    pxTotals->ulRoundTrips += xConnectStats.ulHandshakeRoundTrips;
+    pxTotals->ulSocketWrites += xSendStats.ulSocketWrites;
+    pxTotals->ulHandshakeMs += xConnectStats.ulHandshakeMs;
+    pxTotals->ullWireBytes += xSendStats.ullWireBytes + xRecvStats.ullWireBytes;
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvReport( const char * pcName,
+                       const TestHandshakeTotals_t * pxTotals )
+{
+    uint32_t ulHandshakeMs = pxTotals->ulHandshakeMs / TEST_ITERATIONS;
+
+    /* Time on the wire dominates over a slow link, so add a round trip for
+     * each flight the server answered, and one for the TCP connect. */
+    printf( "\t%-8s %u.%u RTT, %u.%u writes, %u ms, %u bytes, ~%u ms at %u ms RTT\n",
+            pcName,
+            ( unsigned ) ( pxTotals->ulRoundTrips / TEST_ITERATIONS ),
+            ( unsigned ) ( ( pxTotals->ulRoundTrips * 10U / TEST_ITERATIONS ) % 10U ),
+            ( unsigned ) ( pxTotals->ulSocketWrites / TEST_ITERATIONS ),
+            ( unsigned ) ( ( pxTotals->ulSocketWrites * 10U / TEST_ITERATIONS ) % 10U ),
+            ( unsigned ) ulHandshakeMs,
+            ( unsigned ) ( pxTotals->ullWireBytes / TEST_ITERATIONS ),
+            ( unsigned ) ( ulHandshakeMs +
+                           ( pxTotals->ulRoundTrips / TEST_ITERATIONS + 1U ) * TEST_PROJECTED_RTT_MS ),
+            ( unsigned ) TEST_PROJECTED_RTT_MS );
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestHandshakes( void )
+{
+    TestHandshakeTotals_t xFull = { 0 };
+    TestHandshakeTotals_t xResumed = { 0 };
+    int lResult = TEST_TLS_HANDSHAKE_RTT_SUCCESS;
+    int i;
+
+    printf( "Full and resumed handshakes\n" );
+
+    for( i = 0; ( i < TEST_ITERATIONS ) && ( lResult == TEST_TLS_HANDSHAKE_RTT_SUCCESS ); i++ )
+    {
+        /* Nothing to offer, so the server runs a full handshake. */
+        TLS_SessionCache_Invalidate( TEST_HOST_NAME, TEST_PORT );
+        lResult = prvConnectOnce( pdFALSE, 2U, &xFull );
+    }
+
+    /* The last full handshake left its session ticket in the cache. */
+    for( i = 0; ( i < TEST_ITERATIONS ) && ( lResult == TEST_TLS_HANDSHAKE_RTT_SUCCESS ); i++ )
+    {
+        lResult = prvConnectOnce( pdTRUE, 1U, &xResumed );
+    }
+
+    if( lResult == TEST_TLS_HANDSHAKE_RTT_SUCCESS )
+    {
+        prvReport( "full", &xFull );
+        prvReport( "resumed", &xResumed );
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_TLS_HANDSHAKE_RTT_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( TestTlsServer_Start( TEST_PORT ) != pdPASS )
+    {
+        printf( "Failed to start the test server!\n" );
+        lResult = TEST_TLS_HANDSHAKE_RTT_FAIL;
+    }
+    else
+    {
+        lResult = prvTestHandshakes();
+    }
+
+    printf( lResult == TEST_TLS_HANDSHAKE_RTT_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "TlsHandshakeRtt", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_TLS_HANDSHAKE_RTT_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_TLS_HANDSHAKE_RTT_FAIL;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,283 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  UNIT TESTS FOR THE TLS READ-AHEAD BUFFER
+ *
+ *  The echo server sends back MQTT packets, which are read the way the MQTT
+ *  parser reads them: the type byte, the remaining length one byte at a time,
+ *  then the body.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "transport_tls_socket.h"
+#include "test_tls_server.h"
+
+#define TEST_TLS_READ_AHEAD_SUCCESS    0
+#define TEST_TLS_READ_AHEAD_FAIL       1
+
+#define TEST_PORT                      ( 8883 )
+#define TEST_HOST_NAME                 "localhost"
+#define TEST_TIMEOUT_MS                ( 20000U )
+#define TEST_MESSAGES                  ( 50 )
+#define TEST_SMALL_BODY_SIZE           ( 120 )
+#define TEST_LARGE_BODY_SIZE           ( 1500 )
+
+#define TEST_TASK_STACK_SIZE           ( 8 * 1024 )
+#define TEST_TASK_PRIORITY             ( tskIDLE_PRIORITY + 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+static const NetworkCredentials_t xTestCredentials =
+{
+    .pucRootCa   = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA,
+    .xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA )
+};
+
+static uint8_t ucPacket[ TEST_LARGE_BODY_SIZE + 8 ];
+static uint8_t ucBody[ TEST_LARGE_BODY_SIZE ];
+
+/*-----------------------------------------------------------*/
+
+static size_t prvBuildPacket( size_t xBodyLength,
+                              uint8_t ucSeed )
+{
+    size_t xLength = 0;
+    size_t xRemaining = xBodyLength;
+    size_t i;
+
+    ucPacket[ xLength++ ] = 0x30;
+
+    do
+    {
+        ucPacket[ xLength ] = ( uint8_t ) ( xRemaining & 0x7F );
+        xRemaining >>= 7;
+
+        if( xRemaining > 0 )
+        {
+            ucPacket[ xLength ] |= 0x80;
+        }
+
+        xLength++;
+    } while( xRemaining > 0 );
+
+    for( i = 0; i < xBodyLength; i++ )
+    {
+        ucPacket[ xLength++ ] = ( uint8_t ) ( ucSeed + i );
+    }
+
+    return xLength;
+}
+/*-----------------------------------------------------------*/
+
+static int prvRecvExactly( NetworkContext_t * pxNetworkContext,
+                           uint8_t * pucBuffer,
+                           size_t xLength )
+{
+    size_t xReceived = 0;
+    int32_t lRet;
+    TickType_t xStart = xTaskGetTickCount();
+
+    while( ( xReceived < xLength ) &&
+           ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_TIMEOUT_MS ) ) )
+    {
+        lRet = TLS_Socket_Recv( pxNetworkContext, pucBuffer + xReceived, xLength - xReceived );
+
+        if( lRet < 0 )
+        {
+            printf( "\tReceive failed: %d\n", ( int ) lRet );
+            return TEST_TLS_READ_AHEAD_FAIL;
+        }
+
+        xReceived += ( size_t ) lRet;
+    }
+
+    return ( xReceived == xLength ) ? TEST_TLS_READ_AHEAD_SUCCESS : TEST_TLS_READ_AHEAD_FAIL;
+}
+/*-----------------------------------------------------------*/
+
+static int prvEchoPacket( NetworkContext_t * pxNetworkContext,
+                          size_t xBodyLength,
+                          uint8_t ucSeed )
+{
+    size_t xPacketLength = prvBuildPacket( xBodyLength, ucSeed );
+    size_t xRemaining = 0;
+    uint32_t ulMultiplier = 1;
+    uint8_t ucByte;
+    size_t i;
+
+    if( TLS_Socket_Send( pxNetworkContext, ucPacket, xPacketLength ) != ( int32_t ) xPacketLength )
+    {
+        printf( "\tSend failed!\n" );
+        return TEST_TLS_READ_AHEAD_FAIL;
+    }
+
+    /* Packet type. */
+    if( ( prvRecvExactly( pxNetworkContext, &ucByte, 1 ) != TEST_TLS_READ_AHEAD_SUCCESS ) ||
+        ( ucByte != 0x30 ) )
+    {
+        printf( "\tBad packet type!\n" );
+        return TEST_TLS_READ_AHEAD_FAIL;
+    }
+
+    /* Remaining length, one byte at a time. */
+    do
+    {
+        if( prvRecvExactly( pxNetworkContext, &ucByte, 1 ) != TEST_TLS_READ_AHEAD_SUCCESS )
+        {
+            return TEST_TLS_READ_AHEAD_FAIL;
+        }
+
+        xRemaining += ( size_t ) ( ucByte & 0x7F ) * ulMultiplier;
+        ulMultiplier *= 128;
+    } while( ( ucByte & 0x80 ) != 0 );
+
+    if( ( xRemaining != xBodyLength ) ||
+        ( prvRecvExactly( pxNetworkContext, ucBody, xRemaining ) != TEST_TLS_READ_AHEAD_SUCCESS ) )
+    {
+        printf( "\tBad remaining length!\n" );
+        return TEST_TLS_READ_AHEAD_FAIL;
+    }
+
+    for( i = 0; i < xBodyLength; i++ )
+    {
+        if( ucBody[ i ] != ( uint8_t ) ( ucSeed + i ) )
+        {
+            printf( "\tBody mismatch at %u!\n", ( unsigned ) i );
+            return TEST_TLS_READ_AHEAD_FAIL;
+        }
+    }
+
+    return TEST_TLS_READ_AHEAD_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvRun( size_t xBodyLength,
+                   TlsTransportRecvStats_t * pxStats )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    int lResult = TEST_TLS_READ_AHEAD_SUCCESS;
+    int i;
+
+    printf( "%u byte messages\n", ( unsigned ) xBodyLength );
+
+    if( TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xTestCredentials,
+                            TEST_TIMEOUT_MS, TEST_TIMEOUT_MS ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_READ_AHEAD_FAIL;
+    }
+
+    for( i = 0; ( i < TEST_MESSAGES ) && ( lResult == TEST_TLS_READ_AHEAD_SUCCESS ); i++ )
+    {
+        lResult = prvEchoPacket( &xNetworkContext, xBodyLength, ( uint8_t ) i );
+    }
+
+    TLS_Socket_GetRecvStats( &xNetworkContext, pxStats );
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    printf( "\t%5.2f receive calls, %5.2f TLS reads, %5.2f read-ahead hits per message\n",
+            ( double ) pxStats->ulRecvCalls / TEST_MESSAGES,
+            ( double ) pxStats->ulSslReads / TEST_MESSAGES,
+            ( double ) pxStats->ulReadAheadHits / TEST_MESSAGES );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestSmallMessages( void )
+{
+    TlsTransportRecvStats_t xStats;
+
+    if( prvRun( TEST_SMALL_BODY_SIZE, &xStats ) != TEST_TLS_READ_AHEAD_SUCCESS )
+    {
+        return TEST_TLS_READ_AHEAD_FAIL;
+    }
+
+    /* Each packet arrives in one record, so one read from the TLS stack. */
+    if( xStats.ulSslReads != TEST_MESSAGES )
+    {
+        printf( "\tExpected one TLS read per message!\n" );
+        return TEST_TLS_READ_AHEAD_FAIL;
+    }
+
+    if( xStats.ullBytesReceived != ( uint64_t ) TEST_MESSAGES * ( 1 + 1 + TEST_SMALL_BODY_SIZE ) )
+    {
+        printf( "\tUnexpected byte count!\n" );
+        return TEST_TLS_READ_AHEAD_FAIL;
+    }
+
+    return TEST_TLS_READ_AHEAD_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestLargeMessages( void )
+{
+    TlsTransportRecvStats_t xStats;
+
+    if( prvRun( TEST_LARGE_BODY_SIZE, &xStats ) != TEST_TLS_READ_AHEAD_SUCCESS )
+    {
+        return TEST_TLS_READ_AHEAD_FAIL;
+    }
+
+    /* The header comes from the buffer, most of the body straight from TLS. */
+    if( xStats.ulReadAheadHits == 0 )
+    {
+        printf( "\tRead-ahead buffer not used!\n" );
+        return TEST_TLS_READ_AHEAD_FAIL;
+    }
+
+    return TEST_TLS_READ_AHEAD_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_TLS_READ_AHEAD_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( TestTlsServer_Start( TEST_PORT ) != pdPASS )
+    {
+        printf( "Failed to start the test server!\n" );
+        lResult = TEST_TLS_READ_AHEAD_FAIL;
+    }
+    else if( ( prvTestSmallMessages() != TEST_TLS_READ_AHEAD_SUCCESS ) ||
+             ( prvTestLargeMessages() != TEST_TLS_READ_AHEAD_SUCCESS ) )
+    {
+        lResult = TEST_TLS_READ_AHEAD_FAIL;
+    }
+
+    printf( lResult == TEST_TLS_READ_AHEAD_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "TlsReadAheadTest", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_TLS_READ_AHEAD_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_TLS_READ_AHEAD_FAIL;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,414 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  BENCHMARK OF THE ZERO-COPY RECEIVE PATH
+ *
+ *  Receives MQTT PUBLISH packets echoed by the in-process server, once the way
+ *  an MQTT client reading through TLS_Socket_Recv does, into a packet buffer
+ *  and then out to the application, and once parsing them in place with
+ *  TLS_Socket_RecvBorrow. Reports the bytes copied per message by each.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "transport_tls_socket.h"
+#include "test_tls_server.h"
+
+#define TEST_TLS_RECV_BORROW_SUCCESS    0
+#define TEST_TLS_RECV_BORROW_FAIL       1
+
+#define TEST_PORT                       ( 8883 )
+#define TEST_HOST_NAME                  "localhost"
+#define TEST_TIMEOUT_MS                 ( 20000U )
+#define TEST_MESSAGES                   ( 200U )
+#define TEST_TOPIC                      "devices/test/messages/devicebound/%24.to=%2Fdevices"
+
+/* Small enough for the server to echo each packet in a single record. */
+#define TEST_PAYLOAD_SIZE               ( 400U )
+
+/* PUBLISH with QoS 0: fixed header, topic length, topic, payload. */
+#define TEST_PACKET_TYPE                ( 0x30U )
+#define TEST_REMAINING_LENGTH           ( 2U + sizeof( TEST_TOPIC ) - 1U + TEST_PAYLOAD_SIZE )
+#define TEST_PACKET_SIZE                ( 3U + TEST_REMAINING_LENGTH )
+
+#define TEST_TASK_STACK_SIZE            ( 8 * 1024 )
+#define TEST_TASK_PRIORITY              ( tskIDLE_PRIORITY + 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+/* What one way of receiving did. */
+typedef struct TestReceiveTotals
+{
+    uint64_t ullTransportCopied; /**< Bytes the transport copied. */
+    uint64_t ullClientCopied;    /**< Bytes copied by the receive path itself. */
+    uint32_t ulChecksum;         /**< Sum of the payload bytes handed to the application. */
+} TestReceiveTotals_t;
+
+static const NetworkCredentials_t xTestCredentials =
+{
+    .pucRootCa   = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA,
+    .xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA )
+};
+
+static uint8_t ucPacket[ TEST_PACKET_SIZE ];
+
+/* The packet buffer of the MQTT client, and the application's copy. */
+static uint8_t ucMQTTMessageBuffer[ TEST_PACKET_SIZE ];
+static uint8_t ucApplicationBuffer[ TEST_PAYLOAD_SIZE ];
+
+/*-----------------------------------------------------------*/
+
+static void prvBuildPacket( uint32_t ulMessage )
+{
+    size_t xOffset = 0;
+    size_t i;
+
+    ucPacket[ xOffset++ ] = TEST_PACKET_TYPE;
+
+    /* Remaining length, as a two byte variable length integer. */
+    ucPacket[ xOffset++ ] = ( uint8_t ) ( ( TEST_REMAINING_LENGTH & 0x7FU ) | 0x80U );
+    ucPacket[ xOffset++ ] = ( uint8_t ) ( TEST_REMAINING_LENGTH >> 7 );
+
+    ucPacket[ xOffset++ ] = ( uint8_t ) ( ( sizeof( TEST_TOPIC ) - 1U ) >> 8 );
+    ucPacket[ xOffset++ ] = ( uint8_t ) ( sizeof( TEST_TOPIC ) - 1U );
+    ( void ) memcpy( &ucPacket[ xOffset ], TEST_TOPIC, sizeof( TEST_TOPIC ) - 1U );
+    xOffset += sizeof( TEST_TOPIC ) - 1U;
+
+    for( i = 0; i < TEST_PAYLOAD_SIZE; i++ )
+    {
+        ucPacket[ xOffset + i ] = ( uint8_t ) ( ulMessage + i );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Parse a PUBLISH packet and hand its payload to the application, which sums
+ * it. Returns the payload size, or 0 if the packet is malformed. */
+static size_t prvHandlePublish( const uint8_t * pucPacket,
+                                size_t xLength,
+                                uint32_t * pulChecksum )
+{
+    size_t xRemaining;
+    size_t xTopicLength;
+    size_t xPayload = 0;
+    size_t i;
+
+    if( ( xLength >= 5U ) && ( pucPacket[ 0 ] == TEST_PACKET_TYPE ) )
+    {
+        xRemaining = ( size_t ) ( pucPacket[ 1 ] & 0x7FU ) | ( ( size_t ) pucPacket[ 2 ] << 7 );
+        xTopicLength = ( ( size_t ) pucPacket[ 3 ] << 8 ) | pucPacket[ 4 ];
+
+        if( ( xRemaining + 3U == xLength ) && ( xTopicLength + 2U <= xRemaining ) )
+        {
+            xPayload = xRemaining - 2U - xTopicLength;
+
+            for( i = 0; i < xPayload; i++ )
+            {
+                *pulChecksum += pucPacket[ 5U + xTopicLength + i ];
+            }
+        }
+    }
+
+    return xPayload;
+}
+/*-----------------------------------------------------------*/
+
+/* As an MQTT client reading through TLS_Socket_Recv: the packet is copied
+ * into its buffer, and the payload out to the application. */
+static int prvReceiveCopying( NetworkContext_t * pxNetworkContext,
+                              TestReceiveTotals_t * pxTotals )
+{
+    size_t xReceived = 0;
+    size_t xPayload;
+    int32_t lRet;
+
+    while( xReceived < TEST_PACKET_SIZE )
+    {
+        lRet = TLS_Socket_Recv( pxNetworkContext, ucMQTTMessageBuffer + xReceived, TEST_PACKET_SIZE - xReceived );
+
+        if( lRet <= 0 )
+        {
+            printf( "\tReceive failed: %d\n", ( int ) lRet );
+            return TEST_TLS_RECV_BORROW_FAIL;
+        }
+
+        xReceived += ( size_t ) lRet;
+    }
+
+    xPayload = prvHandlePublish( ucMQTTMessageBuffer, TEST_PACKET_SIZE, &( pxTotals->ulChecksum ) );
+    ( void ) memcpy( ucApplicationBuffer, &ucMQTTMessageBuffer[ TEST_PACKET_SIZE - xPayload ], xPayload );
+    pxTotals->ullClientCopied += xPayload;
+
+    return ( xPayload == TEST_PAYLOAD_SIZE ) ? TEST_TLS_RECV_BORROW_SUCCESS : TEST_TLS_RECV_BORROW_FAIL;
+}
+/*-----------------------------------------------------------*/
+
+/* Parse the packet where it was decrypted. A packet split across records is
+ * gathered in the packet buffer instead. */
+static int prvReceiveBorrowing( NetworkContext_t * pxNetworkContext,
+                                TestReceiveTotals_t * pxTotals )
+{
+    const uint8_t * pucData = NULL;
+    size_t xReceived = 0;
+    size_t xTake;
+    int32_t lRet;
+    int lResult = TEST_TLS_RECV_BORROW_SUCCESS;
+
+    while( ( xReceived < TEST_PACKET_SIZE ) && ( lResult == TEST_TLS_RECV_BORROW_SUCCESS ) )
+    {
+        lRet = TLS_Socket_RecvBorrow( pxNetworkContext, &pucData );
+
+        if( lRet <= 0 )
+        {
+            printf( "\tBorrow failed: %d\n", ( int ) lRet );
+            lResult = TEST_TLS_RECV_BORROW_FAIL;
+        }
+        else if( ( xReceived == 0U ) && ( ( size_t ) lRet >= TEST_PACKET_SIZE ) )
+        {
+            if( prvHandlePublish( pucData, TEST_PACKET_SIZE, &( pxTotals->ulChecksum ) ) != TEST_PAYLOAD_SIZE )
+            {
+                lResult = TEST_TLS_RECV_BORROW_FAIL;
+            }
+
+            TLS_Socket_RecvRelease( pxNetworkContext, TEST_PACKET_SIZE );
+            xReceived = TEST_PACKET_SIZE;
+        }
+        else
+        {
+            xTake = ( size_t ) lRet;
+
+            if( xTake > TEST_PACKET_SIZE - xReceived )
+            {
+                xTake = TEST_PACKET_SIZE - xReceived;
+            }
+
+            ( void ) memcpy( ucMQTTMessageBuffer + xReceived, pucData, xTake );
+            pxTotals->ullClientCopied += xTake;
+            TLS_Socket_RecvRelease( pxNetworkContext, xTake );
+            xReceived += xTake;
+
+            if( ( xReceived == TEST_PACKET_SIZE ) &&
+                ( prvHandlePublish( ucMQTTMessageBuffer, TEST_PACKET_SIZE, &( pxTotals->ulChecksum ) ) != TEST_PAYLOAD_SIZE ) )
+            {
+                lResult = TEST_TLS_RECV_BORROW_FAIL;
+            }
+        }
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvRun( BaseType_t xBorrow,
+                   TestReceiveTotals_t * pxTotals )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    TlsTransportRecvStats_t xRecvStats;
+    int lResult = TEST_TLS_RECV_BORROW_SUCCESS;
+    uint32_t i;
+
+    if( TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xTestCredentials,
+                            TEST_TIMEOUT_MS, TEST_TIMEOUT_MS ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_RECV_BORROW_FAIL;
+    }
+
+    for( i = 0; ( i < TEST_MESSAGES ) && ( lResult == TEST_TLS_RECV_BORROW_SUCCESS ); i++ )
+    {
+        prvBuildPacket( i );
+
+        if( TLS_Socket_Send( &xNetworkContext, ucPacket, sizeof( ucPacket ) ) != ( int32_t ) sizeof( ucPacket ) )
+        {
+            printf( "\tSend failed!\n" );
+            lResult = TEST_TLS_RECV_BORROW_FAIL;
+        }
+        else if( xBorrow == pdTRUE )
+        {
+            lResult = prvReceiveBorrowing( &xNetworkContext, pxTotals );
+        }
+        else
+        {
+            lResult = prvReceiveCopying( &xNetworkContext, pxTotals );
+        }
+    }
+
+    TLS_Socket_GetRecvStats( &xNetworkContext, &xRecvStats );
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    pxTotals->ullTransportCopied = xRecvStats.ullBytesCopied;
+
+    if( ( xBorrow == pdTRUE ) && ( xRecvStats.ulBorrows == 0U ) )
+    {
+        printf( "\tNothing was borrowed!\n" );
+        lResult = TEST_TLS_RECV_BORROW_FAIL;
+    }
+
+    if( xRecvStats.ullBytesReceived != ( uint64_t ) TEST_MESSAGES * TEST_PACKET_SIZE )
+    {
+        printf( "\t%u bytes received, expected %u!\n",
+                ( unsigned ) xRecvStats.ullBytesReceived,
+                ( unsigned ) ( TEST_MESSAGES * TEST_PACKET_SIZE ) );
+        lResult = TEST_TLS_RECV_BORROW_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestCopiesPerMessage( void )
+{
+    TestReceiveTotals_t xCopying = { 0 };
+    TestReceiveTotals_t xBorrowing = { 0 };
+    int lResult;
+
+    printf( "Bytes copied per %u byte PUBLISH\n", ( unsigned ) TEST_PACKET_SIZE );
+
+    lResult = prvRun( pdFALSE, &xCopying );
+
+    if( lResult == TEST_TLS_RECV_BORROW_SUCCESS )
+    {
+        lResult = prvRun( pdTRUE, &xBorrowing );
+    }
+
+    if( lResult == TEST_TLS_RECV_BORROW_SUCCESS )
+    {
+        printf( "\tTLS_Socket_Recv:       %u by the transport, %u by the client\n",
+                ( unsigned ) ( xCopying.ullTransportCopied / TEST_MESSAGES ),
+                ( unsigned ) ( xCopying.ullClientCopied / TEST_MESSAGES ) );
+        printf( "\tTLS_Socket_RecvBorrow: %u by the transport, %u by the client\n",
+                ( unsigned ) ( xBorrowing.ullTransportCopied / TEST_MESSAGES ),
+                ( unsigned ) ( xBorrowing.ullClientCopied / TEST_MESSAGES ) );
+
+        /* Both paths handed the same payloads to the application. */
+        if( xCopying.ulChecksum != xBorrowing.ulChecksum )
+        {
+            printf( "\tPayloads differ!\n" );
+            lResult = TEST_TLS_RECV_BORROW_FAIL;
+        }
+
+        if( xBorrowing.ullTransportCopied + xBorrowing.ullClientCopied >=
+            xCopying.ullTransportCopied + xCopying.ullClientCopied )
+        {
+            printf( "\tBorrowing did not save any copy!\n" );
+            lResult = TEST_TLS_RECV_BORROW_FAIL;
+        }
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestPartialRelease( void )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    const uint8_t * pucData = NULL;
+    uint8_t ucRest[ TEST_PACKET_SIZE ];
+    size_t xReceived = 0;
+    int32_t lRet;
+    int lResult = TEST_TLS_RECV_BORROW_SUCCESS;
+
+    printf( "Partial release\n" );
+
+    if( TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xTestCredentials,
+                            TEST_TIMEOUT_MS, TEST_TIMEOUT_MS ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_RECV_BORROW_FAIL;
+    }
+
+    prvBuildPacket( 7U );
+
+    if( TLS_Socket_Send( &xNetworkContext, ucPacket, sizeof( ucPacket ) ) != ( int32_t ) sizeof( ucPacket ) )
+    {
+        lResult = TEST_TLS_RECV_BORROW_FAIL;
+    }
+    else if( ( lRet = TLS_Socket_RecvBorrow( &xNetworkContext, &pucData ) ) <= 0 )
+    {
+        printf( "\tBorrow failed: %d\n", ( int ) lRet );
+        lResult = TEST_TLS_RECV_BORROW_FAIL;
+    }
+    else
+    {
+        /* Consume the fixed header only; the rest comes from a plain receive. */
+        TLS_Socket_RecvRelease( &xNetworkContext, 3U );
+        xReceived = 3U;
+
+        while( ( xReceived < TEST_PACKET_SIZE ) && ( lResult == TEST_TLS_RECV_BORROW_SUCCESS ) )
+        {
+            lRet = TLS_Socket_Recv( &xNetworkContext, ucRest + xReceived, TEST_PACKET_SIZE - xReceived );
+
+            if( lRet <= 0 )
+            {
+                lResult = TEST_TLS_RECV_BORROW_FAIL;
+            }
+            else
+            {
+                xReceived += ( size_t ) lRet;
+            }
+        }
+
+        if( ( lResult == TEST_TLS_RECV_BORROW_SUCCESS ) &&
+            ( memcmp( ucRest + 3U, ucPacket + 3U, TEST_PACKET_SIZE - 3U ) != 0 ) )
+        {
+            printf( "\tData after a partial release does not match!\n" );
+            lResult = TEST_TLS_RECV_BORROW_FAIL;
+        }
+    }
+
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_TLS_RECV_BORROW_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( TestTlsServer_Start( TEST_PORT ) != pdPASS )
+    {
+        printf( "Failed to start the test server!\n" );
+        lResult = TEST_TLS_RECV_BORROW_FAIL;
+    }
+    else if( ( prvTestCopiesPerMessage() != TEST_TLS_RECV_BORROW_SUCCESS ) ||
+             ( prvTestPartialRelease() != TEST_TLS_RECV_BORROW_SUCCESS ) )
+    {
+        lResult = TEST_TLS_RECV_BORROW_FAIL;
+    }
+
+    printf( lResult == TEST_TLS_RECV_BORROW_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "TlsRecvBorrow", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_TLS_RECV_BORROW_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_TLS_RECV_BORROW_FAIL;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,345 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  STRESS TEST FOR THE SHARED MBED TLS RUNTIME
+ *
+ *  Several tasks open and close TLS connections at the same time, mixing
+ *  blocking connects, non-blocking connects and connects abandoned before the
+ *  handshake. Afterwards every runtime reference taken by a connection must
+ *  have been dropped.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "transport_tls_socket.h"
+#include "mbedtls_freertos_port.h"
+#include "test_tls_server.h"
+
+#define TEST_TLS_STRESS_SUCCESS     0
+#define TEST_TLS_STRESS_FAIL        1
+
+#define TEST_PORT                   ( 8883 )
+#define TEST_HOST_NAME              "localhost"
+#define TEST_TIMEOUT_MS             ( 20000U )
+#define TEST_WORKERS                ( 3 )
+#define TEST_ITERATIONS             ( 9 )
+#define TEST_ECHO_MESSAGE           "runtime stress echo"
+
+/* Lets the server close its side before the next connect, so that the
+ * workers never run out of loopback sockets. */
+#define TEST_CLOSE_DELAY_MS         ( 50U )
+
+#define TEST_TASK_STACK_SIZE        ( 8 * 1024 )
+#define TEST_TASK_PRIORITY          ( tskIDLE_PRIORITY + 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+typedef enum TestConnectMode
+{
+    eTestConnectBlocking = 0,
+    eTestConnectNonBlocking,
+    eTestConnectAbandoned,
+    eTestConnectModes
+} TestConnectMode_t;
+
+static const NetworkCredentials_t xTestCredentials =
+{
+    .pucRootCa   = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA,
+    .xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA )
+};
+
+static SemaphoreHandle_t xWorkersDone;
+static volatile uint32_t ulFailures = 0;
+static volatile uint32_t ulCompleted = 0;
+
+/*-----------------------------------------------------------*/
+
+static void prvRecordFailure( void )
+{
+    taskENTER_CRITICAL();
+    ulFailures++;
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+static int prvEcho( NetworkContext_t * pxNetworkContext )
+{
+    uint8_t ucBuffer[ sizeof( TEST_ECHO_MESSAGE ) ];
+    size_t xReceived = 0;
+    int32_t lRet;
+    TickType_t xStart = xTaskGetTickCount();
+
+    lRet = TLS_Socket_Send( pxNetworkContext, TEST_ECHO_MESSAGE, sizeof( TEST_ECHO_MESSAGE ) );
+
+    if( lRet != ( int32_t ) sizeof( TEST_ECHO_MESSAGE ) )
+    {
+        printf( "\tSend failed: %d\n", ( int ) lRet );
+        return TEST_TLS_STRESS_FAIL;
+    }
+
+    while( ( xReceived < sizeof( ucBuffer ) ) &&
+           ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_TIMEOUT_MS ) ) )
+    {
+        lRet = TLS_Socket_Recv( pxNetworkContext, ucBuffer + xReceived, sizeof( ucBuffer ) - xReceived );
+
+        if( lRet < 0 )
+        {
+            printf( "\tReceive failed: %d\n", ( int ) lRet );
+            return TEST_TLS_STRESS_FAIL;
+        }
+
+        xReceived += ( size_t ) lRet;
+    }
+
+    if( ( xReceived != sizeof( ucBuffer ) ) ||
+        ( memcmp( ucBuffer, TEST_ECHO_MESSAGE, sizeof( ucBuffer ) ) != 0 ) )
+    {
+        printf( "\tEcho mismatch!\n" );
+        return TEST_TLS_STRESS_FAIL;
+    }
+
+    return TEST_TLS_STRESS_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvConnectOnce( TestConnectMode_t xMode )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    TlsTransportStatus_t xStatus;
+    TickType_t xStart = xTaskGetTickCount();
+    int lResult = TEST_TLS_STRESS_SUCCESS;
+
+    if( xMode == eTestConnectBlocking )
+    {
+        xStatus = TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT,
+                                      &xTestCredentials, TEST_TIMEOUT_MS, TEST_TIMEOUT_MS );
+    }
+    else
+    {
+        xStatus = TLS_Socket_ConnectStart( &xNetworkContext, TEST_HOST_NAME, TEST_PORT,
+                                           &xTestCredentials, TEST_TIMEOUT_MS, TEST_TIMEOUT_MS );
+
+        if( xMode == eTestConnectAbandoned )
+        {
+            if( xStatus != eTLSTransportInProgress )
+            {
+                printf( "\tConnect did not start in the background: %d\n", xStatus );
+                return TEST_TLS_STRESS_FAIL;
+            }
+
+            TLS_Socket_Disconnect( &xNetworkContext );
+
+            return ( xParams.xSSLContext == NULL ) ? TEST_TLS_STRESS_SUCCESS : TEST_TLS_STRESS_FAIL;
+        }
+
+        while( ( xStatus == eTLSTransportInProgress ) &&
+               ( ( xTaskGetTickCount() - xStart ) < pdMS_TO_TICKS( TEST_TIMEOUT_MS ) ) )
+        {
+            vTaskDelay( 1 );
+            xStatus = TLS_Socket_ConnectPoll( &xNetworkContext );
+        }
+    }
+
+    if( xStatus != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed: %d\n", xStatus );
+
+        if( xStatus == eTLSTransportInProgress )
+        {
+            TLS_Socket_Disconnect( &xNetworkContext );
+        }
+
+        return TEST_TLS_STRESS_FAIL;
+    }
+
+    lResult = prvEcho( &xNetworkContext );
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    if( lResult == TEST_TLS_STRESS_SUCCESS )
+    {
+        taskENTER_CRITICAL();
+        ulCompleted++;
+        taskEXIT_CRITICAL();
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvWorkerTask( void * pvParameters )
+{
+    uint32_t ulWorker = ( uint32_t ) ( uintptr_t ) pvParameters;
+    uint32_t i;
+
+    for( i = 0; i < TEST_ITERATIONS; i++ )
+    {
+        if( prvConnectOnce( ( TestConnectMode_t ) ( ( ulWorker + i ) % eTestConnectModes ) ) != TEST_TLS_STRESS_SUCCESS )
+        {
+            printf( "\tWorker %u iteration %u failed\n", ( unsigned ) ulWorker, ( unsigned ) i );
+            prvRecordFailure();
+        }
+
+        vTaskDelay( pdMS_TO_TICKS( TEST_CLOSE_DELAY_MS ) );
+    }
+
+    ( void ) xSemaphoreGive( xWorkersDone );
+    vTaskDelete( NULL );
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestConcurrentConnections( void )
+{
+    uint32_t ulHandshakesBefore = TestTlsServer_GetHandshakes();
+    uint32_t ulRefsBefore = TLS_Socket_RuntimeRefs();
+    uint32_t ulUsersBefore = mbedtls_platform_threading_users();
+    uint32_t i;
+    int lResult = TEST_TLS_STRESS_SUCCESS;
+
+    printf( "%u tasks, %u connections each\n", TEST_WORKERS, TEST_ITERATIONS );
+
+    xWorkersDone = xSemaphoreCreateCounting( TEST_WORKERS, 0 );
+
+    if( xWorkersDone == NULL )
+    {
+        return TEST_TLS_STRESS_FAIL;
+    }
+
+    for( i = 0; i < TEST_WORKERS; i++ )
+    {
+        if( xTaskCreate( prvWorkerTask, "TlsStressWorker", TEST_TASK_STACK_SIZE,
+                         ( void * ) ( uintptr_t ) i, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+        {
+            printf( "\tFailed to create worker %u\n", ( unsigned ) i );
+            return TEST_TLS_STRESS_FAIL;
+        }
+    }
+
+    for( i = 0; i < TEST_WORKERS; i++ )
+    {
+        if( xSemaphoreTake( xWorkersDone, pdMS_TO_TICKS( TEST_TIMEOUT_MS * TEST_ITERATIONS ) ) != pdTRUE )
+        {
+            printf( "\tWorkers did not finish!\n" );
+            return TEST_TLS_STRESS_FAIL;
+        }
+    }
+
+    printf( "\t%u connections completed, %u failures\n",
+            ( unsigned ) ulCompleted, ( unsigned ) ulFailures );
+
+    if( ulFailures != 0 )
+    {
+        lResult = TEST_TLS_STRESS_FAIL;
+    }
+
+    /* Abandoned connects never reach the handshake. */
+    if( TestTlsServer_GetHandshakes() - ulHandshakesBefore != ulCompleted )
+    {
+        printf( "\tServer saw %u handshakes\n",
+                ( unsigned ) ( TestTlsServer_GetHandshakes() - ulHandshakesBefore ) );
+        lResult = TEST_TLS_STRESS_FAIL;
+    }
+
+    if( ( TLS_Socket_RuntimeRefs() != ulRefsBefore ) ||
+        ( mbedtls_platform_threading_users() != ulUsersBefore ) )
+    {
+        printf( "\tLeaked runtime references: %u transport, %u threading\n",
+                ( unsigned ) ( TLS_Socket_RuntimeRefs() - ulRefsBefore ),
+                ( unsigned ) ( mbedtls_platform_threading_users() - ulUsersBefore ) );
+        lResult = TEST_TLS_STRESS_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestApplicationReference( void )
+{
+    uint32_t ulRefsBefore = TLS_Socket_RuntimeRefs();
+    uint32_t ulUsersBefore = mbedtls_platform_threading_users();
+    int lResult = TEST_TLS_STRESS_SUCCESS;
+
+    printf( "Application runtime reference\n" );
+
+    if( TLS_Socket_RuntimeInit() != eTLSTransportSuccess )
+    {
+        printf( "\tRuntime init failed!\n" );
+        return TEST_TLS_STRESS_FAIL;
+    }
+
+    if( ( TLS_Socket_RuntimeRefs() != ulRefsBefore + 1 ) ||
+        ( mbedtls_platform_threading_users() != ulUsersBefore + 1 ) )
+    {
+        printf( "\tReference not taken!\n" );
+        lResult = TEST_TLS_STRESS_FAIL;
+    }
+
+    /* Connections work while the application holds the runtime. */
+    if( prvConnectOnce( eTestConnectBlocking ) != TEST_TLS_STRESS_SUCCESS )
+    {
+        lResult = TEST_TLS_STRESS_FAIL;
+    }
+
+    TLS_Socket_RuntimeDeinit();
+
+    if( ( TLS_Socket_RuntimeRefs() != ulRefsBefore ) ||
+        ( mbedtls_platform_threading_users() != ulUsersBefore ) )
+    {
+        printf( "\tReference not dropped!\n" );
+        lResult = TEST_TLS_STRESS_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_TLS_STRESS_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( TestTlsServer_Start( TEST_PORT ) != pdPASS )
+    {
+        printf( "Failed to start the test server!\n" );
+        lResult = TEST_TLS_STRESS_FAIL;
+    }
+    else if( ( prvTestConcurrentConnections() != TEST_TLS_STRESS_SUCCESS ) ||
+             ( prvTestApplicationReference() != TEST_TLS_STRESS_SUCCESS ) )
+    {
+        lResult = TEST_TLS_STRESS_FAIL;
+    }
+
+    printf( lResult == TEST_TLS_STRESS_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "TlsStressTest", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_TLS_STRESS_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_TLS_STRESS_FAIL;
+}
+/*-----------------------------------------------------------*/
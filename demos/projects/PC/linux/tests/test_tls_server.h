@@ -0,0 +1,76 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file test_tls_server.h
+ * @brief mbed TLS echo server on the loopback sockets, for the transport tests.
+ */
+
+#ifndef TEST_TLS_SERVER_H
+#define TEST_TLS_SERVER_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include "mbedtls/ssl.h"
+
+#include "sockets_wrapper.h"
+
+/**
+ * @brief Root CA that signed the server certificate, for "localhost".
+ */
+#define TEST_TLS_SERVER_ROOT_CA                                          \
+    "-----BEGIN CERTIFICATE-----\n"                                      \
+    "MIIBnjCCAUOgAwIBAgIUC7DRkW+ZF4aJoJZprO+7Tcf05sEwCgYIKoZIzj0EAwIw\n" \
+    "GzEZMBcGA1UEAwwQTG9vcGJhY2sgVGVzdCBDQTAgFw0yNjEwMTcwNDI3MzZaGA8y\n" \
+    "MTI2MDkyMzA0MjczNlowGzEZMBcGA1UEAwwQTG9vcGJhY2sgVGVzdCBDQTBZMBMG\n" \
+    "ByqGSM49AgEGCCqGSM49AwEHA0IABA/OTPBmahDZLaplLfKMiFLjulDMglwcbsrk\n" \
+    "y9Dlca9yLBVxp1dtPPnGqB5cr/rZMxP1lHUhafgJ4MNPGv6bz4ijYzBhMB0GA1Ud\n" \
+    "DgQWBBTTfvoWfEAeYj2ULKpx/ABMvkjp7jAfBgNVHSMEGDAWgBTTfvoWfEAeYj2U\n" \
+    "LKpx/ABMvkjp7jAPBgNVHRMBAf8EBTADAQH/MA4GA1UdDwEB/wQEAwIBBjAKBggq\n" \
+    "hkjOPQQDAgNJADBGAiEA+lMQj+rtWSL9LdiMyceMIGatR3iSRez0B/7riN0WQnAC\n" \
+    "IQD0OsraftiTNf7L+JRPstFGhE4CQT959OGzPLecg/Az0w==\n"                 \
+    "-----END CERTIFICATE-----\n"
+
+/**
+ * @brief Start the server.
+ *
+ * Each accepted connection is served by its own task, which completes the
+ * handshake and then echoes application data until the client closes. The
+ * server holds one reference on the mbed TLS runtime for as long as it runs.
+ *
+ * Built with testtlsSERVER_SESSION_TICKETS set to 1, the server issues session
+ * tickets, so reconnects can resume the session.
+ *
+ * @param[in] usPort Port to listen on.
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t TestTlsServer_Start( uint16_t usPort );
+
+/**
+ * @brief Set up the server certificate, key and configuration, without
+ * listening. TestTlsServer_Start does this itself.
+ *
+ * @return pdPASS on success, pdFAIL otherwise.
+ */
+BaseType_t TestTlsServer_Init( void );
+
+/**
+ * @brief Run the server side of a handshake on an accepted socket, for tests
+ * that serve their own protocol over TLS.
+ *
+ * @param[in] xSocket Accepted socket.
+ * @param[out] pxSsl Context initialized for the connection. Free it with
+ * mbedtls_ssl_free, whatever the result.
+ * @return 0 on success, or an mbed TLS error code.
+ */
+int TestTlsServer_Handshake( SocketHandle xSocket,
+                             mbedtls_ssl_context * pxSsl );
+
+/**
+ * @brief Number of handshakes the server has completed.
+ */
+uint32_t TestTlsServer_GetHandshakes( void );
+
+#endif /* TEST_TLS_SERVER_H */
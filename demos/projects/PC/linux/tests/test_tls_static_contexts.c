@@ -0,0 +1,248 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  TEST OF THE STATICALLY ALLOCATED TLS CONTEXTS
+ *
+ *  Reconnects many times with a single context allocated at build time, and
+ *  checks that every mbed TLS allocation of the connection, record buffers
+ *  included, was served from its static storage. A second connection while
+ *  the context is in use must fail cleanly.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "transport_tls_socket.h"
+#include "transport_tls_session_cache.h"
+#include "mbedtls_freertos_port.h"
+#include "test_tls_server.h"
+
+#define TEST_TLS_STATIC_CONTEXTS_SUCCESS    0
+#define TEST_TLS_STATIC_CONTEXTS_FAIL       1
+
+#define TEST_PORT                           ( 8883 )
+#define TEST_HOST_NAME                      "localhost"
+#define TEST_TIMEOUT_MS                     ( 20000U )
+#define TEST_RECONNECTS                     ( 20U )
+#define TEST_ECHO_MESSAGE                   "static context echo"
+
+#define TEST_TASK_STACK_SIZE                ( 8 * 1024 )
+#define TEST_TASK_PRIORITY                  ( tskIDLE_PRIORITY + 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+static const NetworkCredentials_t xTestCredentials =
+{
+    .pucRootCa   = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA,
+    .xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA )
+};
+
+/*-----------------------------------------------------------*/
+
+static int prvEcho( NetworkContext_t * pxNetworkContext )
+{
+    uint8_t ucBuffer[ sizeof( TEST_ECHO_MESSAGE ) ];
+    size_t xReceived = 0;
+    int32_t lRet;
+
+    if( TLS_Socket_Send( pxNetworkContext, TEST_ECHO_MESSAGE, sizeof( TEST_ECHO_MESSAGE ) ) !=
+        ( int32_t ) sizeof( TEST_ECHO_MESSAGE ) )
+    {
+        printf( "\tSend failed!\n" );
+        return TEST_TLS_STATIC_CONTEXTS_FAIL;
+    }
+
+    while( xReceived < sizeof( ucBuffer ) )
+    {
+        lRet = TLS_Socket_Recv( pxNetworkContext, ucBuffer + xReceived, sizeof( ucBuffer ) - xReceived );
+
+        if( lRet <= 0 )
+        {
+            printf( "\tReceive failed: %d\n", ( int ) lRet );
+            return TEST_TLS_STATIC_CONTEXTS_FAIL;
+        }
+
+        xReceived += ( size_t ) lRet;
+    }
+
+    return ( memcmp( ucBuffer, TEST_ECHO_MESSAGE, sizeof( ucBuffer ) ) == 0 ) ?
+           TEST_TLS_STATIC_CONTEXTS_SUCCESS : TEST_TLS_STATIC_CONTEXTS_FAIL;
+}
+/*-----------------------------------------------------------*/
+
+static int prvConnectEchoClose( BaseType_t xFullHandshake )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    int lResult;
+
+    if( xFullHandshake == pdTRUE )
+    {
+        TLS_SessionCache_Invalidate( TEST_HOST_NAME, TEST_PORT );
+    }
+
+    if( TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xTestCredentials,
+                            TEST_TIMEOUT_MS, TEST_TIMEOUT_MS ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_STATIC_CONTEXTS_FAIL;
+    }
+
+    lResult = prvEcho( &xNetworkContext );
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestReconnects( void )
+{
+    MbedtlsPoolStats_t xBefore;
+    MbedtlsPoolStats_t xAfter;
+    int lResult;
+    uint32_t i;
+
+    printf( "Reconnects with a static context\n" );
+
+    /* The first connect parses the credentials and seeds the random number
+     * generator, which stay for the next ones. */
+    lResult = prvConnectEchoClose( pdTRUE );
+    mbedtls_platform_pool_stats_get( &xBefore );
+
+    for( i = 0; ( i < TEST_RECONNECTS ) && ( lResult == TEST_TLS_STATIC_CONTEXTS_SUCCESS ); i++ )
+    {
+        /* Alternate full and resumed handshakes. */
+        lResult = prvConnectEchoClose( ( ( i % 2U ) == 0U ) ? pdTRUE : pdFALSE );
+    }
+
+    mbedtls_platform_pool_stats_get( &xAfter );
+
+    if( lResult == TEST_TLS_STATIC_CONTEXTS_SUCCESS )
+    {
+        printf( "\t%u reconnects: %u allocations from static storage, %u from the heap, %u chunks; "
+                "at most %u bytes of storage used\n",
+                ( unsigned ) TEST_RECONNECTS,
+                ( unsigned ) ( xAfter.xArenas.ulAllocations - xBefore.xArenas.ulAllocations ),
+                ( unsigned ) ( xAfter.xArenas.ulHeapAllocations - xBefore.xArenas.ulHeapAllocations ),
+                ( unsigned ) ( xAfter.xArenas.ulChunks - xBefore.xArenas.ulChunks ),
+                ( unsigned ) xAfter.xArenas.xPeakStaticBytes );
+
+        /* Nothing the connection owns came from the heap. */
+        if( ( xAfter.xArenas.ulHeapAllocations != xBefore.xArenas.ulHeapAllocations ) ||
+            ( xAfter.xArenas.ulChunks != xBefore.xArenas.ulChunks ) ||
+            ( xAfter.xArenas.ulAllocations == xBefore.xArenas.ulAllocations ) )
+        {
+            printf( "\tConnection allocations left static storage!\n" );
+            lResult = TEST_TLS_STATIC_CONTEXTS_FAIL;
+        }
+
+        if( ( xAfter.xArenas.xInUseBytes != 0U ) || ( xAfter.ulActiveArenas != 0U ) )
+        {
+            printf( "\tStatic storage still in use after disconnect!\n" );
+            lResult = TEST_TLS_STATIC_CONTEXTS_FAIL;
+        }
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestContextsInUse( void )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    TlsTransportParams_t xSecondParams = { 0 };
+    NetworkContext_t xSecondNetworkContext = { &xSecondParams };
+    TlsTransportStatus_t xStatus;
+    int lResult = TEST_TLS_STATIC_CONTEXTS_SUCCESS;
+
+    printf( "Connect with every static context in use\n" );
+
+    if( TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, &xTestCredentials,
+                            TEST_TIMEOUT_MS, TEST_TIMEOUT_MS ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_STATIC_CONTEXTS_FAIL;
+    }
+
+    xStatus = TLS_Socket_Connect( &xSecondNetworkContext, TEST_HOST_NAME, TEST_PORT, &xTestCredentials,
+                                  TEST_TIMEOUT_MS, TEST_TIMEOUT_MS );
+
+    if( xStatus != eTLSTransportInsufficientMemory )
+    {
+        printf( "\tSecond connect returned %d!\n", xStatus );
+        lResult = TEST_TLS_STATIC_CONTEXTS_FAIL;
+
+        if( xStatus == eTLSTransportSuccess )
+        {
+            TLS_Socket_Disconnect( &xSecondNetworkContext );
+        }
+    }
+
+    /* The first connection is not disturbed. */
+    if( prvEcho( &xNetworkContext ) != TEST_TLS_STATIC_CONTEXTS_SUCCESS )
+    {
+        lResult = TEST_TLS_STATIC_CONTEXTS_FAIL;
+    }
+
+    TLS_Socket_Disconnect( &xNetworkContext );
+
+    /* And the context is free again. */
+    if( ( lResult == TEST_TLS_STATIC_CONTEXTS_SUCCESS ) &&
+        ( prvConnectEchoClose( pdFALSE ) != TEST_TLS_STATIC_CONTEXTS_SUCCESS ) )
+    {
+        lResult = TEST_TLS_STATIC_CONTEXTS_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_TLS_STATIC_CONTEXTS_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( TestTlsServer_Start( TEST_PORT ) != pdPASS )
+    {
+        printf( "Failed to start the test server!\n" );
+        lResult = TEST_TLS_STATIC_CONTEXTS_FAIL;
+    }
+    else if( ( prvTestReconnects() != TEST_TLS_STATIC_CONTEXTS_SUCCESS ) ||
+             ( prvTestContextsInUse() != TEST_TLS_STATIC_CONTEXTS_SUCCESS ) )
+    {
+        lResult = TEST_TLS_STATIC_CONTEXTS_FAIL;
+    }
+
+    printf( lResult == TEST_TLS_STATIC_CONTEXTS_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "TlsStaticContexts", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_TLS_STATIC_CONTEXTS_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_TLS_STATIC_CONTEXTS_FAIL;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,369 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ *  TEST OF THE VERIFIED CERTIFICATE CHAIN CACHE
+ *
+ *  Runs full handshakes with the cache on and off, and compares the handshake
+ *  time and the cache counters. Checks that a cached chain is verified again
+ *  after it is invalidated or its TTL elapsed, that it is not accepted
+ *  against other root CAs, and that a chain verified without SNI, and so
+ *  without its host name, is not cached.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* For democonfigROOT_CA_PEM, root CAs that did not sign the server certificate. */
+#include "demo_config.h"
+
+#include "transport_tls_socket.h"
+#include "transport_tls_session_cache.h"
+#include "transport_tls_verify_cache.h"
+#include "test_tls_server.h"
+
+#define TEST_TLS_VERIFY_CACHE_SUCCESS    0
+#define TEST_TLS_VERIFY_CACHE_FAIL       1
+
+#define TEST_PORT                        ( 8883 )
+#define TEST_HOST_NAME                   "localhost"
+#define TEST_TIMEOUT_MS                  ( 20000U )
+#define TEST_HANDSHAKES                  ( 10U )
+
+#define TEST_TASK_STACK_SIZE             ( 8 * 1024 )
+#define TEST_TASK_PRIORITY               ( tskIDLE_PRIORITY + 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+static const NetworkCredentials_t xTestCredentials =
+{
+    .pucRootCa   = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA,
+    .xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA )
+};
+
+static const NetworkCredentials_t xNoSniCredentials =
+{
+    .pucRootCa   = ( const uint8_t * ) TEST_TLS_SERVER_ROOT_CA,
+    .xRootCaSize = sizeof( TEST_TLS_SERVER_ROOT_CA ),
+    .xDisableSni = pdTRUE
+};
+
+static const NetworkCredentials_t xOtherRootCredentials =
+{
+    .pucRootCa   = ( const uint8_t * ) democonfigROOT_CA_PEM,
+    .xRootCaSize = sizeof( democonfigROOT_CA_PEM )
+};
+
+/*-----------------------------------------------------------*/
+
+/* Full handshake, so that the server sends its certificate chain. */
+static TlsTransportStatus_t prvConnectClose( const NetworkCredentials_t * pxCredentials,
+                                             uint32_t * pulHandshakeMs )
+{
+    TlsTransportParams_t xParams = { 0 };
+    NetworkContext_t xNetworkContext = { &xParams };
+    TlsTransportConnectStats_t xConnectStats;
+    TlsTransportStatus_t xStatus;
+
+    TLS_SessionCache_Invalidate( TEST_HOST_NAME, TEST_PORT );
+
+    xStatus = TLS_Socket_Connect( &xNetworkContext, TEST_HOST_NAME, TEST_PORT, pxCredentials,
+                                  TEST_TIMEOUT_MS, TEST_TIMEOUT_MS );
+
+    if( xStatus == eTLSTransportSuccess )
+    {
+        TLS_Socket_GetConnectStats( &xNetworkContext, &xConnectStats );
+        TLS_Socket_Disconnect( &xNetworkContext );
+
+        if( pulHandshakeMs != NULL )
+        {
+            *pulHandshakeMs = xConnectStats.ulHandshakeMs;
+        }
+    }
+
+    return xStatus;
+}
+/*-----------------------------------------------------------*/
+
+static int prvHandshakes( uint32_t * pulAvgHandshakeMs )
+{
+    uint32_t ulHandshakeMs;
+    uint32_t ulTotalMs = 0;
+    uint32_t i;
+
+    for( i = 0; i < TEST_HANDSHAKES; i++ )
+    {
+        if( prvConnectClose( &xTestCredentials, &ulHandshakeMs ) != eTLSTransportSuccess )
+        {
+            printf( "\tConnect failed!\n" );
+            return TEST_TLS_VERIFY_CACHE_FAIL;
+        }
+
+        ulTotalMs += ulHandshakeMs;
+    }
+
+    *pulAvgHandshakeMs = ulTotalMs / TEST_HANDSHAKES;
+
+    return TEST_TLS_VERIFY_CACHE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestOnAndOff( void )
+{
+    TlsVerifyCacheStats_t xBefore;
+    TlsVerifyCacheStats_t xAfter;
+    uint32_t ulCachedMs;
+    uint32_t ulUncachedMs;
+    int lResult = TEST_TLS_VERIFY_CACHE_SUCCESS;
+
+    printf( "Full handshakes with the cache on and off\n" );
+
+    TLS_VerifyCache_GetStats( &xBefore );
+
+    /* The first handshake verifies the chain and caches it. */
+    if( prvHandshakes( &ulCachedMs ) != TEST_TLS_VERIFY_CACHE_SUCCESS )
+    {
+        return TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    TLS_VerifyCache_GetStats( &xAfter );
+
+    if( ( xAfter.ulStores - xBefore.ulStores != 1U ) ||
+        ( xAfter.ulMisses - xBefore.ulMisses != 1U ) ||
+        ( xAfter.ulHits - xBefore.ulHits != TEST_HANDSHAKES - 1U ) )
+    {
+        printf( "\tCache on: %u stores, %u misses, %u hits!\n",
+                ( unsigned ) ( xAfter.ulStores - xBefore.ulStores ),
+                ( unsigned ) ( xAfter.ulMisses - xBefore.ulMisses ),
+                ( unsigned ) ( xAfter.ulHits - xBefore.ulHits ) );
+        lResult = TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    TLS_VerifyCache_SetEnabled( pdFALSE );
+    TLS_VerifyCache_GetStats( &xBefore );
+
+    if( ( TLS_VerifyCache_IsEnabled() != pdFALSE ) ||
+        ( prvHandshakes( &ulUncachedMs ) != TEST_TLS_VERIFY_CACHE_SUCCESS ) )
+    {
+        lResult = TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    TLS_VerifyCache_GetStats( &xAfter );
+    TLS_VerifyCache_SetEnabled( pdTRUE );
+
+    /* mbed TLS verifies the chains; the cache is not consulted. */
+    if( ( xAfter.ulHits != xBefore.ulHits ) ||
+        ( xAfter.ulMisses != xBefore.ulMisses ) ||
+        ( xAfter.ulStores != xBefore.ulStores ) )
+    {
+        printf( "\tCache used while off!\n" );
+        lResult = TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    if( lResult == TEST_TLS_VERIFY_CACHE_SUCCESS )
+    {
+        printf( "\thandshake %u ms with the cache, %u ms without; "
+                "full verification %u ms, %u ms saved\n",
+                ( unsigned ) ulCachedMs,
+                ( unsigned ) ulUncachedMs,
+                ( unsigned ) ( xAfter.xAvgFullVerify * portTICK_PERIOD_MS ),
+                ( unsigned ) ( xAfter.ullTicksSaved * portTICK_PERIOD_MS ) );
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestInvalidateAndExpiry( void )
+{
+    TlsVerifyCacheStats_t xBefore;
+    TlsVerifyCacheStats_t xAfter;
+    int lResult = TEST_TLS_VERIFY_CACHE_SUCCESS;
+
+    printf( "Invalidated and expired entries\n" );
+
+    /* Cache the chain, then drop it. */
+    if( prvConnectClose( &xTestCredentials, NULL ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    TLS_VerifyCache_GetStats( &xBefore );
+    TLS_VerifyCache_Invalidate( TEST_HOST_NAME );
+
+    if( prvConnectClose( &xTestCredentials, NULL ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    TLS_VerifyCache_GetStats( &xAfter );
+
+    if( ( xAfter.ulInvalidations - xBefore.ulInvalidations != 1U ) ||
+        ( xAfter.ulStores - xBefore.ulStores != 1U ) ||
+        ( xAfter.ulHits != xBefore.ulHits ) )
+    {
+        printf( "\tInvalidated chain not verified again!\n" );
+        lResult = TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    /* Let the entry outlive its TTL. */
+    vTaskDelay( pdMS_TO_TICKS( transporttlsVERIFY_CACHE_TTL_MS + 500U ) );
+    xBefore = xAfter;
+
+    if( prvConnectClose( &xTestCredentials, NULL ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    TLS_VerifyCache_GetStats( &xAfter );
+
+    if( ( xAfter.ulExpired - xBefore.ulExpired != 1U ) ||
+        ( xAfter.ulStores - xBefore.ulStores != 1U ) ||
+        ( xAfter.ulHits != xBefore.ulHits ) )
+    {
+        printf( "\tExpired chain not verified again!\n" );
+        lResult = TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestOtherRootCa( void )
+{
+    TlsVerifyCacheStats_t xBefore;
+    TlsVerifyCacheStats_t xAfter;
+    TlsTransportStatus_t xStatus;
+    int lResult = TEST_TLS_VERIFY_CACHE_SUCCESS;
+
+    printf( "Cached chain presented against other root CAs\n" );
+
+    if( prvConnectClose( &xTestCredentials, NULL ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    TLS_VerifyCache_GetStats( &xBefore );
+    xStatus = prvConnectClose( &xOtherRootCredentials, NULL );
+    TLS_VerifyCache_GetStats( &xAfter );
+
+    if( xStatus != eTLSTransportCAVerifyFailed )
+    {
+        printf( "\tConnect returned %d!\n", xStatus );
+        lResult = TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    if( ( xAfter.ulMismatches - xBefore.ulMismatches != 1U ) ||
+        ( xAfter.ulHits != xBefore.ulHits ) )
+    {
+        printf( "\tChain accepted from the cache!\n" );
+        lResult = TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestSniDisabled( void )
+{
+    TlsVerifyCacheStats_t xBefore;
+    TlsVerifyCacheStats_t xAfter;
+    int lResult = TEST_TLS_VERIFY_CACHE_SUCCESS;
+
+    printf( "Chain verified without SNI\n" );
+
+    TLS_VerifyCache_Invalidate( TEST_HOST_NAME );
+    TLS_VerifyCache_GetStats( &xBefore );
+
+    if( prvConnectClose( &xNoSniCredentials, NULL ) != eTLSTransportSuccess )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    TLS_VerifyCache_GetStats( &xAfter );
+
+    if( ( xAfter.ulStores != xBefore.ulStores ) ||
+        ( xAfter.ulHits != xBefore.ulHits ) )
+    {
+        printf( "\tChain cached without its host name!\n" );
+        lResult = TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    /* A chain cached with its host name also serves connects without SNI. */
+    if( ( prvConnectClose( &xTestCredentials, NULL ) != eTLSTransportSuccess ) ||
+        ( prvConnectClose( &xNoSniCredentials, NULL ) != eTLSTransportSuccess ) )
+    {
+        printf( "\tConnect failed!\n" );
+        return TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    xBefore = xAfter;
+    TLS_VerifyCache_GetStats( &xAfter );
+
+    if( ( xAfter.ulStores - xBefore.ulStores != 1U ) ||
+        ( xAfter.ulHits - xBefore.ulHits != 1U ) )
+    {
+        printf( "\t%u stores and %u hits, expected 1 and 1!\n",
+                ( unsigned ) ( xAfter.ulStores - xBefore.ulStores ),
+                ( unsigned ) ( xAfter.ulHits - xBefore.ulHits ) );
+        lResult = TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    int lResult = TEST_TLS_VERIFY_CACHE_SUCCESS;
+
+    ( void ) pvParameters;
+
+    if( TestTlsServer_Start( TEST_PORT ) != pdPASS )
+    {
+        printf( "Failed to start the test server!\n" );
+        lResult = TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+    else if( ( prvTestOnAndOff() != TEST_TLS_VERIFY_CACHE_SUCCESS ) ||
+             ( prvTestInvalidateAndExpiry() != TEST_TLS_VERIFY_CACHE_SUCCESS ) ||
+             ( prvTestOtherRootCa() != TEST_TLS_VERIFY_CACHE_SUCCESS ) ||
+             ( prvTestSniDisabled() != TEST_TLS_VERIFY_CACHE_SUCCESS ) )
+    {
+        lResult = TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    printf( lResult == TEST_TLS_VERIFY_CACHE_SUCCESS ? "Tests Passed\n" : "Tests Failed\n" );
+
+    /* The scheduler does not return on this port. */
+    exit( lResult );
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( xTaskCreate( prvTestTask, "TlsVerifyCache", TEST_TASK_STACK_SIZE,
+                     NULL, TEST_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return TEST_TLS_VERIFY_CACHE_FAIL;
+    }
+
+    vTaskStartScheduler();
+
+    return TEST_TLS_VERIFY_CACHE_FAIL;
+}
+/*-----------------------------------------------------------*/
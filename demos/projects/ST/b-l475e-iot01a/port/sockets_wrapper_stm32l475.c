@@ -14,6 +14,7 @@
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
 #include "semphr.h"
+#include "task.h"
 
 /* Wifi module */
 #include "es_wifi.h"
@@ -44,6 +45,12 @@
  */
 #define stsecuresocketsSOCKET_IS_CONNECTED_FLAG    ( 1UL << 3 )
 
+/**
+ * @brief A flag to indicate whether or not receive returns at once when
+ * there is no data.
+ */
+#define stsecuresocketsSOCKET_NONBLOCKING_FLAG     ( 1UL << 4 )
+
 /**
  * @brief The maximum timeout accepted by the Inventek module.
  *
@@ -72,6 +79,12 @@
  */
 #define stsecuresocketsONE_MILLISECOND             ( 1 )
 
+/**
+ * @brief Bytes read ahead from the module by Sockets_Poll, to find out whether
+ * a socket has data, and returned by the next Sockets_Recv.
+ */
+#define stsecuresocketsPOLL_BUFFER_SIZE            ( 64 )
+
 /**
  * @brief Maximum number of sockets that can be created simultaneously.
  */
@@ -92,11 +105,15 @@
  */
 typedef struct STSecureSocket
 {
-    uint8_t ucInUse;            /**< Tracks whether the socket is in use or not. */
-    uint8_t esWifiSocketNumber; /**< Socket number used in eswifi layer. */
-    uint32_t ulFlags;           /**< Various properties of the socket (secured etc.). */
-    uint32_t ulSendTimeout;     /**< Send timeout. */
-    uint32_t ulReceiveTimeout;  /**< Receive timeout. */
+    uint8_t ucInUse;                                         /**< Tracks whether the socket is in use or not. */
+    uint8_t esWifiSocketNumber;                              /**< Socket number used in eswifi layer. */
+    uint32_t ulFlags;                                        /**< Various properties of the socket (secured etc.). */
+    uint32_t ulSendTimeout;                                  /**< Send timeout. */
+    uint32_t ulReceiveTimeout;                               /**< Receive timeout. */
+    SocketsConnectTimes_t xConnectTimes;                     /**< Time spent in each phase of the last connect. */
+    uint8_t ucPollBuffer[ stsecuresocketsPOLL_BUFFER_SIZE ]; /**< Data read by Sockets_Poll, not yet received. */
+    uint16_t usPollBufferStart;                              /**< Offset of the first byte not yet received. */
+    uint16_t usPollBufferEnd;                                /**< Offset after the last byte read. */
 } STSecureSocket_t;
 
 static STSecureSocket_t xSockets[ wificonfigMAX_SOCKETS ];
@@ -265,6 +282,9 @@ SocketHandle Sockets_Open()
         pxSecureSocket->ulFlags = stsecuresocketsSOCKET_SECURE_FLAG;
         pxSecureSocket->ulSendTimeout = socketsconfigDEFAULT_SEND_TIMEOUT;
         pxSecureSocket->ulReceiveTimeout = socketsconfigDEFAULT_RECV_TIMEOUT;
+        ( void ) memset( &( pxSecureSocket->xConnectTimes ), 0, sizeof( pxSecureSocket->xConnectTimes ) );
+        pxSecureSocket->usPollBufferStart = 0;
+        pxSecureSocket->usPollBufferEnd = 0;
     }
 
     return ( SocketHandle ) ulSocketNumber;
@@ -292,6 +312,7 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
     STSecureSocket_t * pxSecureSocket;
     int32_t lRetVal = SOCKETS_ERROR_NONE;
     uint32_t ulIPAddres = 0;
+    TickType_t xPhaseStart = xTaskGetTickCount();
 
     if( prvIsValidSocket( ulSocketNumber ) == pdFALSE )
     {
@@ -311,6 +332,9 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
         }
         else
         {
+            pxSecureSocket->xConnectTimes.ulDnsMs = ( uint32_t ) ( ( xTaskGetTickCount() - xPhaseStart ) * portTICK_PERIOD_MS );
+            xPhaseStart = xTaskGetTickCount();
+
             /* Start the client connection. */
             if( WIFI_OpenClientConnection( ulSocketNumber, WIFI_TCP_PROTOCOL,
                                            NULL, ( uint8_t * ) &ulIPAddres, usPort, 0 ) == WIFI_STATUS_OK )
@@ -320,6 +344,7 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
 
                 /* Mark that the socket is connected. */
                 pxSecureSocket->ulFlags |= stsecuresocketsSOCKET_IS_CONNECTED_FLAG;
+                pxSecureSocket->xConnectTimes.ulTcpConnectMs = ( uint32_t ) ( ( xTaskGetTickCount() - xPhaseStart ) * portTICK_PERIOD_MS );
             }
             else
             {
@@ -336,6 +361,30 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_ConnectStart( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort )
+{
+    /* The Inventek module only offers a blocking connect. */
+    return Sockets_Connect( xSocket, pcHostName, usPort );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectPoll( SocketHandle xSocket )
+{
+    uint32_t ulSocketNumber = ( uint32_t ) xSocket;
+    BaseType_t xRetVal = SOCKETS_ENOTCONN;
+
+    if( ( prvIsValidSocket( ulSocketNumber ) == pdTRUE ) &&
+        ( ( xSockets[ ulSocketNumber ].ulFlags & stsecuresocketsSOCKET_IS_CONNECTED_FLAG ) != 0U ) )
+    {
+        xRetVal = SOCKETS_ERROR_NONE;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
 void Sockets_Disconnect( SocketHandle xSocket )
 {
     uint32_t ulSocketNumber = ( uint32_t ) xSocket;
@@ -367,6 +416,17 @@ void Sockets_Disconnect( SocketHandle xSocket )
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_CloseAsync( SocketHandle xSocket )
+{
+    /* The module closes the connection without waiting for the peer, and
+     * Sockets_Disconnect already returns the socket to the pool. Returning it
+     * again could free a socket another task just opened. */
+    Sockets_Disconnect( xSocket );
+
+    return SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
 BaseType_t Sockets_Recv( SocketHandle xSocket,
                          uint8_t * pucReceiveBuffer,
                          size_t xReceiveBufferLength )
@@ -377,10 +437,30 @@ BaseType_t Sockets_Recv( SocketHandle xSocket,
     BaseType_t xRetVal;
     WIFI_Status_t xWiFiResult = WIFI_STATUS_OK;
     TickType_t xTimeOnEntering = xTaskGetTickCount(), xSemaphoreWait;
+    uint32_t ulReceiveTimeout;
 
     /* Shortcut for easy access. */
     pxSecureSocket = &( xSockets[ ulSocketNumber ] );
 
+    /* In non-blocking mode, poll the module once. */
+    ulReceiveTimeout = ( ( pxSecureSocket->ulFlags & stsecuresocketsSOCKET_NONBLOCKING_FLAG ) != 0U ) ?
+                       0U : pxSecureSocket->ulReceiveTimeout;
+
+    /* Return the data Sockets_Poll read first. */
+    if( pxSecureSocket->usPollBufferStart < pxSecureSocket->usPollBufferEnd )
+    {
+        if( xReceiveBufferLength > ( size_t ) ( pxSecureSocket->usPollBufferEnd - pxSecureSocket->usPollBufferStart ) )
+        {
+            xReceiveBufferLength = ( size_t ) ( pxSecureSocket->usPollBufferEnd - pxSecureSocket->usPollBufferStart );
+        }
+
+        ( void ) memcpy( pucReceiveBuffer, &( pxSecureSocket->ucPollBuffer[ pxSecureSocket->usPollBufferStart ] ),
+                         xReceiveBufferLength );
+        pxSecureSocket->usPollBufferStart += ( uint16_t ) xReceiveBufferLength;
+
+        return ( BaseType_t ) xReceiveBufferLength;
+    }
+
     /* WiFi module does not support receiving more than ES_WIFI_PAYLOAD_SIZE
      * bytes at a time. */
     if( xReceiveBufferLength > ( uint32_t ) ES_WIFI_PAYLOAD_SIZE )
@@ -388,7 +468,7 @@ BaseType_t Sockets_Recv( SocketHandle xSocket,
         xReceiveBufferLength = ( uint32_t ) ES_WIFI_PAYLOAD_SIZE;
     }
 
-    xSemaphoreWait = pxSecureSocket->ulReceiveTimeout + stsecuresocketsFIVE_MILLISECONDS;
+    xSemaphoreWait = ulReceiveTimeout + stsecuresocketsFIVE_MILLISECONDS;
 
     for( ; ; )
     {
@@ -415,7 +495,7 @@ BaseType_t Sockets_Recv( SocketHandle xSocket,
             {
                 /* The WiFi poll timed out, but has the socket timeout expired
                  * too? */
-                if( ( xTaskGetTickCount() - xTimeOnEntering ) < pxSecureSocket->ulReceiveTimeout )
+                if( ( xTaskGetTickCount() - xTimeOnEntering ) < ulReceiveTimeout )
                 {
                     /* The socket has not timed out, but the driver supplied
                      * with the board is polling, which would block other tasks, so
@@ -550,10 +630,10 @@ BaseType_t Sockets_Send( SocketHandle xSocket,
 }
 /*-----------------------------------------------------------*/
 
-int32_t Sockets_SetSockOpt( SocketHandle xSocket,
-                            int32_t lOptionName,
-                            const void * pvOptionValue,
-                            size_t xOptionLength )
+BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
+                               int32_t lOptionName,
+                               const void * pvOptionValue,
+                               size_t xOptionLength )
 {
     uint32_t ulSocketNumber = ( uint32_t ) xSocket;
     BaseType_t xRetVal;
@@ -579,6 +659,21 @@ int32_t Sockets_SetSockOpt( SocketHandle xSocket,
                 xRetVal = SOCKETS_ERROR_NONE;
                 break;
 
+            case SOCKETS_SO_NONBLOCK:
+
+                /* Only receive can return early; sends complete in the module. */
+                if( *( ( const BaseType_t * ) pvOptionValue ) != pdFALSE )
+                {
+                    pxSecureSocket->ulFlags |= stsecuresocketsSOCKET_NONBLOCKING_FLAG;
+                }
+                else
+                {
+                    pxSecureSocket->ulFlags &= ~stsecuresocketsSOCKET_NONBLOCKING_FLAG;
+                }
+
+                xRetVal = SOCKETS_ERROR_NONE;
+                break;
+
             default:
                 xRetVal = SOCKETS_ENOPROTOOPT;
                 break;
@@ -588,3 +683,146 @@ int32_t Sockets_SetSockOpt( SocketHandle xSocket,
     return xRetVal;
 }
 /*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the events of a socket that occurred, reading ahead into its
+ * poll buffer to find out whether it has data.
+ *
+ * @param ulSocketNumber
+ * @param ulEvents Events waited for.
+ * @return Events that occurred.
+ */
+static uint32_t prvPollSocket( uint32_t ulSocketNumber,
+                               uint32_t ulEvents )
+{
+    STSecureSocket_t * pxSecureSocket;
+    WIFI_Status_t xWiFiResult;
+    uint16_t usReceivedBytes = 0;
+    uint32_t ulRevents = 0;
+
+    if( ( prvIsValidSocket( ulSocketNumber ) == pdFALSE ) ||
+        ( ( xSockets[ ulSocketNumber ].ulFlags & stsecuresocketsSOCKET_IS_CONNECTED_FLAG ) == 0U ) )
+    {
+        ulRevents = SOCKETS_POLL_ERROR;
+    }
+    else
+    {
+        pxSecureSocket = &( xSockets[ ulSocketNumber ] );
+
+        if( ( ulEvents & SOCKETS_POLL_READ ) != 0U )
+        {
+            if( pxSecureSocket->usPollBufferStart < pxSecureSocket->usPollBufferEnd )
+            {
+                ulRevents |= SOCKETS_POLL_READ;
+            }
+            else if( xSemaphoreTake( xWifiSemaphoreHandle, stsecuresocketsFIVE_MILLISECONDS ) == pdTRUE )
+            {
+                xWiFiResult = WIFI_ReceiveData( ( uint8_t ) ulSocketNumber,
+                                                pxSecureSocket->ucPollBuffer,
+                                                ( uint16_t ) sizeof( pxSecureSocket->ucPollBuffer ),
+                                                &( usReceivedBytes ),
+                                                stsecuresocketsONE_MILLISECOND );
+
+                ( void ) xSemaphoreGive( xWifiSemaphoreHandle );
+
+                if( ( xWiFiResult == WIFI_STATUS_OK ) && ( usReceivedBytes != 0 ) )
+                {
+                    pxSecureSocket->usPollBufferStart = 0;
+                    pxSecureSocket->usPollBufferEnd = usReceivedBytes;
+                    ulRevents |= SOCKETS_POLL_READ;
+                }
+                else if( ( xWiFiResult != WIFI_STATUS_OK ) && ( xWiFiResult != WIFI_STATUS_TIMEOUT ) )
+                {
+                    /* Let Sockets_Recv report the error, and reset the module. */
+                    ulRevents |= SOCKETS_POLL_ERROR;
+                }
+                else
+                {
+                    /* Empty else marker. */
+                }
+            }
+            else
+            {
+                /* The module is busy; try again on the next round. */
+            }
+        }
+
+        /* Sends complete in the module, so a connected socket can always send. */
+        if( ( ulEvents & SOCKETS_POLL_WRITE ) != 0U )
+        {
+            ulRevents |= SOCKETS_POLL_WRITE;
+        }
+    }
+
+    return ulRevents;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Poll( SocketsPollFd_t * pxSockets,
+                         size_t xSocketCount,
+                         uint32_t ulTimeoutMs )
+{
+    TickType_t xTimeOnEntering = xTaskGetTickCount();
+    TickType_t xTimeout = ( ulTimeoutMs == SOCKETS_POLL_WAIT_FOREVER ) ?
+                          portMAX_DELAY : pdMS_TO_TICKS( ulTimeoutMs );
+    BaseType_t xRetVal;
+    size_t xIndex;
+
+    if( ( pxSockets == NULL ) && ( xSocketCount > 0U ) )
+    {
+        return SOCKETS_EINVAL;
+    }
+
+    /* The module has no select; check each socket in turn until one is ready,
+     * sleeping between rounds as Sockets_Recv does. */
+    for( ; ; )
+    {
+        xRetVal = 0;
+
+        for( xIndex = 0; xIndex < xSocketCount; xIndex++ )
+        {
+            pxSockets[ xIndex ].ulRevents = prvPollSocket( ( uint32_t ) pxSockets[ xIndex ].xSocket,
+                                                           pxSockets[ xIndex ].ulEvents );
+
+            if( pxSockets[ xIndex ].ulRevents != 0U )
+            {
+                xRetVal++;
+            }
+        }
+
+        if( ( xRetVal != 0 ) ||
+            ( ( xTaskGetTickCount() - xTimeOnEntering ) >= xTimeout ) )
+        {
+            break;
+        }
+
+        vTaskDelay( stsecuresocketsFIVE_MILLISECONDS );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_GetConnectTimes( SocketHandle xSocket,
+                                    SocketsConnectTimes_t * pxTimes )
+{
+    uint32_t ulSocketNumber = ( uint32_t ) xSocket;
+    BaseType_t xRetVal = SOCKETS_ENOTCONN;
+
+    if( ( prvIsValidSocket( ulSocketNumber ) == pdTRUE ) &&
+        ( ( xSockets[ ulSocketNumber ].ulFlags & stsecuresocketsSOCKET_IS_CONNECTED_FLAG ) != 0U ) )
+    {
+        *pxTimes = xSockets[ ulSocketNumber ].xConnectTimes;
+        xRetVal = SOCKETS_ERROR_NONE;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_Prefetch( const char * pcHostName )
+{
+    /* The module resolves names itself and keeps no cache to fill. */
+    ( void ) pcHostName;
+}
+/*-----------------------------------------------------------*/
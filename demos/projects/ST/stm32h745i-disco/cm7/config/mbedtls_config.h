@@ -33,6 +33,15 @@
 #define MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED
 #define MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED
 
+/* Elliptic curve performance. MBEDTLS_ECP_FIXED_POINT_OPTIM, on by default in
+ * mbed TLS, precomputes multiples of the curve generator for faster ECDHE key
+ * generation and ECDSA signing. TRANSPORT_TLS_ECP_RESTARTABLE, set by the
+ * DEMO_TLS_ECP_RESTARTABLE CMake option, splits the ECC operations of the TLS
+ * handshake into bounded steps, see TLS_Socket_SetEcpMaxOps. */
+#ifdef TRANSPORT_TLS_ECP_RESTARTABLE
+    #define MBEDTLS_ECP_RESTARTABLE
+#endif
+
 /* Enable all SSL alert messages. */
 #define MBEDTLS_SSL_ALL_ALERT_MESSAGES
 
@@ -43,6 +52,14 @@
 #define MBEDTLS_SSL_PROTO_TLS1_2
 #define MBEDTLS_SSL_ALPN
 #define MBEDTLS_SSL_SERVER_NAME_INDICATION
+#define MBEDTLS_SSL_SESSION_TICKETS
+
+/* TRANSPORT_TLS_VERIFY_CACHE, set by the DEMO_TLS_VERIFY_CACHE CMake option,
+ * lets the transport skip the signature checks of a server certificate chain
+ * it verified before. It needs the chain kept after it is parsed. */
+#ifdef TRANSPORT_TLS_VERIFY_CACHE
+    #define MBEDTLS_SSL_KEEP_PEER_CERTIFICATE
+#endif
 
 /* Check certificate key usage. */
 #define MBEDTLS_X509_CHECK_KEY_USAGE
@@ -12,6 +12,11 @@
 /* Demo Specific configs. */
 #include "demo_config.h"
 
+/* DER credentials generated from demo_config.h by tools/pem_to_der.py. */
+#ifdef democonfigUSE_DER_CREDENTIALS
+    #include "demo_config_der.h"
+#endif
+
 /* Demo Specific Interface Functions. */
 #include "azure_sample_connection.h"
 
@@ -133,6 +138,15 @@
  * @brief Wait timeout for subscribe to finish.
  */
 #define sampleazureiotSUBSCRIBE_TIMEOUT                       ( 10 * 1000U )
+
+/**
+ * @brief Diagnostics telemetry sent once per connection, with the time spent
+ * in each connect phase and the TLS traffic so far.
+ */
+#define sampleazureiotDIAGNOSTICS_MESSAGE                                                       \
+    "{ \"connectDiagnostics\": { \"dnsMs\": %u, \"tcpMs\": %u, \"tlsMs\": %u, \"mqttMs\": %u, " \
+    "\"cipherSuite\": \"%s\", \"sessionResumed\": %s, "                                         \
+    "\"recordsOut\": %u, \"bytesOut\": %u, \"recordsIn\": %u, \"bytesIn\": %u } }"
 /*-----------------------------------------------------------*/
 
 /**
@@ -152,6 +166,7 @@ uint64_t ullGetUnixTime( void );
 
 static uint8_t ucPropertyBuffer[ 80 ];
 static uint8_t ucScratchBuffer[ 128 ];
+static uint8_t ucDiagnosticsBuffer[ 320 ];
 
 /* Each compilation unit must define the NetworkContext struct. */
 struct NetworkContext
@@ -207,6 +222,18 @@ static uint32_t prvConnectToServerWithBackoffRetries( const char * pcHostName,
                                                       uint32_t ulPort,
                                                       NetworkCredentials_t * pxNetworkCredentials,
                                                       NetworkContext_t * pxNetworkContext );
+
+/**
+ * @brief Send the connect timings and TLS counters of the connection as telemetry.
+ *
+ * @param pxNetworkContext Network context of the IoT Hub connection.
+ * @param ulMqttConnectMs Time taken by the MQTT connect, up to the CONNACK.
+ * @param pxPropertyBag Properties sent with the telemetry.
+ * @return AzureIoTResult_t The result of sending the telemetry.
+ */
+static AzureIoTResult_t prvSendConnectDiagnostics( NetworkContext_t * pxNetworkContext,
+                                                   uint32_t ulMqttConnectMs,
+                                                   AzureIoTMessageProperties_t * pxPropertyBag );
 /*-----------------------------------------------------------*/
 
 /**
@@ -282,6 +309,14 @@ static void prvHandlePropertiesMessage( AzureIoTHubClientPropertiesResponse_t *
 }
 /*-----------------------------------------------------------*/
 
+#ifdef democonfigUSE_DER_CREDENTIALS
+    static const uint8_t ucRootCaDer[] = democonfigROOT_CA_DER;
+    #ifdef democonfigCLIENT_CERTIFICATE_DER
+        static const uint8_t ucClientCertDer[] = democonfigCLIENT_CERTIFICATE_DER;
+        static const uint8_t ucPrivateKeyDer[] = democonfigCLIENT_PRIVATE_KEY_DER;
+    #endif
+#endif /* democonfigUSE_DER_CREDENTIALS */
+
 /**
  * @brief Setup transport credentials.
  */
@@ -289,14 +324,28 @@ static uint32_t prvSetupNetworkCredentials( NetworkCredentials_t * pxNetworkCred
 {
     pxNetworkCredentials->xDisableSni = pdFALSE;
     /* Set the credentials for establishing a TLS connection. */
-    pxNetworkCredentials->pucRootCa = ( const unsigned char * ) democonfigROOT_CA_PEM;
-    pxNetworkCredentials->xRootCaSize = sizeof( democonfigROOT_CA_PEM );
-    #ifdef democonfigCLIENT_CERTIFICATE_PEM
-        pxNetworkCredentials->pucClientCert = ( const unsigned char * ) democonfigCLIENT_CERTIFICATE_PEM;
-        pxNetworkCredentials->xClientCertSize = sizeof( democonfigCLIENT_CERTIFICATE_PEM );
-        pxNetworkCredentials->pucPrivateKey = ( const unsigned char * ) democonfigCLIENT_PRIVATE_KEY_PEM;
-        pxNetworkCredentials->xPrivateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
-    #endif
+    #ifdef democonfigUSE_DER_CREDENTIALS
+        pxNetworkCredentials->pucRootCa = ucRootCaDer;
+        pxNetworkCredentials->xRootCaSize = sizeof( ucRootCaDer );
+        pxNetworkCredentials->xRootCaFormat = eTlsCredentialFormatDer;
+        #ifdef democonfigCLIENT_CERTIFICATE_DER
+            pxNetworkCredentials->pucClientCert = ucClientCertDer;
+            pxNetworkCredentials->xClientCertSize = sizeof( ucClientCertDer );
+            pxNetworkCredentials->xClientCertFormat = eTlsCredentialFormatDer;
+            pxNetworkCredentials->pucPrivateKey = ucPrivateKeyDer;
+            pxNetworkCredentials->xPrivateKeySize = sizeof( ucPrivateKeyDer );
+            pxNetworkCredentials->xPrivateKeyFormat = eTlsCredentialFormatDer;
+        #endif
+    #else
+        pxNetworkCredentials->pucRootCa = ( const unsigned char * ) democonfigROOT_CA_PEM;
+        pxNetworkCredentials->xRootCaSize = sizeof( democonfigROOT_CA_PEM );
+        #ifdef democonfigCLIENT_CERTIFICATE_PEM
+            pxNetworkCredentials->pucClientCert = ( const unsigned char * ) democonfigCLIENT_CERTIFICATE_PEM;
+            pxNetworkCredentials->xClientCertSize = sizeof( democonfigCLIENT_CERTIFICATE_PEM );
+            pxNetworkCredentials->pucPrivateKey = ( const unsigned char * ) democonfigCLIENT_PRIVATE_KEY_PEM;
+            pxNetworkCredentials->xPrivateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
+        #endif
+    #endif /* democonfigUSE_DER_CREDENTIALS */
 
     return 0;
 }
@@ -320,6 +369,8 @@ static void prvAzureDemoTask( void * pvParameters )
     AzureIoTHubClientOptions_t xHubOptions = { 0 };
     AzureIoTMessageProperties_t xPropertyBag;
     bool xSessionPresent;
+    TickType_t xMqttConnectStart;
+    uint32_t ulMqttConnectMs;
 
     #ifdef democonfigENABLE_DPS_SAMPLE
         uint8_t * pucIotHubHostname = NULL;
@@ -341,6 +392,16 @@ static void prvAzureDemoTask( void * pvParameters )
     ulStatus = prvSetupNetworkCredentials( &xNetworkCredentials );
     configASSERT( ulStatus == 0 );
 
+    ulStatus = ( uint32_t ) Sockets_Init();
+    configASSERT( ulStatus == 0 );
+
+    /* Resolve the first endpoint while the rest of the demo is set up. */
+    #ifdef democonfigENABLE_DPS_SAMPLE
+        Sockets_Prefetch( democonfigENDPOINT );
+    #else
+        Sockets_Prefetch( democonfigHOSTNAME );
+    #endif /* democonfigENABLE_DPS_SAMPLE */
+
     #ifdef democonfigENABLE_DPS_SAMPLE
         /* Run DPS.  */
         if( ( ulStatus = prvIoTHubInfoGet( &xNetworkCredentials, &pucIotHubHostname,
@@ -354,6 +415,9 @@ static void prvAzureDemoTask( void * pvParameters )
 
     xNetworkContext.pParams = &xTlsTransportParams;
 
+    /* Commands and their responses are small and waited on. */
+    xTlsTransportParams.xTrafficClass = eTransportTrafficClassControl;
+
     for( ; ; )
     {
         if( xAzureSample_IsConnectedToInternet() )
@@ -402,10 +466,12 @@ static void prvAzureDemoTask( void * pvParameters )
              * and waits for connection acknowledgment (CONNACK) packet. */
             LogInfo( ( "Creating an MQTT connection to %s.\r\n", pucIotHubHostname ) );
 
+            xMqttConnectStart = xTaskGetTickCount();
             xResult = AzureIoTHubClient_Connect( &xAzureIoTHubClient,
                                                  false, &xSessionPresent,
                                                  sampleazureiotCONNACK_RECV_TIMEOUT_MS );
             configASSERT( xResult == eAzureIoTSuccess );
+            ulMqttConnectMs = ( uint32_t ) ( ( xTaskGetTickCount() - xMqttConnectStart ) * portTICK_PERIOD_MS );
 
             xResult = AzureIoTHubClient_SubscribeCloudToDeviceMessage( &xAzureIoTHubClient, prvHandleCloudMessage,
                                                                        &xAzureIoTHubClient, sampleazureiotSUBSCRIBE_TIMEOUT );
@@ -444,6 +510,10 @@ static void prvAzureDemoTask( void * pvParameters )
                                                         ( uint8_t * ) "value", sizeof( "value" ) - 1 );
             configASSERT( xResult == eAzureIoTSuccess );
 
+            /* Report how long this connection took to set up. */
+            xResult = prvSendConnectDiagnostics( &xNetworkContext, ulMqttConnectMs, &xPropertyBag );
+            configASSERT( xResult == eAzureIoTSuccess );
+
             /* Publish messages with QoS1, send and process Keep alive messages. */
             for( lPublishCount = 0;
                  lPublishCount < lMaxPublishCount && xAzureSample_IsConnectedToInternet();
@@ -669,6 +739,40 @@ static uint32_t prvConnectToServerWithBackoffRetries( const char * pcHostName,
 }
 /*-----------------------------------------------------------*/
 
+static AzureIoTResult_t prvSendConnectDiagnostics( NetworkContext_t * pxNetworkContext,
+                                                   uint32_t ulMqttConnectMs,
+                                                   AzureIoTMessageProperties_t * pxPropertyBag )
+{
+    TlsTransportConnectStats_t xConnectStats;
+    TlsTransportSendStats_t xSendStats;
+    TlsTransportRecvStats_t xRecvStats;
+    uint32_t ulLength;
+
+    TLS_Socket_GetConnectStats( pxNetworkContext, &xConnectStats );
+    TLS_Socket_GetSendStats( pxNetworkContext, &xSendStats );
+    TLS_Socket_GetRecvStats( pxNetworkContext, &xRecvStats );
+
+    ulLength = snprintf( ( char * ) ucDiagnosticsBuffer, sizeof( ucDiagnosticsBuffer ),
+                         sampleazureiotDIAGNOSTICS_MESSAGE,
+                         ( unsigned int ) xConnectStats.ulDnsMs,
+                         ( unsigned int ) xConnectStats.ulTcpConnectMs,
+                         ( unsigned int ) xConnectStats.ulHandshakeMs,
+                         ( unsigned int ) ulMqttConnectMs,
+                         ( xConnectStats.pcCipherSuite != NULL ) ? xConnectStats.pcCipherSuite : "",
+                         ( xConnectStats.xSessionResumed == pdTRUE ) ? "true" : "false",
+                         ( unsigned int ) xSendStats.ulRecords,
+                         ( unsigned int ) xSendStats.ullWireBytes,
+                         ( unsigned int ) xRecvStats.ulRecords,
+                         ( unsigned int ) xRecvStats.ullWireBytes );
+
+    LogInfo( ( "Connect diagnostics: %.*s\r\n", ( int ) ulLength, ucDiagnosticsBuffer ) );
+
+    return AzureIoTHubClient_SendTelemetry( &xAzureIoTHubClient,
+                                            ucDiagnosticsBuffer, ulLength,
+                                            pxPropertyBag, eAzureIoTHubMessageQoS1, NULL );
+}
+/*-----------------------------------------------------------*/
+
 /*
  * @brief Create the task that demonstrates the AzureIoTHub demo
  */
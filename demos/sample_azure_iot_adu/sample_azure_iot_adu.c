@@ -28,12 +28,20 @@
 #include "transport_tls_socket.h"
 #include "transport_socket.h"
 
+/* Keep-alive HTTP download of the update image. */
+#include "sample_azure_iot_adu_download.h"
+
 /* Crypto helper header. */
 #include "azure_sample_crypto.h"
 
 /* Demo Specific configs. */
 #include "demo_config.h"
 
+/* DER credentials generated from demo_config.h by tools/pem_to_der.py. */
+#ifdef democonfigUSE_DER_CREDENTIALS
+    #include "demo_config_der.h"
+#endif
+
 /* Demo Specific Interface Functions. */
 #include "azure_sample_connection.h"
 
@@ -137,6 +145,22 @@
  */
 #define ADU_HEADER_BUFFER_SIZE                                512
 
+/**
+ * @brief Ports of the HTTP and HTTPS servers the update image is downloaded from.
+ */
+#define sampleaduHTTP_PORT                                    ( 80 )
+#define sampleaduHTTPS_PORT                                   ( 443 )
+
+/**
+ * @brief Root CAs for HTTPS image downloads. democonfigADU_ROOT_CA_PEM can name
+ * others than those of the IoT Hub.
+ */
+#ifdef democonfigADU_ROOT_CA_PEM
+    #define sampleaduHTTPS_ROOT_CA_PEM                        democonfigADU_ROOT_CA_PEM
+#else
+    #define sampleaduHTTPS_ROOT_CA_PEM                        democonfigROOT_CA_PEM
+#endif
+
 #define democonfigADU_UPDATE_ID                               "{\"provider\":\"" democonfigADU_UPDATE_PROVIDER "\",\"name\":\"" democonfigADU_UPDATE_NAME "\",\"version\":\"" democonfigADU_UPDATE_VERSION "\"}"
 
 #ifdef democonfigADU_UPDATE_NEW_VERSION
@@ -345,6 +369,19 @@ static void prvHandleProperties( AzureIoTHubClientPropertiesResponse_t * pxMessa
 }
 /*-----------------------------------------------------------*/
 
+#ifdef democonfigUSE_DER_CREDENTIALS
+    static const uint8_t ucRootCaDer[] = democonfigROOT_CA_DER;
+    #ifdef democonfigADU_ROOT_CA_DER
+        static const uint8_t ucHttpsRootCaDer[] = democonfigADU_ROOT_CA_DER;
+    #else
+        #define ucHttpsRootCaDer    ucRootCaDer
+    #endif
+    #ifdef democonfigCLIENT_CERTIFICATE_DER
+        static const uint8_t ucClientCertDer[] = democonfigCLIENT_CERTIFICATE_DER;
+        static const uint8_t ucPrivateKeyDer[] = democonfigCLIENT_PRIVATE_KEY_DER;
+    #endif
+#endif /* democonfigUSE_DER_CREDENTIALS */
+
 /**
  * @brief Setup transport credentials.
  */
@@ -352,38 +389,37 @@ static uint32_t prvSetupNetworkCredentials( NetworkCredentials_t * pxNetworkCred
 {
     pxNetworkCredentials->xDisableSni = pdFALSE;
     /* Set the credentials for establishing a TLS connection. */
-    pxNetworkCredentials->pucRootCa = ( const unsigned char * ) democonfigROOT_CA_PEM;
-    pxNetworkCredentials->xRootCaSize = sizeof( democonfigROOT_CA_PEM );
-    #ifdef democonfigCLIENT_CERTIFICATE_PEM
-        pxNetworkCredentials->pucClientCert = ( const unsigned char * ) democonfigCLIENT_CERTIFICATE_PEM;
-        pxNetworkCredentials->xClientCertSize = sizeof( democonfigCLIENT_CERTIFICATE_PEM );
-        pxNetworkCredentials->pucPrivateKey = ( const unsigned char * ) democonfigCLIENT_PRIVATE_KEY_PEM;
-        pxNetworkCredentials->xPrivateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
-    #endif
+    #ifdef democonfigUSE_DER_CREDENTIALS
+        pxNetworkCredentials->pucRootCa = ucRootCaDer;
+        pxNetworkCredentials->xRootCaSize = sizeof( ucRootCaDer );
+        pxNetworkCredentials->xRootCaFormat = eTlsCredentialFormatDer;
+        #ifdef democonfigCLIENT_CERTIFICATE_DER
+            pxNetworkCredentials->pucClientCert = ucClientCertDer;
+            pxNetworkCredentials->xClientCertSize = sizeof( ucClientCertDer );
+            pxNetworkCredentials->xClientCertFormat = eTlsCredentialFormatDer;
+            pxNetworkCredentials->pucPrivateKey = ucPrivateKeyDer;
+            pxNetworkCredentials->xPrivateKeySize = sizeof( ucPrivateKeyDer );
+            pxNetworkCredentials->xPrivateKeyFormat = eTlsCredentialFormatDer;
+        #endif
+    #else
+        pxNetworkCredentials->pucRootCa = ( const unsigned char * ) democonfigROOT_CA_PEM;
+        pxNetworkCredentials->xRootCaSize = sizeof( democonfigROOT_CA_PEM );
+        #ifdef democonfigCLIENT_CERTIFICATE_PEM
+            pxNetworkCredentials->pucClientCert = ( const unsigned char * ) democonfigCLIENT_CERTIFICATE_PEM;
+            pxNetworkCredentials->xClientCertSize = sizeof( democonfigCLIENT_CERTIFICATE_PEM );
+            pxNetworkCredentials->pucPrivateKey = ( const unsigned char * ) democonfigCLIENT_PRIVATE_KEY_PEM;
+            pxNetworkCredentials->xPrivateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
+        #endif
+    #endif /* democonfigUSE_DER_CREDENTIALS */
 
     return 0;
 }
 /*-----------------------------------------------------------*/
 
-static void prvConnectHTTP( AzureIoTTransportInterface_t * pxHTTPTransport,
-                            const char * pucURL )
-{
-    SocketTransportStatus_t xStatus;
-    TickType_t xRecvTimeout = sampleazureiotTRANSPORT_SEND_RECV_TIMEOUT_MS;
-    TickType_t xSendTimeout = sampleazureiotTRANSPORT_SEND_RECV_TIMEOUT_MS;
-
-    LogInfo( ( "Connecting socket to %s", pucURL ) );
-    xStatus = Azure_Socket_Connect( pxHTTPTransport->pxNetworkContext, pucURL, 80, xRecvTimeout, xSendTimeout );
-
-    LogInfo( ( " xStatus: %i", xStatus ) );
-
-    configASSERT( xStatus == eSocketTransportSuccess );
-}
-
 /**
- * @brief Parses the full ADU file URL into a host (FQDN) and its path.
+ * @brief Parses the full ADU file URL into its scheme, host (FQDN) and path.
  *
- * @param xFileUrl ADU file Url to be parsed.
+ * @param xFileUrl ADU file Url to be parsed, starting with http:// or https://.
  * @param pucBuffer Buffer to be used for pxHost and pxPath.
  * @param ulBufferSize Size of pucBuffer
  * @param pucHost Where the host part of the url is stored, including a null terminator.
@@ -392,6 +428,7 @@ static void prvConnectHTTP( AzureIoTTransportInterface_t * pxHTTPTransport,
  * @param pulHostLength The length of the content pointed by pucHost.
  * @param pucPath Where the path part of the url is stored.
  * @param pulPathLength The length of the content pointed by pucPath.
+ * @param pxHttps Set to pdTRUE for an https:// URL, pdFALSE for an http:// one.
  */
 static void prvParseAduFileUrl( AzureIoTADUUpdateManifestFileUrl_t xFileUrl,
                                 uint8_t * pucBuffer,
@@ -399,12 +436,17 @@ static void prvParseAduFileUrl( AzureIoTADUUpdateManifestFileUrl_t xFileUrl,
                                 uint8_t ** pucHost,
                                 uint32_t * pulHostLength,
                                 uint8_t ** pucPath,
-                                uint32_t * pulPathLength )
+                                uint32_t * pulPathLength,
+                                BaseType_t * pxHttps )
 {
     configASSERT( ulBufferSize >= xFileUrl.ulUrlLength );
 
-    /* Skipping the http protocol prefix. */
-    uint8_t * pucUrl = xFileUrl.pucUrl + sizeof( "http://" ) - 1;
+    *pxHttps = ( ( xFileUrl.ulUrlLength > sizeof( "https://" ) - 1 ) &&
+                 ( strncmp( ( const char * ) xFileUrl.pucUrl, "https://", sizeof( "https://" ) - 1 ) == 0 ) ) ? pdTRUE : pdFALSE;
+    uint32_t ulPrefixLength = ( *pxHttps == pdTRUE ) ? sizeof( "https://" ) - 1 : sizeof( "http://" ) - 1;
+
+    /* Skipping the protocol prefix. */
+    uint8_t * pucUrl = xFileUrl.pucUrl + ulPrefixLength;
     char * pcPathStart = strstr( ( const char * ) pucUrl, "/" );
     configASSERT( pcPathStart != NULL );
 
@@ -413,8 +455,8 @@ static void prvParseAduFileUrl( AzureIoTADUUpdateManifestFileUrl_t xFileUrl,
     *pulHostLength = pcPathStart - ( char * ) pucUrl + 1;
     *pucPath = pucBuffer + *pulHostLength;
 
-    /* Discouting the size of host and http prefix from ulUrlLength */
-    *pulPathLength = xFileUrl.ulUrlLength - ( *pulHostLength - 1 ) - ( sizeof( "http://" ) - 1 );
+    /* Discouting the size of host and protocol prefix from ulUrlLength */
+    *pulPathLength = xFileUrl.ulUrlLength - ( *pulHostLength - 1 ) - ulPrefixLength;
 
     ( void ) memcpy( *pucHost, pucUrl, *pulHostLength - 1 );
     ( void ) memset( *pucHost + *pulHostLength - 1, 0, 1 );
@@ -424,8 +466,6 @@ static void prvParseAduFileUrl( AzureIoTADUUpdateManifestFileUrl_t xFileUrl,
 static AzureIoTResult_t prvDownloadUpdateImageIntoFlash( int32_t ullTimeoutInSec )
 {
     AzureIoTResult_t xResult;
-    AzureIoTHTTPResult_t xHttpResult;
-    AzureIoTHTTP_t xHTTP;
     char * pucOutDataPtr;
     uint32_t ulOutHttpDataBufferLength;
     uint8_t * pucFileUrlHost;
@@ -434,18 +474,26 @@ static AzureIoTResult_t prvDownloadUpdateImageIntoFlash( int32_t ullTimeoutInSec
     uint32_t ulFileUrlPathLength;
     uint64_t ullPreviousTimeout;
     uint64_t ullCurrentTime;
+    BaseType_t xHttps;
+    SampleADUDownloadStats_t xDownloadStats;
+    uint32_t ulElapsedMs;
 
-    /*HTTP Connection */
-    AzureIoTTransportInterface_t xHTTPTransport;
+    /* HTTP connection, kept open for all the range requests of the image. */
+    SampleADUDownload_t xDownload;
     NetworkContext_t xHTTPNetworkContext = { 0 };
     SocketTransportParams_t xHTTPSocketTransportParams = { 0 };
+    TlsTransportParams_t xHTTPSTlsTransportParams = { 0 };
+    NetworkCredentials_t xHTTPSCredentials = { 0 };
 
-    /* Fill in Transport Interface send and receive function pointers. */
-    xHTTPTransport.pxNetworkContext = &xHTTPNetworkContext;
-    xHTTPTransport.xSend = Azure_Socket_Send;
-    xHTTPTransport.xRecv = Azure_Socket_Recv;
-
-    xHTTPNetworkContext.pParams = &xHTTPSocketTransportParams;
+    /* Resolve the download host while the platform is initialized. The url
+     * is parsed again below, as sending the agent state reuses the buffer. */
+    prvParseAduFileUrl(
+        xAzureIoTAduUpdateRequest.pxFileUrls[ 0 ],
+        ucScratchBuffer, sizeof( ucScratchBuffer ),
+        &pucFileUrlHost, &ulFileUrlHostLength,
+        &pucFileUrlPath, &ulFileUrlPathLength,
+        &xHttps );
+    Sockets_Prefetch( ( const char * ) pucFileUrlHost );
 
     xResult = AzureIoTPlatform_Init( &xImage );
 
@@ -469,38 +517,54 @@ static AzureIoTResult_t prvDownloadUpdateImageIntoFlash( int32_t ullTimeoutInSec
                                                 sizeof( ucScratchBuffer ),
                                                 NULL );
 
-    LogInfo( ( "[ADU] Invoke HTTP Connect Callback." ) );
-
     prvParseAduFileUrl(
         xAzureIoTAduUpdateRequest.pxFileUrls[ 0 ],
         ucScratchBuffer, sizeof( ucScratchBuffer ),
         &pucFileUrlHost, &ulFileUrlHostLength,
-        &pucFileUrlPath, &ulFileUrlPathLength );
+        &pucFileUrlPath, &ulFileUrlPathLength,
+        &xHttps );
 
-    prvConnectHTTP( &xHTTPTransport, ( const char * ) pucFileUrlHost );
+    /* The image is downloaded in large responses. */
+    xHTTPSTlsTransportParams.xTrafficClass = eTransportTrafficClassBulk;
+    xHTTPSocketTransportParams.xTrafficClass = eTransportTrafficClassBulk;
 
-    /* Range Check */
-    xHttpResult = AzureIoTHTTP_RequestSizeInit( &xHTTP, &xHTTPTransport,
-                                                ( const char * ) pucFileUrlHost,
-                                                ulFileUrlHostLength - 1, /* minus the null-terminator. */
-                                                ( const char * ) pucFileUrlPath,
-                                                ulFileUrlPathLength,
-                                                ( char * ) ucAduDownloadHeaderBuffer,
-                                                sizeof( ucAduDownloadHeaderBuffer ) );
-
-    if( xHttpResult != eAzureIoTHTTPSuccess )
+    if( xHttps == pdTRUE )
     {
-        return eAzureIoTErrorFailed;
+        #ifdef democonfigUSE_DER_CREDENTIALS
+            xHTTPSCredentials.pucRootCa = ucHttpsRootCaDer;
+            xHTTPSCredentials.xRootCaSize = sizeof( ucHttpsRootCaDer );
+            xHTTPSCredentials.xRootCaFormat = eTlsCredentialFormatDer;
+        #else
+            xHTTPSCredentials.pucRootCa = ( const unsigned char * ) sampleaduHTTPS_ROOT_CA_PEM;
+            xHTTPSCredentials.xRootCaSize = sizeof( sampleaduHTTPS_ROOT_CA_PEM );
+        #endif
+        xHTTPNetworkContext.pParams = &xHTTPSTlsTransportParams;
     }
+    else
+    {
+        xHTTPNetworkContext.pParams = &xHTTPSocketTransportParams;
+    }
+
+    SampleADUDownload_Init( &xDownload, &xHTTPNetworkContext,
+                            ( xHttps == pdTRUE ) ? &xHTTPSCredentials : NULL,
+                            ( const char * ) pucFileUrlHost,
+                            ulFileUrlHostLength - 1, /* minus the null-terminator. */
+                            ( const char * ) pucFileUrlPath,
+                            ulFileUrlPathLength,
+                            ( xHttps == pdTRUE ) ? sampleaduHTTPS_PORT : sampleaduHTTP_PORT,
+                            ( char * ) ucAduDownloadHeaderBuffer,
+                            sizeof( ucAduDownloadHeaderBuffer ) );
 
-    if( ( xImage.ulImageFileSize = AzureIoTHTTP_RequestSize( &xHTTP, ( char * ) ucAduDownloadBuffer,
-                                                             sizeof( ucAduDownloadBuffer ) ) ) != -1 )
+    /* Range Check */
+    if( ( xImage.ulImageFileSize = SampleADUDownload_GetSize( &xDownload, ( char * ) ucAduDownloadBuffer,
+                                                              sizeof( ucAduDownloadBuffer ) ) ) != -1 )
     {
-        LogInfo( ( "[ADU] HTTP Range Request was successful: size %u bytes", ( uint16_t ) xImage.ulImageFileSize ) );
+        LogInfo( ( "[ADU] HTTP Range Request was successful: size %u bytes", ( unsigned ) xImage.ulImageFileSize ) );
     }
     else
     {
         LogError( ( "[ADU] Error getting the headers. " ) );
+        SampleADUDownload_Deinit( &xDownload );
         return eAzureIoTErrorFailed;
     }
 
@@ -528,55 +592,49 @@ static AzureIoTResult_t prvDownloadUpdateImageIntoFlash( int32_t ullTimeoutInSec
             }
         }
 
-        AzureIoTHTTP_Init( &xHTTP, &xHTTPTransport,
-                           ( const char * ) pucFileUrlHost,
-                           ulFileUrlHostLength - 1, /* minus the null-terminator. */
-                           ( const char * ) pucFileUrlPath,
-                           ulFileUrlPathLength,
-                           ( char * ) ucAduDownloadHeaderBuffer,
-                           sizeof( ucAduDownloadHeaderBuffer ) );
-
-        if( ( xHttpResult = AzureIoTHTTP_Request( &xHTTP, xImage.ulCurrentOffset,
-                                                  xImage.ulCurrentOffset + democonfigCHUNK_DOWNLOAD_SIZE - 1,
-                                                  ( char * ) ucAduDownloadBuffer,
-                                                  sizeof( ucAduDownloadBuffer ),
-                                                  &pucOutDataPtr,
-                                                  &ulOutHttpDataBufferLength ) ) == eAzureIoTHTTPSuccess )
+        /* Server side closes are handled by the downloader, which reconnects
+         * and repeats the request. */
+        if( SampleADUDownload_GetRange( &xDownload, xImage.ulCurrentOffset,
+                                        xImage.ulCurrentOffset + democonfigCHUNK_DOWNLOAD_SIZE - 1,
+                                        ( char * ) ucAduDownloadBuffer,
+                                        sizeof( ucAduDownloadBuffer ),
+                                        &pucOutDataPtr,
+                                        &ulOutHttpDataBufferLength ) != eAzureIoTSuccess )
         {
-            /* Write bytes to the flash */
-            xResult = AzureIoTPlatform_WriteBlock( &xImage,
-                                                   ( uint32_t ) xImage.ulCurrentOffset,
-                                                   ( uint8_t * ) pucOutDataPtr,
-                                                   ulOutHttpDataBufferLength );
-
-            if( xResult != eAzureIoTSuccess )
-            {
-                LogError( ( "[ADU] Error writing to flash." ) );
-                return eAzureIoTErrorFailed;
-            }
-
-            /* Advance the offset */
-            xImage.ulCurrentOffset += ( int32_t ) ulOutHttpDataBufferLength;
+            LogError( ( "[ADU] Failed to download the image at offset %u.", ( unsigned ) xImage.ulCurrentOffset ) );
+            SampleADUDownload_Deinit( &xDownload );
+            return eAzureIoTErrorFailed;
         }
-        else if( xHttpResult == eAzureIoTHTTPNoResponse )
-        {
-            LogInfo( ( "[ADU] Reconnecting..." ) );
-            LogInfo( ( "[ADU] Invoke HTTP Connect Callback." ) );
-            prvConnectHTTP( &xHTTPTransport, ( const char * ) pucFileUrlHost );
 
-            if( xResult != eAzureIoTSuccess )
-            {
-                LogError( ( "[ADU] Failed to reconnect to HTTP server!" ) );
-                return eAzureIoTErrorFailed;
-            }
-        }
-        else
+        /* Write bytes to the flash */
+        xResult = AzureIoTPlatform_WriteBlock( &xImage,
+                                               ( uint32_t ) xImage.ulCurrentOffset,
+                                               ( uint8_t * ) pucOutDataPtr,
+                                               ulOutHttpDataBufferLength );
+
+        if( xResult != eAzureIoTSuccess )
         {
-            break;
+            LogError( ( "[ADU] Error writing to flash." ) );
+            SampleADUDownload_Deinit( &xDownload );
+            return eAzureIoTErrorFailed;
         }
+
+        /* Advance the offset */
+        xImage.ulCurrentOffset += ( int32_t ) ulOutHttpDataBufferLength;
     }
 
-    AzureIoTHTTP_Deinit( &xHTTP );
+    SampleADUDownload_GetStats( &xDownload, &xDownloadStats );
+    SampleADUDownload_Deinit( &xDownload );
+
+    ulElapsedMs = ( uint32_t ) ( xDownloadStats.xElapsed * portTICK_PERIOD_MS );
+    LogInfo( ( "[ADU] Downloaded %u bytes over %s in %u ms (%u KB/s) with %u requests over %u connection(s), %u reconnect(s).",
+               ( unsigned ) xDownloadStats.ullBytes,
+               ( xHttps == pdTRUE ) ? "HTTPS" : "HTTP",
+               ( unsigned ) ulElapsedMs,
+               ( unsigned ) ( ulElapsedMs > 0U ? ( xDownloadStats.ullBytes / ulElapsedMs ) : 0U ),
+               ( unsigned ) xDownloadStats.ulRequests,
+               ( unsigned ) xDownloadStats.ulConnections,
+               ( unsigned ) xDownloadStats.ulReconnects ) );
 
     return eAzureIoTSuccess;
 }
@@ -740,6 +798,16 @@ static void prvAzureDemoTask( void * pvParameters )
     ulStatus = prvSetupNetworkCredentials( &xNetworkCredentials );
     configASSERT( ulStatus == 0 );
 
+    ulStatus = ( uint32_t ) Sockets_Init();
+    configASSERT( ulStatus == 0 );
+
+    /* Resolve the first endpoint while the rest of the demo is set up. */
+    #ifdef democonfigENABLE_DPS_SAMPLE
+        Sockets_Prefetch( democonfigENDPOINT );
+    #else
+        Sockets_Prefetch( democonfigHOSTNAME );
+    #endif /* democonfigENABLE_DPS_SAMPLE */
+
     #ifdef democonfigENABLE_DPS_SAMPLE
         /* Run DPS.  */
         if( ( ulStatus = prvIoTHubInfoGet( &xNetworkCredentials, &pucIotHubHostname,
@@ -753,6 +821,9 @@ static void prvAzureDemoTask( void * pvParameters )
 
     xNetworkContext.pParams = &xTlsTransportParams;
 
+    /* Commands and their responses are small and waited on. */
+    xTlsTransportParams.xTrafficClass = eTransportTrafficClassControl;
+
     for( ; ; )
     {
         if( xAzureSample_IsConnectedToInternet() )
@@ -0,0 +1,268 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+#include "sample_azure_iot_adu_download.h"
+
+/* Standard includes. */
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Transport interface implementation include header for plaintext sockets. */
+#include "transport_socket.h"
+
+/* Demo Specific configs. */
+#include "demo_config.h"
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvConnect( SampleADUDownload_t * pxDownload,
+                              BaseType_t xAfterFailure )
+{
+    int32_t lStatus;
+
+    LogInfo( ( "[ADU] Connecting %s to %s:%u", pxDownload->pxCredentials != NULL ? "TLS" : "socket",
+               pxDownload->pcHost, pxDownload->usPort ) );
+
+    if( pxDownload->pxCredentials != NULL )
+    {
+        /* The transport offers the session cached for the host, if any. */
+        lStatus = ( TLS_Socket_Connect( pxDownload->xTransport.pxNetworkContext,
+                                        pxDownload->pcHost,
+                                        pxDownload->usPort,
+                                        pxDownload->pxCredentials,
+                                        sampleaduDOWNLOAD_SEND_RECV_TIMEOUT_MS,
+                                        sampleaduDOWNLOAD_SEND_RECV_TIMEOUT_MS ) == eTLSTransportSuccess ) ? 0 : -1;
+    }
+    else
+    {
+        lStatus = ( Azure_Socket_Connect( pxDownload->xTransport.pxNetworkContext,
+                                          pxDownload->pcHost,
+                                          pxDownload->usPort,
+                                          sampleaduDOWNLOAD_SEND_RECV_TIMEOUT_MS,
+                                          sampleaduDOWNLOAD_SEND_RECV_TIMEOUT_MS ) == eSocketTransportSuccess ) ? 0 : -1;
+    }
+
+    if( lStatus == 0 )
+    {
+        pxDownload->xConnected = pdTRUE;
+        pxDownload->ulConnectionRequests = 0;
+        pxDownload->xStats.ulConnections++;
+
+        if( xAfterFailure == pdTRUE )
+        {
+            pxDownload->xStats.ulReconnects++;
+        }
+    }
+    else
+    {
+        LogError( ( "[ADU] Failed to connect to %s.", pxDownload->pcHost ) );
+    }
+
+    return pxDownload->xConnected;
+}
+/*-----------------------------------------------------------*/
+
+static void prvClose( SampleADUDownload_t * pxDownload )
+{
+    if( pxDownload->xConnected == pdTRUE )
+    {
+        if( pxDownload->pxCredentials != NULL )
+        {
+            TLS_Socket_Disconnect( pxDownload->xTransport.pxNetworkContext );
+        }
+        else
+        {
+            Azure_Socket_Close( pxDownload->xTransport.pxNetworkContext );
+        }
+
+        pxDownload->xConnected = pdFALSE;
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Open the connection when there is none, or when the current one has served
+ * its maximum number of requests. */
+static BaseType_t prvEnsureConnected( SampleADUDownload_t * pxDownload,
+                                      BaseType_t xAfterFailure )
+{
+    if( ( pxDownload->xConnected == pdTRUE ) &&
+        ( pxDownload->ulMaxRequestsPerConnection != 0U ) &&
+        ( pxDownload->ulConnectionRequests >= pxDownload->ulMaxRequestsPerConnection ) )
+    {
+        prvClose( pxDownload );
+    }
+
+    if( pxDownload->xConnected == pdFALSE )
+    {
+        ( void ) prvConnect( pxDownload, xAfterFailure );
+    }
+
+    return pxDownload->xConnected;
+}
+/*-----------------------------------------------------------*/
+
+/* A request that failed leaves the connection in an unknown state: the server
+ * may have closed it, or part of a response may still be in flight. Drop it so
+ * the next attempt starts on a fresh one. */
+static void prvRequestFailed( SampleADUDownload_t * pxDownload,
+                              AzureIoTHTTPResult_t xHttpResult )
+{
+    LogInfo( ( "[ADU] HTTP request failed on request %u of the connection: %d. Reconnecting.",
+               ( unsigned ) pxDownload->ulConnectionRequests, xHttpResult ) );
+
+    pxDownload->xStats.ulFailedRequests++;
+    prvClose( pxDownload );
+}
+/*-----------------------------------------------------------*/
+
+void SampleADUDownload_Init( SampleADUDownload_t * pxDownload,
+                             NetworkContext_t * pxNetworkContext,
+                             const NetworkCredentials_t * pxCredentials,
+                             const char * pcHost,
+                             uint32_t ulHostLength,
+                             const char * pcPath,
+                             uint32_t ulPathLength,
+                             uint16_t usPort,
+                             char * pcHeaderBuffer,
+                             uint32_t ulHeaderBufferLength )
+{
+    ( void ) memset( pxDownload, 0, sizeof( *pxDownload ) );
+
+    pxDownload->xTransport.pxNetworkContext = pxNetworkContext;
+    pxDownload->pxCredentials = pxCredentials;
+
+    if( pxCredentials != NULL )
+    {
+        pxDownload->xTransport.xSend = TLS_Socket_Send;
+        pxDownload->xTransport.xRecv = TLS_Socket_Recv;
+    }
+    else
+    {
+        pxDownload->xTransport.xSend = Azure_Socket_Send;
+        pxDownload->xTransport.xRecv = Azure_Socket_Recv;
+    }
+
+    pxDownload->pcHost = pcHost;
+    pxDownload->ulHostLength = ulHostLength;
+    pxDownload->pcPath = pcPath;
+    pxDownload->ulPathLength = ulPathLength;
+    pxDownload->usPort = usPort;
+    pxDownload->pcHeaderBuffer = pcHeaderBuffer;
+    pxDownload->ulHeaderBufferLength = ulHeaderBufferLength;
+    pxDownload->xConnected = pdFALSE;
+    pxDownload->xStart = xTaskGetTickCount();
+}
+/*-----------------------------------------------------------*/
+
+int32_t SampleADUDownload_GetSize( SampleADUDownload_t * pxDownload,
+                                   char * pcBuffer,
+                                   uint32_t ulBufferLength )
+{
+    AzureIoTHTTPResult_t xHttpResult;
+    int32_t lSize = -1;
+    uint32_t ulAttempt;
+
+    for( ulAttempt = 0; ( ulAttempt < sampleaduDOWNLOAD_REQUEST_ATTEMPTS ) && ( lSize == -1 ); ulAttempt++ )
+    {
+        if( prvEnsureConnected( pxDownload, ulAttempt > 0U ? pdTRUE : pdFALSE ) == pdFALSE )
+        {
+            continue;
+        }
+
+        xHttpResult = AzureIoTHTTP_RequestSizeInit( &pxDownload->xHTTP, &pxDownload->xTransport,
+                                                    pxDownload->pcHost,
+                                                    pxDownload->ulHostLength,
+                                                    pxDownload->pcPath,
+                                                    pxDownload->ulPathLength,
+                                                    pxDownload->pcHeaderBuffer,
+                                                    pxDownload->ulHeaderBufferLength );
+
+        if( xHttpResult == eAzureIoTHTTPSuccess )
+        {
+            lSize = AzureIoTHTTP_RequestSize( &pxDownload->xHTTP, pcBuffer, ulBufferLength );
+            pxDownload->ulConnectionRequests++;
+        }
+
+        if( lSize != -1 )
+        {
+            pxDownload->xStats.ulRequests++;
+        }
+        else
+        {
+            prvRequestFailed( pxDownload, xHttpResult );
+        }
+    }
+
+    return lSize;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t SampleADUDownload_GetRange( SampleADUDownload_t * pxDownload,
+                                             uint32_t ulRangeStart,
+                                             uint32_t ulRangeEnd,
+                                             char * pcBuffer,
+                                             uint32_t ulBufferLength,
+                                             char ** ppcData,
+                                             uint32_t * pulDataLength )
+{
+    AzureIoTResult_t xResult = eAzureIoTErrorFailed;
+    AzureIoTHTTPResult_t xHttpResult;
+    uint32_t ulAttempt;
+
+    for( ulAttempt = 0; ( ulAttempt < sampleaduDOWNLOAD_REQUEST_ATTEMPTS ) && ( xResult != eAzureIoTSuccess ); ulAttempt++ )
+    {
+        if( prvEnsureConnected( pxDownload, ulAttempt > 0U ? pdTRUE : pdFALSE ) == pdFALSE )
+        {
+            continue;
+        }
+
+        /* The request headers are rebuilt for each range; the connection
+         * under them is kept. */
+        xHttpResult = AzureIoTHTTP_Init( &pxDownload->xHTTP, &pxDownload->xTransport,
+                                         pxDownload->pcHost,
+                                         pxDownload->ulHostLength,
+                                         pxDownload->pcPath,
+                                         pxDownload->ulPathLength,
+                                         pxDownload->pcHeaderBuffer,
+                                         pxDownload->ulHeaderBufferLength );
+
+        if( xHttpResult == eAzureIoTHTTPSuccess )
+        {
+            xHttpResult = AzureIoTHTTP_Request( &pxDownload->xHTTP, ulRangeStart, ulRangeEnd,
+                                                pcBuffer, ulBufferLength,
+                                                ppcData, pulDataLength );
+            pxDownload->ulConnectionRequests++;
+        }
+
+        if( xHttpResult == eAzureIoTHTTPSuccess )
+        {
+            xResult = eAzureIoTSuccess;
+            pxDownload->xStats.ulRequests++;
+            pxDownload->xStats.ullBytes += *pulDataLength;
+        }
+        else
+        {
+            prvRequestFailed( pxDownload, xHttpResult );
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+void SampleADUDownload_Deinit( SampleADUDownload_t * pxDownload )
+{
+    AzureIoTHTTP_Deinit( &pxDownload->xHTTP );
+    prvClose( pxDownload );
+}
+/*-----------------------------------------------------------*/
+
+void SampleADUDownload_GetStats( const SampleADUDownload_t * pxDownload,
+                                 SampleADUDownloadStats_t * pxStats )
+{
+    *pxStats = pxDownload->xStats;
+    pxStats->xElapsed = xTaskGetTickCount() - pxDownload->xStart;
+}
+/*-----------------------------------------------------------*/
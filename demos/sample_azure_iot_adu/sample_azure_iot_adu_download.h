@@ -0,0 +1,160 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sample_azure_iot_adu_download.h
+ * @brief HTTP range downloads of an ADU update image over one keep-alive
+ * connection.
+ *
+ * All the range requests of an image go over the same HTTP/1.1 connection.
+ * When the server closes it, or a request gets no response, the connection is
+ * opened again and the request repeated, without the caller noticing.
+ *
+ * Over HTTPS, the connection is made with the TLS transport, which resumes the
+ * session of the previous connection to the host from its session cache, so a
+ * reconnect skips the full handshake.
+ */
+
+#ifndef SAMPLE_AZURE_IOT_ADU_DOWNLOAD_H
+#define SAMPLE_AZURE_IOT_ADU_DOWNLOAD_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include "azure_iot_result.h"
+#include "azure_iot_http.h"
+#include "azure_iot_transport_interface.h"
+
+#include "transport_tls_socket.h"
+
+/**
+ * @brief Attempts at a request, reconnecting between them, before a download
+ * fails.
+ */
+#ifndef sampleaduDOWNLOAD_REQUEST_ATTEMPTS
+    #define sampleaduDOWNLOAD_REQUEST_ATTEMPTS    ( 3U )
+#endif
+
+/**
+ * @brief Transport timeout in milliseconds for send and receive on the
+ * download connection.
+ */
+#ifndef sampleaduDOWNLOAD_SEND_RECV_TIMEOUT_MS
+    #define sampleaduDOWNLOAD_SEND_RECV_TIMEOUT_MS    ( 5000U )
+#endif
+
+/**
+ * @brief Download counters, for one update image.
+ */
+typedef struct SampleADUDownloadStats
+{
+    uint32_t ulConnections;    /**< Connections opened, the first one included. */
+    uint32_t ulReconnects;     /**< Connections opened again after a request failed. */
+    uint32_t ulRequests;       /**< Range requests that succeeded. */
+    uint32_t ulFailedRequests; /**< Range requests that failed and were repeated. */
+    uint64_t ullBytes;         /**< Image bytes received. */
+    TickType_t xElapsed;       /**< Time since SampleADUDownload_Init. */
+} SampleADUDownloadStats_t;
+
+/**
+ * @brief Download of one image.
+ */
+typedef struct SampleADUDownload
+{
+    AzureIoTTransportInterface_t xTransport;    /**< Socket or TLS transport. */
+    const NetworkCredentials_t * pxCredentials; /**< TLS credentials, NULL for plain HTTP. */
+    AzureIoTHTTP_t xHTTP;                       /**< HTTP request in progress. */
+    const char * pcHost;                        /**< Null-terminated host name. */
+    uint32_t ulHostLength;                      /**< Length of pcHost, without the terminator. */
+    const char * pcPath;                        /**< Path of the image on the host. */
+    uint32_t ulPathLength;                      /**< Length of pcPath. */
+    uint16_t usPort;                            /**< HTTP port. */
+    char * pcHeaderBuffer;                      /**< Buffer for the request headers. */
+    uint32_t ulHeaderBufferLength;              /**< Size of pcHeaderBuffer. */
+    uint32_t ulMaxRequestsPerConnection;        /**< Requests after which the connection is opened again, 0 for no limit. */
+    uint32_t ulConnectionRequests;              /**< Requests sent on the current connection. */
+    BaseType_t xConnected;                      /**< Set while the connection is open. */
+    TickType_t xStart;                          /**< Time of SampleADUDownload_Init. */
+    SampleADUDownloadStats_t xStats;            /**< Counters. */
+} SampleADUDownload_t;
+
+/**
+ * @brief Prepare the download of an image. Nothing is sent until the first
+ * request.
+ *
+ * @param[out] pxDownload Download to initialize.
+ * @param[in] pxNetworkContext Network context, with its parameters set for the
+ * transport: SocketTransportParams_t for HTTP, TlsTransportParams_t for HTTPS.
+ * @param[in] pxCredentials TLS credentials for HTTPS, kept until
+ * SampleADUDownload_Deinit; NULL for HTTP.
+ * @param[in] pcHost Null-terminated host name, kept until SampleADUDownload_Deinit.
+ * @param[in] ulHostLength Length of pcHost, without the terminator.
+ * @param[in] pcPath Path of the image, kept until SampleADUDownload_Deinit.
+ * @param[in] ulPathLength Length of pcPath.
+ * @param[in] usPort HTTP port.
+ * @param[in] pcHeaderBuffer Buffer for the request headers.
+ * @param[in] ulHeaderBufferLength Size of pcHeaderBuffer.
+ */
+void SampleADUDownload_Init( SampleADUDownload_t * pxDownload,
+                             NetworkContext_t * pxNetworkContext,
+                             const NetworkCredentials_t * pxCredentials,
+                             const char * pcHost,
+                             uint32_t ulHostLength,
+                             const char * pcPath,
+                             uint32_t ulPathLength,
+                             uint16_t usPort,
+                             char * pcHeaderBuffer,
+                             uint32_t ulHeaderBufferLength );
+
+/**
+ * @brief Get the size of the image.
+ *
+ * @param[in] pxDownload Download.
+ * @param[in] pcBuffer Buffer for the response.
+ * @param[in] ulBufferLength Size of pcBuffer.
+ *
+ * @return Size of the image in bytes, or -1 on failure.
+ */
+int32_t SampleADUDownload_GetSize( SampleADUDownload_t * pxDownload,
+                                   char * pcBuffer,
+                                   uint32_t ulBufferLength );
+
+/**
+ * @brief Get a range of the image.
+ *
+ * @param[in] pxDownload Download.
+ * @param[in] ulRangeStart Offset of the first byte.
+ * @param[in] ulRangeEnd Offset of the last byte.
+ * @param[in] pcBuffer Buffer for the response.
+ * @param[in] ulBufferLength Size of pcBuffer.
+ * @param[out] ppcData Where the range starts in pcBuffer.
+ * @param[out] pulDataLength Length of the range received.
+ *
+ * @return eAzureIoTSuccess, or eAzureIoTErrorFailed once all attempts failed.
+ */
+AzureIoTResult_t SampleADUDownload_GetRange( SampleADUDownload_t * pxDownload,
+                                             uint32_t ulRangeStart,
+                                             uint32_t ulRangeEnd,
+                                             char * pcBuffer,
+                                             uint32_t ulBufferLength,
+                                             char ** ppcData,
+                                             uint32_t * pulDataLength );
+
+/**
+ * @brief Close the connection of the download.
+ *
+ * @param[in] pxDownload Download.
+ */
+void SampleADUDownload_Deinit( SampleADUDownload_t * pxDownload );
+
+/**
+ * @brief Get a copy of the download counters.
+ *
+ * @param[in] pxDownload Download.
+ * @param[out] pxStats Where the counters are copied.
+ */
+void SampleADUDownload_GetStats( const SampleADUDownload_t * pxDownload,
+                                 SampleADUDownloadStats_t * pxStats );
+
+#endif /* SAMPLE_AZURE_IOT_ADU_DOWNLOAD_H */
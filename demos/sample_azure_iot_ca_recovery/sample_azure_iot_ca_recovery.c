@@ -12,6 +12,11 @@
 /* Demo Specific configs. */
 #include "demo_config.h"
 
+/* DER credentials generated from demo_config.h by tools/pem_to_der.py. */
+#ifdef democonfigUSE_DER_CREDENTIALS
+    #include "demo_config_der.h"
+#endif
+
 /* Azure Provisioning/IoT Hub library includes */
 #include "azure_iot_hub_client.h"
 #include "azure_iot_provisioning_client.h"
@@ -284,6 +289,11 @@ static void prvHandlePropertiesMessage( AzureIoTHubClientPropertiesResponse_t *
 }
 /*-----------------------------------------------------------*/
 
+#if defined( democonfigUSE_DER_CREDENTIALS ) && defined( democonfigCLIENT_CERTIFICATE_DER )
+    static const uint8_t ucClientCertDer[] = democonfigCLIENT_CERTIFICATE_DER;
+    static const uint8_t ucPrivateKeyDer[] = democonfigCLIENT_PRIVATE_KEY_DER;
+#endif
+
 /**
  * @brief Setup transport credentials.
  */
@@ -302,15 +312,27 @@ static uint32_t prvSetupNetworkCredentials( NetworkCredentials_t * pxNetworkCred
     }
 
     pxNetworkCredentials->xDisableSni = pdFALSE;
-    /* Set the credentials for establishing a TLS connection. */
+    /* Set the credentials for establishing a TLS connection. The trust bundle
+     * is kept in PEM, also with DER credentials. */
     pxNetworkCredentials->pucRootCa = ( const unsigned char * ) ucRootCABuffer;
     pxNetworkCredentials->xRootCaSize = ulRootCABufferWrittenLength;
-    #ifdef democonfigCLIENT_CERTIFICATE_PEM
-        pxNetworkCredentials->pucClientCert = ( const unsigned char * ) democonfigCLIENT_CERTIFICATE_PEM;
-        pxNetworkCredentials->xClientCertSize = sizeof( democonfigCLIENT_CERTIFICATE_PEM );
-        pxNetworkCredentials->pucPrivateKey = ( const unsigned char * ) democonfigCLIENT_PRIVATE_KEY_PEM;
-        pxNetworkCredentials->xPrivateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
-    #endif
+    #ifdef democonfigUSE_DER_CREDENTIALS
+        #ifdef democonfigCLIENT_CERTIFICATE_DER
+            pxNetworkCredentials->pucClientCert = ucClientCertDer;
+            pxNetworkCredentials->xClientCertSize = sizeof( ucClientCertDer );
+            pxNetworkCredentials->xClientCertFormat = eTlsCredentialFormatDer;
+            pxNetworkCredentials->pucPrivateKey = ucPrivateKeyDer;
+            pxNetworkCredentials->xPrivateKeySize = sizeof( ucPrivateKeyDer );
+            pxNetworkCredentials->xPrivateKeyFormat = eTlsCredentialFormatDer;
+        #endif
+    #else
+        #ifdef democonfigCLIENT_CERTIFICATE_PEM
+            pxNetworkCredentials->pucClientCert = ( const unsigned char * ) democonfigCLIENT_CERTIFICATE_PEM;
+            pxNetworkCredentials->xClientCertSize = sizeof( democonfigCLIENT_CERTIFICATE_PEM );
+            pxNetworkCredentials->pucPrivateKey = ( const unsigned char * ) democonfigCLIENT_PRIVATE_KEY_PEM;
+            pxNetworkCredentials->xPrivateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
+        #endif
+    #endif /* democonfigUSE_DER_CREDENTIALS */
 
     return 0;
 }
@@ -323,12 +345,23 @@ static uint32_t prvSetupNetworkCredentials( NetworkCredentials_t * pxNetworkCred
 static uint32_t prvSetupRecoveryNetworkCredentials( NetworkCredentials_t * pxNetworkCredentials )
 {
     /* Don't set CA cert since we ignore CA validation on recovery */
-    #ifdef democonfigCLIENT_CERTIFICATE_PEM
-        pxNetworkCredentials->pucClientCert = ( const unsigned char * ) democonfigCLIENT_CERTIFICATE_PEM;
-        pxNetworkCredentials->xClientCertSize = sizeof( democonfigCLIENT_CERTIFICATE_PEM );
-        pxNetworkCredentials->pucPrivateKey = ( const unsigned char * ) democonfigCLIENT_PRIVATE_KEY_PEM;
-        pxNetworkCredentials->xPrivateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
-    #endif
+    #ifdef democonfigUSE_DER_CREDENTIALS
+        #ifdef democonfigCLIENT_CERTIFICATE_DER
+            pxNetworkCredentials->pucClientCert = ucClientCertDer;
+            pxNetworkCredentials->xClientCertSize = sizeof( ucClientCertDer );
+            pxNetworkCredentials->xClientCertFormat = eTlsCredentialFormatDer;
+            pxNetworkCredentials->pucPrivateKey = ucPrivateKeyDer;
+            pxNetworkCredentials->xPrivateKeySize = sizeof( ucPrivateKeyDer );
+            pxNetworkCredentials->xPrivateKeyFormat = eTlsCredentialFormatDer;
+        #endif
+    #else
+        #ifdef democonfigCLIENT_CERTIFICATE_PEM
+            pxNetworkCredentials->pucClientCert = ( const unsigned char * ) democonfigCLIENT_CERTIFICATE_PEM;
+            pxNetworkCredentials->xClientCertSize = sizeof( democonfigCLIENT_CERTIFICATE_PEM );
+            pxNetworkCredentials->pucPrivateKey = ( const unsigned char * ) democonfigCLIENT_PRIVATE_KEY_PEM;
+            pxNetworkCredentials->xPrivateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
+        #endif
+    #endif /* democonfigUSE_DER_CREDENTIALS */
 
     return 0;
 }
@@ -406,6 +439,16 @@ static void prvAzureDemoTask( void * pvParameters )
     ulStatus = prvSetupNetworkCredentials( &xNetworkCredentials );
     configASSERT( ulStatus == 0 );
 
+    ulStatus = ( uint32_t ) Sockets_Init();
+    configASSERT( ulStatus == 0 );
+
+    /* Resolve the first endpoint while the rest of the demo is set up. */
+    #ifdef democonfigENABLE_DPS_SAMPLE
+        Sockets_Prefetch( democonfigENDPOINT );
+    #else
+        Sockets_Prefetch( democonfigHOSTNAME );
+    #endif /* democonfigENABLE_DPS_SAMPLE */
+
     #ifdef democonfigENABLE_DPS_SAMPLE
         /* Run DPS.  */
         if( ( ulStatus = prvIoTHubInfoGet( &xNetworkCredentials, &pucIotHubHostname,
@@ -30,6 +30,11 @@
 /* Demo Specific configs. */
 #include "demo_config.h"
 
+/* DER credentials generated from demo_config.h by tools/pem_to_der.py. */
+#ifdef democonfigUSE_DER_CREDENTIALS
+    #include "demo_config_der.h"
+#endif
+
 /* Demo Specific Interface Functions. */
 #include "azure_sample_connection.h"
 
@@ -298,6 +303,14 @@ static void prvHandleProperties( AzureIoTHubClientPropertiesResponse_t * pxMessa
 }
 /*-----------------------------------------------------------*/
 
+#ifdef democonfigUSE_DER_CREDENTIALS
+    static const uint8_t ucRootCaDer[] = democonfigROOT_CA_DER;
+    #ifdef democonfigCLIENT_CERTIFICATE_DER
+        static const uint8_t ucClientCertDer[] = democonfigCLIENT_CERTIFICATE_DER;
+        static const uint8_t ucPrivateKeyDer[] = democonfigCLIENT_PRIVATE_KEY_DER;
+    #endif
+#endif /* democonfigUSE_DER_CREDENTIALS */
+
 /**
  * @brief Setup transport credentials.
  */
@@ -305,14 +318,28 @@ static uint32_t prvSetupNetworkCredentials( NetworkCredentials_t * pxNetworkCred
 {
     pxNetworkCredentials->xDisableSni = pdFALSE;
     /* Set the credentials for establishing a TLS connection. */
-    pxNetworkCredentials->pucRootCa = ( const unsigned char * ) democonfigROOT_CA_PEM;
-    pxNetworkCredentials->xRootCaSize = sizeof( democonfigROOT_CA_PEM );
-    #ifdef democonfigCLIENT_CERTIFICATE_PEM
-        pxNetworkCredentials->pucClientCert = ( const unsigned char * ) democonfigCLIENT_CERTIFICATE_PEM;
-        pxNetworkCredentials->xClientCertSize = sizeof( democonfigCLIENT_CERTIFICATE_PEM );
-        pxNetworkCredentials->pucPrivateKey = ( const unsigned char * ) democonfigCLIENT_PRIVATE_KEY_PEM;
-        pxNetworkCredentials->xPrivateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
-    #endif
+    #ifdef democonfigUSE_DER_CREDENTIALS
+        pxNetworkCredentials->pucRootCa = ucRootCaDer;
+        pxNetworkCredentials->xRootCaSize = sizeof( ucRootCaDer );
+        pxNetworkCredentials->xRootCaFormat = eTlsCredentialFormatDer;
+        #ifdef democonfigCLIENT_CERTIFICATE_DER
+            pxNetworkCredentials->pucClientCert = ucClientCertDer;
+            pxNetworkCredentials->xClientCertSize = sizeof( ucClientCertDer );
+            pxNetworkCredentials->xClientCertFormat = eTlsCredentialFormatDer;
+            pxNetworkCredentials->pucPrivateKey = ucPrivateKeyDer;
+            pxNetworkCredentials->xPrivateKeySize = sizeof( ucPrivateKeyDer );
+            pxNetworkCredentials->xPrivateKeyFormat = eTlsCredentialFormatDer;
+        #endif
+    #else
+        pxNetworkCredentials->pucRootCa = ( const unsigned char * ) democonfigROOT_CA_PEM;
+        pxNetworkCredentials->xRootCaSize = sizeof( democonfigROOT_CA_PEM );
+        #ifdef democonfigCLIENT_CERTIFICATE_PEM
+            pxNetworkCredentials->pucClientCert = ( const unsigned char * ) democonfigCLIENT_CERTIFICATE_PEM;
+            pxNetworkCredentials->xClientCertSize = sizeof( democonfigCLIENT_CERTIFICATE_PEM );
+            pxNetworkCredentials->pucPrivateKey = ( const unsigned char * ) democonfigCLIENT_PRIVATE_KEY_PEM;
+            pxNetworkCredentials->xPrivateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
+        #endif
+    #endif /* democonfigUSE_DER_CREDENTIALS */
 
     return 0;
 }
@@ -355,6 +382,16 @@ static void prvAzureDemoTask( void * pvParameters )
     ulStatus = prvSetupNetworkCredentials( &xNetworkCredentials );
     configASSERT( ulStatus == 0 );
 
+    ulStatus = ( uint32_t ) Sockets_Init();
+    configASSERT( ulStatus == 0 );
+
+    /* Resolve the first endpoint while the rest of the demo is set up. */
+    #ifdef democonfigENABLE_DPS_SAMPLE
+        Sockets_Prefetch( democonfigENDPOINT );
+    #else
+        Sockets_Prefetch( democonfigHOSTNAME );
+    #endif /* democonfigENABLE_DPS_SAMPLE */
+
     #ifdef democonfigENABLE_DPS_SAMPLE
         /* Run DPS.  */
         if( ( ulStatus = prvIoTHubInfoGet( &xNetworkCredentials, &pucIotHubHostname,
@@ -368,6 +405,9 @@ static void prvAzureDemoTask( void * pvParameters )
 
     xNetworkContext.pParams = &xTlsTransportParams;
 
+    /* Commands and their responses are small and waited on. */
+    xTlsTransportParams.xTrafficClass = eTransportTrafficClassControl;
+
     for( ; ; )
     {
         if( xAzureSample_IsConnectedToInternet() )
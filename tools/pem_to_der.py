@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# SPDX-License-Identifier: MIT
+
+"""Convert the PEM credential macros of a demo_config.h into DER arrays.
+
+For each `#define democonfig<NAME>_PEM` holding a PEM string literal, writes
+`#define democonfig<NAME>_DER { 0x30, ... }` to the output header, so the
+device stores and parses the binary form instead of base64 text. Certificate
+chains become the DER certificates back to back. Macros that do not hold PEM
+(e.g. placeholders) are skipped.
+
+Usage: pem_to_der.py <demo_config.h> <output header>
+"""
+
+import base64
+import re
+import sys
+
+DEFINE_RE = re.compile(r'^[ \t]*#[ \t]*define[ \t]+(democonfig\w+)_PEM\b(.*)$')
+LITERAL_RE = re.compile(r'"((?:[^"\\]|\\.)*)"')
+PEM_RE = re.compile(r'-----BEGIN ([A-Z0-9 ]+)-----(.*?)-----END \1-----', re.S)
+ESCAPES = {'n': '\n', 'r': '\r', 't': '\t', '"': '"', '\\': '\\', "'": "'", '0': '\0'}
+
+
+def read_pem_macros(path):
+    """Return (name, PEM text) for each *_PEM macro defined in the header."""
+    macros = []
+    lines = open(path, encoding='utf-8').read().splitlines()
+    index = 0
+
+    while index < len(lines):
+        match = DEFINE_RE.match(lines[index])
+        index += 1
+
+        if match is None:
+            continue
+
+        body = [match.group(2)]
+
+        while body[-1].rstrip().endswith('\\') and index < len(lines):
+            body[-1] = body[-1].rstrip()[:-1]
+            body.append(lines[index])
+            index += 1
+
+        text = ''.join(LITERAL_RE.findall(' '.join(body)))
+        text = re.sub(r'\\(.)', lambda m: ESCAPES.get(m.group(1), m.group(1)), text)
+        macros.append((match.group(1), text))
+
+    return macros
+
+
+def pem_to_der(text):
+    """Decode every PEM block of the text, in order, into one DER blob."""
+    der = b''
+
+    for block in PEM_RE.finditer(text):
+        if 'Proc-Type' in block.group(2):
+            raise ValueError('encrypted PEM blocks are not supported')
+
+        der += base64.b64decode(''.join(block.group(2).split()))
+
+    return der
+
+
+def format_array(der):
+    rows = []
+
+    for offset in range(0, len(der), 12):
+        rows.append('        ' + ', '.join('0x%02x' % b for b in der[offset:offset + 12]))
+
+    return '    { \\\n' + ', \\\n'.join(rows) + ' \\\n    }'
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write(__doc__)
+        return 1
+
+    output = [
+        '/* Generated by tools/pem_to_der.py from %s. Do not edit. */' % argv[1].replace('\\', '/').split('/')[-1],
+        '',
+        '#ifndef DEMO_CONFIG_DER_H',
+        '#define DEMO_CONFIG_DER_H',
+        '',
+    ]
+
+    for name, text in read_pem_macros(argv[1]):
+        try:
+            der = pem_to_der(text)
+        except ValueError as error:
+            sys.stderr.write('pem_to_der: %s_PEM: %s\n' % (name, error))
+            return 1
+
+        if len(der) == 0:
+            sys.stderr.write('pem_to_der: %s_PEM holds no PEM, skipped\n' % name)
+            continue
+
+        output.append('/* %u bytes, from %u bytes of PEM. */' % (len(der), len(text) + 1))
+        output.append('#define %s_DER \\\n%s' % (name, format_array(der)))
+        output.append('')
+
+    output.append('#endif /* DEMO_CONFIG_DER_H */')
+
+    with open(argv[2], 'w', encoding='utf-8', newline='\n') as header:
+        header.write('\n'.join(output) + '\n')
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))